@@ -0,0 +1,1548 @@
+################################################################################
+# retinaface_native.py
+#
+# Envoltorios ctypes para las etapas nativas compiladas dentro de
+# libnvdsinfer_custom_impl_retinaface.so. Se carga la misma librería que usa
+# nvinfer, así que el estado nativo es compartido con el parser.
+################################################################################
+
+import ctypes
+import os
+
+import numpy as np
+
+LIB_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'retinaface',
+                        'nvdsinfer_customparser', 'libnvdsinfer_custom_impl_retinaface.so')
+
+_lib = None
+
+
+def load_library(path=LIB_PATH):
+    global _lib
+    if _lib is None:
+        _lib = ctypes.CDLL(os.path.abspath(path))
+        _declare(_lib)
+    return _lib
+
+
+class FaceCropRef(ctypes.Structure):
+    _fields_ = [("stream_id", ctypes.c_uint32),
+                ("reserved", ctypes.c_uint32),
+                ("frame_num", ctypes.c_uint64),
+                ("track_id", ctypes.c_uint64),
+                ("left", ctypes.c_float),
+                ("top", ctypes.c_float),
+                ("width", ctypes.c_float),
+                ("height", ctypes.c_float)]
+
+
+class CropBatchConfig(ctypes.Structure):
+    _fields_ = [("crop_width", ctypes.c_int),
+                ("crop_height", ctypes.c_int),
+                ("max_batch_size", ctypes.c_int),
+                ("pool_size", ctypes.c_int),
+                ("deadline_ms", ctypes.c_int),
+                ("net_scale_factor", ctypes.c_float),
+                ("offsets", ctypes.c_float * 3),
+                ("color_format", ctypes.c_int)]
+
+
+class FaceCropBatch(ctypes.Structure):
+    _fields_ = [("tensor", ctypes.POINTER(ctypes.c_float)),
+                ("refs", ctypes.POINTER(FaceCropRef)),
+                ("count", ctypes.c_int),
+                ("slot", ctypes.c_int),
+                ("opened_at_us", ctypes.c_int64)]
+
+
+class PreprocParams(ctypes.Structure):
+    _fields_ = [("net_scale_factor", ctypes.c_float),
+                ("offsets", ctypes.c_float * 3),
+                ("color_format", ctypes.c_int),
+                ("output_type", ctypes.c_int),
+                ("interp", ctypes.c_int)]
+
+
+class FaceQualityGates(ctypes.Structure):
+    _fields_ = [("min_score", ctypes.c_float),
+                ("min_size", ctypes.c_float),
+                ("max_yaw", ctypes.c_float),
+                ("sharpness_ref", ctypes.c_float)]
+
+
+FACE_QUALITY_DTYPE = np.dtype([("sharpness", np.float32), ("yaw", np.float32),
+                               ("score", np.float32), ("passed", np.int32)])
+
+
+class RecognitionRequest(ctypes.Structure):
+    _fields_ = [("stream_id", ctypes.c_uint32),
+                ("reserved", ctypes.c_uint32),
+                ("frame_num", ctypes.c_uint64),
+                ("track_id", ctypes.c_uint64),
+                ("payload", ctypes.c_uint64),
+                ("quality", ctypes.c_float),
+                ("priority", ctypes.c_float),
+                ("enqueue_ms", ctypes.c_int64),
+                ("deadline_ms", ctypes.c_int64)]
+
+
+class SchedulerConfig(ctypes.Structure):
+    _fields_ = [("quality_weight", ctypes.c_float),
+                ("novelty_weight", ctypes.c_float),
+                ("age_per_second", ctypes.c_float),
+                ("novelty_time_ms", ctypes.c_float),
+                ("max_pending_per_stream", ctypes.c_int)]
+
+
+class SchedulerStats(ctypes.Structure):
+    _fields_ = [("submitted", ctypes.c_uint64),
+                ("served", ctypes.c_uint64),
+                ("expired", ctypes.c_uint64),
+                ("evicted", ctypes.c_uint64),
+                ("coalesced", ctypes.c_uint64),
+                ("pending", ctypes.c_uint64)]
+
+
+class ZoneStats(ctypes.Structure):
+    _fields_ = [("zone", ctypes.c_int32),
+                ("current", ctypes.c_int32),
+                ("peak", ctypes.c_int32),
+                ("average", ctypes.c_float)]
+
+
+class LineStats(ctypes.Structure):
+    _fields_ = [("line", ctypes.c_int32),
+                ("in_count", ctypes.c_uint32),
+                ("out_count", ctypes.c_uint32),
+                ("reserved", ctypes.c_uint32),
+                ("total_in", ctypes.c_uint64),
+                ("total_out", ctypes.c_uint64)]
+
+
+class ArchiveBlockInfo(ctypes.Structure):
+    _fields_ = [("magic", ctypes.c_uint32),
+                ("count", ctypes.c_uint32),
+                ("stream_id", ctypes.c_uint32),
+                ("payload_bytes", ctypes.c_uint32),
+                ("track_id", ctypes.c_uint64),
+                ("first_frame", ctypes.c_uint64),
+                ("first_ts_ms", ctypes.c_int64),
+                ("last_ts_ms", ctypes.c_int64),
+                ("max_score", ctypes.c_float),
+                ("min_size", ctypes.c_float),
+                ("max_size", ctypes.c_float),
+                ("bounds", ctypes.c_float * 4),
+                ("reserved", ctypes.c_uint32),
+                ("offset", ctypes.c_uint64)]
+
+
+ARCHIVE_RECORD_DTYPE = np.dtype([("frame_num", np.uint64), ("ts_ms", np.int64),
+                                 ("box", np.float32, 4), ("score", np.float32),
+                                 ("landmarks", np.float32, 10)], align=True)
+
+class ArchiveQuery(ctypes.Structure):
+    _fields_ = [("t0", ctypes.c_int64),
+                ("t1", ctypes.c_int64),
+                ("track_id", ctypes.c_uint64),
+                ("stream_id", ctypes.c_int32),
+                ("min_score", ctypes.c_float),
+                ("min_size", ctypes.c_float),
+                ("max_size", ctypes.c_float),
+                ("max_results", ctypes.c_int32),
+                ("threads", ctypes.c_int32)]
+
+
+class QueryStats(ctypes.Structure):
+    _fields_ = [("segments", ctypes.c_uint64),
+                ("blocks", ctypes.c_uint64),
+                ("blocks_scanned", ctypes.c_uint64),
+                ("records_scanned", ctypes.c_uint64),
+                ("hits", ctypes.c_uint64),
+                ("truncated", ctypes.c_int32),
+                ("reserved", ctypes.c_int32),
+                ("elapsed_ms", ctypes.c_double)]
+
+
+QUERY_HIT_DTYPE = np.dtype([("stream_id", np.uint32), ("reserved", np.uint32), ("track_id", np.uint64),
+                            ("record", ARCHIVE_RECORD_DTYPE)], align=True)
+QUERY_ANY_TRACK = (1 << 64) - 1
+
+class WriterConfig(ctypes.Structure):
+    _fields_ = [("buffer_size", ctypes.c_int),
+                ("buffer_count", ctypes.c_int),
+                ("threads", ctypes.c_int),
+                ("queue_depth", ctypes.c_int),
+                ("direct_io", ctypes.c_int),
+                ("backend", ctypes.c_int)]
+
+
+class WriterStats(ctypes.Structure):
+    _fields_ = [("submitted", ctypes.c_uint64),
+                ("completed", ctypes.c_uint64),
+                ("failed", ctypes.c_uint64),
+                ("dropped", ctypes.c_uint64),
+                ("bytes", ctypes.c_uint64),
+                ("pending", ctypes.c_int32),
+                ("backend", ctypes.c_int32)]
+
+
+class AdaptiveJpegConfig(ctypes.Structure):
+    _fields_ = [("min_quality", ctypes.c_int32),
+                ("max_quality", ctypes.c_int32),
+                ("max_downscale", ctypes.c_int32),
+                ("interval_ms", ctypes.c_int32),
+                ("high_water", ctypes.c_float),
+                ("low_water", ctypes.c_float)]
+
+
+class JpegStreamQuality(ctypes.Structure):
+    _fields_ = [("quality", ctypes.c_int32),
+                ("downscale", ctypes.c_int32),
+                ("bytes_per_frame", ctypes.c_float),
+                ("fps", ctypes.c_float),
+                ("bandwidth", ctypes.c_float),
+                ("occupancy", ctypes.c_float),
+                ("frames", ctypes.c_uint64),
+                ("dropped", ctypes.c_uint64),
+                ("decreases", ctypes.c_uint64),
+                ("increases", ctypes.c_uint64)]
+
+
+WRITER_BACKEND_AUTO = 0
+WRITER_BACKEND_THREADS = 1
+WRITER_BACKEND_IO_URING = 2
+
+
+class QosClassConfig(ctypes.Structure):
+    _fields_ = [("min_fps", ctypes.c_float),
+                ("max_fps", ctypes.c_float)]
+
+
+class QosConfig(ctypes.Structure):
+    _fields_ = [("capacity_fps", ctypes.c_float),
+                ("max_inflight", ctypes.c_int),
+                ("update_period_ms", ctypes.c_int)]
+
+
+class QosClassStats(ctypes.Structure):
+    _fields_ = [("cls", ctypes.c_int32),
+                ("sources", ctypes.c_int32),
+                ("demand_fps", ctypes.c_float),
+                ("admitted_fps", ctypes.c_float),
+                ("achieved_fps", ctypes.c_float),
+                ("reserved", ctypes.c_float),
+                ("dropped", ctypes.c_uint64)]
+
+class CropMergeConfig(ctypes.Structure):
+    _fields_ = [("gie_unique_id", ctypes.c_int),
+                ("iou_threshold", ctypes.c_float),
+                ("contain_threshold", ctypes.c_float)]
+
+
+class CropMergeStats(ctypes.Structure):
+    _fields_ = [("frames", ctypes.c_uint64),
+                ("faces", ctypes.c_uint64),
+                ("merged", ctypes.c_uint64)]
+
+
+class AssociationConfig(ctypes.Structure):
+    _fields_ = [("cell_size", ctypes.c_float),
+                ("min_score", ctypes.c_float),
+                ("head_fraction", ctypes.c_float)]
+
+
+class AssociationProbeConfig(ctypes.Structure):
+    _fields_ = [("face_gie_id", ctypes.c_int),
+                ("person_gie_id", ctypes.c_int),
+                ("person_class_id", ctypes.c_int),
+                ("association", AssociationConfig)]
+
+
+class AssociationStats(ctypes.Structure):
+    _fields_ = [("frames", ctypes.c_uint64),
+                ("faces", ctypes.c_uint64),
+                ("persons", ctypes.c_uint64),
+                ("associated", ctypes.c_uint64)]
+
+
+FRAME_META_DTYPE = np.dtype([("source_id", np.uint32), ("batch_id", np.uint32), ("pad_index", np.uint32),
+                             ("frame_num", np.int32), ("buf_pts", np.uint64), ("ntp_timestamp", np.uint64),
+                             ("num_objects", np.uint32), ("first_object", np.uint32)], align=True)
+OBJECT_META_DTYPE = np.dtype([("frame_index", np.uint32), ("source_id", np.uint32), ("frame_num", np.int32),
+                              ("class_id", np.int32), ("object_id", np.uint64), ("gie_id", np.int32),
+                              ("confidence", np.float32), ("box", np.float32, (4,)),
+                              ("landmarks", np.float32, (10,)), ("parent_index", np.int32),
+                              ("has_landmarks", np.int32), ("parent_object_id", np.uint64),
+                              ("quality", np.float32), ("has_quality", np.int32)], align=True)
+
+class DvrConfig(ctypes.Structure):
+    _fields_ = [("data_bytes", ctypes.c_uint64),
+                ("max_records", ctypes.c_int32),
+                ("index_sync_interval", ctypes.c_int32),
+                ("bucket_ms", ctypes.c_int32)]
+
+
+class DvrRecordInfo(ctypes.Structure):
+    _fields_ = [("seq", ctypes.c_uint64),
+                ("ts_ms", ctypes.c_int64),
+                ("frame_num", ctypes.c_int64),
+                ("offset", ctypes.c_uint64),
+                ("size", ctypes.c_uint32),
+                ("reserved", ctypes.c_uint32)]
+
+
+class DvrStats(ctypes.Structure):
+    _fields_ = [("records", ctypes.c_uint64),
+                ("appended", ctypes.c_uint64),
+                ("overwritten", ctypes.c_uint64),
+                ("failed", ctypes.c_uint64),
+                ("oldest_ts_ms", ctypes.c_int64),
+                ("newest_ts_ms", ctypes.c_int64),
+                ("used_bytes", ctypes.c_uint64)]
+
+
+class SmoothingConfig(ctypes.Structure):
+    _fields_ = [("min_cutoff", ctypes.c_float),
+                ("beta", ctypes.c_float),
+                ("derivative_cutoff", ctypes.c_float),
+                ("max_age_ms", ctypes.c_int32)]
+
+
+FACE_EVENT_TYPES = ('enter', 'update', 'exit')
+
+
+class FaceEventConfig(ctypes.Structure):
+    _fields_ = [("enter_frames", ctypes.c_int32),
+                ("min_duration_ms", ctypes.c_int32),
+                ("exit_timeout_ms", ctypes.c_int32),
+                ("heartbeat_ms", ctypes.c_int32)]
+
+
+class FaceEvent(ctypes.Structure):
+    _fields_ = [("track_id", ctypes.c_uint64),
+                ("ts_ms", ctypes.c_int64),
+                ("first_seen_ms", ctypes.c_int64),
+                ("last_seen_ms", ctypes.c_int64),
+                ("stream_id", ctypes.c_uint32),
+                ("type", ctypes.c_int32),
+                ("box", ctypes.c_float * 4),
+                ("confidence", ctypes.c_float),
+                ("max_confidence", ctypes.c_float),
+                ("observations", ctypes.c_int32),
+                ("reserved", ctypes.c_int32)]
+
+
+class FaceEventStats(ctypes.Structure):
+    _fields_ = [("detections", ctypes.c_uint64),
+                ("enters", ctypes.c_uint64),
+                ("updates", ctypes.c_uint64),
+                ("exits", ctypes.c_uint64),
+                ("discarded", ctypes.c_uint64),
+                ("pending", ctypes.c_uint64)]
+
+
+PARSER_NMS_MODES = {'hard': 0, 'soft': 1, 'none': 2}
+PARSER_NMS_KERNELS = {'float': 0, 'int16': 1}
+PARSER_BEST_FACE = {'off': 0, 'score': 1, 'largest': 2}
+MAX_PARSER_ROIS = 8
+
+
+class ParserConfig(ctypes.Structure):
+    _fields_ = [("conf_threshold", ctypes.c_float),
+                ("nms_threshold", ctypes.c_float),
+                ("nms_mode", ctypes.c_int32),
+                ("soft_nms_sigma", ctypes.c_float),
+                ("pre_nms_top_k", ctypes.c_int32),
+                ("top_k", ctypes.c_int32),
+                ("min_face_size", ctypes.c_float),
+                ("num_rois", ctypes.c_int32),
+                ("rois", (ctypes.c_float * 4) * MAX_PARSER_ROIS),
+                ("log_detections", ctypes.c_int32),
+                ("decode_threads", ctypes.c_int32),
+                ("parallel_min_anchors", ctypes.c_int32),
+                ("nms_kernel", ctypes.c_int32),
+                ("nms_verify", ctypes.c_int32),
+                ("best_face", ctypes.c_int32),
+                ("version", ctypes.c_uint32)]
+
+
+class ParserShadowStats(ctypes.Structure):
+    _fields_ = [("sampled", ctypes.c_uint64),
+                ("compared", ctypes.c_uint64),
+                ("dropped", ctypes.c_uint64),
+                ("active_faces", ctypes.c_uint64),
+                ("shadow_faces", ctypes.c_uint64),
+                ("matched", ctypes.c_uint64),
+                ("missed", ctypes.c_uint64),
+                ("extra", ctypes.c_uint64),
+                ("disagreeing", ctypes.c_uint64),
+                ("active_us", ctypes.c_double),
+                ("shadow_us", ctypes.c_double),
+                ("iou_sum", ctypes.c_double),
+                ("score_delta_sum", ctypes.c_double)]
+
+
+class FlightRecorderConfig(ctypes.Structure):
+    _fields_ = [("frames", ctypes.c_int32),
+                ("percentile", ctypes.c_float),
+                ("window", ctypes.c_int32),
+                ("min_samples", ctypes.c_int32),
+                ("cooldown_ms", ctypes.c_int32)]
+
+
+class FlightRecorderStats(ctypes.Structure):
+    _fields_ = [("recorded", ctypes.c_uint64),
+                ("skipped", ctypes.c_uint64),
+                ("dumps", ctypes.c_uint64),
+                ("failed_dumps", ctypes.c_uint64),
+                ("threshold_us", ctypes.c_float),
+                ("threshold_candidates", ctypes.c_int32)]
+
+
+class FlightDumpHeader(ctypes.Structure):
+    _fields_ = [("magic", ctypes.c_char * 4),
+                ("version", ctypes.c_uint32),
+                ("count", ctypes.c_uint32),
+                ("trigger", ctypes.c_uint32),
+                ("trigger_seq", ctypes.c_uint64),
+                ("percentile", ctypes.c_float),
+                ("threshold_us", ctypes.c_float),
+                ("threshold_candidates", ctypes.c_int32),
+                ("reserved", ctypes.c_uint32)]
+
+
+class FlightRecord(ctypes.Structure):
+    _fields_ = [("seq", ctypes.c_uint64),
+                ("wall_ns", ctypes.c_int64),
+                ("parse_us", ctypes.c_float),
+                ("candidates", ctypes.c_int32),
+                ("faces", ctypes.c_int32),
+                ("input_width", ctypes.c_int32),
+                ("input_height", ctypes.c_int32),
+                ("num_anchors", ctypes.c_uint32),
+                ("num_stored", ctypes.c_uint32),
+                ("config", ParserConfig)]
+
+
+class FlightReplayResult(ctypes.Structure):
+    _fields_ = [("seq", ctypes.c_uint64),
+                ("recorded_us", ctypes.c_float),
+                ("replay_us", ctypes.c_float),
+                ("candidates", ctypes.c_int32),
+                ("faces", ctypes.c_int32)]
+
+
+class NmsVerifyStats(ctypes.Structure):
+    _fields_ = [("units", ctypes.c_uint64),
+                ("differing_units", ctypes.c_uint64),
+                ("out_of_band", ctypes.c_uint64)]
+
+
+PREPROC_OUTPUT_FP32 = 0
+PREPROC_OUTPUT_FP16 = 1
+PREPROC_INTERP_BILINEAR = 0
+PREPROC_INTERP_AREA = 1
+
+
+def _declare(lib):
+    lib.RetinaFaceCropBatchCreate.restype = ctypes.c_void_p
+    lib.RetinaFaceCropBatchCreate.argtypes = [ctypes.POINTER(CropBatchConfig)]
+    lib.RetinaFaceCropBatchDestroy.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceCropBatchAdd.restype = ctypes.c_int
+    lib.RetinaFaceCropBatchAdd.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int,
+                                           ctypes.c_int, ctypes.c_int, ctypes.c_void_p,
+                                           ctypes.c_void_p, ctypes.POINTER(FaceCropRef)]
+    lib.RetinaFaceCropBatchAcquire.restype = ctypes.POINTER(FaceCropBatch)
+    lib.RetinaFaceCropBatchAcquire.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceCropBatchFlush.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceCropBatchRelease.argtypes = [ctypes.c_void_p, ctypes.POINTER(FaceCropBatch)]
+    lib.RetinaFaceEvaluateQuality.restype = ctypes.c_int
+    lib.RetinaFaceEvaluateQuality.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+                                              ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
+                                              ctypes.c_int, ctypes.POINTER(FaceQualityGates),
+                                              ctypes.c_void_p]
+    lib.RetinaFaceBestShotCreate.restype = ctypes.c_void_p
+    lib.RetinaFaceBestShotCreate.argtypes = [ctypes.c_uint64]
+    lib.RetinaFaceBestShotDestroy.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceBestShotOffer.restype = ctypes.c_int
+    lib.RetinaFaceBestShotOffer.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint64,
+                                            ctypes.c_uint64, ctypes.c_void_p, ctypes.c_void_p]
+    lib.RetinaFaceBestShotTake.restype = ctypes.c_int
+    lib.RetinaFaceBestShotTake.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint64,
+                                           ctypes.POINTER(ctypes.c_uint64),
+                                           ctypes.POINTER(ctypes.c_float), ctypes.c_void_p]
+    lib.RetinaFaceBestShotForget.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint64]
+    lib.RetinaFaceBestShotExpired.restype = ctypes.c_uint64
+    lib.RetinaFaceBestShotExpired.argtypes = [ctypes.c_void_p]
+    lib.RetinaFacePerceptualHash.restype = ctypes.c_uint64
+    lib.RetinaFacePerceptualHash.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+                                             ctypes.c_void_p, ctypes.c_void_p]
+    lib.RetinaFaceDedupCreate.restype = ctypes.c_void_p
+    lib.RetinaFaceDedupCreate.argtypes = [ctypes.c_int, ctypes.c_int64, ctypes.c_int]
+    lib.RetinaFaceDedupDestroy.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceDedupCheck.restype = ctypes.c_int
+    lib.RetinaFaceDedupCheck.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint64, ctypes.c_int64]
+    lib.RetinaFaceDedupResetStream.argtypes = [ctypes.c_void_p, ctypes.c_uint32]
+    lib.RetinaFaceSchedulerCreate.restype = ctypes.c_void_p
+    lib.RetinaFaceSchedulerCreate.argtypes = [ctypes.POINTER(SchedulerConfig)]
+    lib.RetinaFaceSchedulerDestroy.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceSchedulerSubmit.restype = ctypes.c_int
+    lib.RetinaFaceSchedulerSubmit.argtypes = [ctypes.c_void_p, ctypes.POINTER(RecognitionRequest),
+                                              ctypes.c_int64]
+    lib.RetinaFaceSchedulerPop.restype = ctypes.c_int
+    lib.RetinaFaceSchedulerPop.argtypes = [ctypes.c_void_p, ctypes.POINTER(RecognitionRequest),
+                                           ctypes.c_int, ctypes.c_int64]
+    lib.RetinaFaceSchedulerMarkRecognized.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint64,
+                                                      ctypes.c_int64]
+    lib.RetinaFaceSchedulerForgetTrack.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint64]
+    lib.RetinaFaceSchedulerGetStats.argtypes = [ctypes.c_void_p, ctypes.POINTER(SchedulerStats)]
+    lib.RetinaFaceZonesCreate.restype = ctypes.c_void_p
+    lib.RetinaFaceZonesCreate.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int64, ctypes.c_int64]
+    lib.RetinaFaceZonesDestroy.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceZonesConfigureStream.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_float,
+                                                   ctypes.c_float]
+    lib.RetinaFaceZonesAddZone.restype = ctypes.c_int
+    lib.RetinaFaceZonesAddZone.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_void_p, ctypes.c_int]
+    lib.RetinaFaceZonesAddLine.restype = ctypes.c_int
+    lib.RetinaFaceZonesAddLine.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_float, ctypes.c_float,
+                                           ctypes.c_float, ctypes.c_float]
+    lib.RetinaFaceZonesUpdate.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_int64, ctypes.c_void_p,
+                                          ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p]
+    lib.RetinaFaceZonesPoll.restype = ctypes.c_int
+    lib.RetinaFaceZonesPoll.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_int64,
+                                        ctypes.POINTER(ZoneStats), ctypes.POINTER(ctypes.c_int),
+                                        ctypes.POINTER(LineStats), ctypes.POINTER(ctypes.c_int)]
+    lib.RetinaFaceArchiveOpenWriter.restype = ctypes.c_void_p
+    lib.RetinaFaceArchiveOpenWriter.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_float]
+    lib.RetinaFaceArchiveAppend.restype = ctypes.c_int
+    lib.RetinaFaceArchiveAppend.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_void_p,
+                                            ctypes.c_void_p, ctypes.c_int]
+    lib.RetinaFaceArchiveCloseTrack.restype = ctypes.c_int
+    lib.RetinaFaceArchiveCloseTrack.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint64]
+    lib.RetinaFaceArchiveCloseWriter.restype = ctypes.c_int
+    lib.RetinaFaceArchiveCloseWriter.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceArchiveOpenReader.restype = ctypes.c_void_p
+    lib.RetinaFaceArchiveOpenReader.argtypes = [ctypes.c_char_p]
+    lib.RetinaFaceArchiveCloseReader.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceArchiveBlockCount.restype = ctypes.c_int
+    lib.RetinaFaceArchiveBlockCount.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceArchiveGetBlock.restype = ctypes.c_int
+    lib.RetinaFaceArchiveGetBlock.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ArchiveBlockInfo)]
+    lib.RetinaFaceArchiveTrackBlocks.restype = ctypes.c_int
+    lib.RetinaFaceArchiveTrackBlocks.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint64,
+                                                 ctypes.c_int64, ctypes.c_int64, ctypes.c_void_p, ctypes.c_int]
+    lib.RetinaFaceArchiveReadBlock.restype = ctypes.c_int
+    lib.RetinaFaceArchiveReadBlock.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int]
+    lib.RetinaFaceArchiveQuery.restype = ctypes.c_int
+    lib.RetinaFaceArchiveQuery.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.c_int,
+                                           ctypes.POINTER(ArchiveQuery), ctypes.c_void_p, ctypes.c_int,
+                                           ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(QueryStats)]
+    lib.RetinaFaceWriterCreate.restype = ctypes.c_void_p
+    lib.RetinaFaceWriterCreate.argtypes = [ctypes.POINTER(WriterConfig)]
+    lib.RetinaFaceWriterDestroy.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceWriterAcquire.restype = ctypes.c_void_p
+    lib.RetinaFaceWriterAcquire.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceWriterRelease.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+    lib.RetinaFaceWriterSubmitFile.restype = ctypes.c_int
+    lib.RetinaFaceWriterSubmitFile.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64,
+                                               ctypes.c_char_p]
+    lib.RetinaFaceWriterSubmitAt.restype = ctypes.c_int
+    lib.RetinaFaceWriterSubmitAt.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64, ctypes.c_int,
+                                             ctypes.c_uint64]
+    lib.RetinaFaceWriterWriteFile.restype = ctypes.c_int
+    lib.RetinaFaceWriterWriteFile.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64,
+                                              ctypes.c_char_p]
+    lib.RetinaFaceWriterFlush.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceWriterGetStats.argtypes = [ctypes.c_void_p, ctypes.POINTER(WriterStats)]
+    lib.RetinaFaceWriterSaveSurfaceJpeg.restype = ctypes.c_int
+    lib.RetinaFaceWriterSaveSurfaceJpeg.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_char_p,
+                                                    ctypes.c_int, ctypes.c_void_p, ctypes.c_int]
+    lib.RetinaFaceWriterSaveSurfaceJpegAdaptive.restype = ctypes.c_int
+    lib.RetinaFaceWriterSaveSurfaceJpegAdaptive.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int,
+                                                            ctypes.c_uint32, ctypes.c_char_p, ctypes.c_int,
+                                                            ctypes.c_void_p, ctypes.c_int]
+    lib.RetinaFaceWriterEnableAdaptiveJpeg.argtypes = [ctypes.c_void_p, ctypes.POINTER(AdaptiveJpegConfig)]
+    lib.RetinaFaceWriterJpegSettings.restype = ctypes.c_int
+    lib.RetinaFaceWriterJpegSettings.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.POINTER(ctypes.c_int),
+                                                 ctypes.POINTER(ctypes.c_int)]
+    lib.RetinaFaceWriterReportJpeg.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint64, ctypes.c_int]
+    lib.RetinaFaceWriterJpegQuality.restype = ctypes.c_int
+    lib.RetinaFaceWriterJpegQuality.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.POINTER(JpegStreamQuality)]
+    lib.RetinaFaceQosCreate.restype = ctypes.c_void_p
+    lib.RetinaFaceQosCreate.argtypes = [ctypes.POINTER(QosConfig)]
+    lib.RetinaFaceQosDestroy.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceQosAddClass.restype = ctypes.c_int
+    lib.RetinaFaceQosAddClass.argtypes = [ctypes.c_void_p, ctypes.POINTER(QosClassConfig)]
+    lib.RetinaFaceQosAttachSource.restype = ctypes.c_int
+    lib.RetinaFaceQosAttachSource.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint32, ctypes.c_int]
+    lib.RetinaFaceQosAttachProcessed.restype = ctypes.c_int
+    lib.RetinaFaceQosAttachProcessed.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+    lib.RetinaFaceQosGetClassStats.restype = ctypes.c_int
+    lib.RetinaFaceQosGetClassStats.argtypes = [ctypes.c_void_p, ctypes.POINTER(QosClassStats), ctypes.c_int]
+    lib.RetinaFaceQosGetCapacity.restype = ctypes.c_float
+    lib.RetinaFaceQosGetCapacity.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceSecondaryAttachMerge.restype = ctypes.c_void_p
+    lib.RetinaFaceSecondaryAttachMerge.argtypes = [ctypes.c_void_p, ctypes.POINTER(CropMergeConfig)]
+    lib.RetinaFaceSecondaryGetMergeStats.argtypes = [ctypes.c_void_p, ctypes.POINTER(CropMergeStats)]
+    lib.RetinaFaceAssociate.restype = ctypes.c_int
+    lib.RetinaFaceAssociate.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int,
+                                        ctypes.POINTER(AssociationConfig), ctypes.c_void_p, ctypes.c_void_p]
+    lib.RetinaFaceAssociationAttach.restype = ctypes.c_void_p
+    lib.RetinaFaceAssociationAttach.argtypes = [ctypes.c_void_p, ctypes.POINTER(AssociationProbeConfig)]
+    lib.RetinaFaceAssociationGetStats.argtypes = [ctypes.c_void_p, ctypes.POINTER(AssociationStats)]
+    lib.RetinaFaceExportBatchMeta.restype = ctypes.c_int
+    lib.RetinaFaceExportBatchMeta.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int,
+                                              ctypes.POINTER(ctypes.c_int), ctypes.c_void_p, ctypes.c_int]
+    lib.RetinaFaceAttachQuality.restype = ctypes.c_int
+    lib.RetinaFaceAttachQuality.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_int, ctypes.c_void_p,
+                                            ctypes.c_int]
+    lib.RetinaFaceDvrOpen.restype = ctypes.c_void_p
+    lib.RetinaFaceDvrOpen.argtypes = [ctypes.c_char_p, ctypes.POINTER(DvrConfig), ctypes.c_void_p]
+    lib.RetinaFaceDvrClose.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceDvrWrite.restype = ctypes.c_int
+    lib.RetinaFaceDvrWrite.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64, ctypes.c_int64,
+                                       ctypes.c_int64]
+    lib.RetinaFaceDvrSaveSurfaceJpeg.restype = ctypes.c_int
+    lib.RetinaFaceDvrSaveSurfaceJpeg.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int64,
+                                                 ctypes.c_int64, ctypes.c_int, ctypes.c_void_p, ctypes.c_int]
+    lib.RetinaFaceDvrFind.restype = ctypes.c_int
+    lib.RetinaFaceDvrFind.argtypes = [ctypes.c_void_p, ctypes.c_int64, ctypes.POINTER(DvrRecordInfo)]
+    lib.RetinaFaceDvrRecord.restype = ctypes.c_int
+    lib.RetinaFaceDvrRecord.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.POINTER(DvrRecordInfo)]
+    lib.RetinaFaceDvrRead.restype = ctypes.c_int64
+    lib.RetinaFaceDvrRead.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_void_p, ctypes.c_uint64]
+    lib.RetinaFaceDvrSync.restype = ctypes.c_int
+    lib.RetinaFaceDvrSync.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceDvrGetStats.argtypes = [ctypes.c_void_p, ctypes.POINTER(DvrStats)]
+    lib.RetinaFaceSmoothingCreate.restype = ctypes.c_void_p
+    lib.RetinaFaceSmoothingCreate.argtypes = [ctypes.POINTER(SmoothingConfig)]
+    lib.RetinaFaceSmoothingDestroy.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceSmoothingUpdate.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_int64, ctypes.c_void_p,
+                                              ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int]
+    lib.RetinaFaceSmoothingResetStream.argtypes = [ctypes.c_void_p, ctypes.c_uint32]
+    lib.RetinaFaceSmoothingTrackCount.restype = ctypes.c_int
+    lib.RetinaFaceSmoothingTrackCount.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceEventsCreate.restype = ctypes.c_void_p
+    lib.RetinaFaceEventsCreate.argtypes = [ctypes.POINTER(FaceEventConfig)]
+    lib.RetinaFaceEventsDestroy.argtypes = [ctypes.c_void_p]
+    lib.RetinaFaceEventsUpdate.restype = ctypes.c_int
+    lib.RetinaFaceEventsUpdate.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_int64, ctypes.c_void_p,
+                                           ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int]
+    lib.RetinaFaceEventsFlush.restype = ctypes.c_int
+    lib.RetinaFaceEventsFlush.argtypes = [ctypes.c_void_p, ctypes.c_int64]
+    lib.RetinaFaceEventsDrain.restype = ctypes.c_int
+    lib.RetinaFaceEventsDrain.argtypes = [ctypes.c_void_p, ctypes.POINTER(FaceEvent), ctypes.c_int]
+    lib.RetinaFaceEventsGetStats.restype = None
+    lib.RetinaFaceEventsGetStats.argtypes = [ctypes.c_void_p, ctypes.POINTER(FaceEventStats)]
+    lib.RetinaFaceParserConfigLoad.restype = ctypes.c_int
+    lib.RetinaFaceParserConfigLoad.argtypes = [ctypes.c_char_p]
+    lib.RetinaFaceParserConfigWatch.restype = ctypes.c_int
+    lib.RetinaFaceParserConfigWatch.argtypes = [ctypes.c_char_p, ctypes.c_int]
+    lib.RetinaFaceParserConfigStopWatch.argtypes = []
+    lib.RetinaFaceParserConfigRollback.restype = ctypes.c_int
+    lib.RetinaFaceParserConfigRollback.argtypes = []
+    lib.RetinaFaceParserConfigPublish.restype = ctypes.c_int
+    lib.RetinaFaceParserConfigPublish.argtypes = [ctypes.POINTER(ParserConfig)]
+    lib.RetinaFaceParserConfigGet.argtypes = [ctypes.POINTER(ParserConfig)]
+    lib.RetinaFaceParserConfigFailures.restype = ctypes.c_uint64
+    lib.RetinaFaceParserConfigFailures.argtypes = []
+    lib.RetinaFaceParserShadowStart.restype = ctypes.c_int
+    lib.RetinaFaceParserShadowStart.argtypes = [ctypes.POINTER(ParserConfig), ctypes.c_float, ctypes.c_int]
+    lib.RetinaFaceParserShadowLoad.restype = ctypes.c_int
+    lib.RetinaFaceParserShadowLoad.argtypes = [ctypes.c_char_p, ctypes.c_float, ctypes.c_int]
+    lib.RetinaFaceParserShadowStop.argtypes = []
+    lib.RetinaFaceParserShadowGetStats.argtypes = [ctypes.POINTER(ParserShadowStats)]
+    lib.RetinaFaceFlightRecorderStart.restype = ctypes.c_int
+    lib.RetinaFaceFlightRecorderStart.argtypes = [ctypes.c_char_p, ctypes.POINTER(FlightRecorderConfig)]
+    lib.RetinaFaceFlightRecorderStop.argtypes = []
+    lib.RetinaFaceFlightRecorderDump.restype = ctypes.c_int
+    lib.RetinaFaceFlightRecorderDump.argtypes = []
+    lib.RetinaFaceFlightRecorderGetStats.argtypes = [ctypes.POINTER(FlightRecorderStats)]
+    lib.RetinaFaceFlightReplay.restype = ctypes.c_int
+    lib.RetinaFaceFlightReplay.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.POINTER(FlightReplayResult),
+                                           ctypes.c_int]
+    lib.RetinaFaceNmsInt16Lanes.restype = ctypes.c_int
+    lib.RetinaFaceNmsInt16Lanes.argtypes = []
+    lib.RetinaFaceNmsVerifyStats.restype = None
+    lib.RetinaFaceNmsVerifyStats.argtypes = [ctypes.POINTER(NmsVerifyStats)]
+    lib.RetinaFaceResizeNormalize.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+                                              ctypes.c_void_p, ctypes.c_int, ctypes.c_int,
+                                              ctypes.POINTER(PreprocParams), ctypes.c_void_p]
+
+
+def _as_f32(values, count):
+    if values is None:
+        return None
+    arr = np.ascontiguousarray(values, dtype=np.float32).reshape(-1)
+    if arr.size < count:
+        raise ValueError("se esperaban al menos %d valores" % count)
+    return arr
+
+
+def read_nvinfer_preprocess(config_path):
+    """Lee net-scale-factor, offsets y model-color-format de un config de nvinfer."""
+    scale, offsets, color = 1.0, [0.0, 0.0, 0.0], 0
+    with open(config_path) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith('#') or '=' not in line:
+                continue
+            key, value = [s.strip() for s in line.split('=', 1)]
+            if key == 'net-scale-factor':
+                scale = float(value)
+            elif key == 'offsets':
+                offsets = [float(v) for v in value.split(';') if v]
+            elif key == 'model-color-format':
+                color = int(value)
+    return scale, offsets, color
+
+
+def resize_normalize(frame_rgba, roi, width, height, net_scale_factor=1.0, offsets=(0.0, 0.0, 0.0),
+                     color_format=0, fp16=False, area=False, out=None):
+    """Resize + RGBA->RGB/BGR + normalización de una región en una pasada.
+    Devuelve un array 3 x height x width (float32 o float16)."""
+    lib = load_library()
+    dtype = np.float16 if fp16 else np.float32
+    if out is None:
+        out = np.empty((3, height, width), dtype=dtype)
+    roi_arr = _as_f32(roi, 4)
+    params = PreprocParams(net_scale_factor, (ctypes.c_float * 3)(*offsets), color_format,
+                           PREPROC_OUTPUT_FP16 if fp16 else PREPROC_OUTPUT_FP32,
+                           PREPROC_INTERP_AREA if area else PREPROC_INTERP_BILINEAR)
+    lib.RetinaFaceResizeNormalize(frame_rgba.ctypes.data, frame_rgba.strides[0], frame_rgba.shape[1],
+                                  frame_rgba.shape[0], roi_arr.ctypes.data, width, height,
+                                  ctypes.byref(params), out.ctypes.data)
+    return out
+
+
+def evaluate_face_quality(frame_rgba, boxes, scores=None, landmarks=None, min_score=0.5,
+                          min_size=24.0, max_yaw=0.8, sharpness_ref=100.0):
+    """boxes: Nx4 [left, top, width, height]. Devuelve un array FACE_QUALITY_DTYPE
+    con la nitidez calculada solo para los rostros que pasan los filtros baratos."""
+    lib = load_library()
+    boxes_arr = _as_f32(boxes, 0)
+    count = boxes_arr.size // 4
+    out = np.zeros(count, dtype=FACE_QUALITY_DTYPE)
+    if count == 0:
+        return out
+    scores_arr = _as_f32(scores, count)
+    lm_arr = _as_f32(landmarks, count * 10)
+    gates = FaceQualityGates(min_score, min_size, max_yaw, sharpness_ref)
+    lib.RetinaFaceEvaluateQuality(frame_rgba.ctypes.data, frame_rgba.strides[0], frame_rgba.shape[1],
+                                  frame_rgba.shape[0], boxes_arr.ctypes.data,
+                                  scores_arr.ctypes.data if scores_arr is not None else None,
+                                  lm_arr.ctypes.data if lm_arr is not None else None,
+                                  count, ctypes.byref(gates), out.ctypes.data)
+    return out
+
+
+def face_perceptual_hash(frame_rgba, box, landmarks=None):
+    """pHash de 64 bits del rostro (alineado si se pasan landmarks)."""
+    lib = load_library()
+    box_arr = _as_f32(box, 4)
+    lm_arr = _as_f32(landmarks, 10)
+    return lib.RetinaFacePerceptualHash(frame_rgba.ctypes.data, frame_rgba.strides[0],
+                                        frame_rgba.shape[1], frame_rgba.shape[0], box_arr.ctypes.data,
+                                        lm_arr.ctypes.data if lm_arr is not None else None)
+
+
+class FaceDedupIndex:
+    """Hashes recientes por stream; is_duplicate() inserta los que no lo son."""
+
+    def __init__(self, capacity_per_stream=256, window_ms=10000, max_distance=8):
+        self._lib = load_library()
+        self._handle = self._lib.RetinaFaceDedupCreate(capacity_per_stream, window_ms, max_distance)
+
+    def is_duplicate(self, stream_id, phash, now_ms):
+        return bool(self._lib.RetinaFaceDedupCheck(self._handle, stream_id, phash, now_ms))
+
+    def reset_stream(self, stream_id):
+        self._lib.RetinaFaceDedupResetStream(self._handle, stream_id)
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.RetinaFaceDedupDestroy(self._handle)
+            self._handle = None
+
+
+class RecognitionScheduler:
+    """Cola de reconocimiento por prioridad con deadlines y reparto justo entre streams."""
+
+    def __init__(self, quality_weight=1.0, novelty_weight=0.5, age_per_second=0.2,
+                 novelty_time_ms=5000.0, max_pending_per_stream=64):
+        self._lib = load_library()
+        cfg = SchedulerConfig(quality_weight, novelty_weight, age_per_second, novelty_time_ms,
+                              max_pending_per_stream)
+        self._handle = self._lib.RetinaFaceSchedulerCreate(ctypes.byref(cfg))
+
+    def submit(self, now_ms, stream_id, frame_num, track_id, quality, deadline_ms=0, payload=0):
+        req = RecognitionRequest(stream_id, 0, frame_num, track_id, payload, quality, 0.0, 0, deadline_ms)
+        return bool(self._lib.RetinaFaceSchedulerSubmit(self._handle, ctypes.byref(req), now_ms))
+
+    def pop(self, now_ms, max_count):
+        out = (RecognitionRequest * max_count)()
+        n = self._lib.RetinaFaceSchedulerPop(self._handle, out, max_count, now_ms)
+        return [out[i] for i in range(n)]
+
+    def mark_recognized(self, stream_id, track_id, now_ms):
+        self._lib.RetinaFaceSchedulerMarkRecognized(self._handle, stream_id, track_id, now_ms)
+
+    def forget_track(self, stream_id, track_id):
+        self._lib.RetinaFaceSchedulerForgetTrack(self._handle, stream_id, track_id)
+
+    def stats(self):
+        st = SchedulerStats()
+        self._lib.RetinaFaceSchedulerGetStats(self._handle, ctypes.byref(st))
+        return {name: getattr(st, name) for name, _ in SchedulerStats._fields_}
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.RetinaFaceSchedulerDestroy(self._handle)
+            self._handle = None
+
+
+class ZoneAnalytics:
+    """Ocupación por zonas y cruces de línea por stream, publicados cada period_ms."""
+
+    MAX_ZONES = 64
+
+    def __init__(self, grid_cols=64, grid_rows=36, period_ms=1000, track_timeout_ms=5000):
+        self._lib = load_library()
+        self._handle = self._lib.RetinaFaceZonesCreate(grid_cols, grid_rows, period_ms, track_timeout_ms)
+        self._max_lines = {}
+
+    def configure_stream(self, stream_id, frame_width, frame_height):
+        self._lib.RetinaFaceZonesConfigureStream(self._handle, stream_id, frame_width, frame_height)
+        self._max_lines[stream_id] = 0
+
+    def add_zone(self, stream_id, polygon):
+        pts = _as_f32(polygon, 6)
+        return self._lib.RetinaFaceZonesAddZone(self._handle, stream_id, pts.ctypes.data, pts.size // 2)
+
+    def add_line(self, stream_id, x1, y1, x2, y2):
+        line = self._lib.RetinaFaceZonesAddLine(self._handle, stream_id, x1, y1, x2, y2)
+        if line >= 0:
+            self._max_lines[stream_id] = line + 1
+        return line
+
+    def update(self, stream_id, now_ms, boxes, track_ids=None):
+        """boxes: Nx4 [left, top, width, height]; se usa el centro del bbox.
+        Devuelve la máscara de zonas de cada objeto."""
+        b = np.ascontiguousarray(boxes, dtype=np.float32).reshape(-1, 4)
+        points = np.ascontiguousarray(b[:, :2] + 0.5 * b[:, 2:])
+        masks = np.zeros(len(b), dtype=np.uint64)
+        ids = np.ascontiguousarray(track_ids, dtype=np.uint64) if track_ids is not None else None
+        self._lib.RetinaFaceZonesUpdate(self._handle, stream_id, now_ms,
+                                        ids.ctypes.data if ids is not None else None,
+                                        points.ctypes.data, len(b), masks.ctypes.data)
+        return masks
+
+    def poll(self, stream_id, now_ms):
+        """Devuelve (zonas, líneas) si terminó el periodo, o None."""
+        zones = (ZoneStats * self.MAX_ZONES)()
+        max_lines = max(1, self._max_lines.get(stream_id, 0))
+        lines = (LineStats * max_lines)()
+        nz = ctypes.c_int(self.MAX_ZONES)
+        nl = ctypes.c_int(max_lines)
+        if not self._lib.RetinaFaceZonesPoll(self._handle, stream_id, now_ms, zones, ctypes.byref(nz),
+                                             lines, ctypes.byref(nl)):
+            return None
+        return ([(z.zone, z.current, z.peak, z.average) for z in zones[:nz.value]],
+                [(l.line, l.in_count, l.out_count, l.total_in, l.total_out) for l in lines[:nl.value]])
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.RetinaFaceZonesDestroy(self._handle)
+            self._handle = None
+
+
+class DetectionArchiveWriter:
+    """Archivo de detecciones por track: keyframe cada keyframe_interval
+    registros y deltas cuantizados a coord_step píxeles."""
+
+    def __init__(self, path, keyframe_interval=64, coord_step=0.5):
+        self._lib = load_library()
+        self._handle = self._lib.RetinaFaceArchiveOpenWriter(path.encode(), keyframe_interval, coord_step)
+        if not self._handle:
+            raise IOError("no se pudo crear %s" % path)
+
+    def append(self, stream_id, frame_num, ts_ms, track_ids, boxes, scores, landmarks=None):
+        """Registra las detecciones de un frame. boxes: Nx4 [left, top, width, height]."""
+        ids = np.ascontiguousarray(track_ids, dtype=np.uint64).reshape(-1)
+        records = np.zeros(len(ids), dtype=ARCHIVE_RECORD_DTYPE)
+        records["frame_num"] = frame_num
+        records["ts_ms"] = ts_ms
+        records["box"] = np.asarray(boxes, dtype=np.float32).reshape(-1, 4)
+        records["score"] = scores
+        if landmarks is not None:
+            records["landmarks"] = np.asarray(landmarks, dtype=np.float32).reshape(-1, 10)
+        return bool(self._lib.RetinaFaceArchiveAppend(self._handle, stream_id, ids.ctypes.data,
+                                                      records.ctypes.data, len(ids)))
+
+    def close_track(self, stream_id, track_id):
+        return bool(self._lib.RetinaFaceArchiveCloseTrack(self._handle, stream_id, track_id))
+
+    def close(self):
+        if getattr(self, '_handle', None):
+            ok = self._lib.RetinaFaceArchiveCloseWriter(self._handle)
+            self._handle = None
+            return bool(ok)
+        return True
+
+    def __del__(self):
+        self.close()
+
+
+class DetectionArchiveReader:
+    """Acceso aleatorio por track y rango de tiempo a un archivo de detecciones."""
+
+    def __init__(self, path):
+        self._lib = load_library()
+        self._handle = self._lib.RetinaFaceArchiveOpenReader(path.encode())
+        if not self._handle:
+            raise IOError("no se pudo abrir %s" % path)
+
+    def block_count(self):
+        return self._lib.RetinaFaceArchiveBlockCount(self._handle)
+
+    def block_info(self, index):
+        info = ArchiveBlockInfo()
+        if not self._lib.RetinaFaceArchiveGetBlock(self._handle, index, ctypes.byref(info)):
+            raise IndexError(index)
+        return info
+
+    def read_block(self, index):
+        info = self.block_info(index)
+        out = np.empty(info.count, dtype=ARCHIVE_RECORD_DTYPE)
+        if self._lib.RetinaFaceArchiveReadBlock(self._handle, index, out.ctypes.data, info.count) < 0:
+            raise IOError("bloque %d corrupto" % index)
+        return out
+
+    def read_track(self, stream_id, track_id, t0=-(1 << 63), t1=(1 << 63) - 1):
+        """Registros del track con ts_ms en [t0, t1]."""
+        blocks = np.empty(max(1, self.block_count()), dtype=np.int32)
+        n = self._lib.RetinaFaceArchiveTrackBlocks(self._handle, stream_id, track_id, t0, t1,
+                                                   blocks.ctypes.data, blocks.size)
+        if n == 0:
+            return np.empty(0, dtype=ARCHIVE_RECORD_DTYPE)
+        records = np.concatenate([self.read_block(int(b)) for b in blocks[:n]])
+        return records[(records["ts_ms"] >= t0) & (records["ts_ms"] <= t1)]
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.RetinaFaceArchiveCloseReader(self._handle)
+            self._handle = None
+
+
+def query_archive(paths, t0=-(1 << 63), t1=(1 << 63) - 1, stream_id=-1, track_id=None, min_score=0.0,
+                  min_size=0.0, max_size=0.0, zone=None, limit=100000, threads=0):
+    """Consulta varios segmentos del archivo de detecciones.
+    Devuelve (array QUERY_HIT_DTYPE ordenado por ts, QueryStats)."""
+    lib = load_library()
+    c_paths = (ctypes.c_char_p * len(paths))(*[p.encode() for p in paths])
+    query = ArchiveQuery(t0, t1, QUERY_ANY_TRACK if track_id is None else track_id, stream_id,
+                         min_score, min_size, max_size, limit, threads)
+    zone_arr = _as_f32(zone, 6)
+    out = np.empty(max(1, limit), dtype=QUERY_HIT_DTYPE)
+    stats = QueryStats()
+    n = lib.RetinaFaceArchiveQuery(c_paths, len(paths), ctypes.byref(query),
+                                   zone_arr.ctypes.data if zone_arr is not None else None,
+                                   zone_arr.size // 2 if zone_arr is not None else 0,
+                                   out.ctypes.data, out.size, ctypes.byref(stats))
+    if n < 0:
+        raise IOError("no se pudo abrir ningún segmento")
+    return out[:n], stats
+
+
+class FrameWriter:
+    """Escritor asíncrono (io_uring o hilos con pwrite) con pool de buffers.
+    Si el pool está agotado, write_file() descarta y devuelve False."""
+
+    def __init__(self, buffer_size=1 << 21, buffer_count=32, threads=2, queue_depth=64, direct_io=False,
+                 backend=WRITER_BACKEND_AUTO):
+        self._lib = load_library()
+        config = WriterConfig(buffer_size, buffer_count, threads, queue_depth, int(direct_io), backend)
+        self._handle = self._lib.RetinaFaceWriterCreate(ctypes.byref(config))
+        if not self._handle:
+            raise RuntimeError("no se pudo crear el escritor")
+
+    def write_file(self, path, data, stream_id=None):
+        """data: bytes o array uint8 (p.ej. la salida de cv2.imencode). Con
+        stream_id, el resultado se informa al control adaptativo de JPEG."""
+        if isinstance(data, np.ndarray):
+            buf = np.ascontiguousarray(data, dtype=np.uint8)
+            ptr, size = buf.ctypes.data, buf.nbytes
+        else:
+            ptr, size = ctypes.cast(ctypes.c_char_p(data), ctypes.c_void_p).value, len(data)
+        ok = bool(self._lib.RetinaFaceWriterWriteFile(self._handle, ptr, size, path.encode()))
+        if stream_id is not None:
+            self._lib.RetinaFaceWriterReportJpeg(self._handle, stream_id, size if ok else 0, int(not ok))
+        return ok
+
+    def write_surface_jpeg(self, gst_buffer, batch_id, path, quality=90, boxes=None, stream_id=None):
+        """Codifica el frame batch_id (superficie NV12/I420) a JPEG directamente
+        en un buffer del pool, dibujando boxes (N x 4: left, top, width, height).
+        Con stream_id usa la calidad y resolución del control adaptativo."""
+        ptr, n = None, 0
+        if boxes is not None and len(boxes) > 0:
+            boxes = np.ascontiguousarray(boxes, dtype=np.float32).reshape(-1, 4)
+            ptr, n = boxes.ctypes.data, boxes.shape[0]
+        if stream_id is not None:
+            return bool(self._lib.RetinaFaceWriterSaveSurfaceJpegAdaptive(self._handle, hash(gst_buffer), batch_id,
+                                                                          stream_id, path.encode(), quality, ptr, n))
+        return bool(self._lib.RetinaFaceWriterSaveSurfaceJpeg(self._handle, hash(gst_buffer), batch_id,
+                                                              path.encode(), quality, ptr, n))
+
+    def enable_adaptive_jpeg(self, min_quality=50, max_quality=90, max_downscale=2, interval_ms=500,
+                             high_water=0.75, low_water=0.25):
+        """Calidad JPEG y resolución por stream según la ocupación del pool y
+        el ancho de banda medido del disco."""
+        config = AdaptiveJpegConfig(min_quality, max_quality, max_downscale, interval_ms, high_water, low_water)
+        self._lib.RetinaFaceWriterEnableAdaptiveJpeg(self._handle, ctypes.byref(config))
+
+    def jpeg_settings(self, stream_id):
+        """(quality, downscale) para el próximo JPEG del stream, o None si el
+        control adaptativo no está activo."""
+        quality, downscale = ctypes.c_int(), ctypes.c_int()
+        if not self._lib.RetinaFaceWriterJpegSettings(self._handle, stream_id, ctypes.byref(quality),
+                                                      ctypes.byref(downscale)):
+            return None
+        return quality.value, downscale.value
+
+    def jpeg_quality(self, stream_id):
+        """JpegStreamQuality del stream, o None si todavía no ha escrito."""
+        quality = JpegStreamQuality()
+        if not self._lib.RetinaFaceWriterJpegQuality(self._handle, stream_id, ctypes.byref(quality)):
+            return None
+        return quality
+
+    def flush(self):
+        self._lib.RetinaFaceWriterFlush(self._handle)
+
+    def stats(self):
+        stats = WriterStats()
+        self._lib.RetinaFaceWriterGetStats(self._handle, ctypes.byref(stats))
+        return stats
+
+    def close(self):
+        if getattr(self, '_handle', None):
+            self._lib.RetinaFaceWriterDestroy(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+
+class QosController:
+    """Control de admisión por clases antes de nvstreammux. classes es una lista
+    de (min_fps, max_fps) ordenada por prioridad (índice 0 = la más alta).
+    Los pads se pasan como objetos Gst.Pad; hash(pad) es su puntero nativo.
+    max_inflight son los frames en cola por encima de ritmo × latencia base
+    que indican sobrecarga."""
+
+    def __init__(self, classes, capacity_fps=0.0, max_inflight=8, update_period_ms=500):
+        self._lib = load_library()
+        config = QosConfig(capacity_fps, max_inflight, update_period_ms)
+        self._handle = self._lib.RetinaFaceQosCreate(ctypes.byref(config))
+        if not self._handle:
+            raise RuntimeError("no se pudo crear el control de admisión")
+        for min_fps, max_fps in classes:
+            self._lib.RetinaFaceQosAddClass(self._handle, ctypes.byref(QosClassConfig(min_fps, max_fps)))
+        self._num_classes = len(classes)
+
+    def attach_source(self, pad, source_id, cls):
+        """pad: src de la fuente enlazada a sink_<source_id> de nvstreammux."""
+        return bool(self._lib.RetinaFaceQosAttachSource(self._handle, hash(pad), source_id, cls))
+
+    def attach_processed(self, pad):
+        """pad: src de nvinfer; cuenta los frames que salen de la inferencia."""
+        return bool(self._lib.RetinaFaceQosAttachProcessed(self._handle, hash(pad)))
+
+    def class_stats(self):
+        stats = (QosClassStats * max(1, self._num_classes))()
+        n = self._lib.RetinaFaceQosGetClassStats(self._handle, stats, len(stats))
+        return list(stats[:n])
+
+    def capacity(self):
+        return self._lib.RetinaFaceQosGetCapacity(self._handle)
+
+    def close(self):
+        if getattr(self, '_handle', None):
+            self._lib.RetinaFaceQosDestroy(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+
+class CrossCropMerge:
+    """Fusiona las caras repetidas por recortes de personas solapados cuando
+    RetinaFace corre como secundario (process-mode=2). pad: src del nvinfer
+    de caras. La probe vive mientras viva el pad."""
+
+    def __init__(self, pad, gie_unique_id, iou_threshold=0.4, contain_threshold=0.7):
+        self._lib = load_library()
+        config = CropMergeConfig(gie_unique_id, iou_threshold, contain_threshold)
+        self._handle = self._lib.RetinaFaceSecondaryAttachMerge(hash(pad), ctypes.byref(config))
+        if not self._handle:
+            raise RuntimeError("no se pudo instalar la fusión entre recortes")
+
+    def stats(self):
+        stats = CropMergeStats()
+        self._lib.RetinaFaceSecondaryGetMergeStats(self._handle, ctypes.byref(stats))
+        return stats
+
+
+def associate_faces(persons, faces, min_score=0.3, head_fraction=0.4, cell_size=0.0):
+    """persons, faces: (N, 4) en (left, top, width, height). Devuelve
+    (parent, scores): índice de la persona de cada cara (-1 si ninguna)."""
+    lib = load_library()
+    p = np.ascontiguousarray(persons, dtype=np.float32).reshape(-1, 4)
+    f = np.ascontiguousarray(faces, dtype=np.float32).reshape(-1, 4)
+    parent = np.empty(len(f), dtype=np.int32)
+    scores = np.empty(len(f), dtype=np.float32)
+    config = AssociationConfig(cell_size, min_score, head_fraction)
+    lib.RetinaFaceAssociate(p.ctypes.data, len(p), f.ctypes.data, len(f), ctypes.byref(config),
+                            parent.ctypes.data, scores.ctypes.data)
+    return parent, scores
+
+
+class FacePersonAssociation:
+    """Probe que fija obj_meta.parent de cada cara a su persona. pad: src
+    del último nvinfer que aporta caras o personas."""
+
+    def __init__(self, pad, face_gie_id, person_gie_id, person_class_id=-1, min_score=0.3,
+                 head_fraction=0.4, cell_size=0.0):
+        self._lib = load_library()
+        config = AssociationProbeConfig(face_gie_id, person_gie_id, person_class_id,
+                                        AssociationConfig(cell_size, min_score, head_fraction))
+        self._handle = self._lib.RetinaFaceAssociationAttach(hash(pad), ctypes.byref(config))
+        if not self._handle:
+            raise RuntimeError("no se pudo instalar la asociación cara-persona")
+
+    def stats(self):
+        stats = AssociationStats()
+        self._lib.RetinaFaceAssociationGetStats(self._handle, ctypes.byref(stats))
+        return stats
+
+
+def export_batch_meta(gst_buffer, gie_id=-1, max_frames=256, max_objects=1024):
+    """Batch meta de un GstBuffer en una llamada: (frames, objects) como
+    arrays FRAME_META_DTYPE y OBJECT_META_DTYPE. Los objetos de cada frame son
+    contiguos (first_object, num_objects) y llevan frame_index. gie_id filtra
+    por unique_component_id. Devuelve None si el buffer no tiene batch meta."""
+    lib = load_library()
+    frames = np.empty(max_frames, dtype=FRAME_META_DTYPE)
+    num_frames = ctypes.c_int()
+    while True:
+        objects = np.empty(max_objects, dtype=OBJECT_META_DTYPE)
+        found = lib.RetinaFaceExportBatchMeta(hash(gst_buffer), gie_id, frames.ctypes.data, max_frames,
+                                              ctypes.byref(num_frames), objects.ctypes.data, max_objects)
+        if found < 0:
+            return None
+        if found <= max_objects:
+            return frames[:num_frames.value], objects[:found]
+        max_objects = found
+
+
+def attach_face_quality(gst_buffer, batch_id, quality, gie_id=-1):
+    """Adjunta quality['score'] (array FACE_QUALITY_DTYPE, uno por objeto del
+    frame en el orden de export_batch_meta) al meta de los objetos del frame
+    batch_id; export_batch_meta lo devuelve luego en 'quality'. Devuelve los
+    objetos escritos, o -1 si el buffer no tiene batch meta."""
+    q = np.ascontiguousarray(quality, dtype=FACE_QUALITY_DTYPE)
+    return load_library().RetinaFaceAttachQuality(hash(gst_buffer), batch_id, gie_id, q.ctypes.data, q.size)
+
+
+class FrameStore:
+    """Almacén circular de tamaño fijo (modo DVR) en un archivo por stream.
+    Con writer (un FrameWriter) escribe; sin él abre un archivo existente en
+    solo lectura. El writer debe seguir abierto hasta close()."""
+
+    def __init__(self, path, data_bytes=1 << 30, max_records=100000, writer=None, index_sync_interval=32,
+                 bucket_ms=1000):
+        self._lib = load_library()
+        self._writer = writer
+        config = DvrConfig(data_bytes, max_records, index_sync_interval, bucket_ms)
+        self._handle = self._lib.RetinaFaceDvrOpen(path.encode(), ctypes.byref(config),
+                                                   writer._handle if writer else None)
+        if not self._handle:
+            raise RuntimeError("no se pudo abrir el almacén %s" % path)
+
+    def write(self, data, ts_ms, frame_num=-1):
+        """data: bytes o array uint8 ya codificado (JPEG)."""
+        if isinstance(data, np.ndarray):
+            buf = np.ascontiguousarray(data, dtype=np.uint8)
+            ptr, size = buf.ctypes.data, buf.nbytes
+        else:
+            ptr, size = ctypes.cast(ctypes.c_char_p(data), ctypes.c_void_p).value, len(data)
+        return bool(self._lib.RetinaFaceDvrWrite(self._handle, ptr, size, int(ts_ms), int(frame_num)))
+
+    def save_surface_jpeg(self, gst_buffer, batch_id, ts_ms, frame_num=-1, quality=90, boxes=None):
+        """Como FrameWriter.write_surface_jpeg(), pero al anillo del stream."""
+        ptr, n = None, 0
+        if boxes is not None and len(boxes) > 0:
+            boxes = np.ascontiguousarray(boxes, dtype=np.float32).reshape(-1, 4)
+            ptr, n = boxes.ctypes.data, boxes.shape[0]
+        return bool(self._lib.RetinaFaceDvrSaveSurfaceJpeg(self._handle, hash(gst_buffer), batch_id, int(ts_ms),
+                                                           int(frame_num), quality, ptr, n))
+
+    def find(self, ts_ms):
+        """Último registro con ts <= ts_ms (DvrRecordInfo) o None."""
+        info = DvrRecordInfo()
+        if not self._lib.RetinaFaceDvrFind(self._handle, int(ts_ms), ctypes.byref(info)):
+            return None
+        return info
+
+    def read(self, seq):
+        """Bytes del registro, o None si el anillo ya lo sobrescribió."""
+        info = DvrRecordInfo()
+        if not self._lib.RetinaFaceDvrRecord(self._handle, seq, ctypes.byref(info)):
+            return None
+        out = ctypes.create_string_buffer(info.size)
+        n = self._lib.RetinaFaceDvrRead(self._handle, seq, out, info.size)
+        return out.raw[:n] if n >= 0 else None
+
+    def read_at(self, ts_ms):
+        info = self.find(ts_ms)
+        return self.read(info.seq) if info else None
+
+    def sync(self):
+        return bool(self._lib.RetinaFaceDvrSync(self._handle))
+
+    def stats(self):
+        stats = DvrStats()
+        self._lib.RetinaFaceDvrGetStats(self._handle, ctypes.byref(stats))
+        return stats
+
+    def close(self):
+        if getattr(self, '_handle', None):
+            self._lib.RetinaFaceDvrClose(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+
+class LandmarkSmoother:
+    """Filtro One-Euro por track para caja y landmarks (necesita ids de
+    tracker). min_cutoff baja el jitter en reposo; beta reduce el retraso
+    cuando la cara se mueve."""
+
+    def __init__(self, min_cutoff=1.0, beta=0.02, derivative_cutoff=1.0, max_age_ms=1000):
+        self._lib = load_library()
+        config = SmoothingConfig(min_cutoff, beta, derivative_cutoff, max_age_ms)
+        self._handle = self._lib.RetinaFaceSmoothingCreate(ctypes.byref(config))
+
+    def update(self, stream_id, ts_ms, track_ids, boxes, landmarks=None):
+        """Devuelve (boxes, landmarks) filtrados: N x 4 y N x 10 float32 (NaN
+        en landmarks = sin landmarks). Los ids UNTRACKED pasan sin filtrar."""
+        ids = np.ascontiguousarray(track_ids, dtype=np.uint64)
+        boxes = np.array(boxes, dtype=np.float32, order='C').reshape(-1, 4)
+        if landmarks is not None:
+            landmarks = np.array(landmarks, dtype=np.float32, order='C').reshape(-1, 10)
+        if len(ids) > 0:
+            self._lib.RetinaFaceSmoothingUpdate(self._handle, stream_id, int(ts_ms), ids.ctypes.data,
+                                                boxes.ctypes.data,
+                                                landmarks.ctypes.data if landmarks is not None else None, len(ids))
+        return boxes, landmarks
+
+    def reset_stream(self, stream_id):
+        self._lib.RetinaFaceSmoothingResetStream(self._handle, stream_id)
+
+    def track_count(self):
+        return self._lib.RetinaFaceSmoothingTrackCount(self._handle)
+
+    def close(self):
+        if getattr(self, '_handle', None):
+            self._lib.RetinaFaceSmoothingDestroy(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+
+class FaceEventGenerator:
+    """Eventos enter/update/exit por track en vez de cada detección (necesita
+    ids de tracker). Un track entra tras enter_frames observaciones a lo largo
+    de min_duration_ms, manda un update cada heartbeat_ms y sale tras
+    exit_timeout_ms sin verlo; los que no llegan a entrar no generan nada."""
+
+    def __init__(self, enter_frames=3, min_duration_ms=300, exit_timeout_ms=1000, heartbeat_ms=5000):
+        self._lib = load_library()
+        config = FaceEventConfig(enter_frames, min_duration_ms, exit_timeout_ms, heartbeat_ms)
+        self._handle = self._lib.RetinaFaceEventsCreate(ctypes.byref(config))
+
+    def update(self, stream_id, ts_ms, track_ids, boxes, confidences=None):
+        """Caras de un frame (también sin ninguna: las salidas van con el
+        reloj del stream). Devuelve la lista de FaceEvent generados."""
+        ids = np.ascontiguousarray(track_ids, dtype=np.uint64)
+        b = np.ascontiguousarray(boxes, dtype=np.float32).reshape(-1, 4)
+        conf = _as_f32(confidences, len(ids))
+        produced = self._lib.RetinaFaceEventsUpdate(self._handle, stream_id, int(ts_ms), ids.ctypes.data,
+                                                    b.ctypes.data, conf.ctypes.data if conf is not None else None,
+                                                    len(ids))
+        return self._drain(produced)
+
+    def flush(self, stream_id=None):
+        """exit de los tracks presentes de un stream (o de todos) al terminar."""
+        produced = self._lib.RetinaFaceEventsFlush(self._handle, -1 if stream_id is None else stream_id)
+        return self._drain(produced)
+
+    def _drain(self, count):
+        if count <= 0:
+            return []
+        events = (FaceEvent * count)()
+        n = self._lib.RetinaFaceEventsDrain(self._handle, events, count)
+        return list(events[:n])
+
+    def stats(self):
+        stats = FaceEventStats()
+        self._lib.RetinaFaceEventsGetStats(self._handle, ctypes.byref(stats))
+        return stats
+
+    def close(self):
+        if getattr(self, '_handle', None):
+            self._lib.RetinaFaceEventsDestroy(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+
+def watch_parser_config(path, poll_ms=500):
+    """Carga la configuración del parser y la recarga cada vez que el archivo
+    cambia. Un archivo inválido no se publica: el parser sigue con la
+    configuración anterior. Devuelve si la carga inicial fue válida."""
+    return load_library().RetinaFaceParserConfigWatch(path.encode(), poll_ms) == 1
+
+
+def stop_watching_parser_config():
+    load_library().RetinaFaceParserConfigStopWatch()
+
+
+def load_parser_config(path):
+    return load_library().RetinaFaceParserConfigLoad(path.encode()) == 1
+
+
+def rollback_parser_config():
+    """Vuelve a publicar la configuración anterior a la vigente."""
+    return load_library().RetinaFaceParserConfigRollback() == 1
+
+
+def publish_parser_config(config):
+    return load_library().RetinaFaceParserConfigPublish(ctypes.byref(config)) == 1
+
+
+def parser_config():
+    """Copia de la configuración vigente (version 0 = valores por defecto)."""
+    config = ParserConfig()
+    load_library().RetinaFaceParserConfigGet(ctypes.byref(config))
+    return config
+
+
+def parser_config_failures():
+    """Cargas rechazadas (lectura o validación) desde el arranque."""
+    return load_library().RetinaFaceParserConfigFailures()
+
+
+def start_parser_shadow(config, sample_rate=0.1, queue_depth=4):
+    """Compara en un hilo aparte una configuración candidata (ruta de archivo
+    o ParserConfig) con la vigente sobre una fracción de las unidades, sin
+    cambiar la salida del parser. Reinicia las estadísticas."""
+    lib = load_library()
+    if isinstance(config, ParserConfig):
+        return lib.RetinaFaceParserShadowStart(ctypes.byref(config), sample_rate, queue_depth) == 1
+    return lib.RetinaFaceParserShadowLoad(config.encode(), sample_rate, queue_depth) == 1
+
+
+def stop_parser_shadow():
+    load_library().RetinaFaceParserShadowStop()
+
+
+def parser_shadow_stats():
+    """ParserShadowStats acumuladas más medias listas para imprimir en un dict."""
+    stats = ParserShadowStats()
+    load_library().RetinaFaceParserShadowGetStats(ctypes.byref(stats))
+    compared = max(stats.compared, 1)
+    matched = max(stats.matched, 1)
+    summary = {
+        'compared': stats.compared,
+        'dropped': stats.dropped,
+        'active_ms': stats.active_us / compared / 1000.0,
+        'shadow_ms': stats.shadow_us / compared / 1000.0,
+        'missed': stats.missed,
+        'extra': stats.extra,
+        'disagreeing': stats.disagreeing / compared,
+        'mean_iou': stats.iou_sum / matched,
+        'mean_score_delta': stats.score_delta_sum / matched,
+    }
+    return stats, summary
+
+
+def start_flight_recorder(folder, frames=32, percentile=99.5, window=2048, min_samples=256, cooldown_ms=10000):
+    """Guarda las anclas candidatas de las últimas `frames` unidades y vuelca
+    el anillo a folder/flight_<seq>.rfr cuando el tiempo de parseo o las
+    candidatas de una unidad superan el percentil de las `window` recientes."""
+    config = FlightRecorderConfig(frames, percentile, window, min_samples, cooldown_ms)
+    return load_library().RetinaFaceFlightRecorderStart(folder.encode(), ctypes.byref(config)) == 1
+
+
+def stop_flight_recorder():
+    load_library().RetinaFaceFlightRecorderStop()
+
+
+def dump_flight_recorder():
+    """Vuelca el anillo ahora (asíncrono)."""
+    return load_library().RetinaFaceFlightRecorderDump() == 1
+
+
+def flight_recorder_stats():
+    stats = FlightRecorderStats()
+    load_library().RetinaFaceFlightRecorderGetStats(ctypes.byref(stats))
+    return stats
+
+
+def replay_flight_dump(path, repeats=5, max_results=1024):
+    """Vuelve a parsear cada unidad de un volcado con su configuración y
+    devuelve FlightReplayResult (tiempo grabado y mediana reproducida)."""
+    results = (FlightReplayResult * max_results)()
+    count = load_library().RetinaFaceFlightReplay(path.encode(), repeats, results, max_results)
+    if count < 0:
+        raise IOError("volcado inválido: %s" % path)
+    return list(results[:min(count, max_results)])
+
+
+def read_flight_dump(path):
+    """(FlightDumpHeader, [(FlightRecord, loc, landmarks, conf)]) con los
+    tensores como arrays numpy (anclas x 4, x 10, x 2). Solo las anclas
+    guardadas (record.num_stored candidatas) tienen datos; el resto queda
+    como fondo, igual que al reproducir."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    header = FlightDumpHeader.from_buffer_copy(data)
+    if header.magic != b'RFFR':
+        raise IOError("no es un volcado del registrador de vuelo: %s" % path)
+    offset = ctypes.sizeof(FlightDumpHeader)
+    records = []
+    for _ in range(header.count):
+        record = FlightRecord.from_buffer_copy(data, offset)
+        offset += ctypes.sizeof(FlightRecord)
+        n, m = record.num_anchors, record.num_stored
+        anchors = np.frombuffer(data, dtype=np.uint32, count=m, offset=offset)
+        offset += m * 4
+        stored = np.frombuffer(data, dtype=np.float32, count=m * 16, offset=offset)
+        offset += m * 16 * 4
+        loc = np.zeros((n, 4), dtype=np.float32)
+        landmarks = np.zeros((n, 10), dtype=np.float32)
+        conf = np.zeros((n, 2), dtype=np.float32)
+        conf[:, 1] = -1e4
+        loc[anchors] = stored[:m * 4].reshape(m, 4)
+        landmarks[anchors] = stored[m * 4:m * 14].reshape(m, 10)
+        conf[anchors] = stored[m * 14:].reshape(m, 2)
+        records.append((record, loc, landmarks, conf))
+    return header, records
+
+
+def nms_int16_lanes():
+    """Carriles int16 (min/max/resta) del kernel NMS compilado: 32, 16, 8 o 1
+    (escalar); el área y el IoU van en int32/float a la mitad."""
+    return load_library().RetinaFaceNmsInt16Lanes()
+
+
+def nms_verify_stats():
+    """Unidades verificadas con nms-verify=1, las que difieren del kernel
+    float y las decisiones fuera de la banda del umbral."""
+    stats = NmsVerifyStats()
+    load_library().RetinaFaceNmsVerifyStats(ctypes.byref(stats))
+    return stats
+
+
+class BestShotSelector:
+    """Mejor toma por (stream, track) según FaceQuality.score. Un track sin
+    offer() durante max_age_frames frames se olvida solo (0: nunca)."""
+
+    def __init__(self, max_age_frames=0):
+        self._lib = load_library()
+        self._handle = self._lib.RetinaFaceBestShotCreate(max_age_frames)
+
+    def offer(self, stream_id, track_id, frame_num, quality, box):
+        q = np.ascontiguousarray(quality, dtype=FACE_QUALITY_DTYPE).reshape(1)
+        box_arr = _as_f32(box, 4)
+        return bool(self._lib.RetinaFaceBestShotOffer(self._handle, stream_id, track_id, frame_num,
+                                                      q.ctypes.data, box_arr.ctypes.data))
+
+    def take(self, stream_id, track_id):
+        """Devuelve (frame_num, score, box) y olvida el track, o None."""
+        frame_num = ctypes.c_uint64()
+        score = ctypes.c_float()
+        box = np.zeros(4, dtype=np.float32)
+        if not self._lib.RetinaFaceBestShotTake(self._handle, stream_id, track_id,
+                                                ctypes.byref(frame_num), ctypes.byref(score),
+                                                box.ctypes.data):
+            return None
+        return frame_num.value, score.value, box
+
+    def forget(self, stream_id, track_id):
+        """Olvida el track sin devolver su toma (p.ej. al perderlo el tracker)."""
+        self._lib.RetinaFaceBestShotForget(self._handle, stream_id, track_id)
+
+    def expired(self):
+        """Tracks olvidados por edad."""
+        return self._lib.RetinaFaceBestShotExpired(self._handle)
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.RetinaFaceBestShotDestroy(self._handle)
+            self._handle = None
+
+
+class FaceCropBatchBuilder:
+    """Acumula recortes alineados en tensores NCHW float preasignados."""
+
+    def __init__(self, crop_width=112, crop_height=112, max_batch_size=32, pool_size=4,
+                 deadline_ms=50, net_scale_factor=1.0, offsets=(0.0, 0.0, 0.0), color_format=0):
+        self._lib = load_library()
+        cfg = CropBatchConfig(crop_width, crop_height, max_batch_size, pool_size, deadline_ms,
+                              net_scale_factor, (ctypes.c_float * 3)(*offsets), color_format)
+        self._handle = self._lib.RetinaFaceCropBatchCreate(ctypes.byref(cfg))
+        if not self._handle:
+            raise RuntimeError("No se pudo crear el batch de recortes")
+        self._shape = (max_batch_size, 3, crop_height, crop_width)
+
+    @classmethod
+    def from_nvinfer_config(cls, config_path, **kwargs):
+        scale, offsets, color = read_nvinfer_preprocess(config_path)
+        return cls(net_scale_factor=scale, offsets=offsets, color_format=color, **kwargs)
+
+    def add(self, frame_rgba, box, landmarks=None, stream_id=0, frame_num=0, track_id=0):
+        """frame_rgba: array HxWx4 uint8 (p.ej. pyds.get_nvds_buf_surface)."""
+        box_arr = _as_f32(box, 4)
+        lm_arr = _as_f32(landmarks, 10)
+        ref = FaceCropRef(stream_id, 0, frame_num, track_id)
+        return bool(self._lib.RetinaFaceCropBatchAdd(
+            self._handle, frame_rgba.ctypes.data, frame_rgba.strides[0],
+            frame_rgba.shape[1], frame_rgba.shape[0], box_arr.ctypes.data,
+            lm_arr.ctypes.data if lm_arr is not None else None, ctypes.byref(ref)))
+
+    def acquire(self):
+        """Devuelve (tensor, refs, batch) o None. El tensor es una vista sin copia
+        válida hasta release(batch)."""
+        batch = self._lib.RetinaFaceCropBatchAcquire(self._handle)
+        if not batch:
+            return None
+        b = batch.contents
+        full = np.ctypeslib.as_array(b.tensor, shape=self._shape)
+        refs = [FaceCropRef.from_buffer_copy(b.refs[i]) for i in range(b.count)]
+        return full[:b.count], refs, batch
+
+    def flush(self):
+        self._lib.RetinaFaceCropBatchFlush(self._handle)
+
+    def release(self, batch):
+        self._lib.RetinaFaceCropBatchRelease(self._handle, batch)
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.RetinaFaceCropBatchDestroy(self._handle)
+            self._handle = None
@@ -33,6 +33,9 @@ import platform
 from common.is_aarch_64 import is_aarch64
 from common.bus_call import bus_call
 from common.FPS import PERF_DATA
+from common.retinaface_native import CrossCropMerge, FACE_EVENT_TYPES, FaceEventGenerator, \
+    FacePersonAssociation, FrameStore, FrameWriter, LandmarkSmoother, QosController, export_batch_meta, flight_recorder_stats, parser_shadow_stats, \
+    start_flight_recorder, start_parser_shadow, stop_flight_recorder, stop_parser_shadow, watch_parser_config
 import numpy as np
 import pyds
 import cv2
@@ -41,6 +44,9 @@ import os.path
 from os import path
 
 perf_data = None
+frame_writer = None
+dvr_stores = {}
+qos_controller = None
 frame_count = {}
 saved_count = {}
 global PGIE_CLASS_ID_FACE
@@ -61,6 +67,93 @@ pgie_classes_str = ["Face"]
 
 MIN_CONFIDENCE = 0.3
 
+# Escritor nativo de JPEGs: buffers de staging y escrituras en vuelo
+WRITER_BUFFER_SIZE = 4 * 1024 * 1024
+WRITER_BUFFER_COUNT = 32
+WRITER_DIRECT_IO = False
+# JPEG directo desde el NV12 de nvstreammux: sin nvvidconv1/filter1 a RGBA ni
+# cvtColor/imencode en Python. Las cajas se dibujan sobre los planos YUV.
+SAVE_YUV_JPEG = False
+JPEG_QUALITY = 90
+# Calidad JPEG por stream según el escritor: con el pool lleno o descartando
+# baja la calidad (y ya en el mínimo la resolución); con margen en el disco la
+# recupera hasta JPEG_QUALITY. No se aplica al modo DVR.
+ADAPTIVE_JPEG = False
+ADAPTIVE_JPEG_MIN_QUALITY = 50
+ADAPTIVE_JPEG_MAX_DOWNSCALE = 2
+
+# Modo DVR: en vez de una carpeta de JPEGs que crece sin límite, un archivo
+# preasignado por stream que se sobrescribe en anillo (stream_<i>.dvr)
+DVR_MODE = False
+DVR_BYTES_PER_STREAM = 4 * 1024 * 1024 * 1024
+DVR_MAX_RECORDS = 200000
+
+# Control de admisión con fuentes en vivo: (min_fps, max_fps) por clase, de
+# mayor a menor prioridad. Las fuentes sin entrada en SOURCE_QOS_CLASS van a
+# la última clase. QOS_CAPACITY_FPS = 0 estima la capacidad de la inferencia.
+# QOS_MAX_INFLIGHT: frames en cola por encima del régimen (ritmo × latencia
+# base) a partir de los que hay sobrecarga; no depende del batch-size.
+QOS_CLASSES = [(15.0, 0.0), (2.0, 0.0)]
+SOURCE_QOS_CLASS = {0: 0}
+QOS_CAPACITY_FPS = 0.0
+QOS_MAX_INFLIGHT = 8
+
+# RetinaFace como secundario (process-mode=2) sobre las personas de un
+# detector primario barato: la red ve recortes en vez de frames completos.
+SECONDARY_FACE_MODE = False
+PERSON_DETECTOR_CONFIG = "/opt/nvidia/deepstream/deepstream/samples/configs/deepstream-app/config_infer_primary.txt"
+FACE_GIE_ID = 2 if SECONDARY_FACE_MODE else 1
+
+# Detector de personas a frame completo junto a RetinaFace: cada cara se
+# asocia a su cuerpo (obj_meta.parent). En modo secundario ya lo hace nvinfer.
+ASSOCIATE_PERSONS = False
+PERSON_GIE_ID = 3
+
+# Suavizado temporal (One-Euro) de cajas y landmarks por track. Usa los
+# object_id del nvtracker que se inserta tras la inferencia (ver TRACKER_*).
+SMOOTH_LANDMARKS = False
+landmark_smoother = None
+
+# Eventos por track en vez de cada detección de cada frame: enter cuando la
+# cara lleva FACE_EVENT_ENTER_FRAMES observaciones y FACE_EVENT_MIN_DURATION_MS,
+# update cada FACE_EVENT_HEARTBEAT_MS y exit tras FACE_EVENT_EXIT_TIMEOUT_MS
+# sin verla. También inserta el nvtracker.
+FACE_EVENTS = False
+FACE_EVENT_ENTER_FRAMES = 3
+FACE_EVENT_MIN_DURATION_MS = 300
+FACE_EVENT_EXIT_TIMEOUT_MS = 1000
+FACE_EVENT_HEARTBEAT_MS = 5000
+face_events = None
+
+# nvtracker tras la última inferencia; solo se crea con SMOOTH_LANDMARKS o
+# FACE_EVENTS, que trabajan por track. Sin la librería o la configuración la
+# app no arranca.
+TRACKER_LIB = "/opt/nvidia/deepstream/deepstream/lib/libnvds_nvmultiobjecttracker.so"
+TRACKER_CONFIG = "/opt/nvidia/deepstream/deepstream/samples/configs/deepstream-app/config_tracker_NvDCF_perf.yml"
+TRACKER_WIDTH = 640
+TRACKER_HEIGHT = 384
+# object_id de las caras que no pasan por el tracker; se avisa la primera vez
+UNTRACKED_OBJECT_ID = 0xFFFFFFFFFFFFFFFF
+tracker_in_pipeline = False
+untracked_warned = False
+
+# Configuración del parser recargable en caliente (umbrales, NMS, top-k,
+# ROIs): editar el archivo con el pipeline en marcha aplica el cambio.
+PARSER_CONFIG = "retinaface_parser.txt"
+PARSER_CONFIG_POLL_MS = 500
+
+# Configuración candidata en sombra: se compara con la vigente en una
+# fracción de los frames (coste y caras perdidas/extra) sin cambiar la salida.
+SHADOW_PARSER_CONFIG = None   # p. ej. "retinaface_parser_shadow.txt"
+SHADOW_SAMPLE_RATE = 0.1
+
+# Registrador de vuelo: vuelca a <carpeta>/flight los tensores de las últimas
+# FLIGHT_RECORDER_FRAMES unidades cuando una supera el percentil de tiempo de
+# parseo o de candidatas. replay_flight_dump() reproduce el pico.
+FLIGHT_RECORDER = False
+FLIGHT_RECORDER_FRAMES = 32
+FLIGHT_RECORDER_PERCENTILE = 99.5
+
 def tiler_sink_pad_buffer_probe(pad, info, u_data):
     frame_number = 0
     num_rects = 0
@@ -69,82 +162,116 @@ def tiler_sink_pad_buffer_probe(pad, info, u_data):
         print("Unable to get GstBuffer ")
         return
 
-    # Obtener metadata del batch
-    batch_meta = pyds.gst_buffer_get_nvds_batch_meta(hash(gst_buffer))
-    l_frame = batch_meta.frame_meta_list
-
-    while l_frame is not None:
-        try:
-            frame_meta = pyds.NvDsFrameMeta.cast(l_frame.data)
-        except StopIteration:
-            break
-
-        frame_number = frame_meta.frame_num
-        num_rects = frame_meta.num_obj_meta
-        
-        # 1) Obtener el frame completo desde la GPU
-        n_frame = pyds.get_nvds_buf_surface(hash(gst_buffer), frame_meta.batch_id)
-        
-        # 2) Convertirlo a un array de NumPy (en CPU)
-        frame_copy = np.array(n_frame, copy=True, order='C')
-        # Cambiar de RGBA a BGR (o BGRA) según prefieras
-        frame_copy = cv2.cvtColor(frame_copy, cv2.COLOR_RGBA2BGRA)
-
-        # Si estás en Jetson (aarch64), se recomienda unmap después de obtener la copia
-        if is_aarch64():
-            pyds.unmap_nvds_buf_surface(hash(gst_buffer), frame_meta.batch_id)
-
-        # 3) Recorrer todos los objetos y dibujar bounding boxes en el frame_copy
-        l_obj = frame_meta.obj_meta_list
-        while l_obj is not None:
-            try:
-                obj_meta = pyds.NvDsObjectMeta.cast(l_obj.data)
-            except StopIteration:
-                break
-            
-            top = obj_meta.rect_params.top
-            left = obj_meta.rect_params.left
-            width = obj_meta.rect_params.width
-            height = obj_meta.rect_params.height
-
-            print(f"CONFIDENCE: {obj_meta.confidence}, TOP: {top}, LEFT: {left}, WIDTH: {width}, HEIGHT: {height}")
-
-            draw_bounding_boxes(frame_copy, obj_meta, obj_meta.confidence)
-            
-            try:
-                l_obj = l_obj.next
-            except StopIteration:
-                break
-
-        # 4) Guardar el frame con bounding boxes
-        img_path = "{}/stream_{}/frame_{}.jpg".format(folder_name, frame_meta.pad_index, frame_number)
-        cv2.imwrite(img_path, frame_copy)
-
-        print("Frame Number =", frame_number,
-              "Number of Objects =", num_rects)
+    # Metadata del batch en una llamada: un registro por frame y otro por cara
+    exported = export_batch_meta(gst_buffer, gie_id=FACE_GIE_ID)
+    if exported is None:
+        return Gst.PadProbeReturn.OK
+    frames, faces = exported
+
+    for frame in frames:
+        frame_number = int(frame['frame_num'])
+        batch_id = int(frame['batch_id'])
+        pad_index = int(frame['pad_index'])
+        first = int(frame['first_object'])
+        frame_faces = faces[first:first + int(frame['num_objects'])]
+        num_rects = len(frame_faces)
+        img_path = "{}/stream_{}/frame_{}.jpg".format(folder_name, pad_index, frame_number)
+        # ntp_timestamp solo existe con attach-sys-ts/RTCP; si no, el PTS
+        ts_ms = int(frame['ntp_timestamp'] or frame['buf_pts']) // 1000000
+
+        if tracker_in_pipeline and num_rects:
+            warn_untracked_faces(pad_index, frame_number, frame_faces['object_id'])
+
+        if landmark_smoother and num_rects:
+            boxes, landmarks = landmark_smoother.update(pad_index, ts_ms, frame_faces['object_id'],
+                                                        frame_faces['box'], frame_faces['landmarks'])
+            frame_faces['box'] = boxes
+            frame_faces['landmarks'] = landmarks
+
+        if face_events:
+            print_face_events(face_events.update(pad_index, ts_ms, frame_faces['object_id'], frame_faces['box'],
+                                                 frame_faces['confidence']))
+        else:
+            for face in frame_faces:
+                left, top, width, height = face['box']
+                print(f"CONFIDENCE: {face['confidence']}, TOP: {top}, LEFT: {left}, WIDTH: {width}, HEIGHT: {height}")
+
+        store = dvr_stores.get(pad_index)
+        if store and SAVE_YUV_JPEG:
+            store.save_surface_jpeg(gst_buffer, batch_id, ts_ms, frame_number, JPEG_QUALITY, frame_faces['box'])
+        elif SAVE_YUV_JPEG:
+            # Codificación nativa desde la superficie NV12 al buffer del escritor
+            frame_writer.write_surface_jpeg(gst_buffer, batch_id, img_path, JPEG_QUALITY, frame_faces['box'],
+                                            stream_id=pad_index if ADAPTIVE_JPEG else None)
+        else:
+            # 1) Obtener el frame completo desde la GPU
+            n_frame = pyds.get_nvds_buf_surface(hash(gst_buffer), batch_id)
+
+            # 2) Convertirlo a un array de NumPy (en CPU)
+            frame_copy = np.array(n_frame, copy=True, order='C')
+            # Cambiar de RGBA a BGR (o BGRA) según prefieras
+            frame_copy = cv2.cvtColor(frame_copy, cv2.COLOR_RGBA2BGRA)
+
+            # Si estás en Jetson (aarch64), se recomienda unmap después de obtener la copia
+            if is_aarch64():
+                pyds.unmap_nvds_buf_surface(hash(gst_buffer), batch_id)
+
+            # 3) Dibujar las caras del frame en frame_copy
+            for face in frame_faces:
+                draw_bounding_boxes(frame_copy, face)
+
+            # 4) Guardar el frame con bounding boxes (escritura asíncrona; si el
+            #    disco no da abasto el frame se descarta en vez de frenar el pipeline)
+            quality = JPEG_QUALITY
+            settings = frame_writer.jpeg_settings(pad_index) if ADAPTIVE_JPEG and not store else None
+            if settings:
+                quality, downscale = settings
+                if downscale > 1:
+                    frame_copy = cv2.resize(frame_copy, None, fx=1.0 / downscale, fy=1.0 / downscale,
+                                            interpolation=cv2.INTER_AREA)
+            ok, jpeg = cv2.imencode('.jpg', frame_copy, [cv2.IMWRITE_JPEG_QUALITY, quality])
+            if ok and store:
+                store.write(jpeg, ts_ms, frame_number)
+            elif ok:
+                frame_writer.write_file(img_path, jpeg, stream_id=pad_index if settings else None)
+
+        if not face_events:
+            print("Frame Number =", frame_number,
+                  "Number of Objects =", num_rects)
         
         # Actualizar contador de FPS por stream
-        stream_index = f"stream{frame_meta.pad_index}"
+        stream_index = f"stream{pad_index}"
         global perf_data
         perf_data.update_fps(stream_index)
 
-        try:
-            l_frame = l_frame.next
-        except StopIteration:
-            break
-
     return Gst.PadProbeReturn.OK
 
 
 
-def draw_bounding_boxes(image, obj_meta, confidence):
-    confidence = '{0:.2f}'.format(confidence)
-    rect_params = obj_meta.rect_params
-    top = int(rect_params.top)
-    left = int(rect_params.left)
-    width = int(rect_params.width)
-    height = int(rect_params.height)
-    obj_name = pgie_classes_str[obj_meta.class_id]
+def warn_untracked_faces(pad_index, frame_number, object_ids):
+    global untracked_warned
+    if untracked_warned:
+        return
+    untracked = int(np.count_nonzero(object_ids == UNTRACKED_OBJECT_ID))
+    if untracked:
+        untracked_warned = True
+        sys.stderr.write(" WARNING: %d/%d faces without object_id in stream %d frame %d: "
+                         "check that nvtracker is linked before the probe \n"
+                         % (untracked, len(object_ids), pad_index, frame_number))
+
+
+def print_face_events(events):
+    for event in events:
+        left, top, width, height = event.box
+        print(f"FACE {FACE_EVENT_TYPES[event.type].upper()}: STREAM: {event.stream_id}, TRACK: {event.track_id}, "
+              f"TS: {event.ts_ms}, DURATION: {event.last_seen_ms - event.first_seen_ms}, "
+              f"CONFIDENCE: {event.confidence}, TOP: {top}, LEFT: {left}, WIDTH: {width}, HEIGHT: {height}")
+
+
+def draw_bounding_boxes(image, face):
+    confidence = '{0:.2f}'.format(face['confidence'])
+    left, top, width, height = (int(v) for v in face['box'])
+    obj_name = pgie_classes_str[face['class_id']]
     # image = cv2.rectangle(image, (left, top), (left + width, top + height), (0, 0, 255, 0), 2, cv2.LINE_4)
     color = (0, 0, 255, 0)
     w_percents = int(width * 0.05) if width > 100 else int(width * 0.1)
@@ -164,6 +291,10 @@ def draw_bounding_boxes(image, obj_meta, confidence):
     # Note that on some systems cv2.putText erroneously draws horizontal lines across the image
     image = cv2.putText(image, obj_name + ',C=' + str(confidence), (left - 10, top - 10), cv2.FONT_HERSHEY_SIMPLEX, 0.5,
                         (0, 0, 255, 0), 1)
+    # Landmarks, si el parser es el de máscara de instancia
+    if face['has_landmarks']:
+        for x, y in face['landmarks'].reshape(5, 2):
+            image = cv2.circle(image, (int(x), int(y)), 2, (0, 255, 0, 0), -1)
     return image
 
 
@@ -205,6 +336,27 @@ def decodebin_child_added(child_proxy, Object, name, user_data):
         if source_element.find_property('drop-on-latency') != None:
             Object.set_property("drop-on-latency", True)
 
+def qos_print_callback():
+    for st in qos_controller.class_stats():
+        print("QoS clase %d: %d fuentes, demanda %.1f fps, inferidos %.1f fps, descartados %d"
+              % (st.cls, st.sources, st.demand_fps, st.achieved_fps, st.dropped))
+    return True
+
+
+def print_jpeg_quality(number_sources):
+    for i in range(number_sources):
+        st = frame_writer.jpeg_quality(i)
+        if st:
+            print("JPEG stream %d: quality %d, 1/%d scale, %.0f KB/frame at %.1f fps, disk %.1f MB/s, pool %.0f%%, "
+                  "%d dropped of %d" % (i, st.quality, st.downscale, st.bytes_per_frame / 1024, st.fps,
+                                        st.bandwidth / (1 << 20), 100.0 * st.occupancy, st.dropped, st.frames))
+
+
+def jpeg_quality_print_callback(number_sources):
+    print_jpeg_quality(number_sources)
+    return True
+
+
 def create_source_bin(index, uri):
     print("Creating source bin")
 
@@ -265,6 +417,29 @@ def main(args):
 
     print("Frames will be saved in", folder_name)
 
+    global frame_writer
+    frame_writer = FrameWriter(buffer_size=WRITER_BUFFER_SIZE, buffer_count=WRITER_BUFFER_COUNT,
+                               direct_io=WRITER_DIRECT_IO)
+    if ADAPTIVE_JPEG:
+        frame_writer.enable_adaptive_jpeg(min_quality=ADAPTIVE_JPEG_MIN_QUALITY, max_quality=JPEG_QUALITY,
+                                          max_downscale=ADAPTIVE_JPEG_MAX_DOWNSCALE)
+        GLib.timeout_add(5000, jpeg_quality_print_callback, number_sources)
+    if SMOOTH_LANDMARKS:
+        global landmark_smoother
+        landmark_smoother = LandmarkSmoother()
+    if FACE_EVENTS:
+        global face_events
+        face_events = FaceEventGenerator(FACE_EVENT_ENTER_FRAMES, FACE_EVENT_MIN_DURATION_MS,
+                                         FACE_EVENT_EXIT_TIMEOUT_MS, FACE_EVENT_HEARTBEAT_MS)
+    if PARSER_CONFIG and os.path.exists(PARSER_CONFIG):
+        watch_parser_config(PARSER_CONFIG, PARSER_CONFIG_POLL_MS)
+    if SHADOW_PARSER_CONFIG:
+        start_parser_shadow(SHADOW_PARSER_CONFIG, SHADOW_SAMPLE_RATE)
+    if FLIGHT_RECORDER:
+        flight_folder = os.path.join(folder_name, "flight")
+        os.makedirs(flight_folder, exist_ok=True)
+        start_flight_recorder(flight_folder, FLIGHT_RECORDER_FRAMES, FLIGHT_RECORDER_PERCENTILE)
+
     # Standard GStreamer initialization
     Gst.init(None)
 
@@ -284,8 +459,12 @@ def main(args):
         sys.stderr.write(" Unable to create NvStreamMux \n")
 
     pipeline.add(streammux)
+    source_pads = []
     for i in range(number_sources):
         os.mkdir(folder_name + "/stream_" + str(i))
+        if DVR_MODE:
+            dvr_stores[i] = FrameStore("{}/stream_{}.dvr".format(folder_name, i), DVR_BYTES_PER_STREAM,
+                                       DVR_MAX_RECORDS, writer=frame_writer)
         frame_count["stream_" + str(i)] = 0
         saved_count["stream_" + str(i)] = 0
         print("Creating source_bin ", i, " \n ")
@@ -304,10 +483,39 @@ def main(args):
         if not srcpad:
             sys.stderr.write("Unable to create src pad bin \n")
         srcpad.link(sinkpad)
+        source_pads.append(srcpad)
     print("Creating Pgie \n ")
     pgie = Gst.ElementFactory.make("nvinfer", "primary-inference")
     if not pgie:
         sys.stderr.write(" Unable to create pgie \n")
+    face_gie = pgie
+    if SECONDARY_FACE_MODE:
+        print("Creating Sgie \n ")
+        face_gie = Gst.ElementFactory.make("nvinfer", "secondary-inference")
+        if not face_gie:
+            sys.stderr.write(" Unable to create sgie \n")
+    person_gie = None
+    if ASSOCIATE_PERSONS and not SECONDARY_FACE_MODE:
+        print("Creating person detector \n ")
+        person_gie = Gst.ElementFactory.make("nvinfer", "person-inference")
+        if not person_gie:
+            sys.stderr.write(" Unable to create person detector \n")
+    tracker = None
+    if SMOOTH_LANDMARKS or FACE_EVENTS:
+        print("Creating nvtracker \n ")
+        tracker = Gst.ElementFactory.make("nvtracker", "tracker")
+        if not tracker:
+            sys.stderr.write(" Unable to create nvtracker (needed by SMOOTH_LANDMARKS/FACE_EVENTS) \n")
+            sys.exit(1)
+        for tracker_file in (TRACKER_LIB, TRACKER_CONFIG):
+            if not os.path.exists(tracker_file):
+                sys.stderr.write(" nvtracker file %s not found (needed by SMOOTH_LANDMARKS/FACE_EVENTS) \n"
+                                 % tracker_file)
+                sys.exit(1)
+        tracker.set_property('ll-lib-file', TRACKER_LIB)
+        tracker.set_property('ll-config-file', TRACKER_CONFIG)
+        tracker.set_property('tracker-width', TRACKER_WIDTH)
+        tracker.set_property('tracker-height', TRACKER_HEIGHT)
     # Add nvvidconv1 and filter1 to convert the frames to RGBA
     # which is easier to work with in Python.
     print("Creating nvvidconv1 \n ")
@@ -352,7 +560,14 @@ def main(args):
     streammux.set_property('batch-size', number_sources)
     streammux.set_property('batched-push-timeout', 4000000)
     #pgie.set_property('config-file-path', "dstest_imagedata_config.txt")
-    pgie.set_property('config-file-path', "retinaface_config.txt")
+    if SECONDARY_FACE_MODE:
+        pgie.set_property('config-file-path', PERSON_DETECTOR_CONFIG)
+        face_gie.set_property('config-file-path', "retinaface_sgie_config.txt")
+    else:
+        pgie.set_property('config-file-path', "retinaface_config.txt")
+    if person_gie:
+        person_gie.set_property('config-file-path', PERSON_DETECTOR_CONFIG)
+        person_gie.set_property('unique-id', PERSON_GIE_ID)
     pgie_batch_size = pgie.get_property("batch-size")
     if (pgie_batch_size != number_sources):
         print("WARNING: Overriding infer-config batch-size", pgie_batch_size, " with number of sources ",
@@ -379,22 +594,67 @@ def main(args):
 
     print("Adding elements to Pipeline \n")
     pipeline.add(pgie)
+    if SECONDARY_FACE_MODE:
+        pipeline.add(face_gie)
+    if person_gie:
+        pipeline.add(person_gie)
+    if tracker:
+        pipeline.add(tracker)
     pipeline.add(tiler)
     pipeline.add(nvvidconv)
-    pipeline.add(filter1)
-    pipeline.add(nvvidconv1)
+    if not SAVE_YUV_JPEG:
+        pipeline.add(filter1)
+        pipeline.add(nvvidconv1)
     pipeline.add(nvosd)
     pipeline.add(sink)
 
     print("Linking elements in the Pipeline \n")
     streammux.link(pgie)
-    pgie.link(nvvidconv1)
-    nvvidconv1.link(filter1)
-    filter1.link(tiler)
+    if SECONDARY_FACE_MODE:
+        pgie.link(face_gie)
+    last_gie = face_gie
+    if person_gie:
+        face_gie.link(person_gie)
+        last_gie = person_gie
+    if tracker:
+        global tracker_in_pipeline
+        tracker_in_pipeline = True
+        last_gie.link(tracker)
+        last_gie = tracker
+    if SAVE_YUV_JPEG:
+        last_gie.link(tiler)
+    else:
+        last_gie.link(nvvidconv1)
+        nvvidconv1.link(filter1)
+        filter1.link(tiler)
     tiler.link(nvvidconv)
     nvvidconv.link(nvosd)
     nvosd.link(sink)
 
+    # Con fuentes en vivo la sobrecarga no se regula sola: se diezman primero
+    # las clases bajas. Los archivos ya frenan por backpressure.
+    if is_live:
+        global qos_controller
+        qos_controller = QosController(QOS_CLASSES, capacity_fps=QOS_CAPACITY_FPS,
+                                       max_inflight=QOS_MAX_INFLIGHT)
+        for i, srcpad in enumerate(source_pads):
+            cls = SOURCE_QOS_CLASS.get(i, len(QOS_CLASSES) - 1)
+            if not qos_controller.attach_source(srcpad, i, cls):
+                sys.stderr.write(" Unable to attach QoS to source %d \n" % i)
+        if not qos_controller.attach_processed(face_gie.get_static_pad("src")):
+            sys.stderr.write(" Unable to attach QoS to pgie \n")
+        GLib.timeout_add(5000, qos_print_callback)
+
+    # Las personas solapadas repiten caras: se fusionan en coordenadas de frame
+    crop_merge = None
+    if SECONDARY_FACE_MODE:
+        crop_merge = CrossCropMerge(face_gie.get_static_pad("src"), FACE_GIE_ID)
+
+    association = None
+    if person_gie:
+        association = FacePersonAssociation(person_gie.get_static_pad("src"), FACE_GIE_ID, PERSON_GIE_ID,
+                                            person_class_id=PGIE_CLASS_ID_PERSON)
+
     # create an event loop and feed gstreamer bus mesages to it
     loop = GLib.MainLoop()
     bus = pipeline.get_bus()
@@ -426,6 +686,42 @@ def main(args):
     # cleanup
     print("Exiting app\n")
     pipeline.set_state(Gst.State.NULL)
+    if face_events:
+        print_face_events(face_events.flush())
+        stats = face_events.stats()
+        print("Face events: %d enter, %d update, %d exit from %d detections (%d tracks debounced)" %
+              (stats.enters, stats.updates, stats.exits, stats.detections, stats.discarded))
+    for i, store in dvr_stores.items():
+        stats = store.stats()
+        print("DVR stream %d: %d frames (%d MB), %d overwritten" % (i, stats.records, stats.used_bytes >> 20,
+                                                                   stats.overwritten))
+        store.close()
+    if FLIGHT_RECORDER:
+        stop_flight_recorder()
+        flight = flight_recorder_stats()
+        print("Flight recorder: %d dumps (%d failed), p%.1f %.0f us / %d candidates" %
+              (flight.dumps, flight.failed_dumps, FLIGHT_RECORDER_PERCENTILE, flight.threshold_us,
+               flight.threshold_candidates))
+    if SHADOW_PARSER_CONFIG:
+        stop_parser_shadow()
+        _, shadow = parser_shadow_stats()
+        print("Shadow parser: %d compared (%d dropped), %.2f ms vs %.2f ms active, %d missed, %d extra, "
+              "%.0f%% disagreeing, IoU %.3f" % (shadow['compared'], shadow['dropped'], shadow['shadow_ms'],
+                                                 shadow['active_ms'], shadow['missed'], shadow['extra'],
+                                                 100.0 * shadow['disagreeing'], shadow['mean_iou']))
+    if ADAPTIVE_JPEG:
+        print_jpeg_quality(number_sources)
+    stats = frame_writer.stats()
+    print("Writer: %d saved, %d dropped, %d failed" % (stats.completed, stats.dropped, stats.failed))
+    frame_writer.close()
+    if qos_controller:
+        qos_controller.close()
+    if crop_merge:
+        stats = crop_merge.stats()
+        print("Cross-crop merge: %d faces, %d duplicates removed" % (stats.faces, stats.merged))
+    if association:
+        stats = association.stats()
+        print("Face-person association: %d of %d faces" % (stats.associated, stats.faces))
 
 
 if __name__ == '__main__':
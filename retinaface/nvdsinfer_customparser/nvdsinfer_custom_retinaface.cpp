@@ -6,11 +6,23 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstdlib>
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <thread>
 #include <vector>
 
 // Incluye nuestro header con las declaraciones
 #include "nvdsinfer_custom_retinaface.h"
+#include "retinaface_flight_recorder.h"
+#include "retinaface_nms.h"
+#include "retinaface_parser_config.h"
+#include "retinaface_parser_shadow.h"
+#include "retinaface_thread_pool.h"
 
 //-------------------------------------------------------------------------------
 // Anclas para 3 niveles de FPN, tal como en decode.cu (solo si el modelo usa 3 escalas)
@@ -21,185 +33,746 @@ static const StrideAnchor kStrideAnchors[3] = {
     {32, 256}
 };
 
+int retinaFaceAnchorCount(int inputWidth, int inputHeight)
+{
+    int count = 0;
+    for (int scaleIdx = 0; scaleIdx < 3; ++scaleIdx) {
+        const int stride = kStrideAnchors[scaleIdx].stride;
+        count += 2 * (inputWidth / stride) * (inputHeight / stride);
+    }
+    return count;
+}
+
 //-------------------------------------------------------------------------------
-// Implementación de decodeRetinaFace
+// RetinaFaceDetectionBatch
 //-------------------------------------------------------------------------------
-std::vector<RetinaFaceDetection> decodeRetinaFace(
+static const int kBatchAlignment = 64;
+static const int kBatchPlanes    = 15;   // x1, y1, x2, y2, score + 10 landmarks
+
+RetinaFaceDetectionBatch::RetinaFaceDetectionBatch()
+    : x1(nullptr), y1(nullptr), x2(nullptr), y2(nullptr), score(nullptr),
+      count(0), capacity(0), m_storage(nullptr)
+{
+    std::fill(landmarks, landmarks + 10, static_cast<float*>(nullptr));
+}
+
+RetinaFaceDetectionBatch::RetinaFaceDetectionBatch(int initialCapacity)
+    : RetinaFaceDetectionBatch()
+{
+    reserve(initialCapacity);
+}
+
+RetinaFaceDetectionBatch::~RetinaFaceDetectionBatch()
+{
+    std::free(m_storage);
+}
+
+bool RetinaFaceDetectionBatch::reserve(int newCapacity)
+{
+    if (newCapacity <= capacity) return true;
+
+    // Cada plano se redondea a 16 floats para que todos empiecen alineados
+    const size_t stride = (static_cast<size_t>(newCapacity) + 15) & ~static_cast<size_t>(15);
+    void* memory = nullptr;
+    if (posix_memalign(&memory, kBatchAlignment, stride * kBatchPlanes * sizeof(float)) != 0) {
+        std::cerr << "ERROR: no se pudo reservar un lote de " << newCapacity << " detecciones." << std::endl;
+        return false;
+    }
+    std::free(m_storage);
+    m_storage = static_cast<float*>(memory);
+
+    float* planes[kBatchPlanes];
+    for (int p = 0; p < kBatchPlanes; ++p) planes[p] = m_storage + p * stride;
+    x1 = planes[0];
+    y1 = planes[1];
+    x2 = planes[2];
+    y2 = planes[3];
+    score = planes[4];
+    for (int m = 0; m < 10; ++m) landmarks[m] = planes[5 + m];
+    capacity = static_cast<int>(stride);
+    count = 0;
+    return true;
+}
+
+RetinaFaceDetection RetinaFaceDetectionBatch::get(int i) const
+{
+    RetinaFaceDetection det;
+    det.x1 = x1[i];
+    det.y1 = y1[i];
+    det.x2 = x2[i];
+    det.y2 = y2[i];
+    det.confidence = score[i];
+    for (int m = 0; m < 10; ++m) det.landmarks[m] = landmarks[m][i];
+    return det;
+}
+
+//-------------------------------------------------------------------------------
+// Geometría de una escala FPN y decodificación de un ancla, compartidas por
+// el decode completo y el modo de una sola cara
+//-------------------------------------------------------------------------------
+namespace {
+// Asumimos 2 anchors por celda
+const int kAnchorsPerCell = 2;
+
+struct ScaleLayout {
+    int locOffset;
+    int landmOffset;
+    int confOffset;
+    int anchorSize;
+    int feat_w;
+    int feat_h;
+};
+
+struct AnchorPrior {
+    float cx;
+    float cy;
+    float w;
+    float h;
+};
+}
+
+static ScaleLayout scaleLayout(int inputWidth, int inputHeight, int scaleIdx)
+{
+    // Se asume que la salida está separada por escalas (FPN): los offsets de
+    // esta escala son la suma de las anteriores
+    ScaleLayout layout = {0, 0, 0, 0, 0, 0};
+    for (int s = 0; s < scaleIdx; ++s) {
+        const int featSize = (inputWidth / kStrideAnchors[s].stride) * (inputHeight / kStrideAnchors[s].stride);
+        layout.locOffset   += (4 * kAnchorsPerCell)  * featSize;
+        layout.landmOffset += (10 * kAnchorsPerCell) * featSize;
+        layout.confOffset  += (2 * kAnchorsPerCell)  * featSize;
+    }
+    const int stride = kStrideAnchors[scaleIdx].stride;
+    layout.anchorSize = kStrideAnchors[scaleIdx].baseAnchor;
+    layout.feat_w = inputWidth  / stride;
+    layout.feat_h = inputHeight / stride;
+    return layout;
+}
+
+static inline AnchorPrior anchorPrior(const ScaleLayout &layout, int x, int y, int k, int inputWidth,
+                                      int inputHeight)
+{
+    AnchorPrior prior;
+    prior.cx = (x + 0.5f) / layout.feat_w;
+    prior.cy = (y + 0.5f) / layout.feat_h;
+    prior.w  = (layout.anchorSize * (k + 1)) / static_cast<float>(inputWidth);
+    prior.h  = (layout.anchorSize * (k + 1)) / static_cast<float>(inputHeight);
+    return prior;
+}
+
+// loc: los 4 valores del ancla; box: x1, y1, x2, y2 en px de la entrada
+static inline void decodeAnchorBox(const float* loc, const AnchorPrior &prior, int inputWidth, int inputHeight,
+                                   float box[4])
+{
+    float cx = prior.cx + loc[0] * 0.1f * prior.w;
+    float cy = prior.cy + loc[1] * 0.1f * prior.h;
+    float w  = prior.w  * std::exp(loc[2] * 0.2f);
+    float h  = prior.h  * std::exp(loc[3] * 0.2f);
+
+    box[0] = (cx - 0.5f * w) * inputWidth;
+    box[1] = (cy - 0.5f * h) * inputHeight;
+    box[2] = (cx + 0.5f * w) * inputWidth;
+    box[3] = (cy + 0.5f * h) * inputHeight;
+}
+
+// landm: los 10 valores del ancla; landmarks: x0, y0, ..., x4, y4
+static inline void decodeAnchorLandmarks(const float* landm, const AnchorPrior &prior, int inputWidth,
+                                         int inputHeight, float landmarks[10])
+{
+    for (int m = 0; m < 5; ++m) {
+        landmarks[2*m + 0] = (prior.cx + landm[2*m + 0] * 0.1f * prior.w) * inputWidth;
+        landmarks[2*m + 1] = (prior.cy + landm[2*m + 1] * 0.1f * prior.h) * inputHeight;
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Decodifica las filas [rowBegin, rowEnd) de una escala y escribe las
+// candidatas en out a partir de `base`. Devuelve las que superan el umbral,
+// contando también las que no caben.
+//-------------------------------------------------------------------------------
+static int decodeRows(
     const float* locData,
     const float* landmData,
     const float* confData,
     int inputWidth,
     int inputHeight,
-    float confThreshold
+    float confThreshold,
+    int scaleIdx,
+    int rowBegin,
+    int rowEnd,
+    RetinaFaceDetectionBatch &out,
+    int base
 )
 {
-    std::vector<RetinaFaceDetection> detections;
+    int found = 0;
+    const ScaleLayout layout = scaleLayout(inputWidth, inputHeight, scaleIdx);
+    const int anchorCount = kAnchorsPerCell;
 
-    int locOffset   = 0;
-    int landmOffset = 0;
-    int confOffset  = 0;
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        for (int x = 0; x < layout.feat_w; ++x) {
 
-    // Se asume que la salida está separada por escalas (FPN) y que 
-    // se iteran 3 escalas (kStrideAnchors).
-    for (int scaleIdx = 0; scaleIdx < 3; ++scaleIdx)
-    {
-        const int stride     = kStrideAnchors[scaleIdx].stride;
-        const int anchorSize = kStrideAnchors[scaleIdx].baseAnchor;
+            const int cellIndex = y * layout.feat_w + x;
 
-        const int feat_w = inputWidth  / stride;
-        const int feat_h = inputHeight / stride;
-        const int featSize = feat_w * feat_h;
-
-        // Asumimos 2 anchors por celda
-        const int anchorCount = 2; 
-
-        for (int y = 0; y < feat_h; ++y) {
-            for (int x = 0; x < feat_w; ++x) {
-
-                const int cellIndex = y * feat_w + x;
+            for (int k = 0; k < anchorCount; ++k) {
 
-                for (int k = 0; k < anchorCount; ++k) {
+                // 1) Confianza de la cara
+                float c1 = confData[layout.confOffset + (2 * anchorCount)*cellIndex + (k * 2) + 0]; // bg
+                float c2 = confData[layout.confOffset + (2 * anchorCount)*cellIndex + (k * 2) + 1]; // face
 
-                    // 1) Confianza de la cara
-                    float c1 = confData[confOffset + (2 * anchorCount)*cellIndex + (k * 2) + 0]; // bg
-                    float c2 = confData[confOffset + (2 * anchorCount)*cellIndex + (k * 2) + 1]; // face
+                float scoreFace = std::exp(c2) / (std::exp(c1) + std::exp(c2));
+                if (scoreFace < confThreshold) {
+                    continue;
+                }
 
-                    float scoreFace = std::exp(c2) / (std::exp(c1) + std::exp(c2));
-                    if (scoreFace < confThreshold) {
-                        continue;
-                    }
+                // 2) BBox
+                const AnchorPrior prior = anchorPrior(layout, x, y, k, inputWidth, inputHeight);
+                float box[4];
+                decodeAnchorBox(locData + layout.locOffset + (4 * anchorCount)*cellIndex + (k * 4), prior,
+                                inputWidth, inputHeight, box);
 
-                    // 2) BBox
-                    float dx = locData[locOffset + (4 * anchorCount)*cellIndex + (k * 4) + 0];
-                    float dy = locData[locOffset + (4 * anchorCount)*cellIndex + (k * 4) + 1];
-                    float dw = locData[locOffset + (4 * anchorCount)*cellIndex + (k * 4) + 2];
-                    float dh = locData[locOffset + (4 * anchorCount)*cellIndex + (k * 4) + 3];
+                // 3) Escribir en el lote (solo se cuentan las que no caben)
+                const int idx = base + found++;
+                if (idx >= out.capacity) {
+                    continue;
+                }
+                out.x1[idx] = box[0];
+                out.y1[idx] = box[1];
+                out.x2[idx] = box[2];
+                out.y2[idx] = box[3];
+                out.score[idx] = scoreFace;
+
+                // 4) Landmarks
+                float landmarks[10];
+                decodeAnchorLandmarks(landmData + layout.landmOffset + (10 * anchorCount)*cellIndex + (k * 10),
+                                      prior, inputWidth, inputHeight, landmarks);
+                for (int m = 0; m < 10; ++m) out.landmarks[m][idx] = landmarks[m];
+            }
+        }
+    }
+    return found;
+}
 
-                    float prior_cx = (x + 0.5f) / feat_w;
-                    float prior_cy = (y + 0.5f) / feat_h;
+//-------------------------------------------------------------------------------
+// Implementación de decodeRetinaFaceInto
+//-------------------------------------------------------------------------------
+int decodeRetinaFaceInto(
+    const float* locData,
+    const float* landmData,
+    const float* confData,
+    int inputWidth,
+    int inputHeight,
+    float confThreshold,
+    RetinaFaceDetectionBatch &out
+)
+{
+    out.clear();
+    int found = 0;
+
+    // Se iteran las 3 escalas (kStrideAnchors) completas
+    for (int scaleIdx = 0; scaleIdx < 3; ++scaleIdx) {
+        const int feat_h = inputHeight / kStrideAnchors[scaleIdx].stride;
+        found += decodeRows(locData, landmData, confData, inputWidth, inputHeight, confThreshold, scaleIdx,
+                            0, feat_h, out, found);
+    }
 
-                    float prior_w  = (anchorSize * (k + 1)) / static_cast<float>(inputWidth);
-                    float prior_h  = (anchorSize * (k + 1)) / static_cast<float>(inputHeight);
+    out.count = std::min(found, out.capacity);
+    return found;
+}
 
-                    float cx = prior_cx + dx * 0.1f * prior_w;
-                    float cy = prior_cy + dy * 0.1f * prior_h;
-                    float w  = prior_w  * std::exp(dw * 0.2f);
-                    float h  = prior_h  * std::exp(dh * 0.2f);
+//-------------------------------------------------------------------------------
+// Implementación de decodeRetinaFaceParallel
+//-------------------------------------------------------------------------------
+static const int kBandsPerThread  = 4;   // Más bandas que hilos: las caras se agrupan
+static const int kMaxDecodeThreads = 8;
+
+namespace {
+struct DecodeBand {
+    int scaleIdx;
+    int rowBegin;
+    int rowEnd;
+};
 
-                    float x1 = (cx - 0.5f * w) * inputWidth;
-                    float y1 = (cy - 0.5f * h) * inputHeight;
-                    float x2 = (cx + 0.5f * w) * inputWidth;
-                    float y2 = (cy + 0.5f * h) * inputHeight;
+/**
+ * Bandas y lotes parciales de una decodificación paralela. Pertenece al hilo
+ * que llama: los workers del pool lo reciben por puntero, nunca como
+ * thread_local propio (tendrían su instancia vacía).
+ */
+struct DecodeScratch {
+    std::vector<DecodeBand>                                bands;
+    std::vector<std::unique_ptr<RetinaFaceDetectionBatch> > parts;
+    std::vector<int>                                       partFound;
+};
+}
 
-                    // 3) Landmarks
-                    float lm[10];
-                    for (int m = 0; m < 5; ++m) {
-                        float ldx = landmData[landmOffset + (10 * anchorCount)*cellIndex + (k * 10) + (2*m + 0)];
-                        float ldy = landmData[landmOffset + (10 * anchorCount)*cellIndex + (k * 10) + (2*m + 1)];
+int defaultDecodeThreads()
+{
+    const int cores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::max(1, std::min(cores, kMaxDecodeThreads));
+}
 
-                        float lx = prior_cx + ldx * 0.1f * prior_w;
-                        float ly = prior_cy + ldy * 0.1f * prior_h;
+static ForkJoinPool &decodePool()
+{
+    // Se crea en la primera decodificación paralela; el llamador es un hilo más
+    static ForkJoinPool pool(defaultDecodeThreads() - 1);
+    return pool;
+}
 
-                        lx *= inputWidth;
-                        ly *= inputHeight;
+int decodeRetinaFaceParallel(
+    const float* locData,
+    const float* landmData,
+    const float* confData,
+    int inputWidth,
+    int inputHeight,
+    float confThreshold,
+    int threads,
+    RetinaFaceDetectionBatch &out
+)
+{
+    if (threads <= 1) {
+        return decodeRetinaFaceInto(locData, landmData, confData, inputWidth, inputHeight, confThreshold, out);
+    }
 
-                        lm[2*m + 0] = lx;
-                        lm[2*m + 1] = ly;
-                    }
+    // Se reutiliza entre llamadas del mismo hilo; ver DecodeScratch
+    static thread_local DecodeScratch callerScratch;
+    DecodeScratch* const scratch = &callerScratch;
+
+    // Bandas de filas con un número de anclas parecido, en orden de escaneo
+    std::vector<DecodeBand> &bands = scratch->bands;
+    bands.clear();
+    const int total = retinaFaceAnchorCount(inputWidth, inputHeight);
+    const int target = std::max(1, total / (threads * kBandsPerThread));
+    for (int scaleIdx = 0; scaleIdx < 3; ++scaleIdx) {
+        const int stride = kStrideAnchors[scaleIdx].stride;
+        const int feat_h = inputHeight / stride;
+        const int rowAnchors = std::max(1, 2 * (inputWidth / stride));
+        const int rows = std::max(1, target / rowAnchors);
+        for (int y = 0; y < feat_h; y += rows) {
+            DecodeBand band = {scaleIdx, y, std::min(y + rows, feat_h)};
+            bands.push_back(band);
+        }
+    }
 
-                    // 4) Crear detección
-                    RetinaFaceDetection det;
-                    det.x1 = x1;
-                    det.y1 = y1;
-                    det.x2 = x2;
-                    det.y2 = y2;
-                    det.confidence = scoreFace;
-                    for (int m = 0; m < 10; ++m) {
-                        det.landmarks[m] = lm[m];
-                    }
+    // Un lote de candidatas por banda; se unen en orden y la salida queda
+    // igual que la de decodeRetinaFaceInto
+    std::vector<std::unique_ptr<RetinaFaceDetectionBatch> > &parts = scratch->parts;
+    std::vector<int> &partFound = scratch->partFound;
+    while (parts.size() < bands.size()) parts.push_back(std::unique_ptr<RetinaFaceDetectionBatch>(
+                                                            new RetinaFaceDetectionBatch(64)));
+    partFound.assign(bands.size(), 0);
+
+    const std::function<void(int)> decodeBand = [=](int b) {
+        const DecodeBand &band = scratch->bands[b];
+        RetinaFaceDetectionBatch &part = *scratch->parts[b];
+        int found = decodeRows(locData, landmData, confData, inputWidth, inputHeight, confThreshold,
+                               band.scaleIdx, band.rowBegin, band.rowEnd, part, 0);
+        if (found > part.capacity && part.reserve(found)) {
+            decodeRows(locData, landmData, confData, inputWidth, inputHeight, confThreshold, band.scaleIdx,
+                       band.rowBegin, band.rowEnd, part, 0);
+        }
+        part.count = std::min(found, part.capacity);
+        scratch->partFound[b] = found;
+    };
+    if (!decodePool().tryRun(static_cast<int>(bands.size()), decodeBand)) {
+        // Otro parser está usando el pool: en serie en este hilo
+        for (size_t b = 0; b < bands.size(); ++b) decodeBand(static_cast<int>(b));
+    }
 
-                    detections.push_back(det);
-                }
-            }
+    out.clear();
+    int found = 0;
+    for (size_t b = 0; b < bands.size(); ++b) {
+        const RetinaFaceDetectionBatch &part = *parts[b];
+        const int n = std::max(0, std::min(part.count, out.capacity - out.count));
+        if (n > 0) {
+            const size_t bytes = n * sizeof(float);
+            std::memcpy(out.x1 + out.count, part.x1, bytes);
+            std::memcpy(out.y1 + out.count, part.y1, bytes);
+            std::memcpy(out.x2 + out.count, part.x2, bytes);
+            std::memcpy(out.y2 + out.count, part.y2, bytes);
+            std::memcpy(out.score + out.count, part.score, bytes);
+            for (int m = 0; m < 10; ++m) std::memcpy(out.landmarks[m] + out.count, part.landmarks[m], bytes);
+            out.count += n;
         }
+        found += partFound[b];
+    }
+    return found;
+}
 
-        // Avanzar offsets para la siguiente escala
-        locOffset   += (4 * anchorCount)  * featSize;
-        landmOffset += (10 * anchorCount) * featSize;
-        confOffset  += (2 * anchorCount)  * featSize;
+//-------------------------------------------------------------------------------
+// Implementación de decodeRetinaFace
+//-------------------------------------------------------------------------------
+std::vector<RetinaFaceDetection> decodeRetinaFace(
+    const float* locData,
+    const float* landmData,
+    const float* confData,
+    int inputWidth,
+    int inputHeight,
+    float confThreshold
+)
+{
+    RetinaFaceDetectionBatch batch(256);
+    const int found = decodeRetinaFaceInto(locData, landmData, confData, inputWidth, inputHeight,
+                                           confThreshold, batch);
+    if (found > batch.capacity && batch.reserve(found)) {
+        decodeRetinaFaceInto(locData, landmData, confData, inputWidth, inputHeight, confThreshold, batch);
     }
 
+    std::vector<RetinaFaceDetection> detections(batch.count);
+    for (int i = 0; i < batch.count; ++i) {
+        detections[i] = batch.get(i);
+    }
     return detections;
 }
 
-static std::vector<RetinaFaceDetection> applyNMS(
-    const std::vector<RetinaFaceDetection> &dets, float nmsThreshold)
+static inline float batchIoU(const RetinaFaceDetectionBatch &dets, int a, int b)
 {
-    if (dets.empty()) return {};
-
-    // Ordenar por confianza descendente
-    std::vector<RetinaFaceDetection> sorted = dets;
-    // Ordenar por confianza descendente
-    std::sort(sorted.begin(), sorted.end(),
-            [](const RetinaFaceDetection &a, const RetinaFaceDetection &b) {
-                return a.confidence > b.confidence;
-            });
+    const float areaA = (dets.x2[a] - dets.x1[a]) * (dets.y2[a] - dets.y1[a]);
+    const float areaB = (dets.x2[b] - dets.x1[b]) * (dets.y2[b] - dets.y1[b]);
+    const float w = std::max(0.0f, std::min(dets.x2[a], dets.x2[b]) - std::max(dets.x1[a], dets.x1[b]));
+    const float h = std::max(0.0f, std::min(dets.y2[a], dets.y2[b]) - std::max(dets.y1[a], dets.y1[b]));
+    const float intersection = w * h;
+    return intersection / (areaA + areaB - intersection);
+}
 
-    std::vector<bool> suppressed(sorted.size(), false);
-    std::vector<RetinaFaceDetection> results;
+//-------------------------------------------------------------------------------
+// Soft-NMS gaussiano: en vez de suprimir, atenúa la confianza de las que
+// solapan con la elegida y descarta las que caen bajo confThreshold. Elige
+// cada vez la mejor restante porque la atenuación cambia el orden.
+//-------------------------------------------------------------------------------
+static void applySoftNMS(RetinaFaceDetectionBatch &dets, const ParserConfig &cfg, std::vector<int> &order,
+                         std::vector<int> &keep)
+{
+    int remaining = static_cast<int>(order.size());
+    while (remaining > 0) {
+        int best = 0;
+        for (int i = 1; i < remaining; ++i) {
+            if (dets.score[order[i]] > dets.score[order[best]]) best = i;
+        }
+        const int a = order[best];
+        order[best] = order[--remaining];
+        keep.push_back(a);
+
+        int kept = 0;
+        for (int i = 0; i < remaining; ++i) {
+            const int b = order[i];
+            const float iou = batchIoU(dets, a, b);
+            dets.score[b] *= std::exp(-(iou * iou) / cfg.softNmsSigma);
+            if (dets.score[b] >= cfg.confThreshold) order[kept++] = b;
+        }
+        remaining = kept;
+    }
+}
 
-    for (size_t i = 0; i < sorted.size(); ++i) {
+//-------------------------------------------------------------------------------
+// NMS greedy con el kernel float: `order` ya viene por confianza descendente
+//-------------------------------------------------------------------------------
+static void greedyNMS(const RetinaFaceDetectionBatch &dets, const std::vector<int> &order, float nmsThreshold,
+                      std::vector<char> &suppressed, std::vector<int> &keep)
+{
+    keep.clear();
+    const int n = static_cast<int>(order.size());
+    suppressed.assign(n, 0);
+    for (int i = 0; i < n; ++i) {
         if (suppressed[i]) continue;
 
-        results.push_back(sorted[i]);
-        const auto &detA = sorted[i];
-        float areaA = (detA.x2 - detA.x1) * (detA.y2 - detA.y1);
+        const int a = order[i];
+        keep.push_back(a);
+        const float ax1 = dets.x1[a], ay1 = dets.y1[a], ax2 = dets.x2[a], ay2 = dets.y2[a];
+        const float areaA = (ax2 - ax1) * (ay2 - ay1);
 
         // Comparar con detecciones siguientes
-        for (size_t j = i + 1; j < sorted.size(); ++j) {
+        for (int j = i + 1; j < n; ++j) {
             if (suppressed[j]) continue;
 
-            const auto &detB = sorted[j];
-            float areaB = (detB.x2 - detB.x1) * (detB.y2 - detB.y1);
+            const int b = order[j];
+            const float areaB = (dets.x2[b] - dets.x1[b]) * (dets.y2[b] - dets.y1[b]);
 
-            float interX1 = std::max(detA.x1, detB.x1);
-            float interY1 = std::max(detA.y1, detB.y1);
-            float interX2 = std::min(detA.x2, detB.x2);
-            float interY2 = std::min(detA.y2, detB.y2);
+            const float w = std::max(0.0f, std::min(ax2, dets.x2[b]) - std::max(ax1, dets.x1[b]));
+            const float h = std::max(0.0f, std::min(ay2, dets.y2[b]) - std::max(ay1, dets.y1[b]));
+            const float intersection = w * h;
 
-            float w = std::max(0.0f, interX2 - interX1);
-            float h = std::max(0.0f, interY2 - interY1);
-            float intersection = w * h;
-
-            float iou = intersection / (areaA + areaB - intersection);
+            const float iou = intersection / (areaA + areaB - intersection);
             if (iou > nmsThreshold) {
-                suppressed[j] = true;
+                suppressed[j] = 1;
             }
         }
     }
+}
+
+//-------------------------------------------------------------------------------
+// NMS sobre el lote SoA según cfg.nmsMode: deja en `keep` los índices
+// supervivientes por confianza descendente. `order` y `suppressed` son
+// memoria de trabajo.
+//-------------------------------------------------------------------------------
+static void applyNMS(RetinaFaceDetectionBatch &dets, const ParserConfig &cfg, std::vector<int> &order,
+                     std::vector<char> &suppressed, std::vector<int> &keep)
+{
+    keep.clear();
+    int n = dets.count;
+    if (n == 0) return;
+
+    // Ordenar por confianza descendente; con pre-nms-top-k solo hace falta
+    // ordenar las mejores
+    order.resize(n);
+    for (int i = 0; i < n; ++i) order[i] = i;
+    const auto byScore = [&dets](int a, int b) {
+        return dets.score[a] > dets.score[b];
+    };
+    if (cfg.preNmsTopK > 0 && cfg.preNmsTopK < n) {
+        std::partial_sort(order.begin(), order.begin() + cfg.preNmsTopK, order.end(), byScore);
+        n = cfg.preNmsTopK;
+        order.resize(n);
+    } else {
+        std::sort(order.begin(), order.end(), byScore);
+    }
 
-    return results;
+    if (cfg.nmsMode == PARSER_NMS_NONE) {
+        keep.assign(order.begin(), order.end());
+        return;
+    }
+    if (cfg.nmsMode == PARSER_NMS_SOFT) {
+        applySoftNMS(dets, cfg, order, keep);
+        return;
+    }
+    const float nmsThreshold = cfg.nmsThreshold;
+
+    if (cfg.nmsKernel == PARSER_NMS_KERNEL_INT16) {
+        nmsInt16(dets, order, nmsThreshold, keep);
+        if (cfg.nmsVerify) {
+            // Mismo NMS con el kernel float para comparar
+            static thread_local std::vector<int> floatKeep;
+            greedyNMS(dets, order, nmsThreshold, suppressed, floatKeep);
+            const int outOfBand = verifyNmsDecisions(dets, order, nmsThreshold, keep, kNmsVerifyBand);
+            recordNmsVerification(floatKeep != keep, outOfBand);
+            if (outOfBand > 0) {
+                std::cerr << "ERROR: NMS int16: " << outOfBand << " decisiones fuera de la banda de "
+                          << kNmsVerifyBand << " alrededor de nms-threshold." << std::endl;
+            }
+        }
+        return;
+    }
+    greedyNMS(dets, order, nmsThreshold, suppressed, keep);
 }
 
 //-------------------------------------------------------------------------------
-// Parser que DeepStream llama para extraer detecciones finales
+// Filtros de una cara ya decodificada. Recorta la caja a la entrada de la
+// red: nvinfer escala a la unidad y, en modo secundario, suma el origen del
+// objeto padre, así que una caja fuera de la entrada acabaría fuera del
+// recorte de la persona.
 //-------------------------------------------------------------------------------
-extern "C"
-bool NvDsInferParseCustomRetinaFace(
+static bool acceptFace(RetinaFaceDetection &det, int inputW, int inputH, const ParserConfig &cfg)
+{
+    det.x1 = std::min(std::max(det.x1, 0.0f), static_cast<float>(inputW));
+    det.y1 = std::min(std::max(det.y1, 0.0f), static_cast<float>(inputH));
+    det.x2 = std::min(std::max(det.x2, 0.0f), static_cast<float>(inputW));
+    det.y2 = std::min(std::max(det.y2, 0.0f), static_cast<float>(inputH));
+
+    // Descartar bounding boxes degeneradas
+    if ((det.x2 - det.x1) < 1.0f || (det.y2 - det.y1) < 1.0f) {
+        return false;
+    }
+    if (std::min(det.x2 - det.x1, det.y2 - det.y1) < cfg.minFaceSize) {
+        return false;
+    }
+
+    // ROIs: el centro de la cara, normalizado a la entrada, en alguna
+    if (cfg.numRois > 0) {
+        const float cx = 0.5f * (det.x1 + det.x2) / inputW;
+        const float cy = 0.5f * (det.y1 + det.y2) / inputH;
+        bool inside = false;
+        for (int r = 0; r < cfg.numRois && !inside; ++r) {
+            const float* roi = cfg.rois[r];
+            inside = cx >= roi[0] && cx <= roi[2] && cy >= roi[1] && cy <= roi[3];
+        }
+        if (!inside) return false;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------------
+// best-face: una sola cara con una reducción durante el escaneo de
+// confianzas, sin lote, orden ni NMS. La softmax de dos clases crece con
+// c2 - c1, así que el escaneo compara márgenes sin exp y solo decodifica la
+// caja de las candidatas que mejoran a la actual (en largest, la de todas
+// las que superan el umbral). Las que no pasan los filtros no cuentan.
+//-------------------------------------------------------------------------------
+// Alrededor del logit del umbral se calcula la confianza exacta, así que la
+// decisión coincide con la del decode completo
+static const float kBestFaceMarginSlack = 0.05f;
+
+static bool selectBestFace(
+    const float* locData,
+    const float* landmData,
+    const float* confData,
+    int inputW,
+    int inputH,
+    const ParserConfig &cfg,
+    std::vector<RetinaFaceDetection> &faces,
+    int* candidates)
+{
+    const float confThreshold = cfg.confThreshold;
+    const float inf = std::numeric_limits<float>::infinity();
+
+    // Por debajo de marginLow no pasa nunca, desde marginHigh siempre; en
+    // medio decide la fórmula del decode. Con umbrales casi 1 la softmax en
+    // float satura a 1 a partir de un margen de ~17
+    float marginLow = -inf, marginHigh = -inf;
+    if (confThreshold > 0.f) {
+        const float logit = confThreshold < 1.f ? std::log(confThreshold / (1.f - confThreshold)) : inf;
+        marginLow  = std::min(logit - kBestFaceMarginSlack, 16.f);
+        marginHigh = confThreshold > 0.999f ? inf : logit + kBestFaceMarginSlack;
+    }
+
+    const bool largest = cfg.bestFace == PARSER_BEST_FACE_LARGEST;
+    int found = 0;
+    bool haveBest = false;
+    float bestMargin = -inf, bestArea = 0.f;
+    int bestScale = 0, bestAnchor = 0;
+    RetinaFaceDetection best;
+
+    for (int scaleIdx = 0; scaleIdx < 3; ++scaleIdx) {
+        const ScaleLayout layout = scaleLayout(inputW, inputH, scaleIdx);
+        const float* conf = confData + layout.confOffset;
+        const int anchors = kAnchorsPerCell * layout.feat_w * layout.feat_h;
+
+        for (int a = 0; a < anchors; ++a) {
+            const float c1 = conf[2 * a + 0];
+            const float c2 = conf[2 * a + 1];
+            const float margin = c2 - c1;
+            if (margin < marginLow) continue;
+            if (!(margin >= marginHigh) && std::exp(c2) / (std::exp(c1) + std::exp(c2)) < confThreshold) continue;
+            ++found;
+
+            // En score solo interesa si mejora a la mejor que pasa los filtros
+            if (!largest && haveBest && !(margin > bestMargin)) continue;
+
+            const int cellIndex = a / kAnchorsPerCell;
+            const int k = a % kAnchorsPerCell;
+            const AnchorPrior prior = anchorPrior(layout, cellIndex % layout.feat_w, cellIndex / layout.feat_w, k,
+                                                  inputW, inputH);
+            float box[4];
+            decodeAnchorBox(locData + layout.locOffset + 4 * a, prior, inputW, inputH, box);
+
+            RetinaFaceDetection det;
+            det.x1 = box[0];
+            det.y1 = box[1];
+            det.x2 = box[2];
+            det.y2 = box[3];
+            if (!acceptFace(det, inputW, inputH, cfg)) continue;
+
+            if (largest) {
+                const float area = (det.x2 - det.x1) * (det.y2 - det.y1);
+                if (haveBest && (area < bestArea || (area == bestArea && !(margin > bestMargin)))) continue;
+                bestArea = area;
+            }
+            haveBest = true;
+            bestMargin = margin;
+            bestScale = scaleIdx;
+            bestAnchor = a;
+            best = det;
+        }
+    }
+    if (candidates) *candidates = found;
+    if (!haveBest) return true;
+
+    // Confianza y landmarks solo de la elegida
+    const ScaleLayout layout = scaleLayout(inputW, inputH, bestScale);
+    const int cellIndex = bestAnchor / kAnchorsPerCell;
+    const AnchorPrior prior = anchorPrior(layout, cellIndex % layout.feat_w, cellIndex / layout.feat_w,
+                                          bestAnchor % kAnchorsPerCell, inputW, inputH);
+    const float c1 = confData[layout.confOffset + 2 * bestAnchor + 0];
+    const float c2 = confData[layout.confOffset + 2 * bestAnchor + 1];
+    best.confidence = std::exp(c2) / (std::exp(c1) + std::exp(c2));
+    decodeAnchorLandmarks(landmData + layout.landmOffset + 10 * bestAnchor, prior, inputW, inputH, best.landmarks);
+
+    if (cfg.logDetections) {
+        std::cout << "Detection: " << best.confidence << " [" << best.x1 << ", " << best.y1 << ", " << best.x2
+                  << ", " << best.y2 << "]" << std::endl;
+    }
+    faces.push_back(best);
+    return true;
+}
+
+//-------------------------------------------------------------------------------
+// Implementación de selectRetinaFaces
+//-------------------------------------------------------------------------------
+bool selectRetinaFaces(
+    const float* locData,
+    const float* landmData,
+    const float* confData,
+    int inputW,
+    int inputH,
+    const ParserConfig &cfg,
+    std::vector<RetinaFaceDetection> &faces,
+    int* candidates)
+{
+    faces.clear();
+    if (cfg.bestFace != PARSER_BEST_FACE_OFF) {
+        return selectBestFace(locData, landmData, confData, inputW, inputH, cfg, faces, candidates);
+    }
+    const float confThreshold = cfg.confThreshold;
+
+    // Lote y memoria de trabajo por hilo: tras los primeros frames el
+    // parser ya no reserva memoria
+    static thread_local RetinaFaceDetectionBatch dets(1024);
+    static thread_local std::vector<int> order, keep;
+    static thread_local std::vector<char> suppressed;
+
+    // Decodificar detecciones; con entradas grandes, repartiendo el frame
+    // entre varios hilos
+    int threads = 1;
+    if (cfg.decodeThreads != 1 && retinaFaceAnchorCount(inputW, inputH) >= cfg.parallelMinAnchors) {
+        threads = cfg.decodeThreads > 0 ? cfg.decodeThreads : defaultDecodeThreads();
+    }
+    int found = decodeRetinaFaceParallel(locData, landmData, confData, inputW, inputH, confThreshold, threads, dets);
+    if (found > dets.capacity) {
+        if (!dets.reserve(found)) return false;
+        found = decodeRetinaFaceParallel(locData, landmData, confData, inputW, inputH, confThreshold, threads,
+                                         dets);
+    }
+    if (candidates) *candidates = found;
+
+    // Aplicar NMS
+    applyNMS(dets, cfg, order, suppressed, keep);
+
+    for (size_t k = 0; k < keep.size(); ++k) {
+        RetinaFaceDetection det = dets.get(keep[k]);
+        float score = det.confidence;
+
+        if (cfg.logDetections) {
+            std::cout << "Detection: " << score << " [" << det.x1 << ", " << det.y1 << ", " << det.x2 << ", " << det.y2 << "]" << std::endl;
+        }
+        
+        if (score < confThreshold) continue;
+        if (!acceptFace(det, inputW, inputH, cfg)) continue;
+
+        faces.push_back(det);
+        if (cfg.topK > 0 && static_cast<int>(faces.size()) >= cfg.topK) break;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------------
+// Validación de salidas común a los dos parsers. Deja las caras en `faces`
+// con la caja ya recortada a la entrada de la red.
+//-------------------------------------------------------------------------------
+static bool parseFaces(
     const std::vector<NvDsInferLayerInfo> &outputLayersInfo,
     const NvDsInferNetworkInfo &networkInfo,
-    const NvDsInferParseDetectionParams &detectionParams,
-    std::vector<NvDsInferObjectDetectionInfo> &objectList,
-    std::vector<NvDsInferAttribute> &attrList,
-    void* customData,
-    int batchSize)
+    std::vector<RetinaFaceDetection> &faces)
 {
+    faces.clear();
+
     // Validar que tengamos al menos 3 salidas (loc, landm, conf)
     if (outputLayersInfo.size() < 3) {
         std::cerr << "ERROR: Se esperan al menos 3 salidas: loc, landms, conf." << std::endl;
         return false;
     }
 
+    // Instantánea de la configuración (sin locks): se retiene y se usa la
+    // misma en toda la llamada aunque se publique otra mientras tanto
+    const ParserConfigSnapshot snapshot;
+    const ParserConfig &cfg = *snapshot;
+
     int inputW = networkInfo.width;
     int inputH = networkInfo.height;
 
@@ -211,60 +784,124 @@ bool NvDsInferParseCustomRetinaFace(
     const float* locData   = reinterpret_cast<const float*>(locLayer.buffer);
     const float* landmData = reinterpret_cast<const float*>(landmLayer.buffer);
     const float* confData  = reinterpret_cast<const float*>(confLayer.buffer);
-    std::cout << "locData: " << locData << std::endl;
+    if (cfg.logDetections) std::cout << "locData: " << locData << std::endl;
     // Determinar numBboxes (ej: 16800)
     size_t numBboxes = (locLayer.inferDims.numDims > 0) ? locLayer.inferDims.d[0] : 0;
     if (numBboxes == 0) {
         std::cerr << "ERROR: locLayer.inferDims.d[0] == 0." << std::endl;
         return false;
     }
+    // Con process-mode=2 se suele bajar infer-dims: las anclas deben cuadrar
+    // con la entrada o se leerían salidas de otra escala
+    if (numBboxes != static_cast<size_t>(retinaFaceAnchorCount(inputW, inputH))) {
+        std::cerr << "ERROR: " << numBboxes << " anclas en la salida, se esperaban "
+                  << retinaFaceAnchorCount(inputW, inputH) << " para " << inputW << "x" << inputH
+                  << "." << std::endl;
+        return false;
+    }
 
-    float confThreshold = 0.5; 
-    float nmsThreshold  = 0.5; 
-    batchSize = 1; // Forzamos a 1 para simplificar el código
-    // Procesar cada imagen del batch
-    for (int b = 0; b < batchSize; ++b) {
-        // Calcular punteros para cada batch si la red se ejecuta con batch>1
-        const float* locPtr   = locData   + b * numBboxes * 4;
-        const float* landmPtr = landmData + b * numBboxes * 10;
-        const float* confPtr  = confData  + b * numBboxes * 2;
-
-        // Decodificar detecciones
-        auto dets = decodeRetinaFace(locPtr, landmPtr, confPtr, inputW, inputH, confThreshold);
-
-        // Aplicar NMS
-        std::vector<RetinaFaceDetection> filteredDetections= applyNMS(dets, nmsThreshold);
+    // El registrador de vuelo necesita el coste del parseo de esta unidad
+    const bool recording = flightRecorderActive();
+    std::chrono::steady_clock::time_point start;
+    if (recording) start = std::chrono::steady_clock::now();
 
-        // Llenar la lista final de objetos
-        for (auto &det : filteredDetections) {
-            float score = det.confidence;
+    int candidates = 0;
+    if (!selectRetinaFaces(locData, landmData, confData, inputW, inputH, cfg, faces, &candidates)) return false;
 
-            std::cout << "Detection: " << score << " [" << det.x1 << ", " << det.y1 << ", " << det.x2 << ", " << det.y2 << "]" << std::endl;
-            
-            if (score < confThreshold) continue;
+    if (recording) {
+        const float parseUs = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+        recordFlightFrame(locData, landmData, confData, numBboxes, inputW, inputH, cfg, parseUs, candidates,
+                          static_cast<int>(faces.size()));
+    }
 
-            float x1 = det.x1;
-            float y1 = det.y1;
-            float x2 = det.x2;
-            float y2 = det.y2;
+    // Comparación en sombra: solo copia las salidas en los frames muestreados
+    if (parserShadowActive()) {
+        submitParserShadow(locData, landmData, confData, numBboxes, inputW, inputH, cfg);
+    }
+    return true;
+}
 
-            // Descartar bounding boxes degeneradas
-            if ((x2 - x1) < 1.0f || (y2 - y1) < 1.0f) {
-                continue;
-            }
+//-------------------------------------------------------------------------------
+// Parser que DeepStream llama para extraer detecciones finales
+//-------------------------------------------------------------------------------
+extern "C"
+bool NvDsInferParseCustomRetinaFace(
+    const std::vector<NvDsInferLayerInfo> &outputLayersInfo,
+    const NvDsInferNetworkInfo &networkInfo,
+    const NvDsInferParseDetectionParams &detectionParams,
+    std::vector<NvDsInferObjectDetectionInfo> &objectList,
+    std::vector<NvDsInferAttribute> &attrList,
+    void* customData,
+    int batchSize)
+{
+    // nvinfer llama al parser una vez por unidad del batch (frame completo o,
+    // con process-mode=2, recorte de objeto) con los buffers ya desplazados
+    (void)batchSize;
+    static thread_local std::vector<RetinaFaceDetection> faces;
+    if (!parseFaces(outputLayersInfo, networkInfo, faces)) return false;
+
+    // Llenar la lista final de objetos
+    for (size_t k = 0; k < faces.size(); ++k) {
+        const RetinaFaceDetection &det = faces[k];
+
+        // Agregar detección en formato DeepStream
+        NvDsInferObjectDetectionInfo obj;
+        obj.classId = 0;  // Asumiendo clase "rostro" = 0
+        obj.detectionConfidence = det.confidence;
+        obj.left   = det.x1;
+        obj.top    = det.y1;
+        obj.width  = det.x2 - det.x1;
+        obj.height = det.y2 - det.y1;
+
+        objectList.push_back(obj);
+    }
 
-            // Agregar detección en formato DeepStream
-            NvDsInferObjectDetectionInfo obj;
-            obj.classId = 0;  // Asumiendo clase "rostro" = 0
-            obj.detectionConfidence = score;
-            obj.left   = x1;
-            obj.top    = y1;
-            obj.width  = x2 - x1;
-            obj.height = y2 - y1;
+    return true;
+}
 
-            objectList.push_back(obj);
+//-------------------------------------------------------------------------------
+// Parser de "máscara de instancia" que transporta los landmarks
+//-------------------------------------------------------------------------------
+extern "C"
+bool NvDsInferParseCustomRetinaFaceLandmarks(
+    const std::vector<NvDsInferLayerInfo> &outputLayersInfo,
+    const NvDsInferNetworkInfo &networkInfo,
+    const NvDsInferParseDetectionParams &detectionParams,
+    std::vector<NvDsInferInstanceMaskInfo> &objectList)
+{
+    (void)detectionParams;
+    static thread_local std::vector<RetinaFaceDetection> faces;
+    if (!parseFaces(outputLayersInfo, networkInfo, faces)) return false;
+
+    for (size_t k = 0; k < faces.size(); ++k) {
+        const RetinaFaceDetection &det = faces[k];
+        const float w = det.x2 - det.x1;
+        const float h = det.y2 - det.y1;
+
+        NvDsInferInstanceMaskInfo obj;
+        obj.classId = 0;
+        obj.detectionConfidence = det.confidence;
+        obj.left   = det.x1;
+        obj.top    = det.y1;
+        obj.width  = w;
+        obj.height = h;
+
+        // nvinfer escala la caja pero copia la máscara tal cual: los landmarks
+        // van relativos a la caja para sobrevivir al escalado. nvinfer libera
+        // la máscara con delete[].
+        obj.mask_width  = kLandmarkMaskWidth;
+        obj.mask_height = kLandmarkMaskHeight;
+        obj.mask_size   = sizeof(float) * kLandmarkMaskWidth * kLandmarkMaskHeight;
+        obj.mask = new float[kLandmarkMaskWidth * kLandmarkMaskHeight];
+        for (int m = 0; m < 5; ++m) {
+            obj.mask[2*m + 0] = (det.landmarks[2*m + 0] - det.x1) / w;
+            obj.mask[2*m + 1] = (det.landmarks[2*m + 1] - det.y1) / h;
         }
+
+        objectList.push_back(obj);
     }
 
     return true;
 }
+
+CHECK_CUSTOM_INSTANCE_MASK_PARSE_FUNC_PROTOTYPE(NvDsInferParseCustomRetinaFaceLandmarks);
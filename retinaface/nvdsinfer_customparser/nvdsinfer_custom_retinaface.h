@@ -7,10 +7,19 @@
 #ifndef NVDSINFER_CUSTOM_RETINAFACE_H
 #define NVDSINFER_CUSTOM_RETINAFACE_H
 #include <algorithm>
+#include <cstddef>
 #include <vector>
 #include "nvdsinfer_custom_impl.h" 
 
 
+/**
+ * @brief Forma de la "máscara" con la que NvDsInferParseCustomRetinaFaceLandmarks
+ *        transporta los 5 landmarks en obj_meta->mask_params: 10 floats
+ *        (x0, y0, ..., x4, y4) relativos a la caja (0..1 dentro de ella).
+ */
+static const unsigned int kLandmarkMaskWidth  = 10;
+static const unsigned int kLandmarkMaskHeight = 1;
+
 /**
  * @brief Estructura auxiliar para stride y anchor base.
  */
@@ -31,6 +40,45 @@ struct RetinaFaceDetection {
     float landmarks[10]; 
 };
 
+/**
+ * @brief Lote de detecciones en formato SoA: un array alineado a 64 bytes por
+ *        campo, para que NMS, tracking o calidad recorran cada campo con
+ *        cargas contiguas. La memoria es del lote y solo reserve() reserva.
+ */
+struct RetinaFaceDetectionBatch {
+    float* x1;
+    float* y1;
+    float* x2;
+    float* y2;
+    float* score;
+    float* landmarks[10];   /**< Un plano por coordenada: x0, y0, ..., x4, y4 */
+    int    count;           /**< Detecciones válidas */
+    int    capacity;        /**< Detecciones que caben sin reservar */
+
+    RetinaFaceDetectionBatch();
+    explicit RetinaFaceDetectionBatch(int capacity);
+    ~RetinaFaceDetectionBatch();
+
+    /** @brief Garantiza capacidad; descarta el contenido si tiene que crecer. */
+    bool reserve(int capacity);
+    void clear() { count = 0; }
+
+    /** @brief Copia la detección i a formato AoS. */
+    RetinaFaceDetection get(int i) const;
+
+private:
+    RetinaFaceDetectionBatch(const RetinaFaceDetectionBatch &);
+    RetinaFaceDetectionBatch &operator=(const RetinaFaceDetectionBatch &);
+
+    float* m_storage;
+};
+
+/**
+ * @brief Número de anclas que genera la red para una entrada de ese tamaño
+ *        (3 escalas FPN, 2 anclas por celda).
+ */
+int retinaFaceAnchorCount(int inputWidth, int inputHeight);
+
 /**
  * @brief Decodifica las salidas de la red RetinaFace para generar detecciones.
  *
@@ -52,6 +100,66 @@ std::vector<RetinaFaceDetection> decodeRetinaFace(
     float confThreshold
 );
 
+/**
+ * @brief Igual que decodeRetinaFace() pero escribe en un lote del llamador
+ *        sin reservar memoria. Vacía el lote antes de escribir.
+ *
+ * @return Detecciones que superan el umbral. Si es mayor que out.capacity,
+ *         solo se guardaron las primeras out.capacity (reserve() y repetir).
+ */
+int decodeRetinaFaceInto(
+    const float* locData,
+    const float* landmData,
+    const float* confData,
+    int inputWidth,
+    int inputHeight,
+    float confThreshold,
+    RetinaFaceDetectionBatch &out
+);
+
+/**
+ * @brief Igual que decodeRetinaFaceInto() pero reparte las filas de las
+ *        escalas en bandas entre `threads` hilos de un pool persistente, cada
+ *        una con su lote de candidatas, y las une en el orden de escaneo: la
+ *        salida es idéntica a la versión en serie. Compensa con muchas anclas
+ *        (entradas de 1080p); con threads <= 1 es la versión en serie.
+ */
+int decodeRetinaFaceParallel(
+    const float* locData,
+    const float* landmData,
+    const float* confData,
+    int inputWidth,
+    int inputHeight,
+    float confThreshold,
+    int threads,
+    RetinaFaceDetectionBatch &out
+);
+
+/** @brief Hilos por defecto para decodificar un frame: núcleos, hasta 8. */
+int defaultDecodeThreads();
+
+struct ParserConfig;
+
+/**
+ * @brief Decodificación, NMS, filtros de la configuración y recorte a la
+ *        entrada de la red: lo que hace el parser con unas salidas ya
+ *        validadas. Reutiliza memoria por hilo. Con best-face solo
+ *        escanea confianzas y devuelve como mucho una cara.
+ *
+ * @param faces      Salida: caras por confianza descendente.
+ * @param candidates Salida opcional: anclas que superaron conf-threshold.
+ */
+bool selectRetinaFaces(
+    const float* locData,
+    const float* landmData,
+    const float* confData,
+    int inputWidth,
+    int inputHeight,
+    const ParserConfig &config,
+    std::vector<RetinaFaceDetection> &faces,
+    int* candidates = nullptr
+);
+
 /**
  * @brief Parser principal que DeepStream llama para convertir las salidas de la red en
  *        NvDsInferObjectDetectionInfo y NvDsInferAttribute.
@@ -76,4 +184,16 @@ extern "C" bool NvDsInferParseCustomRetinaFace(
     int batchSize
 );
 
+/**
+ * @brief Variante para network-type=3 (output-instance-mask=1): mismas caras
+ *        que NvDsInferParseCustomRetinaFace, con los landmarks en la máscara
+ *        de cada objeto (ver kLandmarkMaskWidth).
+ */
+extern "C" bool NvDsInferParseCustomRetinaFaceLandmarks(
+    const std::vector<NvDsInferLayerInfo> &outputLayersInfo,
+    const NvDsInferNetworkInfo &networkInfo,
+    const NvDsInferParseDetectionParams &detectionParams,
+    std::vector<NvDsInferInstanceMaskInfo> &objectList
+);
+
 #endif // NVDSINFER_CUSTOM_RETINAFACE_H
@@ -0,0 +1,349 @@
+/******************************************************************************
+ * retinaface_analytics.cpp
+ *
+ * Implementación de zonas (rejilla precompilada) y cruces de línea
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include "retinaface_analytics.h"
+
+//-------------------------------------------------------------------------------
+// Intersección segmento-rectángulo (Liang-Barsky)
+//-------------------------------------------------------------------------------
+static bool segmentHitsRect(float x0, float y0, float x1, float y1,
+                            float rx0, float ry0, float rx1, float ry1)
+{
+    const float dx = x1 - x0;
+    const float dy = y1 - y0;
+    const float p[4] = { -dx, dx, -dy, dy };
+    const float q[4] = { x0 - rx0, rx1 - x0, y0 - ry0, ry1 - y0 };
+    float t0 = 0.f, t1 = 1.f;
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.f) {
+            if (q[i] < 0.f) return false;
+            continue;
+        }
+        const float t = q[i] / p[i];
+        if (p[i] < 0.f) {
+            if (t > t1) return false;
+            t0 = std::max(t0, t);
+        } else {
+            if (t < t0) return false;
+            t1 = std::min(t1, t);
+        }
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------------
+// ZoneGrid
+//-------------------------------------------------------------------------------
+void ZoneGrid::reset(float frameW, float frameH, int cols, int rows)
+{
+    m_cols  = std::max(1, cols);
+    m_rows  = std::max(1, rows);
+    m_cellW = std::max(frameW, 1.f) / m_cols;
+    m_cellH = std::max(frameH, 1.f) / m_rows;
+    m_zones.clear();
+    m_inside.assign(static_cast<size_t>(m_cols) * m_rows, 0);
+    m_boundary.assign(static_cast<size_t>(m_cols) * m_rows, 0);
+}
+
+bool ZoneGrid::pointInPolygon(const std::vector<float> &poly, float x, float y)
+{
+    const size_t n = poly.size() / 2;
+    bool inside = false;
+    for (size_t i = 0, j = n - 1; i < n; j = i++) {
+        const float xi = poly[2*i], yi = poly[2*i + 1];
+        const float xj = poly[2*j], yj = poly[2*j + 1];
+        if ((yi > y) != (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+void ZoneGrid::compileZone(int zone)
+{
+    const std::vector<float> &poly = m_zones[zone];
+    const uint64_t bit = 1ULL << zone;
+    const size_t n = poly.size() / 2;
+
+    // 1) Celdas que toca algún borde
+    for (size_t i = 0; i < n; ++i) {
+        const float x0 = poly[2*i], y0 = poly[2*i + 1];
+        const float x1 = poly[2*((i + 1) % n)], y1 = poly[2*((i + 1) % n) + 1];
+        const int c0 = std::max(0, static_cast<int>(std::floor(std::min(x0, x1) / m_cellW)));
+        const int c1 = std::min(m_cols - 1, static_cast<int>(std::floor(std::max(x0, x1) / m_cellW)));
+        const int r0 = std::max(0, static_cast<int>(std::floor(std::min(y0, y1) / m_cellH)));
+        const int r1 = std::min(m_rows - 1, static_cast<int>(std::floor(std::max(y0, y1) / m_cellH)));
+        for (int r = r0; r <= r1; ++r) {
+            for (int c = c0; c <= c1; ++c) {
+                if (segmentHitsRect(x0, y0, x1, y1, c * m_cellW, r * m_cellH,
+                                    (c + 1) * m_cellW, (r + 1) * m_cellH)) {
+                    m_boundary[r * m_cols + c] |= bit;
+                }
+            }
+        }
+    }
+
+    // 2) Las demás celdas están enteras dentro o fuera: basta su centro
+    for (int r = 0; r < m_rows; ++r) {
+        for (int c = 0; c < m_cols; ++c) {
+            const size_t idx = static_cast<size_t>(r) * m_cols + c;
+            if (m_boundary[idx] & bit) continue;
+            if (pointInPolygon(poly, (c + 0.5f) * m_cellW, (r + 0.5f) * m_cellH)) {
+                m_inside[idx] |= bit;
+            }
+        }
+    }
+}
+
+int ZoneGrid::addZone(const float* xy, int numPoints)
+{
+    if (!xy || numPoints < 3 || static_cast<int>(m_zones.size()) >= kMaxZonesPerStream) return -1;
+    m_zones.push_back(std::vector<float>(xy, xy + 2 * numPoints));
+    const int zone = static_cast<int>(m_zones.size()) - 1;
+    compileZone(zone);
+    return zone;
+}
+
+uint64_t ZoneGrid::query(float x, float y) const
+{
+    const int c = static_cast<int>(std::floor(x / m_cellW));
+    const int r = static_cast<int>(std::floor(y / m_cellH));
+
+    uint64_t mask = 0;
+    uint64_t pending;
+    if (c < 0 || r < 0 || c >= m_cols || r >= m_rows) {
+        // Fuera de la rejilla: test exacto de todas las zonas
+        pending = m_zones.size() >= 64 ? ~0ULL : ((1ULL << m_zones.size()) - 1);
+    } else {
+        const size_t idx = static_cast<size_t>(r) * m_cols + c;
+        mask = m_inside[idx];
+        pending = m_boundary[idx];
+    }
+    while (pending) {
+        const int z = __builtin_ctzll(pending);
+        pending &= pending - 1;
+        if (pointInPolygon(m_zones[z], x, y)) mask |= 1ULL << z;
+    }
+    return mask;
+}
+
+//-------------------------------------------------------------------------------
+// ZoneAnalytics
+//-------------------------------------------------------------------------------
+ZoneAnalytics::ZoneAnalytics(int gridCols, int gridRows, int64_t publishPeriodMs,
+                             int64_t trackTimeoutMs)
+    : m_gridCols(gridCols > 0 ? gridCols : 64),
+      m_gridRows(gridRows > 0 ? gridRows : 36),
+      m_periodMs(publishPeriodMs > 0 ? publishPeriodMs : 1000),
+      m_trackTimeoutMs(trackTimeoutMs > 0 ? trackTimeoutMs : 5000),
+      m_frameCounts(kMaxZonesPerStream, 0)
+{
+}
+
+void ZoneAnalytics::configureStream(uint32_t streamId, float frameW, float frameH)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stream &s = m_streams[streamId];
+    s = Stream();
+    s.grid.reset(frameW, frameH, m_gridCols, m_gridRows);
+}
+
+int ZoneAnalytics::addZone(uint32_t streamId, const float* xy, int numPoints)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<uint32_t, Stream>::iterator it = m_streams.find(streamId);
+    if (it == m_streams.end()) return -1;
+
+    const int zone = it->second.grid.addZone(xy, numPoints);
+    if (zone >= 0) {
+        ZoneAccum acc = { 0, 0, 0 };
+        it->second.zones.push_back(acc);
+    }
+    return zone;
+}
+
+int ZoneAnalytics::addLine(uint32_t streamId, float x1, float y1, float x2, float y2)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<uint32_t, Stream>::iterator it = m_streams.find(streamId);
+    if (it == m_streams.end()) return -1;
+
+    Line line = { x1, y1, x2, y2, 0, 0, 0, 0 };
+    it->second.lines.push_back(line);
+    return static_cast<int>(it->second.lines.size()) - 1;
+}
+
+// +1: cruce de izquierda a derecha, -1: de derecha a izquierda, 0: sin cruce
+int ZoneAnalytics::crossing(const Line &line, float ax, float ay, float bx, float by)
+{
+    const float lx = line.x2 - line.x1;
+    const float ly = line.y2 - line.y1;
+    const float da = lx * (ay - line.y1) - ly * (ax - line.x1);
+    const float db = lx * (by - line.y1) - ly * (bx - line.x1);
+    if ((da < 0.f) == (db < 0.f)) return 0;
+
+    // Los extremos de la línea deben quedar a ambos lados del movimiento
+    const float mx = bx - ax;
+    const float my = by - ay;
+    const float e1 = mx * (line.y1 - ay) - my * (line.x1 - ax);
+    const float e2 = mx * (line.y2 - ay) - my * (line.x2 - ax);
+    if ((e1 < 0.f) == (e2 < 0.f) && e1 != 0.f && e2 != 0.f) return 0;
+
+    return da < 0.f ? 1 : -1;
+}
+
+void ZoneAnalytics::update(uint32_t streamId, int64_t nowMs, const uint64_t* trackIds,
+                           const float* points, int count, uint64_t* zoneMasks)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<uint32_t, Stream>::iterator it = m_streams.find(streamId);
+    if (it == m_streams.end()) return;
+    Stream &s = it->second;
+
+    if (s.periodStartMs < 0) s.periodStartMs = nowMs;
+    const int numZones = s.grid.zoneCount();
+    std::fill(m_frameCounts.begin(), m_frameCounts.begin() + numZones, 0);
+
+    for (int i = 0; i < count; ++i) {
+        const float x = points[2*i];
+        const float y = points[2*i + 1];
+
+        uint64_t mask = s.grid.query(x, y);
+        if (zoneMasks) zoneMasks[i] = mask;
+        while (mask) {
+            ++m_frameCounts[__builtin_ctzll(mask)];
+            mask &= mask - 1;
+        }
+
+        if (!trackIds || s.lines.empty()) continue;
+        TrackState &t = s.tracks[trackIds[i]];
+        if (t.lastSeenMs > 0) {
+            for (size_t l = 0; l < s.lines.size(); ++l) {
+                const int dir = crossing(s.lines[l], t.x, t.y, x, y);
+                if (dir > 0) { ++s.lines[l].periodIn;  ++s.lines[l].totalIn; }
+                if (dir < 0) { ++s.lines[l].periodOut; ++s.lines[l].totalOut; }
+            }
+        }
+        t.x = x;
+        t.y = y;
+        t.lastSeenMs = std::max<int64_t>(nowMs, 1);
+    }
+
+    for (int z = 0; z < numZones; ++z) {
+        ZoneAccum &acc = s.zones[z];
+        acc.current = m_frameCounts[z];
+        acc.peak = std::max(acc.peak, acc.current);
+        acc.sum += acc.current;
+    }
+    ++s.frames;
+
+    // Olvidar tracks que ya no aparecen
+    if (nowMs - s.lastSweepMs >= m_trackTimeoutMs) {
+        for (std::unordered_map<uint64_t, TrackState>::iterator t = s.tracks.begin(); t != s.tracks.end();) {
+            if (nowMs - t->second.lastSeenMs > m_trackTimeoutMs) {
+                t = s.tracks.erase(t);
+            } else {
+                ++t;
+            }
+        }
+        s.lastSweepMs = nowMs;
+    }
+}
+
+bool ZoneAnalytics::poll(uint32_t streamId, int64_t nowMs, ZoneStats* zones, int* numZones,
+                         LineStats* lines, int* numLines)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<uint32_t, Stream>::iterator it = m_streams.find(streamId);
+    if (it == m_streams.end()) return false;
+    Stream &s = it->second;
+
+    if (s.periodStartMs < 0 || nowMs - s.periodStartMs < m_periodMs) return false;
+
+    const int nz = std::min(numZones ? *numZones : 0, static_cast<int>(s.zones.size()));
+    for (int z = 0; z < nz; ++z) {
+        zones[z].zone    = z;
+        zones[z].current = s.zones[z].current;
+        zones[z].peak    = s.zones[z].peak;
+        zones[z].average = s.frames > 0 ? static_cast<float>(s.zones[z].sum) / s.frames : 0.f;
+    }
+    if (numZones) *numZones = nz;
+
+    const int nl = std::min(numLines ? *numLines : 0, static_cast<int>(s.lines.size()));
+    for (int l = 0; l < nl; ++l) {
+        lines[l].line     = l;
+        lines[l].inCount  = s.lines[l].periodIn;
+        lines[l].outCount = s.lines[l].periodOut;
+        lines[l].reserved = 0;
+        lines[l].totalIn  = s.lines[l].totalIn;
+        lines[l].totalOut = s.lines[l].totalOut;
+    }
+    if (numLines) *numLines = nl;
+
+    // Nuevo periodo
+    for (size_t z = 0; z < s.zones.size(); ++z) {
+        s.zones[z].peak = s.zones[z].current;
+        s.zones[z].sum  = 0;
+    }
+    for (size_t l = 0; l < s.lines.size(); ++l) {
+        s.lines[l].periodIn = s.lines[l].periodOut = 0;
+    }
+    s.frames = 0;
+    s.periodStartMs = nowMs;
+    return true;
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" void* RetinaFaceZonesCreate(int gridCols, int gridRows, int64_t publishPeriodMs,
+                                       int64_t trackTimeoutMs)
+{
+    return new ZoneAnalytics(gridCols, gridRows, publishPeriodMs, trackTimeoutMs);
+}
+
+extern "C" void RetinaFaceZonesDestroy(void* analytics)
+{
+    delete static_cast<ZoneAnalytics*>(analytics);
+}
+
+extern "C" void RetinaFaceZonesConfigureStream(void* analytics, uint32_t streamId,
+                                               float frameW, float frameH)
+{
+    if (analytics) static_cast<ZoneAnalytics*>(analytics)->configureStream(streamId, frameW, frameH);
+}
+
+extern "C" int RetinaFaceZonesAddZone(void* analytics, uint32_t streamId, const float* xy, int numPoints)
+{
+    if (!analytics) return -1;
+    return static_cast<ZoneAnalytics*>(analytics)->addZone(streamId, xy, numPoints);
+}
+
+extern "C" int RetinaFaceZonesAddLine(void* analytics, uint32_t streamId,
+                                      float x1, float y1, float x2, float y2)
+{
+    if (!analytics) return -1;
+    return static_cast<ZoneAnalytics*>(analytics)->addLine(streamId, x1, y1, x2, y2);
+}
+
+extern "C" void RetinaFaceZonesUpdate(void* analytics, uint32_t streamId, int64_t nowMs,
+                                      const uint64_t* trackIds, const float* points, int count,
+                                      uint64_t* zoneMasks)
+{
+    if (!analytics || count < 0 || (count > 0 && !points)) return;
+    static_cast<ZoneAnalytics*>(analytics)->update(streamId, nowMs, trackIds, points, count, zoneMasks);
+}
+
+extern "C" int RetinaFaceZonesPoll(void* analytics, uint32_t streamId, int64_t nowMs,
+                                   ZoneStats* zones, int* numZones, LineStats* lines, int* numLines)
+{
+    if (!analytics) return 0;
+    return static_cast<ZoneAnalytics*>(analytics)->poll(streamId, nowMs, zones, numZones,
+                                                        lines, numLines) ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+/******************************************************************************
+ * retinaface_analytics.h
+ *
+ * Ocupación por zonas poligonales y cruces de línea por track, con conteos
+ * agregados publicados periódicamente
+ ******************************************************************************/
+
+#ifndef RETINAFACE_ANALYTICS_H
+#define RETINAFACE_ANALYTICS_H
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/** @brief Máximo de zonas por stream (una máscara de 64 bits por celda). */
+static const int kMaxZonesPerStream = 64;
+
+/**
+ * @brief Conteos de una zona en el último periodo.
+ */
+struct ZoneStats {
+    int32_t zone;
+    int32_t current;   /**< Ocupación en el último frame */
+    int32_t peak;      /**< Máximo del periodo */
+    float   average;   /**< Media por frame del periodo */
+};
+
+/**
+ * @brief Cruces de una línea. "in" es de izquierda a derecha mirando de
+ *        (x1,y1) hacia (x2,y2).
+ */
+struct LineStats {
+    int32_t  line;
+    uint32_t inCount;    /**< Cruces en el periodo */
+    uint32_t outCount;
+    uint32_t reserved;
+    uint64_t totalIn;    /**< Cruces desde el inicio */
+    uint64_t totalOut;
+};
+
+/**
+ * @brief Polígonos precompilados en una rejilla: cada celda guarda qué zonas
+ *        la contienen por completo y cuáles la cruzan con un borde. Solo los
+ *        puntos que caen en celdas de borde hacen el test punto-en-polígono.
+ */
+class ZoneGrid {
+public:
+    ZoneGrid() : m_cols(0), m_rows(0), m_cellW(1.f), m_cellH(1.f) {}
+
+    void reset(float frameW, float frameH, int cols, int rows);
+
+    /** @return Índice de la zona, o -1 si ya hay kMaxZonesPerStream. */
+    int addZone(const float* xy, int numPoints);
+
+    /** @brief Máscara de zonas que contienen el punto. */
+    uint64_t query(float x, float y) const;
+
+    int zoneCount() const { return static_cast<int>(m_zones.size()); }
+
+private:
+    void compileZone(int zone);
+    static bool pointInPolygon(const std::vector<float> &poly, float x, float y);
+
+    int                             m_cols;
+    int                             m_rows;
+    float                           m_cellW;
+    float                           m_cellH;
+    std::vector<std::vector<float> > m_zones;
+    std::vector<uint64_t>           m_inside;    // Zonas que cubren toda la celda
+    std::vector<uint64_t>           m_boundary;  // Zonas con un borde en la celda
+};
+
+/**
+ * @brief Analítica por stream sobre la salida del parser/tracker. Thread-safe.
+ */
+class ZoneAnalytics {
+public:
+    /**
+     * @param gridCols        Columnas de la rejilla de zonas.
+     * @param gridRows        Filas de la rejilla de zonas.
+     * @param publishPeriodMs Duración de cada periodo de agregación.
+     * @param trackTimeoutMs  Tiempo sin ver un track antes de olvidarlo.
+     */
+    ZoneAnalytics(int gridCols, int gridRows, int64_t publishPeriodMs, int64_t trackTimeoutMs);
+
+    /** @brief Fija la resolución del stream; descarta zonas y líneas previas. */
+    void configureStream(uint32_t streamId, float frameW, float frameH);
+
+    int addZone(uint32_t streamId, const float* xy, int numPoints);
+    int addLine(uint32_t streamId, float x1, float y1, float x2, float y2);
+
+    /**
+     * @brief Procesa las detecciones de un frame.
+     *
+     * @param points  Punto de anclaje (x,y) de cada objeto, p.ej. centro del bbox.
+     * @param zoneMasks Salida opcional: máscara de zonas por objeto.
+     */
+    void update(uint32_t streamId, int64_t nowMs, const uint64_t* trackIds,
+                const float* points, int count, uint64_t* zoneMasks);
+
+    /**
+     * @brief Si terminó el periodo del stream, copia los conteos y abre otro.
+     *
+     * @return `true` si se publicó un periodo.
+     */
+    bool poll(uint32_t streamId, int64_t nowMs, ZoneStats* zones, int* numZones,
+              LineStats* lines, int* numLines);
+
+private:
+    struct Line {
+        float    x1, y1, x2, y2;
+        uint32_t periodIn, periodOut;
+        uint64_t totalIn, totalOut;
+    };
+    struct TrackState {
+        float   x, y;
+        int64_t lastSeenMs;
+    };
+    struct ZoneAccum {
+        int32_t current;
+        int32_t peak;
+        int64_t sum;
+    };
+    struct Stream {
+        ZoneGrid                                 grid;
+        std::vector<ZoneAccum>                   zones;
+        std::vector<Line>                        lines;
+        std::unordered_map<uint64_t, TrackState> tracks;
+        int64_t                                  periodStartMs;
+        int64_t                                  frames;
+        int64_t                                  lastSweepMs;
+
+        Stream() : periodStartMs(-1), frames(0), lastSweepMs(0) {}
+    };
+
+    static int crossing(const Line &line, float ax, float ay, float bx, float by);
+
+    int                          m_gridCols;
+    int                          m_gridRows;
+    int64_t                      m_periodMs;
+    int64_t                      m_trackTimeoutMs;
+    std::map<uint32_t, Stream>   m_streams;
+    std::vector<int32_t>         m_frameCounts;
+    std::mutex                   m_mutex;
+};
+
+extern "C" {
+void* RetinaFaceZonesCreate(int gridCols, int gridRows, int64_t publishPeriodMs, int64_t trackTimeoutMs);
+void  RetinaFaceZonesDestroy(void* analytics);
+void  RetinaFaceZonesConfigureStream(void* analytics, uint32_t streamId, float frameW, float frameH);
+int   RetinaFaceZonesAddZone(void* analytics, uint32_t streamId, const float* xy, int numPoints);
+int   RetinaFaceZonesAddLine(void* analytics, uint32_t streamId, float x1, float y1, float x2, float y2);
+void  RetinaFaceZonesUpdate(void* analytics, uint32_t streamId, int64_t nowMs, const uint64_t* trackIds,
+                            const float* points, int count, uint64_t* zoneMasks);
+int   RetinaFaceZonesPoll(void* analytics, uint32_t streamId, int64_t nowMs, ZoneStats* zones,
+                          int* numZones, LineStats* lines, int* numLines);
+}
+
+#endif // RETINAFACE_ANALYTICS_H
@@ -0,0 +1,616 @@
+/******************************************************************************
+ * retinaface_archive.cpp
+ *
+ * Implementación del archivo temporal de detecciones. Los valores de cada
+ * bloque se guardan canal a canal (todas las x1, luego todas las y1, ...) para
+ * que los deltas sean pequeños y la integración sea un recorrido secuencial.
+ * Stream VByte separa los códigos de longitud (2 bits por valor) de los
+ * datos, así que el decodificador expande 4 valores con un solo shuffle.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "retinaface_archive.h"
+
+static const uint32_t kFileMagic    = 0x52414652;  // "RFAR"
+static const uint32_t kFileVersion  = 1;
+static const uint32_t kBlockMagic   = 0x4b4c4246;  // "FBLK"
+static const int64_t  kMaxBlockSpan = 1 << 30;     // Frame/ts relativos caben en int32
+
+struct ArchiveFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    float    coordStep;
+    uint32_t reserved;
+};
+
+//-------------------------------------------------------------------------------
+// Stream VByte (longitudes 0/1/2/4): tablas de shuffle por byte de control
+//-------------------------------------------------------------------------------
+#if defined(__SSSE3__) || defined(__aarch64__)
+namespace {
+struct SvbTables {
+    uint8_t length[256];
+    uint8_t shuffle[256][16];
+
+    SvbTables()
+    {
+        static const int kLen[4] = { 0, 1, 2, 4 };
+        for (int c = 0; c < 256; ++c) {
+            int offset = 0;
+            for (int lane = 0; lane < 4; ++lane) {
+                const int n = kLen[(c >> (2 * lane)) & 3];
+                for (int b = 0; b < 4; ++b) {
+                    shuffle[c][lane * 4 + b] = (b < n) ? static_cast<uint8_t>(offset + b) : 0x80;
+                }
+                offset += n;
+            }
+            length[c] = static_cast<uint8_t>(offset);
+        }
+    }
+};
+} // namespace
+
+static const SvbTables &svbTables()
+{
+    static const SvbTables tables;
+    return tables;
+}
+#endif
+
+static inline uint32_t zigzagEncode(uint32_t d)
+{
+    return (d << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(d) >> 31);
+}
+
+static inline uint32_t zigzagDecode(uint32_t v)
+{
+    return (v >> 1) ^ (0u - (v & 1u));
+}
+
+static void svbEncode(const uint32_t* values, size_t n, std::vector<uint8_t> &out)
+{
+    const size_t ctrlBytes = (n + 3) / 4;
+    out.assign(ctrlBytes, 0);
+    for (size_t i = 0; i < n; ++i) {
+        const uint32_t v = values[i];
+        int code, bytes;
+        if (v == 0)           { code = 0; bytes = 0; }
+        else if (v < 0x100)   { code = 1; bytes = 1; }
+        else if (v < 0x10000) { code = 2; bytes = 2; }
+        else                  { code = 3; bytes = 4; }
+        out[i >> 2] |= static_cast<uint8_t>(code << (2 * (i & 3)));
+        for (int b = 0; b < bytes; ++b) out.push_back(static_cast<uint8_t>(v >> (8 * b)));
+    }
+}
+
+// Decodifica y deshace el zigzag. Devuelve false si los datos no alcanzan.
+static bool svbDecodeZigzag(const uint8_t* ctrl, const uint8_t* data, const uint8_t* end,
+                            uint32_t* out, size_t n)
+{
+    size_t g = 0;
+
+#if defined(__SSSE3__)
+    const SvbTables &t = svbTables();
+    const size_t groups = n / 4;
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i zero = _mm_setzero_si128();
+    for (; g < groups && data + 16 <= end; ++g) {
+        const uint8_t c = ctrl[g];
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        v = _mm_shuffle_epi8(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.shuffle[c])));
+        v = _mm_xor_si128(_mm_srli_epi32(v, 1), _mm_sub_epi32(zero, _mm_and_si128(v, one)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * g), v);
+        data += t.length[c];
+    }
+#elif defined(__aarch64__)
+    const SvbTables &t = svbTables();
+    const size_t groups = n / 4;
+    const uint32x4_t one = vdupq_n_u32(1);
+    for (; g < groups && data + 16 <= end; ++g) {
+        const uint8_t c = ctrl[g];
+        const uint32x4_t v = vreinterpretq_u32_u8(vqtbl1q_u8(vld1q_u8(data), vld1q_u8(t.shuffle[c])));
+        const uint32x4_t sign = vreinterpretq_u32_s32(vnegq_s32(vreinterpretq_s32_u32(vandq_u32(v, one))));
+        vst1q_u32(out + 4 * g, veorq_u32(vshrq_n_u32(v, 1), sign));
+        data += t.length[c];
+    }
+#endif
+
+    // Cola (y todo el bloque sin SIMD): mismo formato, valor a valor
+    for (size_t i = 4 * g; i < n; ++i) {
+        const int code = (ctrl[i >> 2] >> (2 * (i & 3))) & 3;
+        const int bytes = (code == 3) ? 4 : code;
+        if (data + bytes > end) return false;
+        uint32_t v = 0;
+        for (int b = 0; b < bytes; ++b) v |= static_cast<uint32_t>(data[b]) << (8 * b);
+        data += bytes;
+        out[i] = zigzagDecode(v);
+    }
+    return data <= end;
+}
+
+//-------------------------------------------------------------------------------
+// Bloques
+//-------------------------------------------------------------------------------
+static inline int32_t quantize(float v, float inv)
+{
+    const float q = v * inv;
+    if (!(q == q)) return 0;
+    return static_cast<int32_t>(std::lrint(std::max(std::min(q, 1073741824.f), -1073741824.f)));
+}
+
+void encodeArchiveBlock(const ArchiveRecord* records, int count, float coordStep,
+                        ArchiveBlockInfo &info, std::vector<uint8_t> &payload)
+{
+    const float inv = 1.f / coordStep;
+    const ArchiveRecord &first = records[0];
+
+    info.count      = static_cast<uint32_t>(count);
+    info.firstFrame = first.frameNum;
+    info.firstTsMs  = first.tsMs;
+    info.lastTsMs   = records[count - 1].tsMs;
+    info.maxScore   = first.score;
+    info.minSize    = info.maxSize = std::min(first.box[2], first.box[3]);
+    info.bounds[0]  = first.box[0];
+    info.bounds[1]  = first.box[1];
+    info.bounds[2]  = first.box[0] + first.box[2];
+    info.bounds[3]  = first.box[1] + first.box[3];
+
+    // Valores cuantizados canal a canal
+    std::vector<uint32_t> values(static_cast<size_t>(count) * kArchiveChannels);
+    for (int i = 0; i < count; ++i) {
+        const ArchiveRecord &r = records[i];
+        const int32_t left = quantize(r.box[0], inv);
+        const int32_t top  = quantize(r.box[1], inv);
+        uint32_t* col = &values[i];
+        col[ARCHIVE_CH_FRAME * count] = static_cast<uint32_t>(r.frameNum - first.frameNum);
+        col[ARCHIVE_CH_TS * count]    = static_cast<uint32_t>(r.tsMs - first.tsMs);
+        col[(ARCHIVE_CH_BOX + 0) * count] = static_cast<uint32_t>(left);
+        col[(ARCHIVE_CH_BOX + 1) * count] = static_cast<uint32_t>(top);
+        col[(ARCHIVE_CH_BOX + 2) * count] = static_cast<uint32_t>(quantize(r.box[2], inv));
+        col[(ARCHIVE_CH_BOX + 3) * count] = static_cast<uint32_t>(quantize(r.box[3], inv));
+        col[ARCHIVE_CH_SCORE * count] = static_cast<uint32_t>(quantize(r.score, kArchiveScoreScale));
+        for (int k = 0; k < 5; ++k) {
+            col[(ARCHIVE_CH_LANDMARKS + 2*k) * count]     = static_cast<uint32_t>(quantize(r.landmarks[2*k], inv) - left);
+            col[(ARCHIVE_CH_LANDMARKS + 2*k + 1) * count] = static_cast<uint32_t>(quantize(r.landmarks[2*k + 1], inv) - top);
+        }
+
+        const float size = std::min(r.box[2], r.box[3]);
+        info.lastTsMs  = std::max(info.lastTsMs, r.tsMs);
+        info.maxScore  = std::max(info.maxScore, r.score);
+        info.minSize   = std::min(info.minSize, size);
+        info.maxSize   = std::max(info.maxSize, size);
+        info.bounds[0] = std::min(info.bounds[0], r.box[0]);
+        info.bounds[1] = std::min(info.bounds[1], r.box[1]);
+        info.bounds[2] = std::max(info.bounds[2], r.box[0] + r.box[2]);
+        info.bounds[3] = std::max(info.bounds[3], r.box[1] + r.box[3]);
+    }
+
+    // Residuos: delta de delta para frame/ts (casi siempre 0), delta simple
+    // para el resto; el primer valor de cada canal queda absoluto (keyframe)
+    for (int c = 0; c < kArchiveChannels; ++c) {
+        uint32_t* v = &values[static_cast<size_t>(c) * count];
+        uint32_t prev = 0, prevDelta = 0;
+        for (int i = 0; i < count; ++i) {
+            const uint32_t delta = v[i] - prev;
+            prev = v[i];
+            if (c <= ARCHIVE_CH_TS) {
+                v[i] = zigzagEncode(delta - prevDelta);
+                prevDelta = delta;
+            } else {
+                v[i] = zigzagEncode(delta);
+            }
+        }
+    }
+
+    svbEncode(&values[0], values.size(), payload);
+    info.payloadBytes = static_cast<uint32_t>(payload.size());
+}
+
+bool decodeArchiveChannels(const ArchiveBlockInfo &info, const uint8_t* payload, int32_t* channels)
+{
+    const int count = static_cast<int>(info.count);
+    const size_t n = static_cast<size_t>(count) * kArchiveChannels;
+    const size_t ctrlBytes = (n + 3) / 4;
+    if (count <= 0 || info.payloadBytes < ctrlBytes) return false;
+
+    uint32_t* v = reinterpret_cast<uint32_t*>(channels);
+    if (!svbDecodeZigzag(payload, payload + ctrlBytes, payload + info.payloadBytes, v, n)) {
+        return false;
+    }
+
+    for (int c = 0; c < kArchiveChannels; ++c) {
+        uint32_t* ch = v + static_cast<size_t>(c) * count;
+        uint32_t acc = 0, delta = 0;
+        if (c <= ARCHIVE_CH_TS) {
+            for (int i = 0; i < count; ++i) {
+                delta += ch[i];
+                acc += delta;
+                ch[i] = acc;
+            }
+        } else {
+            for (int i = 0; i < count; ++i) {
+                acc += ch[i];
+                ch[i] = acc;
+            }
+        }
+    }
+
+    // Landmarks de vuelta a coordenadas absolutas
+    const int32_t* left = channels + (ARCHIVE_CH_BOX + 0) * count;
+    const int32_t* top  = channels + (ARCHIVE_CH_BOX + 1) * count;
+    for (int k = 0; k < 5; ++k) {
+        int32_t* lx = channels + (ARCHIVE_CH_LANDMARKS + 2*k) * count;
+        int32_t* ly = channels + (ARCHIVE_CH_LANDMARKS + 2*k + 1) * count;
+        for (int i = 0; i < count; ++i) {
+            lx[i] += left[i];
+            ly[i] += top[i];
+        }
+    }
+    return true;
+}
+
+void archiveChannelsToRecord(const ArchiveBlockInfo &info, const int32_t* channels, float coordStep,
+                             int index, ArchiveRecord &out)
+{
+    const int count = static_cast<int>(info.count);
+    const int32_t* col = channels + index;
+    out.frameNum = info.firstFrame + static_cast<int64_t>(col[ARCHIVE_CH_FRAME * count]);
+    out.tsMs     = info.firstTsMs + col[ARCHIVE_CH_TS * count];
+    for (int k = 0; k < 4; ++k) out.box[k] = col[(ARCHIVE_CH_BOX + k) * count] * coordStep;
+    out.score = col[ARCHIVE_CH_SCORE * count] * (1.f / kArchiveScoreScale);
+    for (int k = 0; k < 10; ++k) out.landmarks[k] = col[(ARCHIVE_CH_LANDMARKS + k) * count] * coordStep;
+}
+
+void archiveChannelsToRecords(const ArchiveBlockInfo &info, const int32_t* channels, float coordStep,
+                              ArchiveRecord* out)
+{
+    for (int i = 0; i < static_cast<int>(info.count); ++i) {
+        archiveChannelsToRecord(info, channels, coordStep, i, out[i]);
+    }
+}
+
+//-------------------------------------------------------------------------------
+// ArchiveWriter
+//-------------------------------------------------------------------------------
+ArchiveWriter::ArchiveWriter()
+    : m_file(nullptr), m_interval(64), m_coordStep(0.5f), m_offset(0)
+{
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+    close();
+}
+
+bool ArchiveWriter::open(const char* path, int keyframeInterval, float coordStep)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file) return false;
+
+    m_interval  = std::min(std::max(keyframeInterval, 1), kArchiveMaxBlock);
+    m_coordStep = (coordStep > 0.f) ? coordStep : 0.5f;
+    m_file = std::fopen(path, "wb");
+    if (!m_file) {
+        std::cerr << "ERROR: no se pudo crear el archivo de detecciones " << path << std::endl;
+        return false;
+    }
+    // Sin buffer de stdio: lo que fwrite acepta ya está en el archivo, así que
+    // un bloque fallido se deshace truncando en m_offset (ver writeBlock)
+    std::setvbuf(m_file, nullptr, _IONBF, 0);
+
+    ArchiveFileHeader header;
+    header.magic     = kFileMagic;
+    header.version   = kFileVersion;
+    header.coordStep = m_coordStep;
+    header.reserved  = 0;
+    if (std::fwrite(&header, sizeof(header), 1, m_file) != 1) {
+        std::cerr << "ERROR: fallo al escribir la cabecera de " << path << std::endl;
+        std::fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    m_offset = sizeof(header);
+    return true;
+}
+
+bool ArchiveWriter::writeBlock(const TrackKey &key, std::vector<ArchiveRecord> &records)
+{
+    if (records.empty()) return true;
+
+    ArchiveBlockInfo info;
+    std::memset(&info, 0, sizeof(info));
+    encodeArchiveBlock(&records[0], static_cast<int>(records.size()), m_coordStep, info, m_payload);
+    info.magic    = kBlockMagic;
+    info.streamId = key.first;
+    info.trackId  = key.second;
+    info.offset   = m_offset;
+
+    if (std::fwrite(&info, sizeof(info), 1, m_file) != 1 ||
+        std::fwrite(&m_payload[0], 1, m_payload.size(), m_file) != m_payload.size()) {
+        // Se descarta el bloque parcial y se conservan los registros para
+        // reintentarlo en la próxima escritura del track
+        std::cerr << "ERROR: fallo al escribir un bloque del archivo de detecciones" << std::endl;
+        std::clearerr(m_file);
+        if (ftruncate(fileno(m_file), static_cast<off_t>(m_offset)) != 0 ||
+            std::fseek(m_file, static_cast<long>(m_offset), SEEK_SET) != 0) {
+            std::cerr << "ERROR: no se pudo volver al último bloque válido del archivo de detecciones"
+                      << std::endl;
+        }
+        return false;
+    }
+    m_offset += sizeof(info) + m_payload.size();
+    records.clear();
+    return true;
+}
+
+bool ArchiveWriter::append(uint32_t streamId, const uint64_t* trackIds, const ArchiveRecord* records,
+                           int count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file) return false;
+
+    bool ok = true;
+    for (int i = 0; i < count; ++i) {
+        const TrackKey key(streamId, trackIds[i]);
+        std::vector<ArchiveRecord> &pending = m_pending[key];
+
+        // Frame y ts se guardan relativos al keyframe en 32 bits
+        if (!pending.empty()) {
+            const int64_t dt = records[i].tsMs - pending[0].tsMs;
+            const int64_t df = static_cast<int64_t>(records[i].frameNum - pending[0].frameNum);
+            if ((dt >= kMaxBlockSpan || dt <= -kMaxBlockSpan || df >= kMaxBlockSpan || df <= -kMaxBlockSpan) &&
+                !writeBlock(key, pending)) {
+                // El registro no cabe en el bloque pendiente que no se pudo escribir
+                ok = false;
+                continue;
+            }
+        }
+        // Tras escrituras fallidas el bloque pendiente no crece más allá del máximo
+        if (static_cast<int>(pending.size()) >= kArchiveMaxBlock) {
+            ok &= writeBlock(key, pending);
+            if (!pending.empty()) continue;
+        }
+        pending.push_back(records[i]);
+        if (static_cast<int>(pending.size()) >= m_interval) ok &= writeBlock(key, pending);
+    }
+    return ok;
+}
+
+bool ArchiveWriter::closeTrack(uint32_t streamId, uint64_t trackId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file) return false;
+
+    std::map<TrackKey, std::vector<ArchiveRecord> >::iterator it = m_pending.find(TrackKey(streamId, trackId));
+    if (it == m_pending.end()) return true;
+    // Si falla, los registros quedan pendientes y close() lo reintenta
+    if (!writeBlock(it->first, it->second)) return false;
+    m_pending.erase(it);
+    return true;
+}
+
+bool ArchiveWriter::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file) return true;
+
+    bool ok = true;
+    for (std::map<TrackKey, std::vector<ArchiveRecord> >::iterator it = m_pending.begin();
+         it != m_pending.end(); ++it) {
+        ok &= writeBlock(it->first, it->second);
+    }
+    m_pending.clear();
+    ok &= (std::fclose(m_file) == 0);
+    m_file = nullptr;
+    return ok;
+}
+
+uint64_t ArchiveWriter::bytesWritten()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_offset;
+}
+
+//-------------------------------------------------------------------------------
+// ArchiveReader
+//-------------------------------------------------------------------------------
+ArchiveReader::ArchiveReader()
+    : m_fd(-1), m_coordStep(0.5f)
+{
+}
+
+ArchiveReader::~ArchiveReader()
+{
+    close();
+}
+
+void ArchiveReader::close()
+{
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+    m_blocks.clear();
+    m_byTrack.clear();
+}
+
+bool ArchiveReader::open(const char* path)
+{
+    close();
+    m_fd = ::open(path, O_RDONLY);
+    if (m_fd < 0) {
+        std::cerr << "ERROR: no se pudo abrir el archivo de detecciones " << path << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    ArchiveFileHeader header;
+    if (fstat(m_fd, &st) != 0 ||
+        pread(m_fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        header.magic != kFileMagic || header.version != kFileVersion || !(header.coordStep > 0.f)) {
+        std::cerr << "ERROR: " << path << " no es un archivo de detecciones válido" << std::endl;
+        close();
+        return false;
+    }
+    m_coordStep = header.coordStep;
+
+    // Solo se leen las cabeceras; los payloads se saltan
+    const uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+    uint64_t offset = sizeof(header);
+    while (offset + sizeof(ArchiveBlockInfo) <= fileSize) {
+        ArchiveBlockInfo info;
+        if (pread(m_fd, &info, sizeof(info), offset) != static_cast<ssize_t>(sizeof(info))) break;
+        const uint64_t end = offset + sizeof(info) + info.payloadBytes;
+        if (info.magic != kBlockMagic || info.count == 0 || info.count > kArchiveMaxBlock ||
+            end > fileSize) {
+            std::cerr << "WARNING: bloque inválido o truncado en " << path << " (offset " << offset
+                      << "), se ignora el resto del archivo" << std::endl;
+            break;
+        }
+        info.offset = offset;
+        m_byTrack[std::make_pair(info.streamId, info.trackId)].push_back(static_cast<int>(m_blocks.size()));
+        m_blocks.push_back(info);
+        offset = end;
+    }
+    return true;
+}
+
+void ArchiveReader::trackBlocks(uint32_t streamId, uint64_t trackId, int64_t t0, int64_t t1,
+                                std::vector<int> &out) const
+{
+    out.clear();
+    std::map<std::pair<uint32_t, uint64_t>, std::vector<int> >::const_iterator it =
+        m_byTrack.find(std::make_pair(streamId, trackId));
+    if (it == m_byTrack.end()) return;
+
+    // Los bloques de un track se escriben en orden temporal
+    const std::vector<int> &blocks = it->second;
+    size_t lo = 0, hi = blocks.size();
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (m_blocks[blocks[mid]].lastTsMs < t0) lo = mid + 1;
+        else hi = mid;
+    }
+    for (size_t i = lo; i < blocks.size() && m_blocks[blocks[i]].firstTsMs <= t1; ++i) {
+        out.push_back(blocks[i]);
+    }
+}
+
+bool ArchiveReader::readPayload(int index, std::vector<uint8_t> &buffer) const
+{
+    if (m_fd < 0 || index < 0 || index >= blockCount()) return false;
+    const ArchiveBlockInfo &info = m_blocks[index];
+    buffer.resize(info.payloadBytes);
+    return pread(m_fd, &buffer[0], info.payloadBytes, info.offset + sizeof(ArchiveBlockInfo)) ==
+           static_cast<ssize_t>(info.payloadBytes);
+}
+
+int ArchiveReader::readBlock(int index, ArchiveRecord* out, int maxCount) const
+{
+    std::vector<uint8_t> payload;
+    if (!readPayload(index, payload)) return -1;
+    const ArchiveBlockInfo &info = m_blocks[index];
+    if (static_cast<int>(info.count) > maxCount) return -1;
+
+    std::vector<int32_t> channels(static_cast<size_t>(info.count) * kArchiveChannels);
+    if (!decodeArchiveChannels(info, &payload[0], &channels[0])) {
+        std::cerr << "ERROR: bloque corrupto en el offset " << info.offset << std::endl;
+        return -1;
+    }
+    archiveChannelsToRecords(info, &channels[0], m_coordStep, out);
+    return static_cast<int>(info.count);
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" void* RetinaFaceArchiveOpenWriter(const char* path, int keyframeInterval, float coordStep)
+{
+    if (!path) return nullptr;
+    ArchiveWriter* writer = new ArchiveWriter();
+    if (!writer->open(path, keyframeInterval, coordStep)) {
+        delete writer;
+        return nullptr;
+    }
+    return writer;
+}
+
+extern "C" int RetinaFaceArchiveAppend(void* writer, uint32_t streamId, const uint64_t* trackIds,
+                                       const ArchiveRecord* records, int count)
+{
+    if (!writer || count < 0 || (count > 0 && (!trackIds || !records))) return 0;
+    return static_cast<ArchiveWriter*>(writer)->append(streamId, trackIds, records, count) ? 1 : 0;
+}
+
+extern "C" int RetinaFaceArchiveCloseTrack(void* writer, uint32_t streamId, uint64_t trackId)
+{
+    if (!writer) return 0;
+    return static_cast<ArchiveWriter*>(writer)->closeTrack(streamId, trackId) ? 1 : 0;
+}
+
+extern "C" int RetinaFaceArchiveCloseWriter(void* writer)
+{
+    if (!writer) return 0;
+    ArchiveWriter* w = static_cast<ArchiveWriter*>(writer);
+    const bool ok = w->close();
+    delete w;
+    return ok ? 1 : 0;
+}
+
+extern "C" void* RetinaFaceArchiveOpenReader(const char* path)
+{
+    if (!path) return nullptr;
+    ArchiveReader* reader = new ArchiveReader();
+    if (!reader->open(path)) {
+        delete reader;
+        return nullptr;
+    }
+    return reader;
+}
+
+extern "C" void RetinaFaceArchiveCloseReader(void* reader)
+{
+    delete static_cast<ArchiveReader*>(reader);
+}
+
+extern "C" int RetinaFaceArchiveBlockCount(void* reader)
+{
+    return reader ? static_cast<ArchiveReader*>(reader)->blockCount() : 0;
+}
+
+extern "C" int RetinaFaceArchiveGetBlock(void* reader, int index, ArchiveBlockInfo* info)
+{
+    ArchiveReader* r = static_cast<ArchiveReader*>(reader);
+    if (!r || !info || index < 0 || index >= r->blockCount()) return 0;
+    *info = r->block(index);
+    return 1;
+}
+
+extern "C" int RetinaFaceArchiveTrackBlocks(void* reader, uint32_t streamId, uint64_t trackId, int64_t t0,
+                                            int64_t t1, int* out, int maxCount)
+{
+    if (!reader || !out || maxCount <= 0) return 0;
+    std::vector<int> blocks;
+    static_cast<ArchiveReader*>(reader)->trackBlocks(streamId, trackId, t0, t1, blocks);
+    const int n = std::min(static_cast<int>(blocks.size()), maxCount);
+    std::copy(blocks.begin(), blocks.begin() + n, out);
+    return n;
+}
+
+extern "C" int RetinaFaceArchiveReadBlock(void* reader, int index, ArchiveRecord* out, int maxCount)
+{
+    if (!reader || !out) return -1;
+    return static_cast<ArchiveReader*>(reader)->readBlock(index, out, maxCount);
+}
@@ -0,0 +1,200 @@
+/******************************************************************************
+ * retinaface_archive.h
+ *
+ * Archivo temporal de detecciones por track: bloques que empiezan con un
+ * keyframe absoluto y siguen con deltas cuantizados en Stream VByte
+ ******************************************************************************/
+
+#ifndef RETINAFACE_ARCHIVE_H
+#define RETINAFACE_ARCHIVE_H
+#include <stdint.h>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/** @brief Canales por registro: frame, ts, 4 de caja, score y 10 de landmarks. */
+static const int kArchiveChannels = 17;
+
+/** @brief Máximo de registros por bloque (distancia máxima entre keyframes). */
+static const int kArchiveMaxBlock = 4096;
+
+/** @brief El score se cuantiza en pasos de 1/kArchiveScoreScale. */
+static const float kArchiveScoreScale = 1024.f;
+
+/**
+ * @brief Primer canal de cada campo en las columnas decodificadas.
+ */
+enum ArchiveChannel {
+    ARCHIVE_CH_FRAME     = 0,
+    ARCHIVE_CH_TS        = 1,
+    ARCHIVE_CH_BOX       = 2,   /**< left, top, width, height */
+    ARCHIVE_CH_SCORE     = 6,
+    ARCHIVE_CH_LANDMARKS = 7    /**< x0,y0 .. x4,y4 */
+};
+
+/**
+ * @brief Detección de un track en un frame, tal como se lee del archivo.
+ */
+struct ArchiveRecord {
+    uint64_t frameNum;
+    int64_t  tsMs;
+    float    box[4];         /**< left, top, width, height en coordenadas del frame */
+    float    score;
+    float    landmarks[10];  /**< x0,y0 .. x4,y4 */
+};
+
+/**
+ * @brief Cabecera de un bloque en disco. En memoria forma el índice del
+ *        archivo y sirve de zone map (rangos por bloque) para las consultas.
+ */
+struct ArchiveBlockInfo {
+    uint32_t magic;
+    uint32_t count;         /**< Registros del bloque */
+    uint32_t streamId;
+    uint32_t payloadBytes;  /**< Bytes de control + datos tras la cabecera */
+    uint64_t trackId;
+    uint64_t firstFrame;
+    int64_t  firstTsMs;
+    int64_t  lastTsMs;
+    float    maxScore;
+    float    minSize;       /**< Rango de min(width, height) en el bloque */
+    float    maxSize;
+    float    bounds[4];     /**< Unión de las cajas: x0, y0, x1, y1 */
+    uint32_t reserved;
+    uint64_t offset;        /**< Posición de la cabecera en el archivo */
+};
+
+/**
+ * @brief Codifica `count` registros de un track en un bloque: canal a canal,
+ *        el primer valor absoluto y luego deltas (frame y ts con delta de
+ *        delta, landmarks relativos a la esquina de la caja) en zigzag y
+ *        Stream VByte con longitudes 0/1/2/4 bytes.
+ *
+ * @param coordStep Paso de cuantización de coordenadas en píxeles.
+ * @param info      Salida: cabecera completa salvo magic/offset/ids.
+ * @param payload   Salida: bytes de control seguidos de los datos.
+ */
+void encodeArchiveBlock(const ArchiveRecord* records, int count, float coordStep,
+                        ArchiveBlockInfo &info, std::vector<uint8_t> &payload);
+
+/**
+ * @brief Decodifica un bloque a columnas cuantizadas (canal a canal, `count`
+ *        valores por canal): frame y ts relativos al primero, coordenadas en
+ *        pasos de coordStep y score en 1/1024.
+ *
+ * @return `false` si el payload está truncado o corrupto.
+ */
+bool decodeArchiveChannels(const ArchiveBlockInfo &info, const uint8_t* payload, int32_t* channels);
+
+/** @brief Convierte columnas decodificadas en registros. */
+void archiveChannelsToRecords(const ArchiveBlockInfo &info, const int32_t* channels, float coordStep,
+                              ArchiveRecord* out);
+
+/** @brief Convierte solo el registro `index` de las columnas decodificadas. */
+void archiveChannelsToRecord(const ArchiveBlockInfo &info, const int32_t* channels, float coordStep,
+                             int index, ArchiveRecord &out);
+
+/**
+ * @brief Escritor de archivos de detecciones. Acumula los registros de cada
+ *        track y escribe un bloque cada `keyframeInterval` registros, al cerrar
+ *        el track o al cerrar el archivo. Thread-safe.
+ */
+class ArchiveWriter {
+public:
+    ArchiveWriter();
+    ~ArchiveWriter();
+
+    bool open(const char* path, int keyframeInterval, float coordStep);
+
+    /**
+     * @brief Añade los registros de un frame; uno por track. Si un bloque no
+     *        se puede escribir, el archivo vuelve al último bloque válido, los
+     *        registros del track siguen pendientes y se devuelve `false`.
+     */
+    bool append(uint32_t streamId, const uint64_t* trackIds, const ArchiveRecord* records, int count);
+
+    /**
+     * @brief Escribe lo pendiente del track (p.ej. cuando el tracker lo pierde).
+     *        Si falla, lo pendiente se conserva para close().
+     */
+    bool closeTrack(uint32_t streamId, uint64_t trackId);
+
+    /** @brief Escribe todo lo pendiente y cierra el archivo. */
+    bool close();
+
+    uint64_t bytesWritten();
+
+private:
+    ArchiveWriter(const ArchiveWriter &);
+    ArchiveWriter &operator=(const ArchiveWriter &);
+
+    typedef std::pair<uint32_t, uint64_t> TrackKey;
+
+    bool writeBlock(const TrackKey &key, std::vector<ArchiveRecord> &records);
+
+    FILE*                                          m_file;
+    int                                            m_interval;
+    float                                          m_coordStep;
+    uint64_t                                       m_offset;
+    std::map<TrackKey, std::vector<ArchiveRecord> > m_pending;
+    std::vector<uint8_t>                           m_payload;
+    std::mutex                                     m_mutex;
+};
+
+/**
+ * @brief Lector con acceso aleatorio: al abrir recorre solo las cabeceras de
+ *        bloque y construye el índice en memoria. Las lecturas usan pread, así
+ *        que varios hilos pueden decodificar bloques a la vez.
+ */
+class ArchiveReader {
+public:
+    ArchiveReader();
+    ~ArchiveReader();
+
+    bool open(const char* path);
+    void close();
+
+    int blockCount() const { return static_cast<int>(m_blocks.size()); }
+    const ArchiveBlockInfo &block(int index) const { return m_blocks[index]; }
+    float coordStep() const { return m_coordStep; }
+
+    /**
+     * @brief Bloques del track que se solapan con [t0, t1], en orden temporal.
+     */
+    void trackBlocks(uint32_t streamId, uint64_t trackId, int64_t t0, int64_t t1,
+                     std::vector<int> &out) const;
+
+    /** @brief Lee el payload de un bloque en `buffer` (se redimensiona). */
+    bool readPayload(int index, std::vector<uint8_t> &buffer) const;
+
+    /** @return Registros decodificados, o -1 si falla. */
+    int readBlock(int index, ArchiveRecord* out, int maxCount) const;
+
+private:
+    ArchiveReader(const ArchiveReader &);
+    ArchiveReader &operator=(const ArchiveReader &);
+
+    int                                                       m_fd;
+    float                                                     m_coordStep;
+    std::vector<ArchiveBlockInfo>                             m_blocks;
+    std::map<std::pair<uint32_t, uint64_t>, std::vector<int> > m_byTrack;
+};
+
+extern "C" {
+void* RetinaFaceArchiveOpenWriter(const char* path, int keyframeInterval, float coordStep);
+int   RetinaFaceArchiveAppend(void* writer, uint32_t streamId, const uint64_t* trackIds,
+                              const ArchiveRecord* records, int count);
+int   RetinaFaceArchiveCloseTrack(void* writer, uint32_t streamId, uint64_t trackId);
+int   RetinaFaceArchiveCloseWriter(void* writer);
+void* RetinaFaceArchiveOpenReader(const char* path);
+void  RetinaFaceArchiveCloseReader(void* reader);
+int   RetinaFaceArchiveBlockCount(void* reader);
+int   RetinaFaceArchiveGetBlock(void* reader, int index, ArchiveBlockInfo* info);
+int   RetinaFaceArchiveTrackBlocks(void* reader, uint32_t streamId, uint64_t trackId, int64_t t0,
+                                   int64_t t1, int* out, int maxCount);
+int   RetinaFaceArchiveReadBlock(void* reader, int index, ArchiveRecord* out, int maxCount);
+}
+
+#endif // RETINAFACE_ARCHIVE_H
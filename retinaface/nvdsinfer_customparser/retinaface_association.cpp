@@ -0,0 +1,284 @@
+/******************************************************************************
+ * retinaface_association.cpp
+ *
+ * Implementación de la asociación cara -> persona. Cada cara solo se compara
+ * con las personas de sus celdas, así que el coste es casi lineal en el
+ * número de objetos en vez de caras x personas.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "gstnvdsmeta.h"
+#include "retinaface_association.h"
+
+static const int   kMaxGridSide = 256;
+static const float kMinCellSize = 16.f;
+
+//-------------------------------------------------------------------------------
+// BoxGrid
+//-------------------------------------------------------------------------------
+void BoxGrid::build(const float* boxes, int count, float cellSize)
+{
+    m_items.clear();
+    m_cellStart.clear();
+    m_cols = m_rows = 0;
+    if (count <= 0) return;
+
+    if (cellSize <= 0.f) {
+        std::vector<float> widths(count);
+        for (int i = 0; i < count; ++i) widths[i] = boxes[4 * i + 2];
+        std::nth_element(widths.begin(), widths.begin() + count / 2, widths.end());
+        cellSize = widths[count / 2];
+    }
+
+    float minX = boxes[0], minY = boxes[1], maxX = boxes[0], maxY = boxes[1];
+    for (int i = 0; i < count; ++i) {
+        const float* b = boxes + 4 * i;
+        minX = std::min(minX, b[0]);
+        minY = std::min(minY, b[1]);
+        maxX = std::max(maxX, b[0] + b[2]);
+        maxY = std::max(maxY, b[1] + b[3]);
+    }
+    m_cell = std::max(std::max(cellSize, kMinCellSize),
+                      std::max(maxX - minX, maxY - minY) / kMaxGridSide);
+    m_originX = minX;
+    m_originY = minY;
+    m_cols = std::min(kMaxGridSide, static_cast<int>((maxX - minX) / m_cell) + 1);
+    m_rows = std::min(kMaxGridSide, static_cast<int>((maxY - minY) / m_cell) + 1);
+
+    // Dos pasadas: contar por celda y luego repartir (CSR)
+    m_cellStart.assign(m_cols * m_rows + 1, 0);
+    for (int pass = 0; pass < 2; ++pass) {
+        std::vector<int32_t> cursor;
+        if (pass == 1) {
+            for (size_t c = 1; c < m_cellStart.size(); ++c) m_cellStart[c] += m_cellStart[c - 1];
+            m_items.resize(m_cellStart.back());
+            cursor.assign(m_cellStart.begin(), m_cellStart.end() - 1);
+        }
+        for (int i = 0; i < count; ++i) {
+            const float* b = boxes + 4 * i;
+            const int c0 = std::min(m_cols - 1, std::max(0, static_cast<int>((b[0] - m_originX) / m_cell)));
+            const int c1 = std::min(m_cols - 1, std::max(0, static_cast<int>((b[0] + b[2] - m_originX) / m_cell)));
+            const int r0 = std::min(m_rows - 1, std::max(0, static_cast<int>((b[1] - m_originY) / m_cell)));
+            const int r1 = std::min(m_rows - 1, std::max(0, static_cast<int>((b[1] + b[3] - m_originY) / m_cell)));
+            for (int r = r0; r <= r1; ++r) {
+                for (int c = c0; c <= c1; ++c) {
+                    const int cell = r * m_cols + c;
+                    if (pass == 0) {
+                        ++m_cellStart[cell + 1];
+                    } else {
+                        m_items[cursor[cell]++] = i;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void BoxGrid::query(const float* box, int queryId, std::vector<int> &stamp, std::vector<int> &out) const
+{
+    if (m_cols == 0) return;
+    const float x1 = (box[0] - m_originX) / m_cell, x2 = (box[0] + box[2] - m_originX) / m_cell;
+    const float y1 = (box[1] - m_originY) / m_cell, y2 = (box[1] + box[3] - m_originY) / m_cell;
+    if (x2 < 0.f || y2 < 0.f || x1 >= m_cols || y1 >= m_rows) return;
+
+    const int c0 = std::max(0, static_cast<int>(x1)), c1 = std::min(m_cols - 1, static_cast<int>(x2));
+    const int r0 = std::max(0, static_cast<int>(y1)), r1 = std::min(m_rows - 1, static_cast<int>(y2));
+    for (int r = r0; r <= r1; ++r) {
+        for (int c = c0; c <= c1; ++c) {
+            const int cell = r * m_cols + c;
+            for (int k = m_cellStart[cell]; k < m_cellStart[cell + 1]; ++k) {
+                const int item = m_items[k];
+                if (stamp[item] == queryId) continue;
+                stamp[item] = queryId;
+                out.push_back(item);
+            }
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Asociación
+//-------------------------------------------------------------------------------
+static float pairScore(const float* person, const float* face, float headFraction)
+{
+    const float iw = std::min(person[0] + person[2], face[0] + face[2]) - std::max(person[0], face[0]);
+    const float ih = std::min(person[1] + person[3], face[1] + face[3]) - std::max(person[1], face[1]);
+    const float faceArea = face[2] * face[3];
+    if (iw <= 0.f || ih <= 0.f || faceArea <= 0.f || person[2] <= 0.f || person[3] <= 0.f) return 0.f;
+    const float containment = std::min(1.f, iw * ih / faceArea);
+
+    // La cara debe estar arriba del cuerpo y cerca de su eje
+    const float rel = (face[1] + 0.5f * face[3] - person[1]) / person[3];
+    float vertical = 1.f;
+    if (rel > headFraction) {
+        vertical = (headFraction < 1.f) ? std::max(0.f, 1.f - (rel - headFraction) / (1.f - headFraction)) : 0.f;
+    }
+    const float offset = std::fabs(face[0] + 0.5f * face[2] - (person[0] + 0.5f * person[2])) / (0.5f * person[2]);
+    const float horizontal = 1.f - 0.5f * std::min(1.f, offset);
+    return containment * vertical * horizontal;
+}
+
+namespace {
+struct Candidate {
+    float score;
+    int   face;
+    int   person;
+
+    bool operator<(const Candidate &o) const { return score > o.score; }
+};
+} // namespace
+
+int associateFaces(const float* persons, int numPersons, const float* faces, int numFaces,
+                   const AssociationConfig &config, int32_t* parent, float* scores)
+{
+    for (int f = 0; f < numFaces; ++f) {
+        parent[f] = -1;
+        if (scores) scores[f] = 0.f;
+    }
+    if (numPersons <= 0 || numFaces <= 0) return 0;
+
+    BoxGrid grid;
+    grid.build(persons, numPersons, config.cellSize);
+
+    std::vector<int> stamp(numPersons, -1);
+    std::vector<int> nearby;
+    std::vector<Candidate> candidates;
+    for (int f = 0; f < numFaces; ++f) {
+        nearby.clear();
+        grid.query(faces + 4 * f, f, stamp, nearby);
+        for (size_t k = 0; k < nearby.size(); ++k) {
+            const float s = pairScore(persons + 4 * nearby[k], faces + 4 * f, config.headFraction);
+            if (s >= config.minScore && s > 0.f) {
+                Candidate c;
+                c.score = s;
+                c.face = f;
+                c.person = nearby[k];
+                candidates.push_back(c);
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    std::vector<char> personUsed(numPersons, 0);
+    int associated = 0;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const Candidate &c = candidates[i];
+        if (parent[c.face] >= 0 || personUsed[c.person]) continue;
+        parent[c.face] = c.person;
+        if (scores) scores[c.face] = c.score;
+        personUsed[c.person] = 1;
+        ++associated;
+    }
+    return associated;
+}
+
+//-------------------------------------------------------------------------------
+// Probe de GStreamer
+//-------------------------------------------------------------------------------
+namespace {
+struct AssociationProbe {
+    AssociationProbeConfig config;
+    std::atomic<uint64_t>  frames;
+    std::atomic<uint64_t>  faces;
+    std::atomic<uint64_t>  persons;
+    std::atomic<uint64_t>  associated;
+};
+} // namespace
+
+static void appendBox(std::vector<float> &boxes, const NvDsObjectMeta* obj)
+{
+    boxes.push_back(obj->rect_params.left);
+    boxes.push_back(obj->rect_params.top);
+    boxes.push_back(obj->rect_params.width);
+    boxes.push_back(obj->rect_params.height);
+}
+
+static GstPadProbeReturn associationProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    (void)pad;
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    NvDsBatchMeta* batchMeta = buffer ? gst_buffer_get_nvds_batch_meta(buffer) : nullptr;
+    if (!batchMeta) return GST_PAD_PROBE_OK;
+
+    AssociationProbe* probe = static_cast<AssociationProbe*>(data);
+    const AssociationProbeConfig &cfg = probe->config;
+    std::vector<NvDsObjectMeta*> personMetas, faceMetas;
+    std::vector<float> personBoxes, faceBoxes;
+    std::vector<int32_t> parent;
+    for (NvDsMetaList* l = batchMeta->frame_meta_list; l != nullptr; l = l->next) {
+        NvDsFrameMeta* frameMeta = static_cast<NvDsFrameMeta*>(l->data);
+        personMetas.clear();
+        faceMetas.clear();
+        personBoxes.clear();
+        faceBoxes.clear();
+        for (NvDsMetaList* o = frameMeta->obj_meta_list; o != nullptr; o = o->next) {
+            NvDsObjectMeta* obj = static_cast<NvDsObjectMeta*>(o->data);
+            if (obj->unique_component_id == cfg.faceGieId) {
+                faceMetas.push_back(obj);
+                appendBox(faceBoxes, obj);
+            } else if (obj->unique_component_id == cfg.personGieId &&
+                       (cfg.personClassId < 0 || obj->class_id == cfg.personClassId)) {
+                personMetas.push_back(obj);
+                appendBox(personBoxes, obj);
+            }
+        }
+        probe->frames += 1;
+        probe->faces += faceMetas.size();
+        probe->persons += personMetas.size();
+        if (faceMetas.empty() || personMetas.empty()) continue;
+
+        parent.resize(faceMetas.size());
+        probe->associated += associateFaces(&personBoxes[0], static_cast<int>(personMetas.size()),
+                                            &faceBoxes[0], static_cast<int>(faceMetas.size()),
+                                            cfg.association, &parent[0], nullptr);
+        for (size_t f = 0; f < faceMetas.size(); ++f) {
+            if (parent[f] >= 0) faceMetas[f]->parent = personMetas[parent[f]];
+        }
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+static void freeAssociationProbe(gpointer data)
+{
+    delete static_cast<AssociationProbe*>(data);
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" int RetinaFaceAssociate(const float* persons, int numPersons, const float* faces, int numFaces,
+                                   const AssociationConfig* config, int32_t* parent, float* scores)
+{
+    if (!config || !parent || numFaces < 0 || numPersons < 0) return -1;
+    if ((numPersons > 0 && !persons) || (numFaces > 0 && !faces)) return -1;
+    return associateFaces(persons, numPersons, faces, numFaces, *config, parent, scores);
+}
+
+extern "C" void* RetinaFaceAssociationAttach(GstPad* pad, const AssociationProbeConfig* config)
+{
+    if (!pad || !config) return nullptr;
+    AssociationProbe* probe = new AssociationProbe();
+    probe->config = *config;
+    probe->frames = 0;
+    probe->faces = 0;
+    probe->persons = 0;
+    probe->associated = 0;
+    // Con id 0 GStreamer ya llamó a freeAssociationProbe: no se libera aquí
+    if (gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, associationProbe, probe, freeAssociationProbe) == 0) {
+        return nullptr;
+    }
+    return probe;
+}
+
+extern "C" void RetinaFaceAssociationGetStats(void* association, AssociationStats* stats)
+{
+    if (!association || !stats) return;
+    const AssociationProbe* probe = static_cast<const AssociationProbe*>(association);
+    stats->frames = probe->frames;
+    stats->faces = probe->faces;
+    stats->persons = probe->persons;
+    stats->associated = probe->associated;
+}
@@ -0,0 +1,101 @@
+/******************************************************************************
+ * retinaface_association.h
+ *
+ * Asociación cara -> persona con las cajas de personas indexadas en una
+ * rejilla uniforme
+ ******************************************************************************/
+
+#ifndef RETINAFACE_ASSOCIATION_H
+#define RETINAFACE_ASSOCIATION_H
+#include <stdint.h>
+#include <vector>
+#include <gst/gst.h>
+
+/**
+ * @brief Parámetros de la asociación.
+ */
+struct AssociationConfig {
+    float cellSize;      /**< Lado de la celda en píxeles; <= 0: mediana del ancho de las personas */
+    float minScore;      /**< Puntuación mínima para asociar (0..1) */
+    float headFraction;  /**< Fracción superior del cuerpo donde se espera el centro de la cara */
+};
+
+/**
+ * @brief Configuración de la probe sobre el batch meta.
+ */
+struct AssociationProbeConfig {
+    int               faceGieId;      /**< gie-unique-id de RetinaFace */
+    int               personGieId;    /**< gie-unique-id del detector de personas */
+    int               personClassId;  /**< Clase persona de ese detector (-1: todas) */
+    AssociationConfig association;
+};
+
+/**
+ * @brief Contadores de la probe desde el inicio.
+ */
+struct AssociationStats {
+    uint64_t frames;
+    uint64_t faces;
+    uint64_t persons;
+    uint64_t associated;
+};
+
+/**
+ * @brief Rejilla de cajas: cada caja se anota en las celdas que toca (CSR).
+ *        Una consulta solo visita las cajas de las celdas que toca la suya.
+ */
+class BoxGrid {
+public:
+    BoxGrid() : m_cols(0), m_rows(0), m_originX(0.f), m_originY(0.f), m_cell(1.f) {}
+
+    /** @param boxes (left, top, width, height) por caja. */
+    void build(const float* boxes, int count, float cellSize);
+
+    /**
+     * @brief Añade a `out` los índices de las cajas que comparten celda con
+     *        la consulta, sin repetidos. `stamp` (una entrada por caja, a -1
+     *        al principio) se marca con `queryId`.
+     */
+    void query(const float* box, int queryId, std::vector<int> &stamp, std::vector<int> &out) const;
+
+private:
+    int                  m_cols;
+    int                  m_rows;
+    float                m_originX;
+    float                m_originY;
+    float                m_cell;
+    std::vector<int32_t> m_cellStart;   // m_cols * m_rows + 1
+    std::vector<int32_t> m_items;
+};
+
+/**
+ * @brief Asigna cada cara a la persona con mejor puntuación, como mucho una
+ *        cara por persona. La puntuación es la fracción de la cara dentro del
+ *        cuerpo, penalizada si su centro cae por debajo de headFraction o
+ *        lejos del eje vertical del cuerpo. Los pares se resuelven de mayor a
+ *        menor puntuación.
+ *
+ * @param persons  (left, top, width, height) por persona.
+ * @param faces    (left, top, width, height) por cara.
+ * @param parent   Salida: índice de la persona de cada cara, o -1.
+ * @param scores   Salida opcional: puntuación de cada asignación.
+ *
+ * @return Número de caras asociadas.
+ */
+int associateFaces(const float* persons, int numPersons, const float* faces, int numFaces,
+                   const AssociationConfig &config, int32_t* parent, float* scores);
+
+extern "C" {
+int   RetinaFaceAssociate(const float* persons, int numPersons, const float* faces, int numFaces,
+                          const AssociationConfig* config, int32_t* parent, float* scores);
+
+/**
+ * @brief Instala una probe que asocia en cada frame las caras de faceGieId
+ *        con las personas de personGieId y fija obj_meta->parent. Devuelve un
+ *        handle para las estadísticas, válido mientras exista el pad.
+ */
+void* RetinaFaceAssociationAttach(GstPad* pad, const AssociationProbeConfig* config);
+void  RetinaFaceAssociationGetStats(void* association, AssociationStats* stats);
+}
+
+#endif // RETINAFACE_ASSOCIATION_H
@@ -0,0 +1,277 @@
+/******************************************************************************
+ * retinaface_crop_batch.cpp
+ *
+ * Implementación del constructor de batches de rostros
+ ******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "retinaface_crop_batch.h"
+#include "retinaface_preprocess.h"
+
+//-------------------------------------------------------------------------------
+// Plantilla de 5 landmarks (ArcFace, 112x112): ojo izq, ojo der, nariz,
+// comisura izq, comisura der.
+//-------------------------------------------------------------------------------
+static const float kAlignTemplate[10] = {
+    38.2946f, 51.6963f,
+    73.5318f, 51.5014f,
+    56.0252f, 71.7366f,
+    41.5493f, 92.3655f,
+    70.7299f, 92.2041f
+};
+
+static int64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//-------------------------------------------------------------------------------
+// Similaridad (escala + rotación + traslación) por mínimos cuadrados que lleva
+// la plantilla (espacio del recorte) a los landmarks (espacio del frame).
+// M = [a -b tx; b a ty]
+//-------------------------------------------------------------------------------
+static bool estimateSimilarity(const float* tmpl, const float* lm, float M[6])
+{
+    float sx = 0.f, sy = 0.f, dx = 0.f, dy = 0.f;
+    for (int i = 0; i < 5; ++i) {
+        sx += tmpl[2*i]; sy += tmpl[2*i + 1];
+        dx += lm[2*i];   dy += lm[2*i + 1];
+    }
+    sx /= 5.f; sy /= 5.f; dx /= 5.f; dy /= 5.f;
+
+    float num1 = 0.f, num2 = 0.f, den = 0.f;
+    for (int i = 0; i < 5; ++i) {
+        const float xs = tmpl[2*i] - sx, ys = tmpl[2*i + 1] - sy;
+        const float xd = lm[2*i] - dx,   yd = lm[2*i + 1] - dy;
+        num1 += xs * xd + ys * yd;
+        num2 += xs * yd - ys * xd;
+        den  += xs * xs + ys * ys;
+    }
+    if (den <= 0.f) return false;
+
+    const float a = num1 / den;
+    const float b = num2 / den;
+    M[0] = a;  M[1] = -b; M[2] = dx - (a * sx - b * sy);
+    M[3] = b;  M[4] = a;  M[5] = dy - (b * sx + a * sy);
+    return true;
+}
+
+bool estimateFaceAlignment(const float* landmarks, int cropW, int cropH, float M[6])
+{
+    float tmpl[10];
+    for (int i = 0; i < 5; ++i) {
+        tmpl[2*i]     = kAlignTemplate[2*i]     * cropW / 112.f;
+        tmpl[2*i + 1] = kAlignTemplate[2*i + 1] * cropH / 112.f;
+    }
+    return estimateSimilarity(tmpl, landmarks, M);
+}
+
+//-------------------------------------------------------------------------------
+// FaceCropBatchBuilder
+//-------------------------------------------------------------------------------
+FaceCropBatchBuilder::FaceCropBatchBuilder(const CropBatchConfig &config)
+    : m_config(config), m_open(-1), m_dropped(0)
+{
+    m_config.maxBatchSize = std::max(1, m_config.maxBatchSize);
+    m_config.poolSize     = std::max(1, m_config.poolSize);
+    m_cropElems = static_cast<size_t>(3) * m_config.cropWidth * m_config.cropHeight;
+
+    m_preproc.netScaleFactor = m_config.netScaleFactor;
+    for (int c = 0; c < 3; ++c) m_preproc.offsets[c] = m_config.offsets[c];
+    m_preproc.colorFormat = m_config.colorFormat;
+    m_preproc.outputType  = PREPROC_OUTPUT_FP32;
+    m_preproc.interp      = PREPROC_INTERP_BILINEAR;
+
+    // Toda la memoria se reserva una sola vez; los batches solo apuntan a ella
+    m_tensorStorage.resize(m_cropElems * m_config.maxBatchSize * m_config.poolSize);
+    m_refStorage.resize(static_cast<size_t>(m_config.maxBatchSize) * m_config.poolSize);
+    m_pool.resize(m_config.poolSize);
+    m_acquired.assign(m_config.poolSize, 0);
+    m_writers.assign(m_config.poolSize, 0);
+    m_closed.assign(m_config.poolSize, 0);
+    for (int i = 0; i < m_config.poolSize; ++i) {
+        FaceCropBatch &b = m_pool[i];
+        b.tensor     = &m_tensorStorage[m_cropElems * m_config.maxBatchSize * i];
+        b.refs       = &m_refStorage[static_cast<size_t>(m_config.maxBatchSize) * i];
+        b.count      = 0;
+        b.slot       = i;
+        b.openedAtUs = 0;
+        m_free.push_back(i);
+    }
+}
+
+FaceCropBatchBuilder::~FaceCropBatchBuilder()
+{
+}
+
+void FaceCropBatchBuilder::closeOpenBatch()
+{
+    if (m_open < 0) return;
+    m_closed[m_open] = 1;
+    const int slot = m_open;
+    m_open = -1;
+    publishIfComplete(slot);
+}
+
+// Un batch cerrado pasa a listo (o vuelve al pool si quedó vacío) cuando ya no
+// quedan recortes reservados escribiéndose fuera del lock
+void FaceCropBatchBuilder::publishIfComplete(int slot)
+{
+    if (!m_closed[slot] || m_writers[slot] > 0) return;
+    m_closed[slot] = 0;
+    if (m_pool[slot].count > 0) {
+        m_ready.push_back(slot);
+    } else {
+        m_free.push_back(slot);
+    }
+}
+
+void FaceCropBatchBuilder::closeExpiredBatch()
+{
+    if (m_open >= 0 &&
+        nowUs() - m_pool[m_open].openedAtUs >= static_cast<int64_t>(m_config.deadlineMs) * 1000) {
+        closeOpenBatch();
+    }
+}
+
+bool FaceCropBatchBuilder::addCrop(const uint8_t* rgba, int pitch, int frameW, int frameH,
+                                   const float* box, const float* landmarks,
+                                   const FaceCropRef &ref)
+{
+    if (!rgba || !box || frameW <= 0 || frameH <= 0) return false;
+
+    // Transformación recorte -> frame: alineada por landmarks o solo por bbox
+    float M[6];
+    const bool aligned = landmarks &&
+        estimateFaceAlignment(landmarks, m_config.cropWidth, m_config.cropHeight, M);
+
+    // Reserva del lugar bajo el lock; el warp se hace fuera para no
+    // serializar los streams que agregan recortes
+    int slot;
+    int index;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Un batch vencido se cierra antes de agregar: el recorte abre otro
+        closeExpiredBatch();
+        if (m_open < 0) {
+            if (m_free.empty()) {
+                ++m_dropped;
+                return false;
+            }
+            m_open = m_free.front();
+            m_free.pop_front();
+            m_pool[m_open].count = 0;
+            m_pool[m_open].openedAtUs = nowUs();
+        }
+
+        slot  = m_open;
+        index = m_pool[slot].count++;
+        ++m_writers[slot];
+        if (m_pool[slot].count >= m_config.maxBatchSize) {
+            closeOpenBatch();
+        }
+    }
+
+    // El lugar [slot, index] es exclusivo de esta llamada hasta publicarlo
+    FaceCropBatch &batch = m_pool[slot];
+    float* dstCrop = batch.tensor + m_cropElems * index;
+    if (aligned) {
+        warpAffineNormalizeRGBA(rgba, pitch, frameW, frameH, M,
+                                m_config.cropWidth, m_config.cropHeight, m_preproc, dstCrop);
+    } else {
+        resizeNormalizeRGBA(rgba, pitch, frameW, frameH, box,
+                            m_config.cropWidth, m_config.cropHeight, m_preproc, dstCrop);
+    }
+    FaceCropRef &dst = batch.refs[index];
+    dst = ref;
+    dst.left = box[0]; dst.top = box[1]; dst.width = box[2]; dst.height = box[3];
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    --m_writers[slot];
+    publishIfComplete(slot);
+    return true;
+}
+
+FaceCropBatch* FaceCropBatchBuilder::acquireReady()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_ready.empty()) closeExpiredBatch();
+    if (m_ready.empty()) return nullptr;
+
+    const int slot = m_ready.front();
+    m_ready.pop_front();
+    m_acquired[slot] = 1;
+    return &m_pool[slot];
+}
+
+void FaceCropBatchBuilder::flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    closeOpenBatch();
+}
+
+void FaceCropBatchBuilder::release(FaceCropBatch* batch)
+{
+    if (!batch || batch->slot < 0 || batch->slot >= m_config.poolSize || batch != &m_pool[batch->slot]) {
+        std::cerr << "ERROR: release de un batch que no pertenece al pool." << std::endl;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_acquired[batch->slot]) {
+        // Doble release: otro batch acabaría compartiendo la memoria del slot
+        std::cerr << "ERROR: release del batch " << batch->slot << " que no está en uso; se ignora." << std::endl;
+        return;
+    }
+    m_acquired[batch->slot] = 0;
+    batch->count = 0;
+    m_free.push_back(batch->slot);
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" void* RetinaFaceCropBatchCreate(const CropBatchConfig* config)
+{
+    if (!config || config->cropWidth <= 0 || config->cropHeight <= 0) {
+        std::cerr << "ERROR: Configuración de batch de recortes inválida." << std::endl;
+        return nullptr;
+    }
+    return new FaceCropBatchBuilder(*config);
+}
+
+extern "C" void RetinaFaceCropBatchDestroy(void* builder)
+{
+    delete static_cast<FaceCropBatchBuilder*>(builder);
+}
+
+extern "C" int RetinaFaceCropBatchAdd(void* builder, const uint8_t* rgba, int pitch,
+                                      int frameW, int frameH, const float* box,
+                                      const float* landmarks, const FaceCropRef* ref)
+{
+    if (!builder || !ref) return 0;
+    return static_cast<FaceCropBatchBuilder*>(builder)->addCrop(
+        rgba, pitch, frameW, frameH, box, landmarks, *ref) ? 1 : 0;
+}
+
+extern "C" FaceCropBatch* RetinaFaceCropBatchAcquire(void* builder)
+{
+    if (!builder) return nullptr;
+    return static_cast<FaceCropBatchBuilder*>(builder)->acquireReady();
+}
+
+extern "C" void RetinaFaceCropBatchFlush(void* builder)
+{
+    if (builder) static_cast<FaceCropBatchBuilder*>(builder)->flush();
+}
+
+extern "C" void RetinaFaceCropBatchRelease(void* builder, FaceCropBatch* batch)
+{
+    if (builder) static_cast<FaceCropBatchBuilder*>(builder)->release(batch);
+}
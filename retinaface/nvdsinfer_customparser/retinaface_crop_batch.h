@@ -0,0 +1,151 @@
+/******************************************************************************
+ * retinaface_crop_batch.h
+ *
+ * Constructor de batches de rostros alineados para un reconocedor posterior
+ ******************************************************************************/
+
+#ifndef RETINAFACE_CROP_BATCH_H
+#define RETINAFACE_CROP_BATCH_H
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "retinaface_preprocess.h"
+
+/**
+ * @brief Referencia de cada recorte a su origen (stream/frame/track).
+ */
+struct FaceCropRef {
+    uint32_t streamId;   /**< pad_index / source_id del frame */
+    uint32_t reserved;
+    uint64_t frameNum;   /**< frame_num del frame de origen */
+    uint64_t trackId;    /**< object_id del tracker (o índice del objeto) */
+    float    left;       /**< BBox en coordenadas del frame */
+    float    top;
+    float    width;
+    float    height;
+};
+
+/**
+ * @brief Parámetros del batch. La normalización sigue la fórmula de nvinfer:
+ *        y = netScaleFactor * (x - offsets[c]).
+ */
+struct CropBatchConfig {
+    int   cropWidth;      /**< Ancho del recorte (ej. 112) */
+    int   cropHeight;     /**< Alto del recorte (ej. 112) */
+    int   maxBatchSize;   /**< Recortes por tensor antes de emitirlo */
+    int   poolSize;       /**< Tensores preasignados en el pool */
+    int   deadlineMs;     /**< Tiempo máximo que un batch parcial queda abierto (ver acquireReady) */
+    float netScaleFactor; /**< Igual que net-scale-factor */
+    float offsets[3];     /**< Igual que offsets, en el orden de colorFormat */
+    int   colorFormat;    /**< 0=RGB, 1=BGR (igual que model-color-format) */
+};
+
+/**
+ * @brief Batch NCHW float listo para el reconocedor. La memoria pertenece al
+ *        pool; se devuelve con FaceCropBatchBuilder::release().
+ */
+struct FaceCropBatch {
+    float*       tensor;     /**< maxBatchSize x 3 x cropHeight x cropWidth */
+    FaceCropRef* refs;       /**< Una referencia por recorte válido */
+    int          count;      /**< Recortes válidos en el tensor */
+    int          slot;       /**< Índice dentro del pool */
+    int64_t      openedAtUs; /**< Momento en que se agregó el primer recorte */
+};
+
+/**
+ * @brief Calcula la similaridad M (recorte -> frame) que alinea 5 landmarks con
+ *        la plantilla ArcFace escalada a cropW x cropH.
+ *
+ * @return `false` si los landmarks son degenerados.
+ */
+bool estimateFaceAlignment(const float* landmarks, int cropW, int cropH, float M[6]);
+
+/**
+ * @brief Acumula recortes de varios streams en tensores preasignados y los
+ *        emite al llenarse o al vencer el deadline. Thread-safe.
+ */
+class FaceCropBatchBuilder {
+public:
+    explicit FaceCropBatchBuilder(const CropBatchConfig &config);
+    ~FaceCropBatchBuilder();
+
+    /**
+     * @brief Recorta, alinea y normaliza un rostro dentro del batch abierto.
+     *        El lugar se reserva bajo el lock y el warp se hace fuera de él,
+     *        así que varios streams pueden escribir en el mismo batch a la vez;
+     *        un batch cerrado solo pasa a listo cuando terminan sus escritores.
+     *
+     * @param rgba      Frame RGBA (8 bits por canal).
+     * @param pitch     Bytes por fila del frame.
+     * @param frameW    Ancho del frame.
+     * @param frameH    Alto del frame.
+     * @param box       BBox [left, top, width, height] en coordenadas del frame.
+     * @param landmarks 5 landmarks (x,y) para alinear, o nullptr para usar solo el bbox.
+     * @param ref       Referencia al origen del recorte.
+     *
+     * @return `false` si el pool está agotado y el recorte se descartó.
+     */
+    bool addCrop(const uint8_t* rgba, int pitch, int frameW, int frameH,
+                 const float* box, const float* landmarks, const FaceCropRef &ref);
+
+    /**
+     * @brief Devuelve el siguiente batch lleno o con deadline vencido, o
+     *        nullptr si no hay ninguno. El deadline se comprueba aquí y en
+     *        addCrop(); no hay temporizador propio, así que un batch parcial
+     *        sin recortes nuevos solo se emite si alguien llama a este método
+     *        (o a flush()) periódicamente.
+     */
+    FaceCropBatch* acquireReady();
+
+    /** @brief Cierra el batch abierto aunque no esté lleno. */
+    void flush();
+
+    /**
+     * @brief Devuelve al pool un batch obtenido con acquireReady(). Un batch
+     *        que no está en uso (doble release) se ignora con un error.
+     */
+    void release(FaceCropBatch* batch);
+
+    const CropBatchConfig& config() const { return m_config; }
+    uint64_t droppedCrops() const { return m_dropped; }
+
+private:
+    FaceCropBatchBuilder(const FaceCropBatchBuilder&);
+    FaceCropBatchBuilder& operator=(const FaceCropBatchBuilder&);
+
+    void closeOpenBatch();
+    void closeExpiredBatch();
+    void publishIfComplete(int slot);
+
+    CropBatchConfig            m_config;
+    size_t                     m_cropElems;
+    PreprocParams              m_preproc;
+    std::vector<FaceCropBatch> m_pool;
+    std::vector<float>         m_tensorStorage;
+    std::vector<FaceCropRef>   m_refStorage;
+    std::deque<int>            m_free;
+    std::deque<int>            m_ready;
+    std::vector<uint8_t>       m_acquired;   // Por slot: entregado y sin release
+    std::vector<int>           m_writers;    // Por slot: recortes reservados aún sin escribir
+    std::vector<uint8_t>       m_closed;     // Por slot: cerrado, espera a sus escritores
+    int                        m_open;
+    uint64_t                   m_dropped;
+    std::mutex                 m_mutex;
+};
+
+//-------------------------------------------------------------------------------
+// API C para cargar desde Python con ctypes (ver common/retinaface_native.py)
+//-------------------------------------------------------------------------------
+extern "C" {
+void* RetinaFaceCropBatchCreate(const CropBatchConfig* config);
+void  RetinaFaceCropBatchDestroy(void* builder);
+int   RetinaFaceCropBatchAdd(void* builder, const uint8_t* rgba, int pitch,
+                             int frameW, int frameH, const float* box,
+                             const float* landmarks, const FaceCropRef* ref);
+FaceCropBatch* RetinaFaceCropBatchAcquire(void* builder);
+void  RetinaFaceCropBatchFlush(void* builder);
+void  RetinaFaceCropBatchRelease(void* builder, FaceCropBatch* batch);
+}
+
+#endif // RETINAFACE_CROP_BATCH_H
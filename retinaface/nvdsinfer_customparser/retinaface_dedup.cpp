@@ -0,0 +1,249 @@
+/******************************************************************************
+ * retinaface_dedup.cpp
+ *
+ * Implementación del pHash de rostros y del índice de duplicados por stream
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "retinaface_crop_batch.h"
+#include "retinaface_dedup.h"
+#include "retinaface_preprocess.h"
+
+static const int kHashSide  = 32;   // Lado del parche de luma
+static const int kDctSide   = 8;    // Bloque de baja frecuencia que forma el hash
+static const int kAlignSide = 64;   // Recorte alineado antes de reducir 2x2
+
+//-------------------------------------------------------------------------------
+// Base DCT-II 8x32 (solo las 8 primeras frecuencias), calculada una vez
+//-------------------------------------------------------------------------------
+namespace {
+struct DctBasis {
+    float v[kDctSide * kHashSide];
+
+    DctBasis()
+    {
+        for (int u = 0; u < kDctSide; ++u) {
+            for (int x = 0; x < kHashSide; ++x) {
+                v[u * kHashSide + x] = static_cast<float>(
+                    std::cos((2 * x + 1) * u * M_PI / (2.0 * kHashSide)));
+            }
+        }
+    }
+};
+} // namespace
+
+static const float* dctBasis()
+{
+    static const DctBasis basis;
+    return basis.v;
+}
+
+uint64_t perceptualHash32(const float* luma)
+{
+    const float* D = dctBasis();
+
+    // T = D * F  (8x32), luego C = T * D^T (8x8)
+    float T[kDctSide * kHashSide];
+    for (int u = 0; u < kDctSide; ++u) {
+        const float* du = D + u * kHashSide;
+        for (int x = 0; x < kHashSide; ++x) {
+            float acc = 0.f;
+            for (int y = 0; y < kHashSide; ++y) {
+                acc += du[y] * luma[y * kHashSide + x];
+            }
+            T[u * kHashSide + x] = acc;
+        }
+    }
+    float C[kDctSide * kDctSide];
+    for (int u = 0; u < kDctSide; ++u) {
+        for (int v = 0; v < kDctSide; ++v) {
+            const float* dv = D + v * kHashSide;
+            const float* tu = T + u * kHashSide;
+            float acc = 0.f;
+            for (int x = 0; x < kHashSide; ++x) acc += tu[x] * dv[x];
+            C[u * kDctSide + v] = acc;
+        }
+    }
+
+    // Mediana sin el coeficiente DC (el brillo medio no debe influir)
+    float sorted[kDctSide * kDctSide - 1];
+    std::memcpy(sorted, C + 1, sizeof(sorted));
+    std::nth_element(sorted, sorted + 31, sorted + 63);
+    const float median = sorted[31];
+
+    uint64_t hash = 0;
+    for (int i = 0; i < kDctSide * kDctSide; ++i) {
+        if (C[i] > median) hash |= (1ULL << i);
+    }
+    return hash;
+}
+
+uint64_t facePerceptualHash(const uint8_t* rgba, int pitch, int frameW, int frameH,
+                            const float box[4], const float* landmarks)
+{
+    PreprocParams params;
+    params.netScaleFactor = 1.f;
+    params.offsets[0] = params.offsets[1] = params.offsets[2] = 0.f;
+    params.colorFormat = 0;
+    params.outputType  = PREPROC_OUTPUT_FP32;
+    params.interp      = PREPROC_INTERP_AREA;
+
+    float luma[kHashSide * kHashSide];
+    float M[6];
+    if (landmarks && estimateFaceAlignment(landmarks, kAlignSide, kAlignSide, M)) {
+        // Recorte alineado 64x64 y reducción 2x2 para no perder el filtrado paso bajo
+        float rgb[3 * kAlignSide * kAlignSide];
+        warpAffineNormalizeRGBA(rgba, pitch, frameW, frameH, M, kAlignSide, kAlignSide, params, rgb);
+        const int plane = kAlignSide * kAlignSide;
+        for (int y = 0; y < kHashSide; ++y) {
+            for (int x = 0; x < kHashSide; ++x) {
+                float acc = 0.f;
+                for (int dy = 0; dy < 2; ++dy) {
+                    for (int dx = 0; dx < 2; ++dx) {
+                        const int i = (2 * y + dy) * kAlignSide + 2 * x + dx;
+                        acc += 0.299f * rgb[i] + 0.587f * rgb[plane + i] + 0.114f * rgb[2 * plane + i];
+                    }
+                }
+                luma[y * kHashSide + x] = 0.25f * acc;
+            }
+        }
+    } else {
+        float rgb[3 * kHashSide * kHashSide];
+        resizeNormalizeRGBA(rgba, pitch, frameW, frameH, box, kHashSide, kHashSide, params, rgb);
+        const int plane = kHashSide * kHashSide;
+        for (int i = 0; i < plane; ++i) {
+            luma[i] = 0.299f * rgb[i] + 0.587f * rgb[plane + i] + 0.114f * rgb[2 * plane + i];
+        }
+    }
+    return perceptualHash32(luma);
+}
+
+//-------------------------------------------------------------------------------
+// FaceDedupIndex
+//-------------------------------------------------------------------------------
+static inline uint16_t hashChunk(uint64_t hash, int c)
+{
+    return static_cast<uint16_t>(hash >> (16 * c));
+}
+
+FaceDedupIndex::FaceDedupIndex(int capacityPerStream, int64_t windowMs, int maxDistance)
+    : m_capacity(std::max(1, capacityPerStream)),
+      m_windowMs(windowMs),
+      m_maxDistance(std::min(std::max(maxDistance, 0), 11)),
+      m_duplicates(0),
+      m_lookups(0)
+{
+    // Vecindario de cada trozo: todas las máscaras de 16 bits con <= r/4 bits
+    const int chunkRadius = m_maxDistance / kChunks;
+    for (uint32_t m = 0; m < 65536u; ++m) {
+        if (__builtin_popcount(m) <= chunkRadius) {
+            m_probeMasks.push_back(static_cast<uint16_t>(m));
+        }
+    }
+}
+
+void FaceDedupIndex::evictOldest(StreamSet &set)
+{
+    const uint32_t slot = static_cast<uint32_t>(set.head);
+    const uint64_t hash = set.ring[slot].hash;
+    for (int c = 0; c < kChunks; ++c) {
+        std::unordered_map<uint16_t, std::vector<uint32_t> >::iterator it =
+            set.tables[c].find(hashChunk(hash, c));
+        if (it == set.tables[c].end()) continue;
+        std::vector<uint32_t> &bucket = it->second;
+        std::vector<uint32_t>::iterator pos = std::find(bucket.begin(), bucket.end(), slot);
+        if (pos != bucket.end()) {
+            *pos = bucket.back();
+            bucket.pop_back();
+        }
+        if (bucket.empty()) set.tables[c].erase(it);
+    }
+    set.head = (set.head + 1) % set.ring.size();
+    --set.size;
+}
+
+bool FaceDedupIndex::findNear(const StreamSet &set, uint64_t hash) const
+{
+    for (int c = 0; c < kChunks; ++c) {
+        const uint16_t chunk = hashChunk(hash, c);
+        for (size_t m = 0; m < m_probeMasks.size(); ++m) {
+            std::unordered_map<uint16_t, std::vector<uint32_t> >::const_iterator it =
+                set.tables[c].find(static_cast<uint16_t>(chunk ^ m_probeMasks[m]));
+            if (it == set.tables[c].end()) continue;
+            for (size_t k = 0; k < it->second.size(); ++k) {
+                const uint64_t other = set.ring[it->second[k]].hash;
+                if (__builtin_popcountll(other ^ hash) <= m_maxDistance) return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool FaceDedupIndex::checkAndInsert(uint32_t streamId, uint64_t hash, int64_t nowMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_lookups;
+
+    StreamSet &set = m_streams[streamId];
+    if (set.ring.empty()) set.ring.resize(m_capacity);
+
+    // Expirar por tiempo; el anillo está ordenado por inserción
+    while (set.size > 0 && nowMs - set.ring[set.head].timeMs >= m_windowMs) {
+        evictOldest(set);
+    }
+
+    if (findNear(set, hash)) {
+        ++m_duplicates;
+        return true;
+    }
+
+    if (set.size == set.ring.size()) evictOldest(set);
+    const uint32_t slot = static_cast<uint32_t>((set.head + set.size) % set.ring.size());
+    set.ring[slot].hash   = hash;
+    set.ring[slot].timeMs = nowMs;
+    ++set.size;
+    for (int c = 0; c < kChunks; ++c) {
+        set.tables[c][hashChunk(hash, c)].push_back(slot);
+    }
+    return false;
+}
+
+void FaceDedupIndex::resetStream(uint32_t streamId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_streams.erase(streamId);
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" uint64_t RetinaFacePerceptualHash(const uint8_t* rgba, int pitch, int frameW, int frameH,
+                                             const float* box, const float* landmarks)
+{
+    if (!rgba || !box || frameW <= 0 || frameH <= 0) return 0;
+    return facePerceptualHash(rgba, pitch, frameW, frameH, box, landmarks);
+}
+
+extern "C" void* RetinaFaceDedupCreate(int capacityPerStream, int64_t windowMs, int maxDistance)
+{
+    return new FaceDedupIndex(capacityPerStream, windowMs, maxDistance);
+}
+
+extern "C" void RetinaFaceDedupDestroy(void* index)
+{
+    delete static_cast<FaceDedupIndex*>(index);
+}
+
+extern "C" int RetinaFaceDedupCheck(void* index, uint32_t streamId, uint64_t hash, int64_t nowMs)
+{
+    if (!index) return 0;
+    return static_cast<FaceDedupIndex*>(index)->checkAndInsert(streamId, hash, nowMs) ? 1 : 0;
+}
+
+extern "C" void RetinaFaceDedupResetStream(void* index, uint32_t streamId)
+{
+    if (index) static_cast<FaceDedupIndex*>(index)->resetStream(streamId);
+}
@@ -0,0 +1,101 @@
+/******************************************************************************
+ * retinaface_dedup.h
+ *
+ * Hash perceptual de 64 bits por rostro y supresión de recortes casi
+ * duplicados por stream (búsqueda por distancia de Hamming con multi-index
+ * hashing)
+ ******************************************************************************/
+
+#ifndef RETINAFACE_DEDUP_H
+#define RETINAFACE_DEDUP_H
+#include <stdint.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief pHash de 64 bits: luma 32x32 del rostro (alineado si hay landmarks),
+ *        DCT 2D, bloque 8x8 de baja frecuencia umbralizado por su mediana.
+ *
+ * @param rgba      Frame RGBA.
+ * @param pitch     Bytes por fila.
+ * @param frameW    Ancho del frame.
+ * @param frameH    Alto del frame.
+ * @param box       BBox [left, top, width, height].
+ * @param landmarks 5 landmarks para alinear, o nullptr.
+ */
+uint64_t facePerceptualHash(const uint8_t* rgba, int pitch, int frameW, int frameH,
+                            const float box[4], const float* landmarks);
+
+/** @brief pHash de un parche de luma 32x32 ya preparado (fila mayor). */
+uint64_t perceptualHash32(const float* luma32x32);
+
+/**
+ * @brief Conjunto de hashes recientes por stream. Un hash es duplicado si hay
+ *        otro a distancia de Hamming <= maxDistance dentro de la ventana.
+ *        El hash se parte en 4 trozos de 16 bits; por el principio del
+ *        palomar basta buscar cada trozo a distancia <= maxDistance / 4.
+ *        Thread-safe.
+ */
+class FaceDedupIndex {
+public:
+    /**
+     * @param capacityPerStream Hashes recordados por stream (los más viejos se olvidan).
+     * @param windowMs          Tiempo que un hash suprime a sus vecinos.
+     * @param maxDistance       Distancia de Hamming máxima para considerar duplicado (0..11).
+     */
+    FaceDedupIndex(int capacityPerStream, int64_t windowMs, int maxDistance);
+
+    /**
+     * @brief Consulta e inserta: si el hash no es duplicado se recuerda.
+     *
+     * @return `true` si es un duplicado y el recorte puede omitirse.
+     */
+    bool checkAndInsert(uint32_t streamId, uint64_t hash, int64_t nowMs);
+
+    /** @brief Olvida todos los hashes de un stream (p.ej. al reiniciar la fuente). */
+    void resetStream(uint32_t streamId);
+
+    uint64_t duplicates() const { return m_duplicates; }
+    uint64_t lookups() const { return m_lookups; }
+
+private:
+    static const int kChunks = 4;
+
+    struct Entry {
+        uint64_t hash;
+        int64_t  timeMs;
+    };
+
+    struct StreamSet {
+        std::vector<Entry> ring;          // Orden de inserción (y de expiración)
+        size_t             head;
+        size_t             size;
+        std::unordered_map<uint16_t, std::vector<uint32_t> > tables[kChunks];
+
+        StreamSet() : head(0), size(0) {}
+    };
+
+    void evictOldest(StreamSet &set);
+    bool findNear(const StreamSet &set, uint64_t hash) const;
+
+    int                                    m_capacity;
+    int64_t                                m_windowMs;
+    int                                    m_maxDistance;
+    std::vector<uint16_t>                  m_probeMasks;   // Máscaras de 16 bits a distancia <= r/4
+    std::unordered_map<uint32_t, StreamSet> m_streams;
+    uint64_t                               m_duplicates;
+    uint64_t                               m_lookups;
+    std::mutex                             m_mutex;
+};
+
+extern "C" {
+uint64_t RetinaFacePerceptualHash(const uint8_t* rgba, int pitch, int frameW, int frameH,
+                                  const float* box, const float* landmarks);
+void*    RetinaFaceDedupCreate(int capacityPerStream, int64_t windowMs, int maxDistance);
+void     RetinaFaceDedupDestroy(void* index);
+int      RetinaFaceDedupCheck(void* index, uint32_t streamId, uint64_t hash, int64_t nowMs);
+void     RetinaFaceDedupResetStream(void* index, uint32_t streamId);
+}
+
+#endif // RETINAFACE_DEDUP_H
@@ -0,0 +1,571 @@
+/******************************************************************************
+ * retinaface_dvr.cpp
+ *
+ * Implementación del almacén circular. Disposición del archivo:
+ *   [cabecera: 4096][índice: maxRecords x DvrRecordInfo][datos: dataBytes]
+ * El archivo se preasigna entero al crearlo: después solo hay pwrite sobre
+ * bloques ya reservados, sin crear ni borrar archivos.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "retinaface_dvr.h"
+#include "retinaface_jpeg.h"
+#include "retinaface_writer.h"
+
+static const size_t   kAlignment = 4096;
+static const uint32_t kDvrMagic = 0x52564452;        // "RDVR"
+static const uint32_t kDvrVersion = 1;
+static const uint32_t kDvrRecordMagic = 0x43455252;  // "RREC"
+
+namespace {
+// Cabecera de cada registro en el área de datos (dentro de kDvrRecordHeader)
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t size;
+    uint64_t seq;
+    int64_t  tsMs;
+    int64_t  frameNum;
+};
+} // namespace
+
+static uint64_t alignUp(uint64_t v)
+{
+    return (v + kAlignment - 1) & ~static_cast<uint64_t>(kAlignment - 1);
+}
+
+static bool preadAll(int fd, void* data, size_t size, uint64_t offset)
+{
+    uint8_t* p = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t n = ::pread(fd, p, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+static bool pwriteAll(int fd, const void* data, size_t size, uint64_t offset)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t n = ::pwrite(fd, p, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+DvrStore::DvrStore()
+    : m_fd(-1), m_readOnly(true), m_writer(nullptr), m_indexOffset(0), m_dataOffset(0), m_nextSeq(1),
+      m_tailSeq(1), m_writeOffset(0), m_usedBytes(0), m_dirtySeq(1), m_lastTsMs(0), m_activeReads(0)
+{
+    std::memset(&m_config, 0, sizeof(m_config));
+    std::memset(&m_stats, 0, sizeof(m_stats));
+}
+
+DvrStore::~DvrStore()
+{
+    close();
+}
+
+uint64_t DvrStore::footprint(uint64_t size) const
+{
+    return alignUp(kDvrRecordHeader + size);
+}
+
+int64_t DvrStore::bucketOf(int64_t tsMs) const
+{
+    const int64_t b = tsMs / m_config.bucketMs;
+    return (tsMs < 0 && tsMs % m_config.bucketMs != 0) ? b - 1 : b;
+}
+
+//-------------------------------------------------------------------------------
+// Apertura y persistencia del índice
+//-------------------------------------------------------------------------------
+bool DvrStore::open(const char* path, const DvrConfig &config, FrameWriter* writer)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd >= 0 || !path) return false;
+
+    m_readOnly = (writer == nullptr);
+    m_writer = writer;
+    m_config = config;
+    if (m_config.indexSyncInterval <= 0) m_config.indexSyncInterval = 32;
+    if (m_config.bucketMs <= 0) m_config.bucketMs = 1000;
+
+    m_fd = ::open(path, m_readOnly ? O_RDONLY : (O_RDWR | O_CREAT), 0644);
+    if (m_fd < 0) {
+        std::cerr << "ERROR: no se pudo abrir " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(m_fd, &st) != 0 || (st.st_size == 0 && m_readOnly)) {
+        std::cerr << "ERROR: " << path << " no es un almacén DVR" << std::endl;
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        if (m_config.dataBytes < kAlignment || m_config.maxRecords <= 0) {
+            std::cerr << "ERROR: geometría DVR inválida (dataBytes=" << m_config.dataBytes
+                      << ", maxRecords=" << m_config.maxRecords << ")" << std::endl;
+            ::close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+        m_config.dataBytes = alignUp(m_config.dataBytes);
+        m_indexOffset = kAlignment;
+        m_dataOffset = m_indexOffset + alignUp(m_config.maxRecords * sizeof(DvrRecordInfo));
+        const int err = posix_fallocate(m_fd, 0, static_cast<off_t>(m_dataOffset + m_config.dataBytes));
+        if (err != 0) {
+            std::cerr << "ERROR: no se pudo preasignar " << path << " (" << m_dataOffset + m_config.dataBytes
+                      << " bytes): " << std::strerror(err) << std::endl;
+            ::close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+        m_index.assign(m_config.maxRecords, DvrRecordInfo());
+        std::memset(&m_index[0], 0, m_index.size() * sizeof(DvrRecordInfo));
+        m_nextSeq = m_tailSeq = m_dirtySeq = 1;
+        m_writeOffset = 0;
+        m_bucketId.assign(m_config.maxRecords, INT64_MIN);
+        m_bucketFirst.assign(m_config.maxRecords, 0);
+        if (!syncIndexLocked()) {
+            ::close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    if (!loadIndex()) {
+        std::cerr << "ERROR: " << path << " no es un almacén DVR compatible con la configuración" << std::endl;
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool DvrStore::loadIndex()
+{
+    Header header;
+    if (!preadAll(m_fd, &header, sizeof(header), 0) || header.magic != kDvrMagic ||
+        header.version != kDvrVersion || header.maxRecords == 0) {
+        return false;
+    }
+    // En solo lectura manda la geometría del archivo
+    if (!m_readOnly && (header.dataBytes != alignUp(m_config.dataBytes) ||
+                        header.maxRecords != static_cast<uint32_t>(m_config.maxRecords))) {
+        return false;
+    }
+    m_config.dataBytes = header.dataBytes;
+    m_config.maxRecords = static_cast<int32_t>(header.maxRecords);
+    m_indexOffset = kAlignment;
+    m_dataOffset = m_indexOffset + alignUp(m_config.maxRecords * sizeof(DvrRecordInfo));
+
+    m_index.resize(m_config.maxRecords);
+    if (!preadAll(m_fd, &m_index[0], m_index.size() * sizeof(DvrRecordInfo), m_indexOffset)) return false;
+    m_nextSeq = std::max<uint64_t>(1, header.nextSeq);
+    m_tailSeq = std::min(std::max<uint64_t>(1, header.tailSeq), m_nextSeq);
+    m_writeOffset = header.writeOffset % m_config.dataBytes;
+    m_dirtySeq = m_nextSeq;
+
+    // Reconstruye ocupación y cubetas; una entrada que no corresponde a su
+    // secuencia corta el anillo en ese punto
+    m_bucketId.assign(m_config.maxRecords, INT64_MIN);
+    m_bucketFirst.assign(m_config.maxRecords, 0);
+    m_usedBytes = 0;
+    m_lastTsMs = 0;
+    for (uint64_t seq = m_tailSeq; seq < m_nextSeq; ++seq) {
+        const DvrRecordInfo &e = slot(seq);
+        if (e.seq != seq) {
+            m_tailSeq = seq + 1;
+            m_usedBytes = 0;
+            continue;
+        }
+        m_usedBytes += footprint(e.size);
+        m_lastTsMs = e.tsMs;
+        const int64_t b = bucketOf(e.tsMs);
+        const size_t s = static_cast<size_t>(((b % m_config.maxRecords) + m_config.maxRecords) % m_config.maxRecords);
+        if (m_bucketId[s] != b) {
+            m_bucketId[s] = b;
+            m_bucketFirst[s] = seq;
+        }
+    }
+    return true;
+}
+
+bool DvrStore::syncIndexLocked()
+{
+    if (m_readOnly || m_fd < 0) return true;
+
+    // Entradas nuevas desde la última sincronización, en tramos contiguos
+    const uint64_t n = m_index.size();
+    uint64_t seq = std::max(m_dirtySeq, m_nextSeq > n ? m_nextSeq - n : 1);
+    while (seq < m_nextSeq) {
+        const uint64_t first = seq % n;
+        const uint64_t count = std::min(m_nextSeq - seq, n - first);
+        if (!pwriteAll(m_fd, &m_index[first], count * sizeof(DvrRecordInfo),
+                       m_indexOffset + first * sizeof(DvrRecordInfo))) {
+            std::cerr << "ERROR: no se pudo escribir el índice DVR: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        seq += count;
+    }
+    m_dirtySeq = m_nextSeq;
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = kDvrMagic;
+    header.version = kDvrVersion;
+    header.dataBytes = m_config.dataBytes;
+    header.maxRecords = static_cast<uint32_t>(m_config.maxRecords);
+    header.nextSeq = m_nextSeq;
+    header.tailSeq = m_tailSeq;
+    header.writeOffset = m_writeOffset;
+    if (!pwriteAll(m_fd, &header, sizeof(header), 0)) {
+        std::cerr << "ERROR: no se pudo escribir la cabecera DVR: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool DvrStore::syncIndex()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return syncIndexLocked();
+}
+
+void DvrStore::close()
+{
+    // Los datos en vuelo usan m_fd: hay que esperarlos antes de cerrarlo
+    if (m_writer) m_writer->flush();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_fd < 0) return;
+    syncIndexLocked();
+
+    // Las lecturas en curso usan el descriptor fuera del lock: no se cierra
+    // (ni se puede reutilizar su número) hasta que terminan
+    const int fd = m_fd;
+    m_fd = -1;
+    m_readsDone.wait(lock, [this]() { return m_activeReads == 0; });
+    ::close(fd);
+    m_writer = nullptr;
+}
+
+//-------------------------------------------------------------------------------
+// Escritura
+//-------------------------------------------------------------------------------
+uint8_t* DvrStore::acquire()
+{
+    if (m_readOnly || !m_writer) return nullptr;
+    uint8_t* buffer = m_writer->acquireBuffer();
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_stats.failed;
+    }
+    return buffer;
+}
+
+void DvrStore::release(uint8_t* buffer)
+{
+    if (m_writer && buffer) m_writer->releaseBuffer(buffer);
+}
+
+size_t DvrStore::payloadCapacity() const
+{
+    return m_writer ? m_writer->bufferSize() - kDvrRecordHeader : 0;
+}
+
+void DvrStore::evictForWrite(uint64_t offset, uint64_t bytes)
+{
+    // Los registros vivos están en orden físico a partir del cursor: se
+    // expulsan desde el más antiguo mientras caigan en la zona a consumir
+    // (con vuelta al inicio, también el hueco final que se salta)
+    const bool wrapped = offset < m_writeOffset;
+    while (m_tailSeq < m_nextSeq) {
+        const DvrRecordInfo &e = slot(m_tailSeq);
+        const bool hit = wrapped ? (e.offset >= m_writeOffset || e.offset < offset + bytes)
+                                 : (e.offset >= offset && e.offset < offset + bytes);
+        if (!hit) break;
+        m_usedBytes -= footprint(e.size);
+        ++m_tailSeq;
+        ++m_stats.overwritten;
+    }
+    // Índice lleno: se pierde el más antiguo aunque su espacio siga libre
+    if (m_nextSeq - m_tailSeq >= m_index.size()) {
+        m_usedBytes -= footprint(slot(m_tailSeq).size);
+        ++m_tailSeq;
+        ++m_stats.overwritten;
+    }
+}
+
+bool DvrStore::commit(uint8_t* buffer, size_t size, int64_t tsMs, int64_t frameNum)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd < 0 || m_readOnly || !buffer) {
+        ++m_stats.failed;
+        if (buffer) release(buffer);
+        return false;
+    }
+    const uint64_t bytes = footprint(size);
+    if (size == 0 || size > payloadCapacity() || bytes > m_config.dataBytes) {
+        std::cerr << "ERROR: registro DVR de tamaño inválido (" << size << " bytes)" << std::endl;
+        ++m_stats.failed;
+        release(buffer);
+        return false;
+    }
+
+    // Estado previo, para deshacer el registro si el escritor no lo acepta:
+    // en ese caso no se escribió nada y los registros expulsados siguen enteros
+    const uint64_t prevTailSeq = m_tailSeq;
+    const uint64_t prevWriteOffset = m_writeOffset;
+    const uint64_t prevUsedBytes = m_usedBytes;
+    const uint64_t prevOverwritten = m_stats.overwritten;
+    const int64_t  prevLastTsMs = m_lastTsMs;
+
+    uint64_t offset = m_writeOffset;
+    if (offset + bytes > m_config.dataBytes) offset = 0;
+    evictForWrite(offset, bytes);
+
+    if (m_nextSeq > m_tailSeq) tsMs = std::max(tsMs, m_lastTsMs);
+    const uint64_t seq = m_nextSeq++;
+    DvrRecordInfo &e = slot(seq);
+    const DvrRecordInfo prevSlot = e;
+    e.seq = seq;
+    e.tsMs = tsMs;
+    e.frameNum = frameNum;
+    e.offset = offset;
+    e.size = static_cast<uint32_t>(size);
+    e.reserved = 0;
+    m_writeOffset = (offset + bytes) % m_config.dataBytes;
+    m_usedBytes += bytes;
+    m_lastTsMs = tsMs;
+    ++m_stats.appended;
+
+    const int64_t b = bucketOf(tsMs);
+    const size_t s = static_cast<size_t>(((b % m_config.maxRecords) + m_config.maxRecords) % m_config.maxRecords);
+    const int64_t  prevBucketId = m_bucketId[s];
+    const uint64_t prevBucketFirst = m_bucketFirst[s];
+    if (m_bucketId[s] != b) {
+        m_bucketId[s] = b;
+        m_bucketFirst[s] = seq;
+    }
+
+    std::memset(buffer, 0, kDvrRecordHeader);
+    RecordHeader* header = reinterpret_cast<RecordHeader*>(buffer);
+    header->magic = kDvrRecordMagic;
+    header->size = e.size;
+    header->seq = seq;
+    header->tsMs = tsMs;
+    header->frameNum = frameNum;
+    if (!m_writer->submitAt(buffer, kDvrRecordHeader + size, m_fd, m_dataOffset + offset)) {
+        // submitAt ya devolvió el buffer al pool
+        m_nextSeq = seq;
+        e = prevSlot;
+        m_bucketId[s] = prevBucketId;
+        m_bucketFirst[s] = prevBucketFirst;
+        m_tailSeq = prevTailSeq;
+        m_writeOffset = prevWriteOffset;
+        m_usedBytes = prevUsedBytes;
+        m_lastTsMs = prevLastTsMs;
+        m_stats.overwritten = prevOverwritten;
+        --m_stats.appended;
+        ++m_stats.failed;
+        return false;
+    }
+
+    if (m_nextSeq - m_dirtySeq >= static_cast<uint64_t>(m_config.indexSyncInterval)) syncIndexLocked();
+    return true;
+}
+
+//-------------------------------------------------------------------------------
+// Búsqueda y lectura
+//-------------------------------------------------------------------------------
+bool DvrStore::findLocked(int64_t tsMs, uint64_t &seq)
+{
+    if (m_tailSeq >= m_nextSeq || tsMs < slot(m_tailSeq).tsMs) return false;
+    if (tsMs >= m_lastTsMs) {
+        seq = m_nextSeq - 1;
+        return true;
+    }
+
+    const int64_t b = bucketOf(tsMs);
+    const size_t s = static_cast<size_t>(((b % m_config.maxRecords) + m_config.maxRecords) % m_config.maxRecords);
+    const uint64_t first = m_bucketFirst[s];
+    if (m_bucketId[s] == b && first >= m_tailSeq && first < m_nextSeq) {
+        // Primero de la cubeta: o es posterior (vale el anterior) o se avanza
+        // dentro de la cubeta
+        if (slot(first).tsMs > tsMs) {
+            if (first == m_tailSeq) return false;
+            seq = first - 1;
+            return true;
+        }
+        seq = first;
+        while (seq + 1 < m_nextSeq && slot(seq + 1).tsMs <= tsMs) ++seq;
+        return true;
+    }
+
+    // Cubeta vacía o expulsada: búsqueda binaria del último con ts <= tsMs
+    uint64_t lo = m_tailSeq, hi = m_nextSeq;
+    while (hi - lo > 1) {
+        const uint64_t mid = lo + (hi - lo) / 2;
+        if (slot(mid).tsMs <= tsMs) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    seq = lo;
+    return true;
+}
+
+bool DvrStore::find(int64_t tsMs, DvrRecordInfo &info)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t seq = 0;
+    if (m_fd < 0 || !findLocked(tsMs, seq)) return false;
+    info = slot(seq);
+    return true;
+}
+
+bool DvrStore::record(uint64_t seq, DvrRecordInfo &info)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd < 0 || seq < m_tailSeq || seq >= m_nextSeq) return false;
+    info = slot(seq);
+    return true;
+}
+
+int64_t DvrStore::read(uint64_t seq, uint8_t* out, size_t capacity)
+{
+    DvrRecordInfo info;
+    int fd;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_fd < 0 || seq < m_tailSeq || seq >= m_nextSeq) return -1;
+        info = slot(seq);
+        if (info.size > capacity) return -1;
+        fd = m_fd;
+        ++m_activeReads;
+    }
+
+    // Sin lock: close() espera a que m_activeReads vuelva a cero
+    RecordHeader header;
+    const bool ok = preadAll(fd, &header, sizeof(header), m_dataOffset + info.offset) &&
+                    header.magic == kDvrRecordMagic && header.seq == seq && header.size == info.size &&
+                    preadAll(fd, out, info.size, m_dataOffset + info.offset + kDvrRecordHeader);
+
+    // Aún en vuelo o perdido en una caída (!ok), o pisado por el anillo
+    // durante la lectura: los bytes no son fiables
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_activeReads == 0) m_readsDone.notify_all();
+    return (ok && seq >= m_tailSeq) ? static_cast<int64_t>(info.size) : -1;
+}
+
+DvrStats DvrStore::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    DvrStats s = m_stats;
+    s.records = m_nextSeq - m_tailSeq;
+    s.oldestTsMs = (m_tailSeq < m_nextSeq) ? m_index[m_tailSeq % m_index.size()].tsMs : 0;
+    s.newestTsMs = (m_tailSeq < m_nextSeq) ? m_lastTsMs : 0;
+    s.usedBytes = m_usedBytes;
+    return s;
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" void* RetinaFaceDvrOpen(const char* path, const DvrConfig* config, void* writer)
+{
+    if (!path) return nullptr;
+    DvrConfig cfg;
+    std::memset(&cfg, 0, sizeof(cfg));
+    if (config) cfg = *config;
+    DvrStore* store = new DvrStore();
+    if (!store->open(path, cfg, static_cast<FrameWriter*>(writer))) {
+        delete store;
+        return nullptr;
+    }
+    return store;
+}
+
+extern "C" void RetinaFaceDvrClose(void* store)
+{
+    delete static_cast<DvrStore*>(store);
+}
+
+extern "C" int RetinaFaceDvrWrite(void* store, const uint8_t* data, uint64_t size, int64_t tsMs, int64_t frameNum)
+{
+    if (!store || !data) return 0;
+    DvrStore* s = static_cast<DvrStore*>(store);
+    if (size > s->payloadCapacity()) return 0;
+    uint8_t* buffer = s->acquire();
+    if (!buffer) return 0;
+    std::memcpy(buffer + kDvrRecordHeader, data, size);
+    return s->commit(buffer, size, tsMs, frameNum) ? 1 : 0;
+}
+
+extern "C" int RetinaFaceDvrSaveSurfaceJpeg(void* store, GstBuffer* buffer, int batchId, int64_t tsMs,
+                                            int64_t frameNum, int quality, const float* boxes, int numBoxes)
+{
+    if (!store || !buffer || batchId < 0) return 0;
+    DvrStore* s = static_cast<DvrStore*>(store);
+    uint8_t* staging = s->acquire();
+    if (!staging) return 0;
+    const size_t size = encodeSurfaceJpeg(buffer, batchId, quality, boxes, numBoxes,
+                                          staging + kDvrRecordHeader, s->payloadCapacity());
+    if (size == 0) {
+        s->release(staging);
+        return 0;
+    }
+    return s->commit(staging, size, tsMs, frameNum) ? 1 : 0;
+}
+
+extern "C" int RetinaFaceDvrFind(void* store, int64_t tsMs, DvrRecordInfo* info)
+{
+    if (!store || !info) return 0;
+    return static_cast<DvrStore*>(store)->find(tsMs, *info) ? 1 : 0;
+}
+
+extern "C" int RetinaFaceDvrRecord(void* store, uint64_t seq, DvrRecordInfo* info)
+{
+    if (!store || !info) return 0;
+    return static_cast<DvrStore*>(store)->record(seq, *info) ? 1 : 0;
+}
+
+extern "C" int64_t RetinaFaceDvrRead(void* store, uint64_t seq, uint8_t* out, uint64_t capacity)
+{
+    if (!store || !out) return -1;
+    return static_cast<DvrStore*>(store)->read(seq, out, capacity);
+}
+
+extern "C" int RetinaFaceDvrSync(void* store)
+{
+    if (!store) return 0;
+    return static_cast<DvrStore*>(store)->syncIndex() ? 1 : 0;
+}
+
+extern "C" void RetinaFaceDvrGetStats(void* store, DvrStats* stats)
+{
+    if (!store || !stats) return;
+    *stats = static_cast<DvrStore*>(store)->stats();
+}
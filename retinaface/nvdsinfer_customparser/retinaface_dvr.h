@@ -0,0 +1,175 @@
+/******************************************************************************
+ * retinaface_dvr.h
+ *
+ * Almacén circular de frames en disco (modo DVR): un archivo de tamaño fijo
+ * por stream donde los JPEGs se escriben en anillo sobre los más antiguos,
+ * con índice en memoria persistido en el mismo archivo
+ ******************************************************************************/
+
+#ifndef RETINAFACE_DVR_H
+#define RETINAFACE_DVR_H
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <gst/gst.h>
+
+class FrameWriter;
+
+/** @brief Bytes reservados delante de cada registro en el área de datos. */
+static const int kDvrRecordHeader = 64;
+
+/**
+ * @brief Geometría del almacén. Se fija al crear el archivo; al reabrirlo
+ *        debe coincidir.
+ */
+struct DvrConfig {
+    uint64_t dataBytes;          /**< Tamaño del área de datos (se redondea a 4096) */
+    int32_t  maxRecords;         /**< Entradas del índice circular */
+    int32_t  indexSyncInterval;  /**< Registros entre escrituras del índice a disco */
+    int32_t  bucketMs;           /**< Ancho de las cubetas de tiempo para buscar por ts */
+};
+
+/**
+ * @brief Entrada del índice (igual en memoria y en disco).
+ */
+struct DvrRecordInfo {
+    uint64_t seq;        /**< Secuencia del registro; 0 = libre */
+    int64_t  tsMs;
+    int64_t  frameNum;
+    uint64_t offset;     /**< Posición en el área de datos */
+    uint32_t size;       /**< Bytes del payload (sin cabecera) */
+    uint32_t reserved;
+};
+
+/**
+ * @brief Contadores del almacén.
+ */
+struct DvrStats {
+    uint64_t records;      /**< Registros vivos en el índice */
+    uint64_t appended;
+    uint64_t overwritten;  /**< Registros expulsados por el anillo */
+    uint64_t failed;       /**< Escrituras rechazadas (tamaño, pool, escritor) */
+    int64_t  oldestTsMs;
+    int64_t  newestTsMs;
+    uint64_t usedBytes;    /**< Bytes ocupados por registros vivos */
+};
+
+/**
+ * @brief Archivo preasignado con cabecera, índice circular y área de datos.
+ *        Cada registro va alineado a 4096 (compatible con O_DIRECT) y empieza
+ *        con una cabecera con su secuencia, que se comprueba al leer: así se
+ *        detectan los datos aún en vuelo o pisados tras una caída. Las
+ *        escrituras de datos van por FrameWriter::submitAt(); el índice se
+ *        escribe con pwrite cada indexSyncInterval registros y al cerrar.
+ *        Los timestamps deben crecer (los que retroceden se igualan al
+ *        último). Thread-safe.
+ */
+class DvrStore {
+public:
+    DvrStore();
+    ~DvrStore();
+
+    /**
+     * @brief Crea (preasignando) o reabre `path`. Sin escritor se abre en
+     *        solo lectura y el archivo debe existir.
+     */
+    bool open(const char* path, const DvrConfig &config, FrameWriter* writer);
+
+    /** @brief Escribe el índice pendiente y cierra el archivo. */
+    void close();
+
+    /**
+     * @brief Buffer del escritor para un registro; el payload va en
+     *        buffer + kDvrRecordHeader (hasta payloadCapacity() bytes).
+     */
+    uint8_t* acquire();
+    void     release(uint8_t* buffer);
+    size_t   payloadCapacity() const;
+
+    /**
+     * @brief Indexa y entrega a disco un buffer de acquire(). Si el escritor
+     *        no acepta el buffer, el índice y el cursor vuelven a su estado
+     *        anterior (los registros expulsados siguen vivos) y devuelve `false`.
+     */
+    bool commit(uint8_t* buffer, size_t size, int64_t tsMs, int64_t frameNum);
+
+    /**
+     * @brief Último registro con ts <= tsMs. O(1) con la cubeta de tiempo; si
+     *        la cubeta no tiene registros vivos, búsqueda binaria en el índice.
+     */
+    bool find(int64_t tsMs, DvrRecordInfo &info);
+
+    /** @brief Registro por secuencia, si sigue vivo. */
+    bool record(uint64_t seq, DvrRecordInfo &info);
+
+    /**
+     * @brief Lee el payload del registro en `out`. El pread va fuera del lock;
+     *        close() espera a las lecturas en curso antes de cerrar el archivo.
+     * @return Bytes leídos, -1 si ya no está o sus datos no son válidos.
+     */
+    int64_t read(uint64_t seq, uint8_t* out, size_t capacity);
+
+    /** @brief Escribe cabecera e índice a disco. */
+    bool syncIndex();
+
+    DvrStats stats();
+
+private:
+    DvrStore(const DvrStore &);
+    DvrStore &operator=(const DvrStore &);
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t dataBytes;
+        uint32_t maxRecords;
+        uint32_t reserved;
+        uint64_t nextSeq;
+        uint64_t tailSeq;
+        uint64_t writeOffset;
+    };
+
+    DvrRecordInfo &slot(uint64_t seq) { return m_index[seq % m_index.size()]; }
+    uint64_t footprint(uint64_t size) const;
+    bool loadIndex();
+    bool syncIndexLocked();
+    void evictForWrite(uint64_t offset, uint64_t bytes);
+    bool findLocked(int64_t tsMs, uint64_t &seq);
+    int64_t bucketOf(int64_t tsMs) const;
+
+    int                        m_fd;
+    bool                       m_readOnly;
+    FrameWriter*               m_writer;
+    DvrConfig                  m_config;
+    uint64_t                   m_indexOffset;   // Posición del índice en el archivo
+    uint64_t                   m_dataOffset;    // Posición del área de datos
+    std::vector<DvrRecordInfo> m_index;
+    uint64_t                   m_nextSeq;
+    uint64_t                   m_tailSeq;       // Registro vivo más antiguo
+    uint64_t                   m_writeOffset;
+    uint64_t                   m_usedBytes;
+    uint64_t                   m_dirtySeq;      // Primer registro sin persistir
+    int64_t                    m_lastTsMs;
+    std::vector<int64_t>       m_bucketId;      // Cubeta (ts / bucketMs) de cada ranura
+    std::vector<uint64_t>      m_bucketFirst;   // Primer registro de la cubeta
+    DvrStats                   m_stats;
+    int                        m_activeReads;   // Lecturas con m_fd fuera del lock
+    std::mutex                 m_mutex;
+    std::condition_variable    m_readsDone;
+};
+
+extern "C" {
+void*   RetinaFaceDvrOpen(const char* path, const DvrConfig* config, void* writer);
+void    RetinaFaceDvrClose(void* store);
+int     RetinaFaceDvrWrite(void* store, const uint8_t* data, uint64_t size, int64_t tsMs, int64_t frameNum);
+int     RetinaFaceDvrSaveSurfaceJpeg(void* store, GstBuffer* buffer, int batchId, int64_t tsMs, int64_t frameNum,
+                                     int quality, const float* boxes, int numBoxes);
+int     RetinaFaceDvrFind(void* store, int64_t tsMs, DvrRecordInfo* info);
+int     RetinaFaceDvrRecord(void* store, uint64_t seq, DvrRecordInfo* info);
+int64_t RetinaFaceDvrRead(void* store, uint64_t seq, uint8_t* out, uint64_t capacity);
+int     RetinaFaceDvrSync(void* store);
+void    RetinaFaceDvrGetStats(void* store, DvrStats* stats);
+}
+
+#endif // RETINAFACE_DVR_H
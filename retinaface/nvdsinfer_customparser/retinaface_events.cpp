@@ -0,0 +1,211 @@
+/******************************************************************************
+ * retinaface_events.cpp
+ *
+ * Máquina de estados por track: candidato (sin eventos) -> presente (enter,
+ * update cada heartbeatMs) -> exit tras exitTimeoutMs sin verlo. Los
+ * candidatos que caducan antes de entrar se olvidan en silencio.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "retinaface_events.h"
+
+static const uint64_t kUntracked = ~static_cast<uint64_t>(0);
+
+FaceEventGenerator::FaceEventGenerator(const FaceEventConfig &config)
+    : m_config(config), m_updates(0)
+{
+    m_config.enterFrames = std::max(1, m_config.enterFrames);
+    m_config.minDurationMs = std::max(0, m_config.minDurationMs);
+    m_config.exitTimeoutMs = std::max(0, m_config.exitTimeoutMs);
+    m_config.heartbeatMs = std::max(0, m_config.heartbeatMs);
+    std::memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void FaceEventGenerator::emit(uint32_t streamId, uint64_t trackId, const TrackState &track, int64_t tsMs,
+                              FaceEventType type)
+{
+    FaceEvent event;
+    event.trackId = trackId;
+    event.tsMs = tsMs;
+    event.firstSeenMs = track.firstSeenMs;
+    event.lastSeenMs = track.lastSeenMs;
+    event.streamId = streamId;
+    event.type = type;
+    std::memcpy(event.box, track.box, sizeof(event.box));
+    event.confidence = track.confidence;
+    event.maxConfidence = track.maxConfidence;
+    event.observations = track.observations;
+    event.reserved = 0;
+    m_queue.push_back(event);
+
+    if (type == FACE_EVENT_ENTER) {
+        ++m_stats.enters;
+    } else if (type == FACE_EVENT_UPDATE) {
+        ++m_stats.updates;
+    } else {
+        ++m_stats.exits;
+    }
+}
+
+int FaceEventGenerator::update(uint32_t streamId, int64_t tsMs, const uint64_t* trackIds, const float* boxes,
+                               const float* confidences, int count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    StreamTracks &tracks = m_streams[streamId];
+    const size_t queued = m_queue.size();
+    const uint64_t frame = ++m_updates;
+
+    for (int f = 0; f < count; ++f) {
+        if (trackIds[f] == kUntracked) continue;
+        ++m_stats.detections;
+
+        std::pair<StreamTracks::iterator, bool> inserted = tracks.insert(std::make_pair(trackIds[f], TrackState()));
+        TrackState &track = inserted.first->second;
+        if (inserted.second) {
+            track.firstSeenMs = tsMs;
+            track.lastEventMs = tsMs;
+            track.maxConfidence = 0.f;
+            track.observations = 0;
+            track.entered = false;
+        } else if (track.lastUpdate == frame) {
+            continue;   // Id repetido en el frame
+        }
+        track.lastUpdate = frame;
+        track.lastSeenMs = tsMs;
+        std::memcpy(track.box, boxes + 4 * f, sizeof(track.box));
+        track.confidence = confidences ? confidences[f] : 1.f;
+        track.maxConfidence = std::max(track.maxConfidence, track.confidence);
+        ++track.observations;
+
+        if (!track.entered) {
+            if (track.observations >= m_config.enterFrames &&
+                tsMs - track.firstSeenMs >= m_config.minDurationMs) {
+                track.entered = true;
+                track.lastEventMs = tsMs;
+                emit(streamId, trackIds[f], track, tsMs, FACE_EVENT_ENTER);
+            }
+        } else if (m_config.heartbeatMs > 0 && tsMs - track.lastEventMs >= m_config.heartbeatMs) {
+            track.lastEventMs = tsMs;
+            emit(streamId, trackIds[f], track, tsMs, FACE_EVENT_UPDATE);
+        }
+    }
+
+    // Salidas y candidatos caducados, con el reloj de este stream. Un salto
+    // hacia atrás (reinicio de la fuente) también cierra los tracks
+    for (StreamTracks::iterator it = tracks.begin(); it != tracks.end();) {
+        const int64_t age = tsMs - it->second.lastSeenMs;
+        if (age > m_config.exitTimeoutMs || age < 0) {
+            if (it->second.entered) {
+                emit(streamId, it->first, it->second, tsMs, FACE_EVENT_EXIT);
+            } else {
+                ++m_stats.discarded;
+            }
+            it = tracks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return static_cast<int>(m_queue.size() - queued);
+}
+
+int FaceEventGenerator::flush(uint32_t streamId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<uint32_t, StreamTracks>::iterator s = m_streams.find(streamId);
+    if (s == m_streams.end()) return 0;
+
+    // Por orden de id para que la salida no dependa del hash
+    std::vector<uint64_t> ids;
+    for (StreamTracks::const_iterator it = s->second.begin(); it != s->second.end(); ++it) {
+        ids.push_back(it->first);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    int exits = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const TrackState &track = s->second[ids[i]];
+        if (track.entered) {
+            emit(streamId, ids[i], track, track.lastSeenMs, FACE_EVENT_EXIT);
+            ++exits;
+        } else {
+            ++m_stats.discarded;
+        }
+    }
+    m_streams.erase(s);
+    return exits;
+}
+
+int FaceEventGenerator::flushAll()
+{
+    std::vector<uint32_t> streams;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (std::map<uint32_t, StreamTracks>::const_iterator s = m_streams.begin(); s != m_streams.end(); ++s) {
+            streams.push_back(s->first);
+        }
+    }
+    int exits = 0;
+    for (size_t i = 0; i < streams.size(); ++i) exits += flush(streams[i]);
+    return exits;
+}
+
+int FaceEventGenerator::drain(FaceEvent* events, int maxEvents)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const int n = std::min(maxEvents, static_cast<int>(m_queue.size()));
+    for (int i = 0; i < n; ++i) {
+        events[i] = m_queue.front();
+        m_queue.pop_front();
+    }
+    return n;
+}
+
+void FaceEventGenerator::getStats(FaceEventStats &stats)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats = m_stats;
+    stats.pending = m_queue.size();
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" void* RetinaFaceEventsCreate(const FaceEventConfig* config)
+{
+    if (!config) return nullptr;
+    return new FaceEventGenerator(*config);
+}
+
+extern "C" void RetinaFaceEventsDestroy(void* generator)
+{
+    delete static_cast<FaceEventGenerator*>(generator);
+}
+
+extern "C" int RetinaFaceEventsUpdate(void* generator, uint32_t streamId, int64_t tsMs, const uint64_t* trackIds,
+                                      const float* boxes, const float* confidences, int count)
+{
+    if (!generator || count < 0 || (count > 0 && (!trackIds || !boxes))) return -1;
+    return static_cast<FaceEventGenerator*>(generator)->update(streamId, tsMs, trackIds, boxes, confidences, count);
+}
+
+extern "C" int RetinaFaceEventsFlush(void* generator, int64_t streamId)
+{
+    if (!generator) return -1;
+    FaceEventGenerator* events = static_cast<FaceEventGenerator*>(generator);
+    // streamId < 0: todos los streams
+    return streamId < 0 ? events->flushAll() : events->flush(static_cast<uint32_t>(streamId));
+}
+
+extern "C" int RetinaFaceEventsDrain(void* generator, FaceEvent* events, int maxEvents)
+{
+    if (!generator || !events || maxEvents <= 0) return 0;
+    return static_cast<FaceEventGenerator*>(generator)->drain(events, maxEvents);
+}
+
+extern "C" void RetinaFaceEventsGetStats(void* generator, FaceEventStats* stats)
+{
+    if (generator && stats) static_cast<FaceEventGenerator*>(generator)->getStats(*stats);
+}
@@ -0,0 +1,120 @@
+/******************************************************************************
+ * retinaface_events.h
+ *
+ * Eventos de llegada, permanencia y salida de caras por track a partir de la
+ * salida del tracker, en lugar de publicar cada detección de cada frame
+ ******************************************************************************/
+
+#ifndef RETINAFACE_EVENTS_H
+#define RETINAFACE_EVENTS_H
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+enum FaceEventType {
+    FACE_EVENT_ENTER  = 0,   /**< El track superó el debounce de entrada */
+    FACE_EVENT_UPDATE = 1,   /**< Latido periódico mientras sigue presente */
+    FACE_EVENT_EXIT   = 2    /**< Sin observaciones durante exitTimeoutMs (o flush) */
+};
+
+/**
+ * @brief Debounce y latidos. Un track solo entra tras enterFrames
+ *        observaciones a lo largo de al menos minDurationMs; si desaparece
+ *        antes se descarta sin eventos, así que los falsos positivos de uno
+ *        o dos frames no salen del generador.
+ */
+struct FaceEventConfig {
+    int32_t enterFrames;     /**< Observaciones necesarias para el enter */
+    int32_t minDurationMs;   /**< Desde la primera observación hasta el enter */
+    int32_t exitTimeoutMs;   /**< Oclusiones más cortas no producen exit */
+    int32_t heartbeatMs;     /**< Periodo de los update (0: sin update) */
+};
+
+struct FaceEvent {
+    uint64_t trackId;
+    int64_t  tsMs;            /**< Frame que produjo el evento */
+    int64_t  firstSeenMs;
+    int64_t  lastSeenMs;
+    uint32_t streamId;
+    int32_t  type;            /**< FaceEventType */
+    float    box[4];          /**< left, top, width, height de la última observación */
+    float    confidence;      /**< De la última observación */
+    float    maxConfidence;
+    int32_t  observations;
+    int32_t  reserved;
+};
+
+struct FaceEventStats {
+    uint64_t detections;      /**< Caras con track recibidas */
+    uint64_t enters;
+    uint64_t updates;
+    uint64_t exits;
+    uint64_t discarded;       /**< Tracks que no superaron el debounce */
+    uint64_t pending;         /**< Eventos sin recoger */
+};
+
+/**
+ * @brief Estado por (stream, track). update() recibe todas las caras de un
+ *        frame, incluso cuando no hay ninguna, porque las salidas se detectan
+ *        con el reloj del propio stream; los eventos se acumulan en una cola
+ *        que se vacía con drain(). Thread-safe.
+ */
+class FaceEventGenerator {
+public:
+    explicit FaceEventGenerator(const FaceEventConfig &config);
+
+    /**
+     * @param trackIds    Id de tracker por cara; UINT64_MAX (sin tracker) se ignora.
+     * @param boxes       count x (left, top, width, height).
+     * @param confidences count valores, o nullptr.
+     * @return Eventos generados por este frame.
+     */
+    int update(uint32_t streamId, int64_t tsMs, const uint64_t* trackIds, const float* boxes,
+               const float* confidences, int count);
+
+    /** @brief Exit de todos los tracks presentes del stream (EOS). */
+    int flush(uint32_t streamId);
+    int flushAll();
+
+    /** @return Eventos copiados a `events` (como mucho maxEvents), en orden. */
+    int drain(FaceEvent* events, int maxEvents);
+
+    void getStats(FaceEventStats &stats);
+
+private:
+    struct TrackState {
+        int64_t  firstSeenMs;
+        int64_t  lastSeenMs;
+        int64_t  lastEventMs;
+        uint64_t lastUpdate;      // update() que lo vio por última vez
+        float    box[4];
+        float    confidence;
+        float    maxConfidence;
+        int32_t  observations;
+        bool     entered;
+    };
+    typedef std::unordered_map<uint64_t, TrackState> StreamTracks;
+
+    void emit(uint32_t streamId, uint64_t trackId, const TrackState &track, int64_t tsMs, FaceEventType type);
+
+    FaceEventConfig                   m_config;
+    std::map<uint32_t, StreamTracks>  m_streams;
+    std::deque<FaceEvent>             m_queue;
+    FaceEventStats                    m_stats;
+    uint64_t                          m_updates;
+    std::mutex                        m_mutex;
+};
+
+extern "C" {
+void* RetinaFaceEventsCreate(const FaceEventConfig* config);
+void  RetinaFaceEventsDestroy(void* generator);
+int   RetinaFaceEventsUpdate(void* generator, uint32_t streamId, int64_t tsMs, const uint64_t* trackIds,
+                             const float* boxes, const float* confidences, int count);
+int   RetinaFaceEventsFlush(void* generator, int64_t streamId);
+int   RetinaFaceEventsDrain(void* generator, FaceEvent* events, int maxEvents);
+void  RetinaFaceEventsGetStats(void* generator, FaceEventStats* stats);
+}
+
+#endif // RETINAFACE_EVENTS_H
@@ -0,0 +1,432 @@
+/******************************************************************************
+ * retinaface_flight_recorder.cpp
+ *
+ * Cada hilo del parser copia las candidatas de su unidad a una ranura propia
+ * (thread_local) sin tomar el mutex, y bajo él solo la intercambia con la
+ * ranura del anillo, que le devuelve los buffers para la siguiente unidad.
+ * Durante un volcado el anillo queda congelado (las unidades nuevas no se
+ * guardan), así que el hilo escribe directamente desde las ranuras.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nvdsinfer_custom_retinaface.h"
+#include "retinaface_flight_recorder.h"
+
+static const uint32_t kFlightDumpVersion = 5;
+static const int      kThresholdRefresh  = 64;   // Unidades entre recálculos del percentil
+static const float    kStoreMarginSlack  = 0.05f;   // Logit por debajo del umbral que también se guarda
+static const float    kBackgroundLogit   = -1e4f;   // Conf de las anclas no guardadas al reproducir
+
+namespace {
+struct Slot {
+    FlightRecord          record;
+    std::vector<uint32_t> anchors;   // Índices de las anclas guardadas
+    std::vector<float>    tensors;   // loc | landmarks | conf de esas anclas
+};
+
+std::atomic<bool>        g_active(false);
+std::mutex               g_mutex;
+std::condition_variable  g_wake;
+std::thread              g_writer;
+bool                     g_stop = false;
+std::string              g_dir;
+FlightRecorderConfig     g_config;
+FlightRecorderStats      g_stats;
+
+std::vector<Slot>        g_ring;
+size_t                   g_head = 0;
+size_t                   g_count = 0;
+uint64_t                 g_seq = 0;
+
+std::vector<float>       g_timeWindow;
+std::vector<int32_t>     g_candWindow;
+std::vector<float>       g_timeScratch;
+std::vector<int32_t>     g_candScratch;
+size_t                   g_windowPos = 0;
+size_t                   g_windowCount = 0;
+int                      g_sinceRefresh = 0;
+
+bool                     g_dumping = false;
+uint32_t                 g_trigger = 0;
+uint64_t                 g_triggerSeq = 0;
+int64_t                  g_lastDumpMs = std::numeric_limits<int64_t>::min() / 2;
+
+std::mutex               g_controlMutex;   // Serializa start/stop
+
+int64_t nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename T>
+T percentileOf(const std::vector<T> &window, size_t count, float percentile, std::vector<T> &scratch)
+{
+    scratch.assign(window.begin(), window.begin() + count);
+    size_t k = static_cast<size_t>(std::ceil(percentile / 100.0 * count));
+    k = std::min(std::max<size_t>(k, 1), count) - 1;
+    std::nth_element(scratch.begin(), scratch.begin() + k, scratch.end());
+    return scratch[k];
+}
+
+// Con g_mutex tomado
+void refreshThresholds()
+{
+    g_sinceRefresh = 0;
+    if (g_windowCount == 0) return;
+    g_stats.thresholdUs = percentileOf(g_timeWindow, g_windowCount, g_config.percentile, g_timeScratch);
+    g_stats.thresholdCandidates = percentileOf(g_candWindow, g_windowCount, g_config.percentile, g_candScratch);
+}
+
+// Con g_mutex tomado
+void beginDump(uint32_t trigger, uint64_t seq)
+{
+    g_dumping = true;
+    g_trigger = trigger;
+    g_triggerSeq = seq;
+    g_lastDumpMs = nowMs();
+    g_wake.notify_one();
+}
+
+// Con g_mutex tomado: la cabecera copia los umbrales vigentes en el disparo,
+// que el hilo de inferencia sigue actualizando durante la escritura
+FlightDumpHeader dumpHeader(uint32_t trigger, uint64_t triggerSeq, size_t count)
+{
+    FlightDumpHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "RFFR", 4);
+    header.version = kFlightDumpVersion;
+    header.count = static_cast<uint32_t>(count);
+    header.trigger = trigger;
+    header.triggerSeq = triggerSeq;
+    header.percentile = g_config.percentile;
+    header.thresholdUs = g_stats.thresholdUs;
+    header.thresholdCandidates = g_stats.thresholdCandidates;
+    return header;
+}
+
+bool writeDump(const FlightDumpHeader &header, size_t head)
+{
+    const uint32_t trigger = header.trigger;
+    const size_t count = header.count;
+    const std::string path = g_dir + "/flight_" + std::to_string(header.triggerSeq) + ".rfr";
+    const std::string tmpPath = path + ".tmp";
+    std::FILE* file = std::fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "ERROR: no se pudo crear el volcado " << tmpPath << std::endl;
+        return false;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    const size_t capacity = g_ring.size();
+    for (size_t i = 0; ok && i < count; ++i) {
+        const Slot &slot = g_ring[(head + capacity - count + i) % capacity];
+        const size_t n = slot.record.numStored;
+        ok = std::fwrite(&slot.record, sizeof(slot.record), 1, file) == 1 &&
+             std::fwrite(slot.anchors.data(), sizeof(uint32_t), n, file) == n &&
+             std::fwrite(slot.tensors.data(), sizeof(float), n * 16, file) == n * 16;
+    }
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "ERROR: falló el volcado " << path << std::endl;
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    std::cout << "Flight recorder: " << count << " unidades en " << path << " (disparo " << trigger << ")"
+              << std::endl;
+    return true;
+}
+
+void writerLoop()
+{
+    std::unique_lock<std::mutex> lock(g_mutex);
+    while (true) {
+        g_wake.wait(lock, []() { return g_stop || g_dumping; });
+        if (g_dumping) {
+            const FlightDumpHeader header = dumpHeader(g_trigger, g_triggerSeq, g_count);
+            const size_t head = g_head;
+
+            // El anillo no cambia mientras g_dumping esté activo
+            lock.unlock();
+            const bool ok = writeDump(header, head);
+            lock.lock();
+            ++(ok ? g_stats.dumps : g_stats.failedDumps);
+            g_dumping = false;
+            continue;
+        }
+        if (g_stop) break;
+    }
+}
+} // namespace
+
+//-------------------------------------------------------------------------------
+// Control
+//-------------------------------------------------------------------------------
+static void stopLocked()
+{
+    g_active.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_stop = true;
+    }
+    g_wake.notify_all();
+    if (g_writer.joinable()) g_writer.join();   // Termina el volcado pendiente
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    std::vector<Slot>().swap(g_ring);
+    g_head = g_count = 0;
+}
+
+bool startFlightRecorder(const char* dir, const FlightRecorderConfig &config)
+{
+    if (!dir || config.frames <= 0 || config.window <= 0 || config.minSamples < 0 ||
+        !(config.percentile > 0.f && config.percentile <= 100.f)) {
+        std::cerr << "ERROR: configuración del registrador de vuelo inválida." << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> control(g_controlMutex);
+    stopLocked();
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_dir = dir;
+    g_config = config;
+    std::memset(&g_stats, 0, sizeof(g_stats));
+    g_stats.thresholdUs = std::numeric_limits<float>::infinity();
+    g_stats.thresholdCandidates = INT_MAX;
+    g_ring.resize(config.frames);
+    g_head = g_count = 0;
+    g_timeWindow.assign(config.window, 0.f);
+    g_candWindow.assign(config.window, 0);
+    g_windowPos = g_windowCount = 0;
+    g_sinceRefresh = 0;
+    g_dumping = false;
+    g_lastDumpMs = std::numeric_limits<int64_t>::min() / 2;
+    g_stop = false;
+    g_writer = std::thread(writerLoop);
+    g_active.store(true, std::memory_order_release);
+    return true;
+}
+
+void stopFlightRecorder()
+{
+    std::lock_guard<std::mutex> control(g_controlMutex);
+    stopLocked();
+}
+
+bool flightRecorderActive()
+{
+    return g_active.load(std::memory_order_relaxed);
+}
+
+void recordFlightFrame(const float* locData, const float* landmData, const float* confData, size_t numAnchors,
+                       int inputWidth, int inputHeight, const ParserConfig &config, float parseUs, int candidates,
+                       int faces)
+{
+    // Ranura del hilo: se rellena sin el mutex y se intercambia con la del
+    // anillo, cuyos buffers se reutilizan en la siguiente unidad
+    static thread_local Slot staging;
+    FlightRecord &record = staging.record;
+    record.wallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.parseUs = parseUs;
+    record.candidates = candidates;
+    record.faces = faces;
+    record.inputWidth = inputWidth;
+    record.inputHeight = inputHeight;
+    record.numAnchors = static_cast<uint32_t>(numAnchors);
+    record.config = config;
+
+    // Candidatas según el logit del umbral (el parser compara la softmax),
+    // con margen para no perder las que quedan justo en el límite
+    const float threshold = config.confThreshold;
+    const float minMargin = threshold >= 1.f ? std::numeric_limits<float>::infinity()
+                          : threshold <= 0.f ? -std::numeric_limits<float>::infinity()
+                          : std::log(threshold / (1.f - threshold)) - kStoreMarginSlack;
+    staging.anchors.clear();
+    for (size_t i = 0; i < numAnchors; ++i) {
+        if (confData[2 * i + 1] - confData[2 * i] >= minMargin) staging.anchors.push_back(static_cast<uint32_t>(i));
+    }
+    const size_t stored = staging.anchors.size();
+    record.numStored = static_cast<uint32_t>(stored);
+    staging.tensors.resize(stored * 16);
+    float* loc = staging.tensors.data();
+    float* landm = loc + stored * 4;
+    float* conf = loc + stored * 14;
+    for (size_t j = 0; j < stored; ++j) {
+        const size_t a = staging.anchors[j];
+        std::memcpy(loc + 4 * j, locData + 4 * a, 4 * sizeof(float));
+        std::memcpy(landm + 10 * j, landmData + 10 * a, 10 * sizeof(float));
+        std::memcpy(conf + 2 * j, confData + 2 * a, 2 * sizeof(float));
+    }
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (!g_active.load(std::memory_order_acquire) || g_ring.empty()) return;
+    const uint64_t seq = g_seq++;
+    if (g_dumping) {
+        ++g_stats.skipped;
+        return;
+    }
+    record.seq = seq;
+    std::swap(g_ring[g_head], staging);
+
+    g_head = (g_head + 1) % g_ring.size();
+    g_count = std::min(g_count + 1, g_ring.size());
+    ++g_stats.recorded;
+
+    // Ventana de muestras para los percentiles
+    g_timeWindow[g_windowPos] = parseUs;
+    g_candWindow[g_windowPos] = candidates;
+    g_windowPos = (g_windowPos + 1) % g_timeWindow.size();
+    g_windowCount = std::min(g_windowCount + 1, g_timeWindow.size());
+    if (++g_sinceRefresh >= kThresholdRefresh) refreshThresholds();
+
+    if (g_windowCount < static_cast<size_t>(g_config.minSamples)) return;
+    uint32_t trigger = 0;
+    if (parseUs > g_stats.thresholdUs) trigger |= FLIGHT_TRIGGER_PARSE_TIME;
+    if (candidates > g_stats.thresholdCandidates) trigger |= FLIGHT_TRIGGER_CANDIDATES;
+    if (trigger && nowMs() - g_lastDumpMs >= g_config.cooldownMs) beginDump(trigger, seq);
+}
+
+bool requestFlightDump()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (!g_active.load() || g_dumping || g_count == 0) return false;
+    beginDump(FLIGHT_TRIGGER_MANUAL, g_seq - 1);
+    return true;
+}
+
+void getFlightRecorderStats(FlightRecorderStats &stats)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    stats = g_stats;
+}
+
+// Para el hilo al descargar la librería si nadie llamó a stop
+static struct FlightRecorderShutdown {
+    ~FlightRecorderShutdown() { stopFlightRecorder(); }
+} g_shutdown;
+
+//-------------------------------------------------------------------------------
+// Reproducción
+//-------------------------------------------------------------------------------
+int replayFlightDump(const char* path, int repeats, FlightReplayResult* results, int maxResults)
+{
+    std::FILE* file = path ? std::fopen(path, "rb") : nullptr;
+    if (!file) {
+        std::cerr << "ERROR: no se pudo abrir el volcado " << (path ? path : "(null)") << std::endl;
+        return -1;
+    }
+    FlightDumpHeader header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.magic, "RFFR", 4) != 0 ||
+        header.version != kFlightDumpVersion) {
+        std::cerr << "ERROR: " << path << " no es un volcado del registrador de vuelo." << std::endl;
+        std::fclose(file);
+        return -1;
+    }
+
+    repeats = std::max(repeats, 1);
+    std::vector<uint32_t> anchors;
+    std::vector<float> stored;
+    std::vector<float> tensors;
+    std::vector<float> times(repeats);
+    std::vector<RetinaFaceDetection> faces;
+    for (uint32_t i = 0; i < header.count; ++i) {
+        FlightRecord record;
+        if (std::fread(&record, sizeof(record), 1, file) != 1 || record.numStored > record.numAnchors ||
+            record.numAnchors != static_cast<uint32_t>(retinaFaceAnchorCount(record.inputWidth, record.inputHeight))) {
+            std::cerr << "ERROR: registro " << i << " de " << path << " corrupto." << std::endl;
+            std::fclose(file);
+            return -1;
+        }
+        const size_t n = record.numAnchors;
+        const size_t m = record.numStored;
+        anchors.resize(m);
+        stored.resize(m * 16);
+        if (std::fread(anchors.data(), sizeof(uint32_t), m, file) != m ||
+            std::fread(stored.data(), sizeof(float), stored.size(), file) != stored.size()) {
+            std::cerr << "ERROR: registro " << i << " de " << path << " truncado." << std::endl;
+            std::fclose(file);
+            return -1;
+        }
+
+        // Tensores completos: las anclas no guardadas quedan como fondo
+        tensors.assign(n * 16, 0.f);
+        float* conf = tensors.data() + n * 14;
+        for (size_t a = 0; a < n; ++a) conf[2 * a + 1] = kBackgroundLogit;
+        for (size_t j = 0; j < m; ++j) {
+            const size_t a = anchors[j];
+            if (a >= n) {
+                std::cerr << "ERROR: registro " << i << " de " << path << " corrupto." << std::endl;
+                std::fclose(file);
+                return -1;
+            }
+            std::memcpy(tensors.data() + 4 * a, stored.data() + 4 * j, 4 * sizeof(float));
+            std::memcpy(tensors.data() + n * 4 + 10 * a, stored.data() + m * 4 + 10 * j, 10 * sizeof(float));
+            std::memcpy(conf + 2 * a, stored.data() + m * 14 + 2 * j, 2 * sizeof(float));
+        }
+
+        ParserConfig config = record.config;
+        config.logDetections = 0;
+        int candidates = 0;
+        for (int r = 0; r < repeats; ++r) {
+            const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            selectRetinaFaces(tensors.data(), tensors.data() + n * 4, tensors.data() + n * 14, record.inputWidth,
+                              record.inputHeight, config, faces, &candidates);
+            times[r] = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        }
+        if (static_cast<int>(i) < maxResults && results) {
+            std::nth_element(times.begin(), times.begin() + repeats / 2, times.end());
+            FlightReplayResult &result = results[i];
+            result.seq = record.seq;
+            result.recordedUs = record.parseUs;
+            result.replayUs = times[repeats / 2];
+            result.candidates = candidates;
+            result.faces = static_cast<int32_t>(faces.size());
+        }
+    }
+    std::fclose(file);
+    return static_cast<int>(header.count);
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" int RetinaFaceFlightRecorderStart(const char* dir, const FlightRecorderConfig* config)
+{
+    return (config && startFlightRecorder(dir, *config)) ? 1 : 0;
+}
+
+extern "C" void RetinaFaceFlightRecorderStop()
+{
+    stopFlightRecorder();
+}
+
+extern "C" int RetinaFaceFlightRecorderDump()
+{
+    return requestFlightDump() ? 1 : 0;
+}
+
+extern "C" void RetinaFaceFlightRecorderGetStats(FlightRecorderStats* stats)
+{
+    if (stats) getFlightRecorderStats(*stats);
+}
+
+extern "C" int RetinaFaceFlightReplay(const char* path, int repeats, FlightReplayResult* results, int maxResults)
+{
+    return replayFlightDump(path, repeats, results, maxResults);
+}
@@ -0,0 +1,124 @@
+/******************************************************************************
+ * retinaface_flight_recorder.h
+ *
+ * Registrador de vuelo del parser: guarda en un anillo en memoria las anclas
+ * candidatas de las últimas N unidades y, cuando una tarda más o trae
+ * más candidatas que un percentil configurado, vuelca el anillo a disco en
+ * segundo plano para reproducir el pico fuera del pipeline
+ ******************************************************************************/
+
+#ifndef RETINAFACE_FLIGHT_RECORDER_H
+#define RETINAFACE_FLIGHT_RECORDER_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include "retinaface_parser_config.h"
+
+enum FlightTrigger {
+    FLIGHT_TRIGGER_PARSE_TIME = 1,   /**< parseUs por encima del percentil */
+    FLIGHT_TRIGGER_CANDIDATES = 2,   /**< Candidatas por encima del percentil */
+    FLIGHT_TRIGGER_MANUAL     = 4    /**< RetinaFaceFlightRecorderDump() */
+};
+
+struct FlightRecorderConfig {
+    int32_t frames;        /**< Unidades en el anillo (17 palabras por ancla candidata) */
+    float   percentile;    /**< Percentil que dispara el volcado, p. ej. 99.5 */
+    int32_t window;        /**< Muestras recientes sobre las que se calcula el percentil */
+    int32_t minSamples;    /**< No dispara hasta tener tantas muestras */
+    int32_t cooldownMs;    /**< Separación mínima entre volcados */
+};
+
+/** @brief Cabecera de un volcado flight_<seq>.rfr. Le siguen `count` registros. */
+struct FlightDumpHeader {
+    char     magic[4];            /**< "RFFR" */
+    uint32_t version;
+    uint32_t count;
+    uint32_t trigger;             /**< FlightTrigger */
+    uint64_t triggerSeq;          /**< Unidad que disparó (la última del volcado) */
+    float    percentile;
+    float    thresholdUs;
+    int32_t  thresholdCandidates;
+    uint32_t reserved;
+};
+
+/**
+ * @brief Registro de una unidad, del más antiguo al más reciente. Solo se
+ *        guardan las numStored anclas cuya confianza llega al umbral de la
+ *        configuración (con un margen): le siguen sus índices (uint32) y
+ *        numStored x 4 floats de loc, x 10 de landmarks y x 2 de conf. Al
+ *        reproducir, el resto de anclas se rellena como fondo, así que el
+ *        parseo ve las mismas candidatas.
+ */
+struct FlightRecord {
+    uint64_t     seq;
+    int64_t      wallNs;          /**< Reloj del sistema al parsear */
+    float        parseUs;         /**< Decodificación + NMS + filtros */
+    int32_t      candidates;
+    int32_t      faces;
+    int32_t      inputWidth;
+    int32_t      inputHeight;
+    uint32_t     numAnchors;
+    uint32_t     numStored;
+    ParserConfig config;          /**< Instantánea con la que se parseó */
+};
+
+struct FlightRecorderStats {
+    uint64_t recorded;
+    uint64_t skipped;             /**< Unidades no guardadas mientras se volcaba */
+    uint64_t dumps;
+    uint64_t failedDumps;
+    float    thresholdUs;         /**< Percentiles vigentes */
+    int32_t  thresholdCandidates;
+};
+
+struct FlightReplayResult {
+    uint64_t seq;
+    float    recordedUs;
+    float    replayUs;            /**< Mediana de las repeticiones */
+    int32_t  candidates;
+    int32_t  faces;
+};
+
+/**
+ * @brief Arranca el registrador (uno por proceso, como la configuración del
+ *        parser). Sustituye a uno anterior.
+ *
+ * @param dir Carpeta de los volcados; debe existir.
+ */
+bool startFlightRecorder(const char* dir, const FlightRecorderConfig &config);
+void stopFlightRecorder();
+
+/** @brief Coste en el parser cuando está apagado: una carga atómica. */
+bool flightRecorderActive();
+
+/**
+ * @brief Guarda las candidatas de una unidad y, si supera el percentil, pide
+ *        el volcado. La copia se hace fuera del mutex; bajo él solo se
+ *        publica la ranura.
+ */
+void recordFlightFrame(const float* locData, const float* landmData, const float* confData, size_t numAnchors,
+                       int inputWidth, int inputHeight, const ParserConfig &config, float parseUs, int candidates,
+                       int faces);
+
+/** @brief Pide un volcado del anillo tal como está. */
+bool requestFlightDump();
+
+void getFlightRecorderStats(FlightRecorderStats &stats);
+
+/**
+ * @brief Vuelve a parsear cada registro de un volcado con su configuración,
+ *        `repeats` veces, para reproducir el coste fuera del pipeline.
+ *
+ * @return Registros del archivo (puede ser mayor que maxResults) o -1.
+ */
+int replayFlightDump(const char* path, int repeats, FlightReplayResult* results, int maxResults);
+
+extern "C" {
+int  RetinaFaceFlightRecorderStart(const char* dir, const FlightRecorderConfig* config);
+void RetinaFaceFlightRecorderStop();
+int  RetinaFaceFlightRecorderDump();
+void RetinaFaceFlightRecorderGetStats(FlightRecorderStats* stats);
+int  RetinaFaceFlightReplay(const char* path, int repeats, FlightReplayResult* results, int maxResults);
+}
+
+#endif // RETINAFACE_FLIGHT_RECORDER_H
@@ -0,0 +1,509 @@
+/******************************************************************************
+ * retinaface_jpeg.cpp
+ *
+ * Implementación del JPEG desde YUV. libjpeg recibe las muestras ya en YCbCr
+ * 4:2:0 (raw_data_in), así que la única pasada sobre el frame es la copia por
+ * bandas, que además permite dibujar las cajas sin tocar la superficie. Las
+ * superficies de rango limitado o BT.709 se convierten en la banda (tablas)
+ * a BT.601 de rango completo, que es lo que asume un lector JFIF.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <jpeglib.h>
+
+#include "nvbufsurface.h"
+#include "retinaface_jpeg.h"
+#include "retinaface_writer.h"
+
+// Rojo en YCbCr (BT.601 rango completo; se dibuja tras convertir la banda) y
+// grosor de las cajas en luma
+static const uint8_t kBoxY  = 76;
+static const uint8_t kBoxCb = 85;
+static const uint8_t kBoxCr = 255;
+static const int     kBoxThickness = 2;
+static const int     kColorShift = 10;   // Punto fijo de las tablas de color
+
+namespace {
+struct ErrorManager {
+    jpeg_error_mgr pub;
+    jmp_buf        jump;
+};
+
+// Destino sobre un buffer fijo. Si se llena, el resto se tira a `discard` y
+// se marca el desbordamiento (libjpeg no admite abortar desde aquí)
+struct DestManager {
+    jpeg_destination_mgr pub;
+    uint8_t*             begin;
+    size_t               capacity;
+    bool                 overflow;
+    JOCTET               discard[4096];
+};
+
+// Conversión a BT.601 rango completo en punto fijo (kColorShift). El croma
+// nunca depende de Y; con BT.709 Y depende del croma y Cb/Cr se mezclan, con
+// BT.601 cada plano es una LUT de bytes
+struct ColorTables {
+    bool    mix;
+    uint8_t yLut[256];            // Sin mezcla: Y -> Y'
+    uint8_t cLut[256];            // Sin mezcla: Cb -> Cb', Cr -> Cr'
+    int32_t y[256], cbY[256], crY[256];
+    int32_t cbCb[256], crCb[256];
+    int32_t cbCr[256], crCr[256];
+};
+} // namespace
+
+struct YuvJpegEncoder::Impl {
+    jpeg_compress_struct cinfo;
+    ErrorManager         err;
+    DestManager          dest;
+};
+
+static void jpegErrorExit(j_common_ptr cinfo)
+{
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    std::cerr << "ERROR: libjpeg: " << message << std::endl;
+    longjmp(reinterpret_cast<ErrorManager*>(cinfo->err)->jump, 1);
+}
+
+static void initDestination(j_compress_ptr cinfo)
+{
+    DestManager* dest = reinterpret_cast<DestManager*>(cinfo->dest);
+    dest->pub.next_output_byte = dest->begin;
+    dest->pub.free_in_buffer = dest->capacity;
+    dest->overflow = false;
+}
+
+static boolean emptyOutputBuffer(j_compress_ptr cinfo)
+{
+    DestManager* dest = reinterpret_cast<DestManager*>(cinfo->dest);
+    dest->overflow = true;
+    dest->pub.next_output_byte = dest->discard;
+    dest->pub.free_in_buffer = sizeof(dest->discard);
+    return TRUE;
+}
+
+static void termDestination(j_compress_ptr cinfo)
+{
+    (void)cinfo;
+}
+
+YuvJpegEncoder::YuvJpegEncoder()
+    : m_impl(new Impl())
+{
+    m_impl->cinfo.err = jpeg_std_error(&m_impl->err.pub);
+    m_impl->err.pub.error_exit = jpegErrorExit;
+    jpeg_create_compress(&m_impl->cinfo);
+
+    m_impl->dest.pub.init_destination = initDestination;
+    m_impl->dest.pub.empty_output_buffer = emptyOutputBuffer;
+    m_impl->dest.pub.term_destination = termDestination;
+    m_impl->cinfo.dest = &m_impl->dest.pub;
+}
+
+YuvJpegEncoder::~YuvJpegEncoder()
+{
+    jpeg_destroy_compress(&m_impl->cinfo);
+    delete m_impl;
+}
+
+//-------------------------------------------------------------------------------
+// Copia de bandas y dibujo
+//-------------------------------------------------------------------------------
+static void buildColorTables(ColorTables &t, bool limited, bool bt709)
+{
+    // Columnas de la matriz YCbCr (origen) -> RGB -> YCbCr BT.601
+    const double kr = bt709 ? 0.2126 : 0.299, kb = bt709 ? 0.0722 : 0.114;
+    double m[3][3];
+    for (int c = 0; c < 3; ++c) {
+        const double y0 = (c == 0) ? 1.0 : 0.0, cb0 = (c == 1) ? 1.0 : 0.0, cr0 = (c == 2) ? 1.0 : 0.0;
+        const double r = y0 + 2.0 * (1.0 - kr) * cr0;
+        const double b = y0 + 2.0 * (1.0 - kb) * cb0;
+        const double g = (y0 - kr * r - kb * b) / (1.0 - kr - kb);
+        const double y = 0.299 * r + 0.587 * g + 0.114 * b;
+        m[0][c] = y;
+        m[1][c] = (b - y) / 1.772;
+        m[2][c] = (r - y) / 1.402;
+    }
+    t.mix = bt709;
+    const double one = 1 << kColorShift, scale = 255.0 * one;
+    for (int v = 0; v < 256; ++v) {
+        const double yn = limited ? (v - 16) / 219.0 : v / 255.0;
+        const double cn = limited ? (v - 128) / 224.0 : (v - 128) / 255.0;
+        // +0.5 de redondeo en el término de Y y en el de Cb/Cr que lleva el 128
+        t.y[v]    = static_cast<int32_t>(std::floor(scale * m[0][0] * yn + 0.5 * one + 0.5));
+        t.cbY[v]  = static_cast<int32_t>(std::floor(scale * m[0][1] * cn + 0.5));
+        t.crY[v]  = static_cast<int32_t>(std::floor(scale * m[0][2] * cn + 0.5));
+        t.cbCb[v] = static_cast<int32_t>(std::floor(scale * m[1][1] * cn + 128.5 * one + 0.5));
+        t.crCb[v] = static_cast<int32_t>(std::floor(scale * m[1][2] * cn + 0.5));
+        t.cbCr[v] = static_cast<int32_t>(std::floor(scale * m[2][1] * cn + 0.5));
+        t.crCr[v] = static_cast<int32_t>(std::floor(scale * m[2][2] * cn + 128.5 * one + 0.5));
+        t.yLut[v] = static_cast<uint8_t>(std::min(255, std::max(0, t.y[v] >> kColorShift)));
+        t.cLut[v] = static_cast<uint8_t>(std::min(255, std::max(0, t.cbCb[v] >> kColorShift)));
+    }
+}
+
+/** Tablas de `colorSpace` (YuvColorSpace), o nullptr si no hay que convertir. */
+static const ColorTables* colorTables(int colorSpace)
+{
+    struct AllTables {
+        ColorTables t[4];
+        AllTables()
+        {
+            for (int c = 0; c < 4; ++c) buildColorTables(t[c], (c & 1) != 0, (c & 2) != 0);
+        }
+    };
+    static const AllTables all;
+    return (colorSpace > YUV_COLOR_BT601_FULL && colorSpace <= YUV_COLOR_BT709_LIMITED) ? &all.t[colorSpace]
+                                                                                         : nullptr;
+}
+
+/**
+ * Lleva la banda recién copiada a BT.601 de rango completo. La luma va
+ * primero porque con BT.709 usa el croma original de su bloque 2x2.
+ */
+static void convertBand(uint8_t* bandY, uint8_t* bandU, uint8_t* bandV, int paddedW, int paddedCW,
+                        const ColorTables &t)
+{
+    if (!t.mix) {
+        for (int i = 0; i < 16 * paddedW; ++i) bandY[i] = t.yLut[bandY[i]];
+        for (int i = 0; i < 8 * paddedCW; ++i) bandU[i] = t.cLut[bandU[i]];
+        for (int i = 0; i < 8 * paddedCW; ++i) bandV[i] = t.cLut[bandV[i]];
+        return;
+    }
+    const int32_t maxValue = 255 << kColorShift;
+    for (int r = 0; r < 16; ++r) {
+        uint8_t* y = bandY + r * paddedW;
+        const uint8_t* u = bandU + (r / 2) * paddedCW;
+        const uint8_t* v = bandV + (r / 2) * paddedCW;
+        for (int x = 0; x < paddedW; ++x) {
+            const int32_t sum = t.y[y[x]] + t.cbY[u[x / 2]] + t.crY[v[x / 2]];
+            y[x] = static_cast<uint8_t>(std::min(maxValue, std::max(0, sum)) >> kColorShift);
+        }
+    }
+    for (int r = 0; r < 8; ++r) {
+        uint8_t* u = bandU + r * paddedCW;
+        uint8_t* v = bandV + r * paddedCW;
+        for (int x = 0; x < paddedCW; ++x) {
+            const int32_t cb = t.cbCb[u[x]] + t.crCb[v[x]];
+            const int32_t cr = t.cbCr[u[x]] + t.crCr[v[x]];
+            u[x] = static_cast<uint8_t>(std::min(maxValue, std::max(0, cb)) >> kColorShift);
+            v[x] = static_cast<uint8_t>(std::min(maxValue, std::max(0, cr)) >> kColorShift);
+        }
+    }
+}
+
+static void copyRow(uint8_t* dst, const uint8_t* src, int width, int paddedWidth)
+{
+    std::memcpy(dst, src, width);
+    std::memset(dst + width, src[width - 1], paddedWidth - width);
+}
+
+static void deinterleaveRow(uint8_t* u, uint8_t* v, const uint8_t* uv, int width, int paddedWidth)
+{
+    for (int x = 0; x < width; ++x) {
+        u[x] = uv[2 * x + 0];
+        v[x] = uv[2 * x + 1];
+    }
+    std::memset(u + width, u[width - 1], paddedWidth - width);
+    std::memset(v + width, v[width - 1], paddedWidth - width);
+}
+
+/**
+ * Fila reducida por `factor` en ambos ejes con filtro de caja: `src` son las
+ * `factor` filas de origen y la muestra c de una fila está en c * step + offset
+ * (step 2 para el plano UV entrelazado de NV12).
+ */
+static void downscaleRow(uint8_t* dst, const uint8_t* const* src, int factor, int srcWidth, int step, int offset,
+                         int width, int paddedWidth)
+{
+    for (int x = 0; x < width; ++x) {
+        const int c0 = x * factor, c1 = std::min(c0 + factor, srcWidth);
+        int sum = 0;
+        for (int r = 0; r < factor; ++r) {
+            for (int c = c0; c < c1; ++c) sum += src[r][c * step + offset];
+        }
+        const int count = factor * (c1 - c0);
+        dst[x] = static_cast<uint8_t>((sum + count / 2) / count);
+    }
+    std::memset(dst + width, dst[width - 1], paddedWidth - width);
+}
+
+/** Filas de origen de la fila reducida y, repitiendo la última del plano. */
+static void sourceRows(const uint8_t** rows, const uint8_t* plane, int pitch, int y, int factor, int height)
+{
+    for (int r = 0; r < factor; ++r) {
+        rows[r] = plane + static_cast<size_t>(std::min(y * factor + r, height - 1)) * pitch;
+    }
+}
+
+/**
+ * Dibuja los bordes de las cajas en las filas [row0, row0 + rows) de un plano
+ * de `width` x `height` muestras; `scale` pasa de coordenadas de luma al plano.
+ */
+static void drawBoxes(uint8_t* band, int pitch, int row0, int rows, int width, int height,
+                      const float* boxes, int numBoxes, float scale, int thickness, uint8_t value)
+{
+    for (int b = 0; b < numBoxes; ++b) {
+        const float* box = boxes + 4 * b;
+        const int x0 = std::max(0, static_cast<int>(box[0] * scale));
+        const int y0 = std::max(0, static_cast<int>(box[1] * scale));
+        const int x1 = std::min(width - 1, static_cast<int>((box[0] + box[2]) * scale));
+        const int y1 = std::min(height - 1, static_cast<int>((box[1] + box[3]) * scale));
+        if (x1 < x0 || y1 < y0 || y1 < row0 || y0 >= row0 + rows) continue;
+
+        const int span = x1 - x0 + 1;
+        const int side = std::min(thickness, span);
+        for (int r = std::max(y0, row0); r <= std::min(y1, row0 + rows - 1); ++r) {
+            uint8_t* p = band + (r - row0) * pitch;
+            if (r < y0 + thickness || r > y1 - thickness) {
+                std::memset(p + x0, value, span);
+            } else {
+                std::memset(p + x0, value, side);
+                std::memset(p + x1 - side + 1, value, side);
+            }
+        }
+    }
+}
+
+size_t YuvJpegEncoder::encode(const YuvImage &image, int quality, const float* boxes, int numBoxes,
+                              uint8_t* out, size_t capacity, int downscale)
+{
+    const int factor = (downscale >= 4) ? 4 : (downscale >= 2 ? 2 : 1);
+    const int srcW = image.width, srcH = image.height;
+    const int width = (srcW + factor - 1) / factor, height = (srcH + factor - 1) / factor;
+    if (srcW <= 0 || srcH <= 0 || !out || capacity == 0 || !image.planes[0] || !image.planes[1] ||
+        (image.layout == YUV_LAYOUT_I420 && !image.planes[2])) {
+        return 0;
+    }
+
+    // libjpeg lee bloques completos: las filas van rellenas a 16 (luma) y 8 (croma)
+    const int paddedW = (width + 15) & ~15;
+    const int chromaW = (width + 1) / 2, chromaH = (height + 1) / 2;
+    const int paddedCW = paddedW / 2;
+    const int srcCW = (srcW + 1) / 2, srcCH = (srcH + 1) / 2;
+    m_band.resize(16 * paddedW + 2 * 8 * paddedCW);
+    uint8_t* bandY = &m_band[0];
+    uint8_t* bandU = bandY + 16 * paddedW;
+    uint8_t* bandV = bandU + 8 * paddedCW;
+
+    jpeg_compress_struct &cinfo = m_impl->cinfo;
+    if (setjmp(m_impl->err.jump)) {
+        jpeg_abort_compress(&cinfo);
+        return 0;
+    }
+    m_impl->dest.begin = out;
+    m_impl->dest.capacity = capacity;
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_colorspace(&cinfo, JCS_YCbCr);
+    cinfo.raw_data_in = TRUE;
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 2;
+    cinfo.comp_info[1].h_samp_factor = cinfo.comp_info[1].v_samp_factor = 1;
+    cinfo.comp_info[2].h_samp_factor = cinfo.comp_info[2].v_samp_factor = 1;
+    cinfo.dct_method = JDCT_IFAST;
+    jpeg_set_quality(&cinfo, std::min(100, std::max(1, quality)), TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    const ColorTables* color = colorTables(image.colorSpace);
+    const int boxCount = boxes ? numBoxes : 0;
+    JSAMPROW rowsY[16], rowsU[8], rowsV[8];
+    JSAMPARRAY planes[3] = { rowsY, rowsU, rowsV };
+    for (int r = 0; r < 16; ++r) rowsY[r] = bandY + r * paddedW;
+    for (int r = 0; r < 8; ++r) {
+        rowsU[r] = bandU + r * paddedCW;
+        rowsV[r] = bandV + r * paddedCW;
+    }
+
+    for (int row0 = 0; row0 < height; row0 += 16) {
+        // Las filas más allá del final repiten la última
+        const uint8_t* src[4];
+        for (int r = 0; r < 16; ++r) {
+            const int y = std::min(row0 + r, height - 1);
+            if (factor > 1) {
+                sourceRows(src, image.planes[0], image.pitches[0], y, factor, srcH);
+                downscaleRow(rowsY[r], src, factor, srcW, 1, 0, width, paddedW);
+            } else {
+                copyRow(rowsY[r], image.planes[0] + static_cast<size_t>(y) * image.pitches[0], width, paddedW);
+            }
+        }
+        const int crow0 = row0 / 2;
+        for (int r = 0; r < 8; ++r) {
+            const int y = std::min(crow0 + r, chromaH - 1);
+            if (factor > 1) {
+                const bool nv12 = (image.layout == YUV_LAYOUT_NV12);
+                const int step = nv12 ? 2 : 1;
+                sourceRows(src, image.planes[1], image.pitches[1], y, factor, srcCH);
+                downscaleRow(rowsU[r], src, factor, srcCW, step, 0, chromaW, paddedCW);
+                if (!nv12) sourceRows(src, image.planes[2], image.pitches[2], y, factor, srcCH);
+                downscaleRow(rowsV[r], src, factor, srcCW, step, nv12 ? 1 : 0, chromaW, paddedCW);
+            } else if (image.layout == YUV_LAYOUT_NV12) {
+                deinterleaveRow(rowsU[r], rowsV[r], image.planes[1] + static_cast<size_t>(y) * image.pitches[1],
+                                chromaW, paddedCW);
+            } else {
+                copyRow(rowsU[r], image.planes[1] + static_cast<size_t>(y) * image.pitches[1], chromaW, paddedCW);
+                copyRow(rowsV[r], image.planes[2] + static_cast<size_t>(y) * image.pitches[2], chromaW, paddedCW);
+            }
+        }
+        if (color) convertBand(bandY, bandU, bandV, paddedW, paddedCW, *color);
+        if (boxCount > 0) {
+            const float scale = 1.f / factor;
+            drawBoxes(bandY, paddedW, row0, 16, width, height, boxes, boxCount, scale, kBoxThickness, kBoxY);
+            drawBoxes(bandU, paddedCW, crow0, 8, chromaW, chromaH, boxes, boxCount, 0.5f * scale,
+                      kBoxThickness / 2, kBoxCb);
+            drawBoxes(bandV, paddedCW, crow0, 8, chromaW, chromaH, boxes, boxCount, 0.5f * scale,
+                      kBoxThickness / 2, kBoxCr);
+        }
+        jpeg_write_raw_data(&cinfo, planes, 16);
+    }
+    jpeg_finish_compress(&cinfo);
+
+    if (m_impl->dest.overflow) return 0;
+    return capacity - m_impl->dest.pub.free_in_buffer;
+}
+
+//-------------------------------------------------------------------------------
+// Superficies de DeepStream
+//-------------------------------------------------------------------------------
+static bool surfaceLayout(NvBufSurfaceColorFormat format, int &layout, int &colorSpace)
+{
+    switch (format) {
+    case NVBUF_COLOR_FORMAT_NV12:
+    case NVBUF_COLOR_FORMAT_NV12_ER:
+    case NVBUF_COLOR_FORMAT_NV12_709:
+    case NVBUF_COLOR_FORMAT_NV12_709_ER:
+        layout = YUV_LAYOUT_NV12;
+        break;
+    case NVBUF_COLOR_FORMAT_YUV420:
+    case NVBUF_COLOR_FORMAT_YUV420_ER:
+    case NVBUF_COLOR_FORMAT_YUV420_709:
+    case NVBUF_COLOR_FORMAT_YUV420_709_ER:
+        layout = YUV_LAYOUT_I420;
+        break;
+    default:
+        return false;
+    }
+    // Sin sufijo _ER el rango es limitado (16-235), el habitual de los decodificadores
+    const bool full = (format == NVBUF_COLOR_FORMAT_NV12_ER || format == NVBUF_COLOR_FORMAT_NV12_709_ER ||
+                       format == NVBUF_COLOR_FORMAT_YUV420_ER || format == NVBUF_COLOR_FORMAT_YUV420_709_ER);
+    const bool bt709 = (format == NVBUF_COLOR_FORMAT_NV12_709 || format == NVBUF_COLOR_FORMAT_NV12_709_ER ||
+                        format == NVBUF_COLOR_FORMAT_YUV420_709 || format == NVBUF_COLOR_FORMAT_YUV420_709_ER);
+    if (bt709) {
+        colorSpace = full ? YUV_COLOR_BT709_FULL : YUV_COLOR_BT709_LIMITED;
+    } else {
+        colorSpace = full ? YUV_COLOR_BT601_FULL : YUV_COLOR_BT601_LIMITED;
+    }
+    return true;
+}
+
+size_t encodeSurfaceJpeg(GstBuffer* buffer, int batchId, int quality, const float* boxes, int numBoxes,
+                         uint8_t* out, size_t capacity, int downscale)
+{
+    GstMapInfo map;
+    if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+        std::cerr << "ERROR: no se pudo mapear el GstBuffer" << std::endl;
+        return 0;
+    }
+    NvBufSurface* surface = reinterpret_cast<NvBufSurface*>(map.data);
+    if (static_cast<uint32_t>(batchId) >= surface->numFilled) {
+        gst_buffer_unmap(buffer, &map);
+        return 0;
+    }
+    const NvBufSurfaceParams &params = surface->surfaceList[batchId];
+    YuvImage image;
+    if (!surfaceLayout(params.colorFormat, image.layout, image.colorSpace) || params.layout != NVBUF_LAYOUT_PITCH) {
+        std::cerr << "ERROR: la superficie no es YUV 4:2:0 pitch-linear (formato " << params.colorFormat
+                  << "); quitar la conversión a RGBA del pipeline" << std::endl;
+        gst_buffer_unmap(buffer, &map);
+        return 0;
+    }
+    if (NvBufSurfaceMap(surface, batchId, -1, NVBUF_MAP_READ) != 0) {
+        std::cerr << "ERROR: NvBufSurfaceMap falló para el frame " << batchId << std::endl;
+        gst_buffer_unmap(buffer, &map);
+        return 0;
+    }
+    NvBufSurfaceSyncForCpu(surface, batchId, -1);
+
+    const int numPlanes = (image.layout == YUV_LAYOUT_NV12) ? 2 : 3;
+    for (int p = 0; p < 3; ++p) {
+        image.planes[p] = (p < numPlanes) ? static_cast<const uint8_t*>(params.mappedAddr.addr[p]) : nullptr;
+        image.pitches[p] = (p < numPlanes) ? static_cast<int32_t>(params.planeParams.pitch[p]) : 0;
+    }
+    image.width = params.width;
+    image.height = params.height;
+
+    static thread_local YuvJpegEncoder encoder;
+    const size_t size = encoder.encode(image, quality, boxes, numBoxes, out, capacity, downscale);
+    if (size == 0) {
+        std::cerr << "ERROR: el JPEG del frame " << batchId << " no cabe en " << capacity << " bytes" << std::endl;
+    }
+
+    NvBufSurfaceUnMap(surface, batchId, -1);
+    gst_buffer_unmap(buffer, &map);
+    return size;
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" uint64_t RetinaFaceEncodeYuvJpeg(const YuvImage* image, int quality, const float* boxes, int numBoxes,
+                                            uint8_t* out, uint64_t capacity)
+{
+    if (!image || !out) return 0;
+    static thread_local YuvJpegEncoder encoder;
+    return encoder.encode(*image, quality, boxes, numBoxes, out, capacity);
+}
+
+extern "C" int RetinaFaceWriterSaveSurfaceJpeg(void* writer, GstBuffer* buffer, int batchId, const char* path,
+                                               int quality, const float* boxes, int numBoxes)
+{
+    if (!writer || !buffer || !path || batchId < 0) return 0;
+    FrameWriter* w = static_cast<FrameWriter*>(writer);
+
+    // Se codifica directamente en el buffer de staging del escritor
+    uint8_t* staging = w->acquireBuffer();
+    if (!staging) return 0;
+    const size_t size = encodeSurfaceJpeg(buffer, batchId, quality, boxes, numBoxes, staging, w->bufferSize());
+    if (size == 0) {
+        w->releaseBuffer(staging);
+        return 0;
+    }
+    return w->submitFile(staging, size, path) ? 1 : 0;
+}
+
+extern "C" int RetinaFaceWriterSaveSurfaceJpegAdaptive(void* writer, GstBuffer* buffer, int batchId,
+                                                       uint32_t streamId, const char* path, int quality,
+                                                       const float* boxes, int numBoxes)
+{
+    if (!writer || !buffer || !path || batchId < 0) return 0;
+    FrameWriter* w = static_cast<FrameWriter*>(writer);
+
+    int downscale = 1;
+    w->jpegSettings(streamId, quality, downscale);
+
+    uint8_t* staging = w->acquireBuffer();
+    if (!staging) {
+        w->reportJpeg(streamId, 0, true);
+        return 0;
+    }
+    const size_t size = encodeSurfaceJpeg(buffer, batchId, quality, boxes, numBoxes, staging, w->bufferSize(),
+                                          downscale);
+    if (size == 0) {
+        w->releaseBuffer(staging);
+        return 0;
+    }
+    const bool submitted = w->submitFile(staging, size, path);
+    w->reportJpeg(streamId, submitted ? size : 0, !submitted);
+    return submitted ? 1 : 0;
+}
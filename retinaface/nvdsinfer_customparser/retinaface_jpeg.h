@@ -0,0 +1,109 @@
+/******************************************************************************
+ * retinaface_jpeg.h
+ *
+ * Codificación JPEG directa desde superficies NV12/I420 (sin pasar por RGBA)
+ * con dibujo de cajas sobre los planos, escribiendo en los buffers del
+ * FrameWriter
+ ******************************************************************************/
+
+#ifndef RETINAFACE_JPEG_H
+#define RETINAFACE_JPEG_H
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <gst/gst.h>
+
+enum YuvLayout {
+    YUV_LAYOUT_I420 = 0,   /**< Y, U, V en planos separados */
+    YUV_LAYOUT_NV12 = 1    /**< Y y un plano UV entrelazado (planes[1]) */
+};
+
+/**
+ * @brief Rango y matriz de las muestras. JFIF espera BT.601 de rango completo;
+ *        el resto se convierte al copiar cada banda.
+ */
+enum YuvColorSpace {
+    YUV_COLOR_BT601_FULL    = 0,   /**< Formatos _ER de NvBufSurface: se codifica tal cual */
+    YUV_COLOR_BT601_LIMITED = 1,   /**< Y 16-235, Cb/Cr 16-240 (NV12, YUV420) */
+    YUV_COLOR_BT709_FULL    = 2,
+    YUV_COLOR_BT709_LIMITED = 3
+};
+
+/**
+ * @brief Imagen YUV 4:2:0 en memoria de CPU.
+ */
+struct YuvImage {
+    const uint8_t* planes[3];
+    int32_t        pitches[3];
+    int32_t        width;
+    int32_t        height;
+    int32_t        layout;      /**< YuvLayout */
+    int32_t        colorSpace;  /**< YuvColorSpace */
+};
+
+/**
+ * @brief Codificador JPEG 4:2:0 con entrada raw (jpeg_write_raw_data): los
+ *        planos pasan a libjpeg sin conversión a RGB ni resubmuestreo.
+ *        Procesa bandas de 16 filas de luma: cada banda se copia
+ *        (desentrelazando UV si es NV12), se lleva a BT.601 de rango completo
+ *        si hace falta, se le dibujan las cajas y se comprime mientras sigue
+ *        en caché. No es thread-safe; usar uno por hilo.
+ */
+class YuvJpegEncoder {
+public:
+    YuvJpegEncoder();
+    ~YuvJpegEncoder();
+
+    /**
+     * @param boxes     (left, top, width, height) por caja a dibujar, o nullptr.
+     * @param out       Destino del JPEG.
+     * @param downscale Divisor de ancho y alto (1, 2 o 4), con filtro de caja
+     *                  al copiar cada banda; las cajas siguen en coordenadas
+     *                  de la imagen original.
+     * @return Bytes escritos; 0 si falla o no cabe en `capacity`.
+     */
+    size_t encode(const YuvImage &image, int quality, const float* boxes, int numBoxes,
+                  uint8_t* out, size_t capacity, int downscale = 1);
+
+private:
+    YuvJpegEncoder(const YuvJpegEncoder &);
+    YuvJpegEncoder &operator=(const YuvJpegEncoder &);
+
+    struct Impl;
+    Impl*                m_impl;
+    std::vector<uint8_t> m_band;   // 16 filas Y + 8 filas U + 8 filas V
+};
+
+/**
+ * @brief Mapea el frame `batchId` del batch (NvBufSurface NV12/I420 con
+ *        layout pitch) y lo codifica en `out`.
+ *
+ * @return Bytes escritos; 0 si el formato no es YUV 4:2:0, falla el mapeo o
+ *         el JPEG no cabe en `capacity`.
+ */
+size_t encodeSurfaceJpeg(GstBuffer* buffer, int batchId, int quality, const float* boxes, int numBoxes,
+                         uint8_t* out, size_t capacity, int downscale = 1);
+
+extern "C" {
+/** @return Bytes escritos en `out`, 0 si falla. */
+uint64_t RetinaFaceEncodeYuvJpeg(const YuvImage* image, int quality, const float* boxes, int numBoxes,
+                                 uint8_t* out, uint64_t capacity);
+
+/**
+ * @brief encodeSurfaceJpeg() directamente en un buffer del escritor, que se
+ *        entrega para guardarlo en `path`. Devuelve 0 si el pool está agotado
+ *        o la codificación falla.
+ */
+int RetinaFaceWriterSaveSurfaceJpeg(void* writer, GstBuffer* buffer, int batchId, const char* path,
+                                    int quality, const float* boxes, int numBoxes);
+
+/**
+ * @brief Como RetinaFaceWriterSaveSurfaceJpeg() con la calidad y el divisor
+ *        de resolución del control adaptativo del stream (`quality` solo se
+ *        usa si no está activo), al que se informa del tamaño o del descarte.
+ */
+int RetinaFaceWriterSaveSurfaceJpegAdaptive(void* writer, GstBuffer* buffer, int batchId, uint32_t streamId,
+                                            const char* path, int quality, const float* boxes, int numBoxes);
+}
+
+#endif // RETINAFACE_JPEG_H
@@ -0,0 +1,136 @@
+/******************************************************************************
+ * retinaface_meta_export.cpp
+ *
+ * Implementación de la exportación del batch meta. Los landmarks llegan en
+ * mask_params cuando el parser es NvDsInferParseCustomRetinaFaceLandmarks;
+ * la calidad, en misc_obj_info cuando se adjuntó con attachFaceQuality().
+ ******************************************************************************/
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#include "gstnvdsmeta.h"
+#include "nvdsinfer_custom_retinaface.h"
+#include "retinaface_meta_export.h"
+
+static void exportObject(const NvDsObjectMeta* obj, uint32_t frameIndex, const NvDsFrameMeta* frameMeta,
+                         ObjectMetaRecord &rec)
+{
+    const NvOSD_RectParams &r = obj->rect_params;
+    rec.frameIndex = frameIndex;
+    rec.sourceId = frameMeta->source_id;
+    rec.frameNum = frameMeta->frame_num;
+    rec.classId = obj->class_id;
+    rec.objectId = obj->object_id;
+    rec.gieId = obj->unique_component_id;
+    rec.confidence = obj->confidence;
+    rec.box[0] = r.left;
+    rec.box[1] = r.top;
+    rec.box[2] = r.width;
+    rec.box[3] = r.height;
+    rec.parentIndex = -1;
+    rec.parentObjectId = obj->parent ? obj->parent->object_id : UNTRACKED_OBJECT_ID;
+
+    // Landmarks relativos a la caja (ver kLandmarkMaskWidth)
+    const NvOSD_MaskParams &mask = obj->mask_params;
+    rec.hasLandmarks = mask.data && mask.width == kLandmarkMaskWidth && mask.height == kLandmarkMaskHeight;
+    for (int m = 0; m < 5; ++m) {
+        if (rec.hasLandmarks) {
+            rec.landmarks[2 * m + 0] = r.left + mask.data[2 * m + 0] * r.width;
+            rec.landmarks[2 * m + 1] = r.top + mask.data[2 * m + 1] * r.height;
+        } else {
+            rec.landmarks[2 * m + 0] = rec.landmarks[2 * m + 1] = std::numeric_limits<float>::quiet_NaN();
+        }
+    }
+
+    rec.hasQuality = decodeQualityMeta(obj->misc_obj_info[kQualityMiscSlot], rec.quality);
+    if (!rec.hasQuality) rec.quality = std::numeric_limits<float>::quiet_NaN();
+}
+
+int exportBatchMeta(GstBuffer* buffer, int gieId, FrameMetaRecord* frames, int maxFrames, int* numFrames,
+                    ObjectMetaRecord* objects, int maxObjects)
+{
+    *numFrames = 0;
+    NvDsBatchMeta* batchMeta = gst_buffer_get_nvds_batch_meta(buffer);
+    if (!batchMeta) return -1;
+
+    // Objeto -> índice exportado, para resolver los padres dentro del frame
+    std::unordered_map<const NvDsObjectMeta*, int32_t> exported;
+    int found = 0;
+    for (NvDsMetaList* l = batchMeta->frame_meta_list; l != nullptr && *numFrames < maxFrames; l = l->next) {
+        const NvDsFrameMeta* frameMeta = static_cast<const NvDsFrameMeta*>(l->data);
+        const uint32_t frameIndex = static_cast<uint32_t>(*numFrames);
+        FrameMetaRecord &frame = frames[(*numFrames)++];
+        frame.sourceId = frameMeta->source_id;
+        frame.batchId = frameMeta->batch_id;
+        frame.padIndex = frameMeta->pad_index;
+        frame.frameNum = frameMeta->frame_num;
+        frame.bufPts = frameMeta->buf_pts;
+        frame.ntpTimestamp = frameMeta->ntp_timestamp;
+        frame.firstObject = static_cast<uint32_t>(std::min(found, maxObjects));
+        frame.numObjects = 0;
+
+        exported.clear();
+        for (NvDsMetaList* o = frameMeta->obj_meta_list; o != nullptr; o = o->next) {
+            const NvDsObjectMeta* obj = static_cast<const NvDsObjectMeta*>(o->data);
+            if (gieId >= 0 && obj->unique_component_id != gieId) continue;
+            const int idx = found++;
+            if (idx >= maxObjects) continue;
+            exportObject(obj, frameIndex, frameMeta, objects[idx]);
+            exported[obj] = idx;
+            ++frame.numObjects;
+        }
+        // Sin tracker object_id no identifica al padre: se resuelve por puntero
+        if (!exported.empty()) {
+            for (NvDsMetaList* o = frameMeta->obj_meta_list; o != nullptr; o = o->next) {
+                const NvDsObjectMeta* obj = static_cast<const NvDsObjectMeta*>(o->data);
+                if (!obj->parent) continue;
+                std::unordered_map<const NvDsObjectMeta*, int32_t>::const_iterator child = exported.find(obj);
+                std::unordered_map<const NvDsObjectMeta*, int32_t>::const_iterator parent = exported.find(obj->parent);
+                if (child != exported.end() && parent != exported.end()) {
+                    objects[child->second].parentIndex = parent->second;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+int attachFaceQuality(GstBuffer* buffer, uint32_t batchId, int gieId, const FaceQuality* quality, int count)
+{
+    NvDsBatchMeta* batchMeta = gst_buffer_get_nvds_batch_meta(buffer);
+    if (!batchMeta) return -1;
+
+    for (NvDsMetaList* l = batchMeta->frame_meta_list; l != nullptr; l = l->next) {
+        NvDsFrameMeta* frameMeta = static_cast<NvDsFrameMeta*>(l->data);
+        if (frameMeta->batch_id != batchId) continue;
+
+        int written = 0;
+        for (NvDsMetaList* o = frameMeta->obj_meta_list; o != nullptr && written < count; o = o->next) {
+            NvDsObjectMeta* obj = static_cast<NvDsObjectMeta*>(o->data);
+            if (gieId >= 0 && obj->unique_component_id != gieId) continue;
+            obj->misc_obj_info[kQualityMiscSlot] = encodeQualityMeta(quality[written].score);
+            ++written;
+        }
+        return written;
+    }
+    return 0;
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" int RetinaFaceAttachQuality(GstBuffer* buffer, uint32_t batchId, int gieId, const FaceQuality* quality,
+                                       int count)
+{
+    if (!buffer || (!quality && count > 0)) return -1;
+    return attachFaceQuality(buffer, batchId, gieId, quality, count);
+}
+
+extern "C" int RetinaFaceExportBatchMeta(GstBuffer* buffer, int gieId, FrameMetaRecord* frames, int maxFrames,
+                                         int* numFrames, ObjectMetaRecord* objects, int maxObjects)
+{
+    if (!buffer || !frames || !numFrames || maxFrames <= 0 || (!objects && maxObjects > 0)) return -1;
+    return exportBatchMeta(buffer, gieId, frames, maxFrames, numFrames, objects, maxObjects);
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+ * retinaface_meta_export.h
+ *
+ * Exportación del batch meta de un GstBuffer a arrays planos (registros por
+ * frame y por objeto) en una sola llamada, para consumirlos desde NumPy, y
+ * escritura de la calidad por rostro en el meta de cada objeto
+ ******************************************************************************/
+
+#ifndef RETINAFACE_META_EXPORT_H
+#define RETINAFACE_META_EXPORT_H
+#include <stdint.h>
+#include <gst/gst.h>
+#include "retinaface_quality.h"
+
+/**
+ * @brief Un frame del batch.
+ */
+struct FrameMetaRecord {
+    uint32_t sourceId;
+    uint32_t batchId;       /**< Índice para get_nvds_buf_surface() */
+    uint32_t padIndex;
+    int32_t  frameNum;
+    uint64_t bufPts;
+    uint64_t ntpTimestamp;
+    uint32_t numObjects;    /**< Objetos exportados de este frame */
+    uint32_t firstObject;   /**< Índice del primero en el array de objetos */
+};
+
+/**
+ * @brief Un objeto del batch. Los objetos de un frame son contiguos.
+ */
+struct ObjectMetaRecord {
+    uint32_t frameIndex;      /**< Índice en el array de frames */
+    uint32_t sourceId;
+    int32_t  frameNum;
+    int32_t  classId;
+    uint64_t objectId;        /**< Id del tracker (UNTRACKED_OBJECT_ID sin tracker) */
+    int32_t  gieId;           /**< unique_component_id */
+    float    confidence;
+    float    box[4];          /**< left, top, width, height en coordenadas de frame */
+    float    landmarks[10];   /**< x0, y0, ..., x4, y4 en coordenadas de frame; NaN si no hay */
+    int32_t  parentIndex;     /**< Índice del padre si también se exportó, o -1 */
+    int32_t  hasLandmarks;
+    uint64_t parentObjectId;  /**< object_id del padre, o UNTRACKED_OBJECT_ID */
+    float    quality;         /**< FaceQuality.score adjunto con attachFaceQuality(); NaN si no hay */
+    int32_t  hasQuality;
+};
+
+/**
+ * @brief Recorre el batch meta una vez y rellena los arrays del llamador.
+ *
+ * @param gieId       Solo objetos de este unique_component_id (-1: todos).
+ * @param numFrames   Salida: frames escritos (como mucho maxFrames).
+ *
+ * @return Objetos encontrados en los frames escritos. Si supera maxObjects,
+ *         solo se escribieron los primeros maxObjects (ampliar y repetir),
+ *         -1 si el buffer no tiene batch meta.
+ */
+int exportBatchMeta(GstBuffer* buffer, int gieId, FrameMetaRecord* frames, int maxFrames, int* numFrames,
+                    ObjectMetaRecord* objects, int maxObjects);
+
+/**
+ * @brief Adjunta FaceQuality.score a los objetos del frame `batchId` en
+ *        misc_obj_info[kQualityMiscSlot]. quality[i] corresponde al i-ésimo
+ *        objeto del frame que pasa el filtro gieId, el mismo orden en que los
+ *        exporta exportBatchMeta(). Los rostros que no pasaron los filtros
+ *        baratos llevan score 0.
+ *
+ * @return Objetos escritos, o -1 si el buffer no tiene batch meta.
+ */
+int attachFaceQuality(GstBuffer* buffer, uint32_t batchId, int gieId, const FaceQuality* quality, int count);
+
+extern "C" {
+int RetinaFaceAttachQuality(GstBuffer* buffer, uint32_t batchId, int gieId, const FaceQuality* quality,
+                            int count);
+int RetinaFaceExportBatchMeta(GstBuffer* buffer, int gieId, FrameMetaRecord* frames, int maxFrames,
+                              int* numFrames, ObjectMetaRecord* objects, int maxObjects);
+}
+
+#endif // RETINAFACE_META_EXPORT_H
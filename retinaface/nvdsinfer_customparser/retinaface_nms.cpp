@@ -0,0 +1,261 @@
+/******************************************************************************
+ * retinaface_nms.cpp
+ *
+ * Las coordenadas cuantizadas quedan en [0, 32767], así que mínimos, máximos
+ * y restas caben en int16; solo el producto ancho x alto pasa a int32 y la
+ * comparación con el umbral se hace en float con la misma secuencia de
+ * operaciones en todos los caminos, de modo que SIMD y escalar deciden igual:
+ *
+ *     inter * (1 + threshold) > (areaA + areaB) * threshold
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__AVX512BW__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "retinaface_nms.h"
+
+static const float kQuantMax = 32767.f;
+
+namespace {
+std::atomic<uint64_t> g_units(0);
+std::atomic<uint64_t> g_differing(0);
+std::atomic<uint64_t> g_outOfBand(0);
+
+struct QuantizedBoxes {
+    std::vector<int16_t> x1, y1, x2, y2;
+    std::vector<float>   area;
+};
+
+void quantize(const RetinaFaceDetectionBatch &dets, const std::vector<int> &order, QuantizedBoxes &q)
+{
+    const int n = static_cast<int>(order.size());
+    float minX = dets.x1[order[0]], maxX = dets.x2[order[0]];
+    float minY = dets.y1[order[0]], maxY = dets.y2[order[0]];
+    for (int i = 1; i < n; ++i) {
+        const int d = order[i];
+        minX = std::min(minX, dets.x1[d]);
+        maxX = std::max(maxX, dets.x2[d]);
+        minY = std::min(minY, dets.y1[d]);
+        maxY = std::max(maxY, dets.y2[d]);
+    }
+    // La IoU no cambia con una escala distinta por eje
+    const float sx = maxX > minX ? kQuantMax / (maxX - minX) : 1.f;
+    const float sy = maxY > minY ? kQuantMax / (maxY - minY) : 1.f;
+
+    q.x1.resize(n);
+    q.y1.resize(n);
+    q.x2.resize(n);
+    q.y2.resize(n);
+    q.area.resize(n);
+    for (int i = 0; i < n; ++i) {
+        const int d = order[i];
+        const float ox1 = std::min(kQuantMax, std::max(0.f, (dets.x1[d] - minX) * sx));
+        const float oy1 = std::min(kQuantMax, std::max(0.f, (dets.y1[d] - minY) * sy));
+        const float ox2 = std::min(kQuantMax, std::max(0.f, (dets.x2[d] - minX) * sx));
+        const float oy2 = std::min(kQuantMax, std::max(0.f, (dets.y2[d] - minY) * sy));
+        q.x1[i] = static_cast<int16_t>(std::lrint(ox1));
+        q.y1[i] = static_cast<int16_t>(std::lrint(oy1));
+        q.x2[i] = static_cast<int16_t>(std::lrint(ox2));
+        q.y2[i] = static_cast<int16_t>(std::lrint(oy2));
+        const int32_t w = std::max(0, q.x2[i] - q.x1[i]);
+        const int32_t h = std::max(0, q.y2[i] - q.y1[i]);
+        q.area[i] = static_cast<float>(w * h);
+    }
+}
+
+inline bool suppressScalar(const QuantizedBoxes &q, int a, int b, float k1, float threshold)
+{
+    const int32_t w = std::max(0, std::min(q.x2[a], q.x2[b]) - std::max(q.x1[a], q.x1[b]));
+    const int32_t h = std::max(0, std::min(q.y2[a], q.y2[b]) - std::max(q.y1[a], q.y1[b]));
+    const float inter = static_cast<float>(w * h);
+    return inter * k1 > (q.area[a] + q.area[b]) * threshold;
+}
+
+// Marca en `suppressed` las cajas j en [begin, n) que la caja a suprime
+void suppressFrom(const QuantizedBoxes &q, int a, int begin, int n, float threshold, std::vector<char> &suppressed)
+{
+    const float k1 = 1.f + threshold;
+    int j = begin;
+#if defined(__AVX512BW__)
+    const __m512i vax1 = _mm512_set1_epi16(q.x1[a]), vay1 = _mm512_set1_epi16(q.y1[a]);
+    const __m512i vax2 = _mm512_set1_epi16(q.x2[a]), vay2 = _mm512_set1_epi16(q.y2[a]);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512 vAreaA = _mm512_set1_ps(q.area[a]), vK1 = _mm512_set1_ps(k1), vThr = _mm512_set1_ps(threshold);
+    for (; j + 32 <= n; j += 32) {
+        const __m512i w = _mm512_max_epi16(zero, _mm512_sub_epi16(
+            _mm512_min_epi16(vax2, _mm512_loadu_si512(&q.x2[j])), _mm512_max_epi16(vax1, _mm512_loadu_si512(&q.x1[j]))));
+        const __m512i h = _mm512_max_epi16(zero, _mm512_sub_epi16(
+            _mm512_min_epi16(vay2, _mm512_loadu_si512(&q.y2[j])), _mm512_max_epi16(vay1, _mm512_loadu_si512(&q.y1[j]))));
+        // Ancho x alto no cabe en int16: se ensancha a int32 en dos mitades de
+        // 16 carriles. Variantes maskz (fuente cero) porque las normales de GCC
+        // parten de un vector sin inicializar (-Wmaybe-uninitialized con -O3)
+        uint32_t mask = 0;
+        for (int half = 0; half < 2; ++half) {
+            const __m256i wHalf = half ? _mm512_maskz_extracti64x4_epi64(0xFF, w, 1)
+                                       : _mm512_maskz_extracti64x4_epi64(0xFF, w, 0);
+            const __m256i hHalf = half ? _mm512_maskz_extracti64x4_epi64(0xFF, h, 1)
+                                       : _mm512_maskz_extracti64x4_epi64(0xFF, h, 0);
+            const __m512i w32 = _mm512_maskz_cvtepi16_epi32(0xFFFF, wHalf);
+            const __m512i h32 = _mm512_maskz_cvtepi16_epi32(0xFFFF, hHalf);
+            const __m512 inter = _mm512_maskz_cvtepi32_ps(0xFFFF, _mm512_mullo_epi32(w32, h32));
+            const __m512 sum = _mm512_add_ps(vAreaA, _mm512_loadu_ps(&q.area[j + 16 * half]));
+            const __mmask16 gt = _mm512_cmp_ps_mask(_mm512_mul_ps(inter, vK1), _mm512_mul_ps(sum, vThr), _CMP_GT_OQ);
+            mask |= static_cast<uint32_t>(gt) << (16 * half);
+        }
+        for (; mask; mask &= mask - 1) suppressed[j + __builtin_ctz(mask)] = 1;
+    }
+#elif defined(__AVX2__)
+    const __m256i vax1 = _mm256_set1_epi16(q.x1[a]), vay1 = _mm256_set1_epi16(q.y1[a]);
+    const __m256i vax2 = _mm256_set1_epi16(q.x2[a]), vay2 = _mm256_set1_epi16(q.y2[a]);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256 vAreaA = _mm256_set1_ps(q.area[a]), vK1 = _mm256_set1_ps(k1), vThr = _mm256_set1_ps(threshold);
+    for (; j + 16 <= n; j += 16) {
+        const __m256i bx1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&q.x1[j]));
+        const __m256i by1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&q.y1[j]));
+        const __m256i bx2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&q.x2[j]));
+        const __m256i by2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&q.y2[j]));
+        const __m256i w = _mm256_max_epi16(zero, _mm256_sub_epi16(_mm256_min_epi16(vax2, bx2), _mm256_max_epi16(vax1, bx1)));
+        const __m256i h = _mm256_max_epi16(zero, _mm256_sub_epi16(_mm256_min_epi16(vay2, by2), _mm256_max_epi16(vay1, by1)));
+        uint32_t mask = 0;
+        for (int half = 0; half < 2; ++half) {
+            const __m256i w32 = _mm256_cvtepi16_epi32(half ? _mm256_extracti128_si256(w, 1) : _mm256_castsi256_si128(w));
+            const __m256i h32 = _mm256_cvtepi16_epi32(half ? _mm256_extracti128_si256(h, 1) : _mm256_castsi256_si128(h));
+            const __m256 inter = _mm256_cvtepi32_ps(_mm256_mullo_epi32(w32, h32));
+            const __m256 sum = _mm256_add_ps(vAreaA, _mm256_loadu_ps(&q.area[j + 8 * half]));
+            const __m256 gt = _mm256_cmp_ps(_mm256_mul_ps(inter, vK1), _mm256_mul_ps(sum, vThr), _CMP_GT_OQ);
+            mask |= static_cast<uint32_t>(_mm256_movemask_ps(gt)) << (8 * half);
+        }
+        for (; mask; mask &= mask - 1) suppressed[j + __builtin_ctz(mask)] = 1;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const int16x8_t vax1 = vdupq_n_s16(q.x1[a]), vay1 = vdupq_n_s16(q.y1[a]);
+    const int16x8_t vax2 = vdupq_n_s16(q.x2[a]), vay2 = vdupq_n_s16(q.y2[a]);
+    const int16x8_t zero = vdupq_n_s16(0);
+    const float32x4_t vAreaA = vdupq_n_f32(q.area[a]), vK1 = vdupq_n_f32(k1), vThr = vdupq_n_f32(threshold);
+    for (; j + 8 <= n; j += 8) {
+        const int16x8_t w = vmaxq_s16(zero, vsubq_s16(vminq_s16(vax2, vld1q_s16(&q.x2[j])), vmaxq_s16(vax1, vld1q_s16(&q.x1[j]))));
+        const int16x8_t h = vmaxq_s16(zero, vsubq_s16(vminq_s16(vay2, vld1q_s16(&q.y2[j])), vmaxq_s16(vay1, vld1q_s16(&q.y1[j]))));
+        const float32x4_t interLo = vcvtq_f32_s32(vmull_s16(vget_low_s16(w), vget_low_s16(h)));
+        const float32x4_t interHi = vcvtq_f32_s32(vmull_high_s16(w, h));
+        const float32x4_t sumLo = vaddq_f32(vAreaA, vld1q_f32(&q.area[j]));
+        const float32x4_t sumHi = vaddq_f32(vAreaA, vld1q_f32(&q.area[j + 4]));
+        const uint32x4_t gtLo = vcgtq_f32(vmulq_f32(interLo, vK1), vmulq_f32(sumLo, vThr));
+        const uint32x4_t gtHi = vcgtq_f32(vmulq_f32(interHi, vK1), vmulq_f32(sumHi, vThr));
+        const uint8x8_t gt = vmovn_u16(vcombine_u16(vmovn_u32(gtLo), vmovn_u32(gtHi)));
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(gt), 0);
+        for (; mask; mask &= mask - 1) suppressed[j + (__builtin_ctzll(mask) >> 3)] = 1;
+    }
+#endif
+    for (; j < n; ++j) {
+        if (suppressScalar(q, a, j, k1, threshold)) suppressed[j] = 1;
+    }
+}
+
+inline float floatIoU(const RetinaFaceDetectionBatch &dets, int a, int b)
+{
+    const float areaA = (dets.x2[a] - dets.x1[a]) * (dets.y2[a] - dets.y1[a]);
+    const float areaB = (dets.x2[b] - dets.x1[b]) * (dets.y2[b] - dets.y1[b]);
+    const float w = std::max(0.0f, std::min(dets.x2[a], dets.x2[b]) - std::max(dets.x1[a], dets.x1[b]));
+    const float h = std::max(0.0f, std::min(dets.y2[a], dets.y2[b]) - std::max(dets.y1[a], dets.y1[b]));
+    const float intersection = w * h;
+    return intersection / (areaA + areaB - intersection);
+}
+} // namespace
+
+//-------------------------------------------------------------------------------
+// Kernel
+//-------------------------------------------------------------------------------
+int nmsInt16Lanes()
+{
+#if defined(__AVX512BW__)
+    return 32;
+#elif defined(__AVX2__)
+    return 16;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return 8;
+#else
+    return 1;
+#endif
+}
+
+void nmsInt16(const RetinaFaceDetectionBatch &dets, const std::vector<int> &order, float threshold,
+              std::vector<int> &keep)
+{
+    keep.clear();
+    const int n = static_cast<int>(order.size());
+    if (n == 0) return;
+
+    static thread_local QuantizedBoxes q;
+    static thread_local std::vector<char> suppressed;
+    quantize(dets, order, q);
+    suppressed.assign(n, 0);
+
+    for (int i = 0; i < n; ++i) {
+        if (suppressed[i]) continue;
+        keep.push_back(order[i]);
+        suppressFrom(q, i, i + 1, n, threshold, suppressed);
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Verificación
+//-------------------------------------------------------------------------------
+int verifyNmsDecisions(const RetinaFaceDetectionBatch &dets, const std::vector<int> &order, float threshold,
+                       const std::vector<int> &keep, float band)
+{
+    static thread_local std::vector<char> kept;
+    static thread_local std::vector<int> keptBefore;
+    kept.assign(dets.count, 0);
+    for (size_t k = 0; k < keep.size(); ++k) kept[keep[k]] = 1;
+
+    int outOfBand = 0;
+    keptBefore.clear();
+    for (size_t i = 0; i < order.size(); ++i) {
+        const int d = order[i];
+        float maxIoU = 0.f;
+        for (size_t k = 0; k < keptBefore.size(); ++k) {
+            maxIoU = std::max(maxIoU, floatIoU(dets, keptBefore[k], d));
+        }
+        if (kept[d]) {
+            if (maxIoU > threshold + band) ++outOfBand;
+            keptBefore.push_back(d);
+        } else if (!(maxIoU > threshold - band)) {
+            ++outOfBand;
+        }
+    }
+    return outOfBand;
+}
+
+void recordNmsVerification(bool differs, int outOfBand)
+{
+    ++g_units;
+    if (differs) ++g_differing;
+    g_outOfBand += static_cast<uint64_t>(std::max(outOfBand, 0));
+}
+
+void getNmsVerifyStats(NmsVerifyStats &stats)
+{
+    stats.units = g_units.load();
+    stats.differingUnits = g_differing.load();
+    stats.outOfBand = g_outOfBand.load();
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" int RetinaFaceNmsInt16Lanes()
+{
+    return nmsInt16Lanes();
+}
+
+extern "C" void RetinaFaceNmsVerifyStats(NmsVerifyStats* stats)
+{
+    if (stats) getNmsVerifyStats(*stats);
+}
@@ -0,0 +1,66 @@
+/******************************************************************************
+ * retinaface_nms.h
+ *
+ * NMS greedy con las cajas cuantizadas a int16: mínimos, máximos y restas
+ * de la intersección van en SIMD entero de 16 bits (32 carriles AVX-512BW,
+ * 16 AVX2, 8 NEON); el producto ancho x alto y la comparación del IoU se
+ * ensanchan a 32 bits (16, 8 y 4 carriles). Verificación opcional contra el
+ * kernel float
+ ******************************************************************************/
+
+#ifndef RETINAFACE_NMS_H
+#define RETINAFACE_NMS_H
+#include <stdint.h>
+#include <vector>
+
+#include "nvdsinfer_custom_retinaface.h"
+
+/**
+ * @brief Margen de IoU alrededor del umbral dentro del cual una decisión del
+ *        kernel int16 puede diferir de la del float por la cuantización.
+ */
+static const float kNmsVerifyBand = 0.01f;
+
+struct NmsVerifyStats {
+    uint64_t units;             /**< Unidades verificadas */
+    uint64_t differingUnits;    /**< Con conjunto de supervivientes distinto al del float */
+    uint64_t outOfBand;         /**< Decisiones que ni con el umbral +- kNmsVerifyBand cuadran */
+};
+
+/**
+ * @brief Carriles int16 del kernel compilado (min/max/resta): 32, 16, 8 o 1
+ *        (escalar). La etapa de área e IoU va a la mitad.
+ */
+int nmsInt16Lanes();
+
+/**
+ * @brief NMS greedy sobre `order` (índices en dets por confianza
+ *        descendente). Cuantiza las cajas una vez a int16 por eje, con origen
+ *        en la mínima y la escala que lleva el rango a 32767, así que la
+ *        resolución es de una fracción de píxel con entradas de red hasta
+ *        4K. La suposición es IoU > threshold, como en el kernel float.
+ */
+void nmsInt16(const RetinaFaceDetectionBatch &dets, const std::vector<int> &order, float threshold,
+              std::vector<int> &keep);
+
+/**
+ * @brief Comprueba con IoU float cada decisión de un resultado de NMS: una
+ *        caja conservada no puede solapar más de threshold + band con una
+ *        conservada anterior y una suprimida tiene que solapar más de
+ *        threshold - band con alguna.
+ *
+ * @return Decisiones fuera de la banda (0: resultado válido).
+ */
+int verifyNmsDecisions(const RetinaFaceDetectionBatch &dets, const std::vector<int> &order, float threshold,
+                       const std::vector<int> &keep, float band);
+
+/** @brief Acumula el resultado de una verificación (nms-verify=1). */
+void recordNmsVerification(bool differs, int outOfBand);
+void getNmsVerifyStats(NmsVerifyStats &stats);
+
+extern "C" {
+int  RetinaFaceNmsInt16Lanes();
+void RetinaFaceNmsVerifyStats(NmsVerifyStats* stats);
+}
+
+#endif // RETINAFACE_NMS_H
@@ -0,0 +1,504 @@
+/******************************************************************************
+ * retinaface_parser_config.cpp
+ *
+ * Publicación estilo RCU con reclamación por épocas: la instantánea vigente
+ * es un std::atomic<const ParserConfig*> que los lectores (hilos de nvinfer)
+ * cargan sin locks. Cada hilo lector tiene un slot donde anuncia la época
+ * global al entrar y 0 al salir. El escritor publica una copia nueva con un
+ * exchange, avanza la época y guarda la anterior como retirada en esa época;
+ * se libera cuando ningún slot anuncia una época anterior, por mucho que
+ * tarde el lector. Las publicaciones se serializan con un mutex que los
+ * lectores nunca tocan.
+ ******************************************************************************/
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "retinaface_parser_config.h"
+
+namespace {
+ParserConfig makeDefault()
+{
+    ParserConfig config;
+    defaultParserConfig(config);
+    return config;
+}
+
+// Slot de un hilo lector; los slots no se liberan nunca, se reutilizan
+struct ReaderSlot {
+    std::atomic<uint64_t> epoch;   // Época anunciada; 0 fuera de lectura
+    std::atomic<bool>     used;
+    ReaderSlot*           next;
+};
+
+ReaderSlot* acquireReaderSlot();
+
+// Slot del hilo; solo el hilo dueño escribe su época
+struct ReaderHandle {
+    ReaderSlot* slot;
+    int         depth;   // Instantáneas anidadas del hilo
+
+    ReaderHandle() : slot(acquireReaderSlot()), depth(0) {}
+    ~ReaderHandle()
+    {
+        slot->epoch.store(0);
+        slot->used.store(false);
+    }
+};
+
+struct RetiredConfig {
+    const ParserConfig* config;
+    uint64_t            epoch;   // Época en la que dejó de ser la vigente
+};
+
+std::atomic<const ParserConfig*>   g_current(new ParserConfig(makeDefault()));
+std::atomic<uint64_t>              g_epoch(1);
+std::atomic<ReaderSlot*>           g_readers(nullptr);
+thread_local ReaderHandle          t_reader;
+std::atomic<uint64_t>              g_failures(0);
+std::mutex                         g_publishMutex;
+std::vector<RetiredConfig>         g_retired;      // Bajo g_publishMutex
+uint32_t                           g_version = 0;
+ParserConfig                       g_previous = makeDefault();
+bool                               g_hasPrevious = false;
+
+ReaderSlot* acquireReaderSlot()
+{
+    // Reutiliza el slot de un hilo que ya terminó
+    for (ReaderSlot* slot = g_readers.load(); slot; slot = slot->next) {
+        bool expected = false;
+        if (slot->used.compare_exchange_strong(expected, true)) return slot;
+    }
+    ReaderSlot* slot = new ReaderSlot;
+    slot->epoch.store(0);
+    slot->used.store(true);
+    slot->next = g_readers.load();
+    while (!g_readers.compare_exchange_weak(slot->next, slot)) {}
+    return slot;
+}
+
+// Libera las retiradas que ningún lector puede estar usando. Con g_publishMutex
+void reclaimRetired()
+{
+    uint64_t oldest = UINT64_MAX;
+    for (ReaderSlot* slot = g_readers.load(); slot; slot = slot->next) {
+        const uint64_t epoch = slot->epoch.load();
+        if (epoch != 0 && epoch < oldest) oldest = epoch;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < g_retired.size(); ++i) {
+        // Un lector que anunció una época >= la del retiro ya cargó la nueva
+        if (g_retired[i].epoch <= oldest) {
+            delete g_retired[i].config;
+        } else {
+            g_retired[kept++] = g_retired[i];
+        }
+    }
+    g_retired.resize(kept);
+}
+
+// Vigilancia del archivo
+struct Watcher {
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable wake;
+    bool                    stop;
+    std::string             path;
+    int                     pollMs;
+
+    Watcher() : stop(false), pollMs(500) {}
+    ~Watcher() { halt(); }
+
+    void halt()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        if (thread.joinable()) thread.join();
+    }
+};
+
+Watcher          g_watcher;
+std::mutex       g_watchMutex;   // Serializa watch/stop
+std::once_flag   g_envOnce;
+} // namespace
+
+//-------------------------------------------------------------------------------
+// Texto -> configuración
+//-------------------------------------------------------------------------------
+void defaultParserConfig(ParserConfig &config)
+{
+    std::memset(&config, 0, sizeof(config));
+    config.confThreshold = 0.5f;
+    config.nmsThreshold = 0.5f;
+    config.nmsMode = PARSER_NMS_HARD;
+    config.softNmsSigma = 0.5f;
+    config.preNmsTopK = 0;
+    config.topK = 0;
+    config.minFaceSize = 0.f;
+    config.numRois = 0;
+    config.logDetections = 1;
+    config.decodeThreads = 0;
+    config.parallelMinAnchors = 50000;
+    config.nmsKernel = PARSER_NMS_KERNEL_FLOAT;
+    config.nmsVerify = 0;
+    config.bestFace = PARSER_BEST_FACE_OFF;
+    config.version = 0;
+}
+
+static std::string trim(const std::string &s)
+{
+    const size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) return std::string();
+    const size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+static bool toFloat(const std::string &v, float &out)
+{
+    char* end = nullptr;
+    errno = 0;
+    const float f = std::strtof(v.c_str(), &end);
+    if (v.empty() || errno != 0 || *end != '\0') return false;
+    out = f;
+    return true;
+}
+
+static bool toInt(const std::string &v, int32_t &out)
+{
+    char* end = nullptr;
+    errno = 0;
+    const long i = std::strtol(v.c_str(), &end, 10);
+    if (v.empty() || errno != 0 || *end != '\0') return false;
+    out = static_cast<int32_t>(i);
+    return true;
+}
+
+bool validateParserConfig(const ParserConfig &c, std::string &error)
+{
+    if (!(c.confThreshold >= 0.f && c.confThreshold <= 1.f)) {
+        error = "conf-threshold fuera de [0, 1]";
+    } else if (!(c.nmsThreshold > 0.f && c.nmsThreshold <= 1.f)) {
+        error = "nms-threshold fuera de (0, 1]";
+    } else if (c.nmsMode < PARSER_NMS_HARD || c.nmsMode > PARSER_NMS_NONE) {
+        error = "nms-mode inválido";
+    } else if (!(c.softNmsSigma > 0.f)) {
+        error = "soft-nms-sigma debe ser > 0";
+    } else if (c.preNmsTopK < 0 || c.topK < 0) {
+        error = "pre-nms-top-k y top-k deben ser >= 0";
+    } else if (!(c.minFaceSize >= 0.f)) {
+        error = "min-face-size debe ser >= 0";
+    } else if (c.decodeThreads < 0 || c.decodeThreads > 64 || c.parallelMinAnchors < 0) {
+        error = "decode-threads fuera de [0, 64] o parallel-min-anchors < 0";
+    } else if (c.nmsKernel < PARSER_NMS_KERNEL_FLOAT || c.nmsKernel > PARSER_NMS_KERNEL_INT16) {
+        error = "nms-kernel inválido";
+    } else if (c.bestFace < PARSER_BEST_FACE_OFF || c.bestFace > PARSER_BEST_FACE_LARGEST) {
+        error = "best-face inválido";
+    } else if (c.numRois < 0 || c.numRois > kMaxParserRois) {
+        error = "demasiadas roi";
+    } else {
+        for (int r = 0; r < c.numRois; ++r) {
+            const float* roi = c.rois[r];
+            if (!(roi[0] >= 0.f && roi[1] >= 0.f && roi[2] <= 1.f && roi[3] <= 1.f && roi[0] < roi[2] &&
+                  roi[1] < roi[3])) {
+                error = "roi " + std::to_string(r) + " no cumple 0 <= x1 < x2 <= 1, 0 <= y1 < y2 <= 1";
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool parseParserConfig(const std::string &text, ParserConfig &config, std::string &error)
+{
+    defaultParserConfig(config);
+    std::istringstream in(text);
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+        ++lineNo;
+        const size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        line = trim(line);
+        if (line.empty() || line[0] == '[') continue;   // Se admite una cabecera [property]
+
+        const size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            error = "línea " + std::to_string(lineNo) + ": falta '='";
+            return false;
+        }
+        const std::string key = trim(line.substr(0, eq));
+        const std::string value = trim(line.substr(eq + 1));
+        bool ok = true;
+        if (key == "conf-threshold") {
+            ok = toFloat(value, config.confThreshold);
+        } else if (key == "nms-threshold") {
+            ok = toFloat(value, config.nmsThreshold);
+        } else if (key == "nms-mode") {
+            if (value == "hard") {
+                config.nmsMode = PARSER_NMS_HARD;
+            } else if (value == "soft") {
+                config.nmsMode = PARSER_NMS_SOFT;
+            } else if (value == "none") {
+                config.nmsMode = PARSER_NMS_NONE;
+            } else {
+                ok = false;
+            }
+        } else if (key == "soft-nms-sigma") {
+            ok = toFloat(value, config.softNmsSigma);
+        } else if (key == "pre-nms-top-k") {
+            ok = toInt(value, config.preNmsTopK);
+        } else if (key == "top-k") {
+            ok = toInt(value, config.topK);
+        } else if (key == "min-face-size") {
+            ok = toFloat(value, config.minFaceSize);
+        } else if (key == "log-detections") {
+            ok = toInt(value, config.logDetections);
+        } else if (key == "decode-threads") {
+            ok = toInt(value, config.decodeThreads);
+        } else if (key == "parallel-min-anchors") {
+            ok = toInt(value, config.parallelMinAnchors);
+        } else if (key == "nms-kernel") {
+            if (value == "float") {
+                config.nmsKernel = PARSER_NMS_KERNEL_FLOAT;
+            } else if (value == "int16") {
+                config.nmsKernel = PARSER_NMS_KERNEL_INT16;
+            } else {
+                ok = false;
+            }
+        } else if (key == "nms-verify") {
+            ok = toInt(value, config.nmsVerify);
+        } else if (key == "best-face") {
+            if (value == "off") {
+                config.bestFace = PARSER_BEST_FACE_OFF;
+            } else if (value == "score") {
+                config.bestFace = PARSER_BEST_FACE_SCORE;
+            } else if (value == "largest") {
+                config.bestFace = PARSER_BEST_FACE_LARGEST;
+            } else {
+                ok = false;
+            }
+        } else if (key == "roi") {
+            if (config.numRois >= kMaxParserRois) {
+                error = "línea " + std::to_string(lineNo) + ": más de " + std::to_string(kMaxParserRois) + " roi";
+                return false;
+            }
+            std::istringstream parts(value);
+            std::string part;
+            int n = 0;
+            while (ok && std::getline(parts, part, ',')) {
+                ok = n < 4 && toFloat(trim(part), config.rois[config.numRois][n]);
+                ++n;
+            }
+            ok = ok && n == 4;
+            if (ok) ++config.numRois;
+        } else {
+            error = "línea " + std::to_string(lineNo) + ": clave desconocida '" + key + "'";
+            return false;
+        }
+        if (!ok) {
+            error = "línea " + std::to_string(lineNo) + ": valor inválido para " + key + ": '" + value + "'";
+            return false;
+        }
+    }
+    return validateParserConfig(config, error);
+}
+
+//-------------------------------------------------------------------------------
+// Publicación
+//-------------------------------------------------------------------------------
+ParserConfigSnapshot::ParserConfigSnapshot()
+{
+    std::call_once(g_envOnce, []() {
+        const char* path = std::getenv(kParserConfigEnv);
+        if (path && *path) watchParserConfig(path, 500);
+    });
+    // Se anuncia la época antes de cargar el puntero (ambos seq_cst): si la
+    // carga devuelve una instantánea ya retirada, su época de retiro es
+    // posterior a la anunciada y el escritor no la libera
+    ReaderHandle &reader = t_reader;
+    if (reader.depth++ == 0) reader.slot->epoch.store(g_epoch.load());
+    m_config = g_current.load();
+}
+
+ParserConfigSnapshot::~ParserConfigSnapshot()
+{
+    ReaderHandle &reader = t_reader;
+    if (--reader.depth == 0) reader.slot->epoch.store(0);
+}
+
+bool publishParserConfig(const ParserConfig &config)
+{
+    std::string error;
+    if (!validateParserConfig(config, error)) {
+        std::cerr << "ERROR: configuración del parser rechazada: " << error << std::endl;
+        ++g_failures;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_publishMutex);
+    ParserConfig* next = new ParserConfig(config);
+    next->version = ++g_version;
+    const ParserConfig* old = g_current.exchange(next);
+    g_previous = *old;
+    g_hasPrevious = true;
+    // La anterior sigue viva mientras algún lector anuncie una época previa
+    RetiredConfig retired;
+    retired.config = old;
+    retired.epoch  = g_epoch.fetch_add(1) + 1;
+    g_retired.push_back(retired);
+    reclaimRetired();
+
+    std::cout << "Parser config v" << next->version << ": conf=" << next->confThreshold
+              << " nms=" << next->nmsThreshold << " mode=" << next->nmsMode << " top-k=" << next->topK
+              << " rois=" << next->numRois << " best-face=" << next->bestFace << std::endl;
+    return true;
+}
+
+bool loadParserConfig(const char* path)
+{
+    if (!path) return false;
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "ERROR: no se pudo leer la configuración del parser " << path << std::endl;
+        ++g_failures;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+
+    ParserConfig config;
+    std::string error;
+    if (!parseParserConfig(text.str(), config, error)) {
+        // Rollback implícito: la instantánea vigente sigue publicada
+        std::cerr << "ERROR: " << path << ": " << error << "; se mantiene la configuración v"
+                  << ParserConfigSnapshot()->version << std::endl;
+        ++g_failures;
+        return false;
+    }
+    return publishParserConfig(config);
+}
+
+bool rollbackParserConfig()
+{
+    ParserConfig previous;
+    {
+        std::lock_guard<std::mutex> lock(g_publishMutex);
+        if (!g_hasPrevious) return false;
+        previous = g_previous;
+    }
+    return publishParserConfig(previous);
+}
+
+//-------------------------------------------------------------------------------
+// Vigilancia
+//-------------------------------------------------------------------------------
+static bool fileStamp(const std::string &path, struct stat &st)
+{
+    return ::stat(path.c_str(), &st) == 0;
+}
+
+static bool sameStamp(const struct stat &a, const struct stat &b)
+{
+    return a.st_ino == b.st_ino && a.st_size == b.st_size && a.st_mtim.tv_sec == b.st_mtim.tv_sec &&
+           a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+static void watchLoop()
+{
+    struct stat last;
+    std::memset(&last, 0, sizeof(last));
+    bool haveLast = fileStamp(g_watcher.path, last);
+
+    std::unique_lock<std::mutex> lock(g_watcher.mutex);
+    while (!g_watcher.stop) {
+        g_watcher.wake.wait_for(lock, std::chrono::milliseconds(g_watcher.pollMs));
+        if (g_watcher.stop) break;
+
+        struct stat st;
+        if (!fileStamp(g_watcher.path, st)) continue;   // Reemplazo en curso
+        if (haveLast && sameStamp(st, last)) continue;
+        last = st;
+        haveLast = true;
+
+        const std::string path = g_watcher.path;
+        lock.unlock();
+        loadParserConfig(path.c_str());
+        lock.lock();
+    }
+}
+
+bool watchParserConfig(const char* path, int pollMs)
+{
+    if (!path) return false;
+    std::lock_guard<std::mutex> lock(g_watchMutex);
+    g_watcher.halt();
+    const bool loaded = loadParserConfig(path);
+
+    g_watcher.stop = false;
+    g_watcher.path = path;
+    g_watcher.pollMs = pollMs > 0 ? pollMs : 500;
+    g_watcher.thread = std::thread(watchLoop);
+    return loaded;
+}
+
+void stopWatchingParserConfig()
+{
+    std::lock_guard<std::mutex> lock(g_watchMutex);
+    g_watcher.halt();
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" int RetinaFaceParserConfigLoad(const char* path)
+{
+    return loadParserConfig(path) ? 1 : 0;
+}
+
+extern "C" int RetinaFaceParserConfigWatch(const char* path, int pollMs)
+{
+    return watchParserConfig(path, pollMs) ? 1 : 0;
+}
+
+extern "C" void RetinaFaceParserConfigStopWatch()
+{
+    stopWatchingParserConfig();
+}
+
+extern "C" int RetinaFaceParserConfigRollback()
+{
+    return rollbackParserConfig() ? 1 : 0;
+}
+
+extern "C" int RetinaFaceParserConfigPublish(const ParserConfig* config)
+{
+    return (config && publishParserConfig(*config)) ? 1 : 0;
+}
+
+extern "C" void RetinaFaceParserConfigGet(ParserConfig* config)
+{
+    if (!config) return;
+    ParserConfigSnapshot snapshot;
+    *config = *snapshot;
+}
+
+extern "C" uint64_t RetinaFaceParserConfigFailures()
+{
+    return g_failures.load();
+}
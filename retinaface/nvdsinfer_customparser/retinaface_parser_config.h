@@ -0,0 +1,123 @@
+/******************************************************************************
+ * retinaface_parser_config.h
+ *
+ * Configuración del parser recargable en caliente: se lee de un archivo
+ * key=value vigilado, se valida fuera del camino crítico y se publica como
+ * una instantánea inmutable que el parser retiene durante cada llamada
+ ******************************************************************************/
+
+#ifndef RETINAFACE_PARSER_CONFIG_H
+#define RETINAFACE_PARSER_CONFIG_H
+#include <stdint.h>
+#include <string>
+
+/** @brief Máximo de ROIs (rectángulos) por configuración. */
+static const int kMaxParserRois = 8;
+
+/** @brief Variable de entorno con el archivo a vigilar desde la primera inferencia. */
+static const char* const kParserConfigEnv = "RETINAFACE_PARSER_CONFIG";
+
+enum ParserNmsMode {
+    PARSER_NMS_HARD = 0,   /**< Greedy: suprime si IoU > nms-threshold */
+    PARSER_NMS_SOFT = 1,   /**< Soft-NMS gaussiano: atenúa score *= exp(-IoU² / sigma) */
+    PARSER_NMS_NONE = 2
+};
+
+enum ParserNmsKernel {
+    PARSER_NMS_KERNEL_FLOAT = 0,   /**< IoU en float, caja a caja */
+    PARSER_NMS_KERNEL_INT16 = 1    /**< Cajas cuantizadas a int16 y SIMD entero (retinaface_nms.h) */
+};
+
+enum ParserBestFace {
+    PARSER_BEST_FACE_OFF     = 0,  /**< Todas las caras tras el NMS */
+    PARSER_BEST_FACE_SCORE   = 1,  /**< Solo la de mayor confianza, sin ordenar ni NMS */
+    PARSER_BEST_FACE_LARGEST = 2   /**< Solo la caja más grande por encima de conf-threshold */
+};
+
+/**
+ * @brief Parámetros del parser. Una instantánea publicada no cambia nunca.
+ */
+struct ParserConfig {
+    float    confThreshold;           /**< conf-threshold */
+    float    nmsThreshold;            /**< nms-threshold */
+    int32_t  nmsMode;                 /**< nms-mode: hard | soft | none */
+    float    softNmsSigma;            /**< soft-nms-sigma */
+    int32_t  preNmsTopK;              /**< pre-nms-top-k: candidatos que entran al NMS (0: todos) */
+    int32_t  topK;                    /**< top-k: caras por unidad del batch (0: todas) */
+    float    minFaceSize;             /**< min-face-size: lado menor mínimo en px de la entrada de la red */
+    int32_t  numRois;
+    float    rois[kMaxParserRois][4]; /**< roi=x1,y1,x2,y2 normalizados a la entrada; el centro de la cara
+                                           debe caer en alguno (sin ROIs: toda la imagen) */
+    int32_t  logDetections;           /**< log-detections: imprime cada detección */
+    int32_t  decodeThreads;           /**< decode-threads: hilos por frame (0: automático, 1: en serie) */
+    int32_t  parallelMinAnchors;      /**< parallel-min-anchors: anclas a partir de las que se reparte */
+    int32_t  nmsKernel;               /**< nms-kernel: float | int16 (solo nms-mode=hard) */
+    int32_t  nmsVerify;               /**< nms-verify: repite el NMS int16 en float y compara */
+    int32_t  bestFace;                /**< best-face: off | score | largest */
+    uint32_t version;                 /**< 0 = valores por defecto; sube con cada publicación */
+};
+
+/** @brief Valores por defecto (los que el parser usaba fijos). */
+void defaultParserConfig(ParserConfig &config);
+
+/**
+ * @brief Parsea y valida el texto de un archivo de configuración. Las claves
+ *        ausentes toman el valor por defecto.
+ *
+ * @param error Salida: línea y motivo si falla.
+ */
+bool parseParserConfig(const std::string &text, ParserConfig &config, std::string &error);
+
+/** @brief Comprueba rangos y ROIs de una configuración. */
+bool validateParserConfig(const ParserConfig &config, std::string &error);
+
+/**
+ * @brief Lectura sin locks de la instantánea vigente. Mientras el objeto
+ *        vive, la instantánea sigue siendo válida aunque se publique otra:
+ *        el hilo anuncia la época en la que entró y las instantáneas
+ *        retiradas solo se liberan cuando ningún lector anuncia una época
+ *        anterior a su retiro. Se puede anidar en el mismo hilo.
+ */
+class ParserConfigSnapshot {
+public:
+    ParserConfigSnapshot();
+    ~ParserConfigSnapshot();
+
+    const ParserConfig &operator*() const { return *m_config; }
+    const ParserConfig* operator->() const { return m_config; }
+
+private:
+    ParserConfigSnapshot(const ParserConfigSnapshot &);
+    ParserConfigSnapshot &operator=(const ParserConfigSnapshot &);
+
+    const ParserConfig* m_config;
+};
+
+/** @brief Valida y publica; si falla, la instantánea vigente no cambia. */
+bool publishParserConfig(const ParserConfig &config);
+
+/** @brief Lee, valida y publica `path`. */
+bool loadParserConfig(const char* path);
+
+/** @brief Vuelve a publicar la configuración anterior a la vigente. */
+bool rollbackParserConfig();
+
+/**
+ * @brief Carga `path` y arranca un hilo que lo vuelve a cargar cuando cambia
+ *        (mtime, tamaño o inodo; vale con editores que reemplazan el archivo).
+ *        Sustituye a cualquier vigilancia anterior.
+ */
+bool watchParserConfig(const char* path, int pollMs);
+void stopWatchingParserConfig();
+
+extern "C" {
+int      RetinaFaceParserConfigLoad(const char* path);
+int      RetinaFaceParserConfigWatch(const char* path, int pollMs);
+void     RetinaFaceParserConfigStopWatch();
+int      RetinaFaceParserConfigRollback();
+int      RetinaFaceParserConfigPublish(const ParserConfig* config);
+void     RetinaFaceParserConfigGet(ParserConfig* config);
+uint64_t RetinaFaceParserConfigFailures();
+}
+
+#endif // RETINAFACE_PARSER_CONFIG_H
@@ -0,0 +1,315 @@
+/******************************************************************************
+ * retinaface_parser_shadow.cpp
+ *
+ * El hilo de nvinfer solo copia los tres tensores a una ranura libre de un
+ * pool fijo (o descarta la muestra si no hay); el hilo de comparación parsea
+ * la copia con las dos configuraciones, empareja las caras por IoU y acumula
+ * estadísticas.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nvdsinfer_custom_retinaface.h"
+#include "retinaface_parser_shadow.h"
+
+namespace {
+struct ShadowJob {
+    std::vector<float> loc;
+    std::vector<float> landm;
+    std::vector<float> conf;
+    int                inputW;
+    int                inputH;
+    ParserConfig       active;
+};
+
+std::atomic<bool>        g_active(false);
+std::atomic<uint64_t>    g_counter(0);
+std::atomic<uint64_t>    g_stride(1);
+ParserConfig             g_shadow;
+
+std::mutex               g_queueMutex;
+std::condition_variable  g_queueReady;
+bool                     g_stop = false;
+std::vector<ShadowJob>   g_jobs;
+std::vector<int>         g_free;
+std::deque<int>          g_ready;
+std::thread              g_worker;
+
+std::mutex               g_statsMutex;
+ParserShadowStats        g_stats;
+
+std::mutex               g_controlMutex;   // Serializa start/stop
+
+double elapsedUs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    return std::chrono::duration<double, std::micro>(to - from).count();
+}
+
+float faceIoU(const RetinaFaceDetection &a, const RetinaFaceDetection &b)
+{
+    const float w = std::max(0.0f, std::min(a.x2, b.x2) - std::max(a.x1, b.x1));
+    const float h = std::max(0.0f, std::min(a.y2, b.y2) - std::max(a.y1, b.y1));
+    const float intersection = w * h;
+    const float areaA = (a.x2 - a.x1) * (a.y2 - a.y1);
+    const float areaB = (b.x2 - b.x1) * (b.y2 - b.y1);
+    return intersection / (areaA + areaB - intersection);
+}
+
+struct Candidate {
+    float iou;
+    int   a;
+    int   s;
+};
+
+void compareJob(const ShadowJob &job, std::vector<RetinaFaceDetection> &activeFaces,
+                std::vector<RetinaFaceDetection> &shadowFaces, std::vector<Candidate> &pairs,
+                std::vector<char> &usedA, std::vector<char> &usedS)
+{
+    // Sin impresiones: la sombra no debe ensuciar el log del parser
+    ParserConfig active = job.active;
+    ParserConfig shadow = g_shadow;
+    active.logDetections = 0;
+    shadow.logDetections = 0;
+
+    const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    const bool okA = selectRetinaFaces(job.loc.data(), job.landm.data(), job.conf.data(), job.inputW, job.inputH,
+                                       active, activeFaces);
+    const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    const bool okS = selectRetinaFaces(job.loc.data(), job.landm.data(), job.conf.data(), job.inputW, job.inputH,
+                                       shadow, shadowFaces);
+    const std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    if (!okA || !okS) return;
+
+    // Emparejamiento voraz por IoU descendente
+    pairs.clear();
+    for (size_t a = 0; a < activeFaces.size(); ++a) {
+        for (size_t s = 0; s < shadowFaces.size(); ++s) {
+            const float iou = faceIoU(activeFaces[a], shadowFaces[s]);
+            if (iou >= kShadowMatchIoU) {
+                Candidate c = {iou, static_cast<int>(a), static_cast<int>(s)};
+                pairs.push_back(c);
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Candidate &x, const Candidate &y) { return x.iou > y.iou; });
+    usedA.assign(activeFaces.size(), 0);
+    usedS.assign(shadowFaces.size(), 0);
+
+    uint64_t matched = 0;
+    double iouSum = 0.0, scoreDeltaSum = 0.0;
+    for (size_t p = 0; p < pairs.size(); ++p) {
+        const Candidate &c = pairs[p];
+        if (usedA[c.a] || usedS[c.s]) continue;
+        usedA[c.a] = usedS[c.s] = 1;
+        ++matched;
+        iouSum += c.iou;
+        scoreDeltaSum += shadowFaces[c.s].confidence - activeFaces[c.a].confidence;
+    }
+    const uint64_t missed = activeFaces.size() - matched;
+    const uint64_t extra = shadowFaces.size() - matched;
+
+    std::lock_guard<std::mutex> lock(g_statsMutex);
+    ++g_stats.compared;
+    g_stats.activeFaces += activeFaces.size();
+    g_stats.shadowFaces += shadowFaces.size();
+    g_stats.matched += matched;
+    g_stats.missed += missed;
+    g_stats.extra += extra;
+    if (missed || extra) ++g_stats.disagreeing;
+    g_stats.activeUs += elapsedUs(t0, t1);
+    g_stats.shadowUs += elapsedUs(t1, t2);
+    g_stats.iouSum += iouSum;
+    g_stats.scoreDeltaSum += scoreDeltaSum;
+}
+
+void workerLoop()
+{
+    std::vector<RetinaFaceDetection> activeFaces, shadowFaces;
+    std::vector<Candidate> pairs;
+    std::vector<char> usedA, usedS;
+
+    std::unique_lock<std::mutex> lock(g_queueMutex);
+    while (true) {
+        g_queueReady.wait(lock, []() { return g_stop || !g_ready.empty(); });
+        if (g_stop) break;
+        const int slot = g_ready.front();
+        g_ready.pop_front();
+
+        lock.unlock();
+        compareJob(g_jobs[slot], activeFaces, shadowFaces, pairs, usedA, usedS);
+        lock.lock();
+        g_free.push_back(slot);
+    }
+}
+} // namespace
+
+//-------------------------------------------------------------------------------
+// Control
+//-------------------------------------------------------------------------------
+static void stopLocked()
+{
+    g_active.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        g_stop = true;
+    }
+    g_queueReady.notify_all();
+    if (g_worker.joinable()) g_worker.join();
+
+    // Un submit que ya pasó el muestreo puede estar copiando a su ranura:
+    // se espera a que la devuelva antes de liberar el pool
+    std::unique_lock<std::mutex> lock(g_queueMutex);
+    while (g_free.size() + g_ready.size() < g_jobs.size()) {
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+    }
+    g_jobs.clear();
+    g_free.clear();
+    g_ready.clear();
+}
+
+bool startParserShadow(const ParserConfig &shadow, float sampleRate, int queueDepth)
+{
+    std::string error;
+    if (!validateParserConfig(shadow, error)) {
+        std::cerr << "ERROR: configuración en sombra inválida: " << error << std::endl;
+        return false;
+    }
+    if (!(sampleRate > 0.f && sampleRate <= 1.f) || queueDepth <= 0) {
+        std::cerr << "ERROR: la sombra necesita sampleRate en (0, 1] y queueDepth > 0." << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> control(g_controlMutex);
+    stopLocked();
+
+    g_shadow = shadow;
+    g_stride.store(std::max<uint64_t>(1, static_cast<uint64_t>(std::lround(1.0 / sampleRate))));
+    {
+        std::lock_guard<std::mutex> lock(g_statsMutex);
+        std::memset(&g_stats, 0, sizeof(g_stats));
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        g_jobs.resize(queueDepth);
+        for (int i = 0; i < queueDepth; ++i) g_free.push_back(i);
+        g_stop = false;
+    }
+    g_worker = std::thread(workerLoop);
+    g_active.store(true, std::memory_order_release);
+
+    std::cout << "Parser en sombra: 1 de cada " << g_stride.load() << " unidades, conf=" << shadow.confThreshold
+              << " nms=" << shadow.nmsThreshold << " mode=" << shadow.nmsMode << std::endl;
+    return true;
+}
+
+void stopParserShadow()
+{
+    std::lock_guard<std::mutex> control(g_controlMutex);
+    stopLocked();
+}
+
+bool parserShadowActive()
+{
+    return g_active.load(std::memory_order_relaxed);
+}
+
+void submitParserShadow(const float* locData, const float* landmData, const float* confData, size_t numAnchors,
+                        int inputWidth, int inputHeight, const ParserConfig &active)
+{
+    if (g_counter.fetch_add(1, std::memory_order_relaxed) % g_stride.load(std::memory_order_relaxed) != 0) return;
+
+    int slot;
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        if (g_stop || !g_active.load(std::memory_order_acquire)) return;
+        {
+            std::lock_guard<std::mutex> stats(g_statsMutex);
+            ++g_stats.sampled;
+            if (g_free.empty()) {
+                ++g_stats.dropped;
+                return;
+            }
+        }
+        slot = g_free.back();
+        g_free.pop_back();
+    }
+
+    // La copia va fuera del lock; tras las primeras muestras no reserva
+    ShadowJob &job = g_jobs[slot];
+    job.loc.assign(locData, locData + numAnchors * 4);
+    job.landm.assign(landmData, landmData + numAnchors * 10);
+    job.conf.assign(confData, confData + numAnchors * 2);
+    job.inputW = inputWidth;
+    job.inputH = inputHeight;
+    job.active = active;
+
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        g_ready.push_back(slot);
+    }
+    g_queueReady.notify_one();
+}
+
+void getParserShadowStats(ParserShadowStats &stats)
+{
+    std::lock_guard<std::mutex> lock(g_statsMutex);
+    stats = g_stats;
+}
+
+// Para el hilo al descargar la librería si nadie llamó a stop
+static struct ShadowShutdown {
+    ~ShadowShutdown() { stopParserShadow(); }
+} g_shutdown;
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" int RetinaFaceParserShadowStart(const ParserConfig* shadow, float sampleRate, int queueDepth)
+{
+    return (shadow && startParserShadow(*shadow, sampleRate, queueDepth)) ? 1 : 0;
+}
+
+extern "C" int RetinaFaceParserShadowLoad(const char* path, float sampleRate, int queueDepth)
+{
+    if (!path) return 0;
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "ERROR: no se pudo leer la configuración en sombra " << path << std::endl;
+        return 0;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+
+    ParserConfig config;
+    std::string error;
+    if (!parseParserConfig(text.str(), config, error)) {
+        std::cerr << "ERROR: " << path << ": " << error << std::endl;
+        return 0;
+    }
+    return startParserShadow(config, sampleRate, queueDepth) ? 1 : 0;
+}
+
+extern "C" void RetinaFaceParserShadowStop()
+{
+    stopParserShadow();
+}
+
+extern "C" void RetinaFaceParserShadowGetStats(ParserShadowStats* stats)
+{
+    if (stats) getParserShadowStats(*stats);
+}
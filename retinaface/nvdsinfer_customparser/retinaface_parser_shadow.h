@@ -0,0 +1,72 @@
+/******************************************************************************
+ * retinaface_parser_shadow.h
+ *
+ * Comparación en sombra (A/B) de configuraciones del parser: una fracción de
+ * las unidades del batch se vuelve a parsear en un hilo aparte con una
+ * configuración candidata, sobre una copia de los mismos tensores, y se mide
+ * coste y discrepancia frente a la vigente sin tocar la salida del parser
+ ******************************************************************************/
+
+#ifndef RETINAFACE_PARSER_SHADOW_H
+#define RETINAFACE_PARSER_SHADOW_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include "retinaface_parser_config.h"
+
+/** @brief IoU mínimo para emparejar una cara de la vigente con una de la candidata. */
+static const float kShadowMatchIoU = 0.5f;
+
+/**
+ * @brief Acumulados desde el arranque o el último reset. Tiempos en µs de
+ *        decodificación + NMS + filtros, medidos en el mismo hilo para las dos
+ *        configuraciones.
+ */
+struct ParserShadowStats {
+    uint64_t sampled;           /**< Unidades elegidas por el muestreo */
+    uint64_t compared;          /**< Unidades ya comparadas */
+    uint64_t dropped;           /**< Muestreadas con la cola llena */
+    uint64_t activeFaces;
+    uint64_t shadowFaces;
+    uint64_t matched;           /**< Pares con IoU >= kShadowMatchIoU */
+    uint64_t missed;            /**< Caras de la vigente sin pareja en la candidata */
+    uint64_t extra;             /**< Caras de la candidata sin pareja en la vigente */
+    uint64_t disagreeing;       /**< Unidades con alguna cara perdida o extra */
+    double   activeUs;
+    double   shadowUs;
+    double   iouSum;            /**< Suma de IoU de los pares (media = iouSum / matched) */
+    double   scoreDeltaSum;     /**< Suma de score candidata - vigente de los pares */
+};
+
+/**
+ * @brief Arranca la comparación (sustituye a una anterior y pone a cero las
+ *        estadísticas).
+ *
+ * @param sampleRate Fracción de unidades comparadas (0, 1]; se toma una de
+ *                   cada round(1 / sampleRate).
+ * @param queueDepth Copias de tensores en vuelo; si el hilo no da abasto,
+ *                   las siguientes muestras se descartan.
+ */
+bool startParserShadow(const ParserConfig &shadow, float sampleRate, int queueDepth);
+void stopParserShadow();
+
+/** @brief Coste en el camino del parser cuando no hay comparación: una carga atómica. */
+bool parserShadowActive();
+
+/**
+ * @brief Llamada por el parser tras producir su salida con `active`. Si la
+ *        unidad sale en el muestreo copia los tensores y la encola.
+ */
+void submitParserShadow(const float* locData, const float* landmData, const float* confData, size_t numAnchors,
+                        int inputWidth, int inputHeight, const ParserConfig &active);
+
+void getParserShadowStats(ParserShadowStats &stats);
+
+extern "C" {
+int  RetinaFaceParserShadowStart(const ParserConfig* shadow, float sampleRate, int queueDepth);
+int  RetinaFaceParserShadowLoad(const char* path, float sampleRate, int queueDepth);
+void RetinaFaceParserShadowStop();
+void RetinaFaceParserShadowGetStats(ParserShadowStats* stats);
+}
+
+#endif // RETINAFACE_PARSER_SHADOW_H
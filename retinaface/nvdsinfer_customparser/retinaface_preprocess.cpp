@@ -0,0 +1,307 @@
+/******************************************************************************
+ * retinaface_preprocess.cpp
+ *
+ * Resize bilineal/área + RGBA->RGB/BGR + (x - offset) * escala en una pasada.
+ * Se procesan 4 píxeles de salida a la vez: cada píxel RGBA es un vector de
+ * 4 floats, y una transposición 4x4 deja un vector por canal listo para
+ * escribirse en su plano.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+#include "retinaface_preprocess.h"
+
+//-------------------------------------------------------------------------------
+// Vector de 4 floats: SSE2 en x86 y genérico en el resto (el compilador lo
+// vectoriza con NEON en Jetson).
+//-------------------------------------------------------------------------------
+#if defined(__SSE2__)
+typedef __m128 Vec4;
+
+static inline Vec4 loadPixel(const uint8_t* p)
+{
+    int32_t raw;
+    std::memcpy(&raw, p, 4);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_cvtsi32_si128(raw);
+    v = _mm_unpacklo_epi8(v, zero);
+    v = _mm_unpacklo_epi16(v, zero);
+    return _mm_cvtepi32_ps(v);
+}
+static inline Vec4 vset1(float a)              { return _mm_set1_ps(a); }
+static inline Vec4 vzero()                     { return _mm_setzero_ps(); }
+static inline Vec4 vadd(Vec4 a, Vec4 b)        { return _mm_add_ps(a, b); }
+static inline Vec4 vsub(Vec4 a, Vec4 b)        { return _mm_sub_ps(a, b); }
+static inline Vec4 vmul(Vec4 a, Vec4 b)        { return _mm_mul_ps(a, b); }
+static inline Vec4 vlerp(Vec4 a, Vec4 b, Vec4 t) { return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t)); }
+static inline void vtranspose(Vec4 &r0, Vec4 &r1, Vec4 &r2, Vec4 &r3) { _MM_TRANSPOSE4_PS(r0, r1, r2, r3); }
+static inline void vstore(float* dst, Vec4 v)  { _mm_storeu_ps(dst, v); }
+#else
+struct Vec4 { float v[4]; };
+
+static inline Vec4 loadPixel(const uint8_t* p)
+{
+    Vec4 r = {{ float(p[0]), float(p[1]), float(p[2]), float(p[3]) }};
+    return r;
+}
+static inline Vec4 vset1(float a)              { Vec4 r = {{ a, a, a, a }}; return r; }
+static inline Vec4 vzero()                     { return vset1(0.f); }
+static inline Vec4 vadd(Vec4 a, Vec4 b)        { for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+static inline Vec4 vsub(Vec4 a, Vec4 b)        { for (int i = 0; i < 4; ++i) a.v[i] -= b.v[i]; return a; }
+static inline Vec4 vmul(Vec4 a, Vec4 b)        { for (int i = 0; i < 4; ++i) a.v[i] *= b.v[i]; return a; }
+static inline Vec4 vlerp(Vec4 a, Vec4 b, Vec4 t) { return vadd(a, vmul(vsub(b, a), t)); }
+static inline void vtranspose(Vec4 &r0, Vec4 &r1, Vec4 &r2, Vec4 &r3)
+{
+    Vec4 *rows[4] = { &r0, &r1, &r2, &r3 };
+    for (int i = 0; i < 4; ++i)
+        for (int j = i + 1; j < 4; ++j)
+            std::swap(rows[i]->v[j], rows[j]->v[i]);
+}
+static inline void vstore(float* dst, Vec4 v)  { std::memcpy(dst, v.v, sizeof(v.v)); }
+#endif
+
+uint16_t floatToHalf(float value)
+{
+    uint32_t x;
+    std::memcpy(&x, &value, 4);
+    const uint32_t sign = (x >> 16) & 0x8000u;
+    const uint32_t expF = (x >> 23) & 0xffu;
+    uint32_t mant = x & 0x7fffffu;
+
+    if (expF == 0xffu) return static_cast<uint16_t>(sign | 0x7c00u | (mant ? 0x200u : 0u));
+
+    const int32_t exp = static_cast<int32_t>(expF) - 127 + 15;
+    if (exp >= 31) return static_cast<uint16_t>(sign | 0x7c00u);
+    if (exp <= 0) {
+        // Subnormal en FP16
+        if (exp < -10) return static_cast<uint16_t>(sign);
+        mant |= 0x800000u;
+        const uint32_t shift = static_cast<uint32_t>(14 - exp);
+        uint32_t h = mant >> shift;
+        const uint32_t rem  = mant & ((1u << shift) - 1u);
+        const uint32_t half = 1u << (shift - 1u);
+        if (rem > half || (rem == half && (h & 1u))) ++h;
+        return static_cast<uint16_t>(sign | h);
+    }
+    uint32_t h = (static_cast<uint32_t>(exp) << 10) | (mant >> 13);
+    const uint32_t rem = mant & 0x1fffu;
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1u))) ++h;   // el acarreo sube al exponente
+    return static_cast<uint16_t>(sign | h);
+}
+
+//-------------------------------------------------------------------------------
+// Escritura de 4 píxeles (ya interpolados, en orden RGBA) a los 3 planos
+//-------------------------------------------------------------------------------
+namespace {
+
+struct PlanarWriter {
+    Vec4     scale;
+    Vec4     offset[3];
+    int      chan[3];     // Canal RGBA que va a cada plano
+    int      type;
+    float*   dstF;
+    uint16_t* dstH;
+    size_t   planeSize;
+
+    PlanarWriter(const PreprocParams &p, void* dst, int dstW, int dstH_)
+    {
+        scale = vset1(p.netScaleFactor);
+        for (int c = 0; c < 3; ++c) offset[c] = vset1(p.offsets[c]);
+        chan[0] = (p.colorFormat == 1) ? 2 : 0;
+        chan[1] = 1;
+        chan[2] = (p.colorFormat == 1) ? 0 : 2;
+        type = p.outputType;
+        dstF = static_cast<float*>(dst);
+        dstH = static_cast<uint16_t*>(dst);
+        planeSize = static_cast<size_t>(dstW) * dstH_;
+    }
+
+    // px[0..3] son 4 píxeles consecutivos; se escriben `count` (1..4)
+    inline void write(Vec4 px[4], size_t index, int count) const
+    {
+        vtranspose(px[0], px[1], px[2], px[3]);   // px[k] = canal k de los 4 píxeles
+        for (int c = 0; c < 3; ++c) {
+            const Vec4 v = vmul(vsub(px[chan[c]], offset[c]), scale);
+            const size_t o = c * planeSize + index;
+            if (type == PREPROC_OUTPUT_FP16) {
+#if defined(__F16C__)
+                if (count == 4) {
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(dstH + o),
+                                     _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+                    continue;
+                }
+#endif
+                float tmp[4];
+                vstore(tmp, v);
+                for (int i = 0; i < count; ++i) dstH[o + i] = floatToHalf(tmp[i]);
+            } else if (count == 4) {
+                vstore(dstF + o, v);
+            } else {
+                float tmp[4];
+                vstore(tmp, v);
+                for (int i = 0; i < count; ++i) dstF[o + i] = tmp[i];
+            }
+        }
+    }
+};
+
+inline int clampi(int v, int lo, int hi) { return std::min(std::max(v, lo), hi); }
+
+} // namespace
+
+//-------------------------------------------------------------------------------
+// Resize bilineal con tablas de coordenadas precalculadas
+//-------------------------------------------------------------------------------
+static void resizeBilinear(const uint8_t* src, int pitch, int frameW, int frameH,
+                           const float roi[4], int dstW, int dstH, const PlanarWriter &out)
+{
+    const float sx = roi[2] / dstW;
+    const float sy = roi[3] / dstH;
+
+    std::vector<int>   xOff0(dstW), xOff1(dstW);
+    std::vector<float> xFrac(dstW);
+    for (int x = 0; x < dstW; ++x) {
+        const float fx = roi[0] + (x + 0.5f) * sx - 0.5f;
+        const int x0 = static_cast<int>(std::floor(fx));
+        xFrac[x] = fx - x0;
+        xOff0[x] = clampi(x0, 0, frameW - 1) * 4;
+        xOff1[x] = clampi(x0 + 1, 0, frameW - 1) * 4;
+    }
+
+    Vec4 px[4];
+    for (int y = 0; y < dstH; ++y) {
+        const float fy = roi[1] + (y + 0.5f) * sy - 0.5f;
+        const int y0 = static_cast<int>(std::floor(fy));
+        const Vec4 ay = vset1(fy - y0);
+        const uint8_t* row0 = src + static_cast<size_t>(clampi(y0, 0, frameH - 1)) * pitch;
+        const uint8_t* row1 = src + static_cast<size_t>(clampi(y0 + 1, 0, frameH - 1)) * pitch;
+
+        for (int x = 0; x < dstW; x += 4) {
+            const int n = std::min(4, dstW - x);
+            for (int i = 0; i < 4; ++i) {
+                const int xi = x + std::min(i, n - 1);
+                const Vec4 ax = vset1(xFrac[xi]);
+                const Vec4 top = vlerp(loadPixel(row0 + xOff0[xi]), loadPixel(row0 + xOff1[xi]), ax);
+                const Vec4 bot = vlerp(loadPixel(row1 + xOff0[xi]), loadPixel(row1 + xOff1[xi]), ax);
+                px[i] = vlerp(top, bot, ay);
+            }
+            out.write(px, static_cast<size_t>(y) * dstW + x, n);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Resize por área: promedio de los píxeles fuente que cubre cada píxel destino
+//-------------------------------------------------------------------------------
+static void resizeArea(const uint8_t* src, int pitch, int frameW, int frameH,
+                       const float roi[4], int dstW, int dstH, const PlanarWriter &out)
+{
+    const float sx = roi[2] / dstW;
+    const float sy = roi[3] / dstH;
+
+    std::vector<int> xBeg(dstW), xEnd(dstW);
+    for (int x = 0; x < dstW; ++x) {
+        const int b = clampi(static_cast<int>(std::floor(roi[0] + x * sx)), 0, frameW - 1);
+        const int e = clampi(static_cast<int>(std::ceil(roi[0] + (x + 1) * sx)), b + 1, frameW);
+        xBeg[x] = b;
+        xEnd[x] = e;
+    }
+
+    Vec4 px[4];
+    for (int y = 0; y < dstH; ++y) {
+        const int yb = clampi(static_cast<int>(std::floor(roi[1] + y * sy)), 0, frameH - 1);
+        const int ye = clampi(static_cast<int>(std::ceil(roi[1] + (y + 1) * sy)), yb + 1, frameH);
+
+        for (int x = 0; x < dstW; x += 4) {
+            const int n = std::min(4, dstW - x);
+            for (int i = 0; i < 4; ++i) {
+                const int xi = x + std::min(i, n - 1);
+                Vec4 acc = vzero();
+                for (int yy = yb; yy < ye; ++yy) {
+                    const uint8_t* row = src + static_cast<size_t>(yy) * pitch;
+                    for (int xx = xBeg[xi]; xx < xEnd[xi]; ++xx) {
+                        acc = vadd(acc, loadPixel(row + xx * 4));
+                    }
+                }
+                const float inv = 1.f / ((ye - yb) * (xEnd[xi] - xBeg[xi]));
+                px[i] = vmul(acc, vset1(inv));
+            }
+            out.write(px, static_cast<size_t>(y) * dstW + x, n);
+        }
+    }
+}
+
+void resizeNormalizeRGBA(const uint8_t* src, int pitch, int frameW, int frameH,
+                         const float roi[4], int dstW, int dstH,
+                         const PreprocParams &params, void* dst)
+{
+    if (!src || !dst || dstW <= 0 || dstH <= 0 || frameW <= 0 || frameH <= 0) return;
+
+    const PlanarWriter out(params, dst, dstW, dstH);
+    if (params.interp == PREPROC_INTERP_AREA) {
+        resizeArea(src, pitch, frameW, frameH, roi, dstW, dstH, out);
+    } else {
+        resizeBilinear(src, pitch, frameW, frameH, roi, dstW, dstH, out);
+    }
+}
+
+void warpAffineNormalizeRGBA(const uint8_t* src, int pitch, int frameW, int frameH,
+                             const float M[6], int dstW, int dstH,
+                             const PreprocParams &params, void* dst)
+{
+    if (!src || !dst || dstW <= 0 || dstH <= 0 || frameW <= 0 || frameH <= 0) return;
+
+    const PlanarWriter out(params, dst, dstW, dstH);
+    Vec4 px[4];
+    for (int y = 0; y < dstH; ++y) {
+        for (int x = 0; x < dstW; x += 4) {
+            const int n = std::min(4, dstW - x);
+            for (int i = 0; i < 4; ++i) {
+                const int xi = x + std::min(i, n - 1);
+                const float fx = M[0] * xi + M[1] * y + M[2];
+                const float fy = M[3] * xi + M[4] * y + M[5];
+                const int x0 = static_cast<int>(std::floor(fx));
+                const int y0 = static_cast<int>(std::floor(fy));
+                const Vec4 ax = vset1(fx - x0);
+                const Vec4 ay = vset1(fy - y0);
+                const int c0 = clampi(x0, 0, frameW - 1) * 4;
+                const int c1 = clampi(x0 + 1, 0, frameW - 1) * 4;
+                const uint8_t* row0 = src + static_cast<size_t>(clampi(y0, 0, frameH - 1)) * pitch;
+                const uint8_t* row1 = src + static_cast<size_t>(clampi(y0 + 1, 0, frameH - 1)) * pitch;
+                const Vec4 top = vlerp(loadPixel(row0 + c0), loadPixel(row0 + c1), ax);
+                const Vec4 bot = vlerp(loadPixel(row1 + c0), loadPixel(row1 + c1), ax);
+                px[i] = vlerp(top, bot, ay);
+            }
+            out.write(px, static_cast<size_t>(y) * dstW + x, n);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" void RetinaFaceResizeNormalize(const uint8_t* src, int pitch, int frameW, int frameH,
+                                          const float* roi, int dstW, int dstH,
+                                          const PreprocParams* params, void* dst)
+{
+    if (!roi || !params) return;
+    resizeNormalizeRGBA(src, pitch, frameW, frameH, roi, dstW, dstH, *params, dst);
+}
+
+extern "C" void RetinaFaceWarpAffineNormalize(const uint8_t* src, int pitch, int frameW, int frameH,
+                                              const float* M, int dstW, int dstH,
+                                              const PreprocParams* params, void* dst)
+{
+    if (!M || !params) return;
+    warpAffineNormalizeRGBA(src, pitch, frameW, frameH, M, dstW, dstH, *params, dst);
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+ * retinaface_preprocess.h
+ *
+ * Kernel fusionado resize + orden de color + normalización para recortes
+ ******************************************************************************/
+
+#ifndef RETINAFACE_PREPROCESS_H
+#define RETINAFACE_PREPROCESS_H
+#include <stdint.h>
+
+/** @brief Tipo de los planos de salida. */
+enum PreprocOutputType {
+    PREPROC_OUTPUT_FP32 = 0,
+    PREPROC_OUTPUT_FP16 = 1
+};
+
+/** @brief Interpolación usada en el resize. */
+enum PreprocInterp {
+    PREPROC_INTERP_BILINEAR = 0,
+    PREPROC_INTERP_AREA     = 1   /**< Promedio del área cubierta (reducciones grandes) */
+};
+
+/**
+ * @brief Parámetros de preprocesado, con el mismo significado que en el
+ *        config de nvinfer: y = netScaleFactor * (x - offsets[c]).
+ */
+struct PreprocParams {
+    float netScaleFactor;
+    float offsets[3];   /**< En el orden de colorFormat */
+    int   colorFormat;  /**< 0=RGB, 1=BGR (model-color-format) */
+    int   outputType;   /**< PreprocOutputType */
+    int   interp;       /**< PreprocInterp (solo resizeNormalizeRGBA) */
+};
+
+/**
+ * @brief Redimensiona una región RGBA y escribe 3 planos normalizados
+ *        (CHW) en una sola pasada por píxel de salida.
+ *
+ * @param src     Frame RGBA de 8 bits.
+ * @param pitch   Bytes por fila de src.
+ * @param frameW  Ancho del frame.
+ * @param frameH  Alto del frame.
+ * @param roi     Región [left, top, width, height] en coordenadas del frame.
+ * @param dstW    Ancho de salida.
+ * @param dstH    Alto de salida.
+ * @param params  Normalización, orden de color, tipo de salida e interpolación.
+ * @param dst     Salida de 3 x dstH x dstW elementos (float o uint16 FP16).
+ */
+void resizeNormalizeRGBA(const uint8_t* src, int pitch, int frameW, int frameH,
+                         const float roi[4], int dstW, int dstH,
+                         const PreprocParams &params, void* dst);
+
+/**
+ * @brief Igual que resizeNormalizeRGBA pero con una transformación afín
+ *        arbitraria M (salida -> frame), p.ej. la alineación por landmarks.
+ *        Siempre bilineal.
+ */
+void warpAffineNormalizeRGBA(const uint8_t* src, int pitch, int frameW, int frameH,
+                             const float M[6], int dstW, int dstH,
+                             const PreprocParams &params, void* dst);
+
+/** @brief Conversión escalar float -> FP16 (redondeo al par más cercano). */
+uint16_t floatToHalf(float value);
+
+extern "C" {
+void RetinaFaceResizeNormalize(const uint8_t* src, int pitch, int frameW, int frameH,
+                               const float* roi, int dstW, int dstH,
+                               const PreprocParams* params, void* dst);
+void RetinaFaceWarpAffineNormalize(const uint8_t* src, int pitch, int frameW, int frameH,
+                                   const float* M, int dstW, int dstH,
+                                   const PreprocParams* params, void* dst);
+}
+
+#endif // RETINAFACE_PREPROCESS_H
@@ -0,0 +1,363 @@
+/******************************************************************************
+ * retinaface_qos.cpp
+ *
+ * Implementación del control de admisión por clases de QoS. Los frames en
+ * vuelo crecen con ritmo × latencia (Little) aunque no haya atraso, así que
+ * la sobrecarga se detecta por la cola que sobra sobre el régimen: ritmo de
+ * salida × (latencia media del periodo - latencia base), con la latencia
+ * medida frame a frame (PTS) y la base como la mínima de las últimas
+ * ventanas. Si supera maxInflight, la capacidad pasa a ser el ritmo medido a
+ * la salida; sin atraso se sondea hacia arriba de forma aditiva.
+ ******************************************************************************/
+
+#include <algorithm>
+
+#include "gstnvdsmeta.h"
+#include "retinaface_qos.h"
+
+static const float kRateSmoothing = 0.5f;   // Peso del último periodo en las tasas
+static const int   kLatencyWindowPeriods = 60;   // Periodos por ventana de la latencia base
+static const size_t kMaxPendingPerSource = 1024; // Tope de frames sin emparejar por fuente
+static const size_t kPtsSearchDepth = 64;        // Frames que se miran para emparejar un PTS
+
+QosController::QosController(const QosConfig &config)
+    : m_config(config),
+      m_periodStartUs(-1),
+      m_inflight(0),
+      m_latencySumUs(0),
+      m_latencySamples(0),
+      m_windowMinUs(INT64_MAX),
+      m_prevWindowMinUs(INT64_MAX),
+      m_windowPeriods(0),
+      m_capacity(config.capacityFps > 0.f ? config.capacityFps : 0.f),
+      m_hasProcessedProbe(false)
+{
+    if (m_config.maxInflight <= 0) m_config.maxInflight = 8;
+    if (m_config.updatePeriodMs <= 0) m_config.updatePeriodMs = 500;
+}
+
+int QosController::addClass(const QosClassConfig &cls)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_classes.push_back(cls);
+    return static_cast<int>(m_classes.size()) - 1;
+}
+
+bool QosController::setSource(uint32_t sourceId, int cls)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (cls < 0 || cls >= static_cast<int>(m_classes.size())) return false;
+    m_sources[sourceId].cls = cls;
+    return true;
+}
+
+void QosController::setProcessedProbe(bool attached)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hasProcessedProbe = attached;
+}
+
+bool QosController::admit(uint32_t sourceId, uint64_t pts, int64_t nowUs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    update(nowUs);
+
+    // Las fuentes sin registrar van a la clase más baja
+    std::map<uint32_t, Source>::iterator it = m_sources.find(sourceId);
+    if (it == m_sources.end()) {
+        it = m_sources.insert(std::make_pair(sourceId, Source())).first;
+        it->second.cls = std::max(0, static_cast<int>(m_classes.size()) - 1);
+    }
+    Source &s = it->second;
+    ++s.arrivals;
+
+    // Diezmado uniforme: se admite un frame cada 1/quota
+    s.credit += s.quota;
+    if (s.credit >= 1.f) {
+        s.credit -= 1.f;
+        ++s.admitted;
+        if (s.pending.size() >= kMaxPendingPerSource) {
+            // Perdidos aguas abajo sin emparejar
+            s.pending.pop_front();
+            --m_inflight;
+        }
+        Pending p;
+        p.pts = pts;
+        p.admittedUs = nowUs;
+        s.pending.push_back(p);
+        ++m_inflight;
+        return true;
+    }
+    ++s.dropped;
+    return false;
+}
+
+void QosController::onProcessed(uint32_t sourceId, uint64_t pts, int64_t nowUs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    update(nowUs);
+    std::map<uint32_t, Source>::iterator it = m_sources.find(sourceId);
+    if (it == m_sources.end()) return;
+    Source &s = it->second;
+    ++s.processed;
+    if (s.pending.empty()) return;
+
+    // Por PTS: los anteriores al emparejado se perdieron aguas abajo. Sin
+    // PTS (o si no aparece) se toma el más antiguo
+    size_t match = 0;
+    if (pts != kQosNoPts) {
+        const size_t depth = std::min(s.pending.size(), kPtsSearchDepth);
+        for (size_t i = 0; i < depth; ++i) {
+            if (s.pending[i].pts == pts) {
+                match = i;
+                break;
+            }
+        }
+    }
+    const int64_t latencyUs = nowUs - s.pending[match].admittedUs;
+    s.pending.erase(s.pending.begin(), s.pending.begin() + match + 1);
+    m_inflight -= static_cast<int64_t>(match + 1);
+    m_latencySumUs += std::max<int64_t>(0, latencyUs);
+    ++m_latencySamples;
+}
+
+void QosController::update(int64_t nowUs)
+{
+    if (m_periodStartUs < 0) {
+        m_periodStartUs = nowUs;
+        return;
+    }
+    const int64_t elapsedUs = nowUs - m_periodStartUs;
+    if (elapsedUs < static_cast<int64_t>(m_config.updatePeriodMs) * 1000) return;
+    m_periodStartUs = nowUs;
+
+    const float seconds = elapsedUs / 1e6f;
+    float demandTotal = 0.f, processedRate = 0.f;
+    uint32_t admittedCount = 0;
+    for (std::map<uint32_t, Source>::iterator it = m_sources.begin(); it != m_sources.end(); ++it) {
+        Source &s = it->second;
+        s.demandFps   += kRateSmoothing * (s.arrivals / seconds - s.demandFps);
+        s.admittedFps += kRateSmoothing * (s.admitted / seconds - s.admittedFps);
+        s.achievedFps += kRateSmoothing * (s.processed / seconds - s.achievedFps);
+        demandTotal   += s.demandFps;
+        processedRate += s.processed / seconds;
+        admittedCount += s.admitted;
+        s.arrivals = s.admitted = s.processed = 0;
+    }
+    // Sin frames admitidos el pipeline está vacío (EOS, fuentes paradas)
+    if (admittedCount == 0) {
+        for (std::map<uint32_t, Source>::iterator it = m_sources.begin(); it != m_sources.end(); ++it) {
+            it->second.pending.clear();
+        }
+        m_inflight = 0;
+    }
+
+    // Cola sobrante: lo que hay en vuelo por encima de ritmo × latencia base
+    float excessFrames = 0.f;
+    if (m_latencySamples > 0) {
+        const int64_t meanUs = m_latencySumUs / m_latencySamples;
+        m_windowMinUs = std::min(m_windowMinUs, meanUs);
+        const int64_t baseUs = std::min(m_windowMinUs, m_prevWindowMinUs);
+        excessFrames = processedRate * static_cast<float>(meanUs - baseUs) / 1e6f;
+        if (++m_windowPeriods >= kLatencyWindowPeriods) {
+            // La base sigue a cambios del pipeline (batch, modelo) en 1-2 ventanas
+            m_prevWindowMinUs = m_windowMinUs;
+            m_windowMinUs = INT64_MAX;
+            m_windowPeriods = 0;
+        }
+    }
+    m_latencySumUs = 0;
+    m_latencySamples = 0;
+
+    if (m_config.capacityFps > 0.f) {
+        m_capacity = m_config.capacityFps;
+    } else if (m_hasProcessedProbe) {
+        if (excessFrames > m_config.maxInflight) {
+            // Sobrecarga: lo que sale de la inferencia es la capacidad real; un
+            // 5% menos para que el atraso se vacíe
+            m_capacity = std::max(1.f, 0.95f * processedRate);
+        } else if (m_capacity > 0.f) {
+            if (demandTotal < 0.8f * m_capacity) {
+                m_capacity = 0.f;   // Sobra capacidad: se deja de limitar
+            } else {
+                m_capacity += std::max(1.f, 0.05f * m_capacity);
+            }
+        }
+    }
+    allocate(m_capacity);
+}
+
+void QosController::allocate(float budget)
+{
+    const int numClasses = std::max(1, static_cast<int>(m_classes.size()));
+    std::vector<std::vector<Source*> > byClass(numClasses);
+    float wantTotal = 0.f;
+    for (std::map<uint32_t, Source>::iterator it = m_sources.begin(); it != m_sources.end(); ++it) {
+        Source &s = it->second;
+        const int cls = std::min(std::max(s.cls, 0), numClasses - 1);
+        const float maxFps = m_classes.empty() ? 0.f : m_classes[cls].maxFps;
+        s.quota = (maxFps > 0.f && s.demandFps > maxFps) ? maxFps / s.demandFps : 1.f;
+        byClass[cls].push_back(&s);
+        wantTotal += s.demandFps * s.quota;
+    }
+    if (budget <= 0.f || wantTotal <= budget) return;
+
+    // 1) Mínimos garantizados, por orden de clase
+    std::map<Source*, float> given;
+    float remaining = budget;
+    for (int c = 0; c < numClasses; ++c) {
+        const float minFps = m_classes.empty() ? 0.f : m_classes[c].minFps;
+        for (size_t i = 0; i < byClass[c].size(); ++i) {
+            Source* s = byClass[c][i];
+            const float g = std::min(std::min(s->demandFps * s->quota, minFps), remaining);
+            given[s] = g;
+            remaining -= g;
+        }
+    }
+
+    // 2) El resto, por orden de clase y a partes iguales dentro de la clase
+    for (int c = 0; c < numClasses && remaining > 0.f; ++c) {
+        std::vector<std::pair<float, Source*> > pending;
+        for (size_t i = 0; i < byClass[c].size(); ++i) {
+            Source* s = byClass[c][i];
+            const float extra = s->demandFps * s->quota - given[s];
+            if (extra > 0.f) pending.push_back(std::make_pair(extra, s));
+        }
+        std::sort(pending.begin(), pending.end());
+        for (size_t i = 0; i < pending.size(); ++i) {
+            const float share = remaining / static_cast<float>(pending.size() - i);
+            const float g = std::min(pending[i].first, share);
+            given[pending[i].second] += g;
+            remaining -= g;
+        }
+    }
+
+    for (std::map<Source*, float>::iterator it = given.begin(); it != given.end(); ++it) {
+        Source* s = it->first;
+        s->quota = (s->demandFps > 0.f) ? std::min(1.f, it->second / s->demandFps) : 1.f;
+    }
+}
+
+int QosController::classStats(QosClassStats* out, int maxCount)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const int n = std::min(maxCount, static_cast<int>(m_classes.size()));
+    for (int c = 0; c < n; ++c) {
+        QosClassStats &st = out[c];
+        st.cls = c;
+        st.sources = 0;
+        st.demandFps = st.admittedFps = st.achievedFps = st.reserved = 0.f;
+        st.dropped = 0;
+    }
+    for (std::map<uint32_t, Source>::const_iterator it = m_sources.begin(); it != m_sources.end(); ++it) {
+        const Source &s = it->second;
+        if (s.cls < 0 || s.cls >= n) continue;
+        QosClassStats &st = out[s.cls];
+        ++st.sources;
+        st.demandFps   += s.demandFps;
+        st.admittedFps += s.admittedFps;
+        st.achievedFps += s.achievedFps;
+        st.dropped     += s.dropped;
+    }
+    return n;
+}
+
+float QosController::capacity()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_capacity;
+}
+
+//-------------------------------------------------------------------------------
+// Probes de GStreamer
+//-------------------------------------------------------------------------------
+namespace {
+struct SourceProbe {
+    QosController* qos;
+    uint32_t       sourceId;
+};
+} // namespace
+
+static GstPadProbeReturn sourceProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    (void)pad;
+    const SourceProbe* probe = static_cast<const SourceProbe*>(data);
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    const uint64_t pts = (buffer && GST_BUFFER_PTS_IS_VALID(buffer)) ? GST_BUFFER_PTS(buffer) : kQosNoPts;
+    return probe->qos->admit(probe->sourceId, pts, g_get_monotonic_time()) ? GST_PAD_PROBE_OK
+                                                                            : GST_PAD_PROBE_DROP;
+}
+
+static void freeSourceProbe(gpointer data)
+{
+    delete static_cast<SourceProbe*>(data);
+}
+
+static GstPadProbeReturn processedProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    (void)pad;
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    NvDsBatchMeta* batchMeta = buffer ? gst_buffer_get_nvds_batch_meta(buffer) : nullptr;
+    if (!batchMeta) return GST_PAD_PROBE_OK;
+
+    QosController* qos = static_cast<QosController*>(data);
+    const int64_t now = g_get_monotonic_time();
+    for (NvDsMetaList* l = batchMeta->frame_meta_list; l != nullptr; l = l->next) {
+        const NvDsFrameMeta* frameMeta = static_cast<const NvDsFrameMeta*>(l->data);
+        // nvstreammux conserva el PTS del buffer de la fuente en buf_pts
+        qos->onProcessed(frameMeta->source_id, frameMeta->buf_pts, now);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" void* RetinaFaceQosCreate(const QosConfig* config)
+{
+    if (!config) return nullptr;
+    return new QosController(*config);
+}
+
+extern "C" void RetinaFaceQosDestroy(void* qos)
+{
+    delete static_cast<QosController*>(qos);
+}
+
+extern "C" int RetinaFaceQosAddClass(void* qos, const QosClassConfig* cls)
+{
+    if (!qos || !cls) return -1;
+    return static_cast<QosController*>(qos)->addClass(*cls);
+}
+
+extern "C" int RetinaFaceQosAttachSource(void* qos, GstPad* pad, uint32_t sourceId, int cls)
+{
+    if (!qos || !pad) return 0;
+    QosController* controller = static_cast<QosController*>(qos);
+    if (!controller->setSource(sourceId, cls)) return 0;
+
+    SourceProbe* probe = new SourceProbe();
+    probe->qos = controller;
+    probe->sourceId = sourceId;
+    return gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, sourceProbe, probe, freeSourceProbe) != 0;
+}
+
+extern "C" int RetinaFaceQosAttachProcessed(void* qos, GstPad* pad)
+{
+    if (!qos || !pad) return 0;
+    QosController* controller = static_cast<QosController*>(qos);
+    if (gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, processedProbe, controller, nullptr) == 0) return 0;
+    controller->setProcessedProbe(true);
+    return 1;
+}
+
+extern "C" int RetinaFaceQosGetClassStats(void* qos, QosClassStats* out, int maxCount)
+{
+    if (!qos || !out || maxCount <= 0) return 0;
+    return static_cast<QosController*>(qos)->classStats(out, maxCount);
+}
+
+extern "C" float RetinaFaceQosGetCapacity(void* qos)
+{
+    return qos ? static_cast<QosController*>(qos)->capacity() : 0.f;
+}
@@ -0,0 +1,147 @@
+/******************************************************************************
+ * retinaface_qos.h
+ *
+ * Control de admisión por clases de QoS antes de nvstreammux: con sobrecarga
+ * se diezman primero las fuentes de clases bajas y se garantiza un mínimo de
+ * FPS por fuente a las clases altas
+ ******************************************************************************/
+
+#ifndef RETINAFACE_QOS_H
+#define RETINAFACE_QOS_H
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <gst/gst.h>
+
+/** @brief PTS desconocido: el frame se empareja por orden de llegada. */
+static const uint64_t kQosNoPts = UINT64_MAX;
+
+/**
+ * @brief Clase de QoS. El índice de la clase es su prioridad (0 = la más alta).
+ */
+struct QosClassConfig {
+    float minFps;   /**< FPS garantizados por fuente de la clase */
+    float maxFps;   /**< Tope por fuente aunque sobre capacidad (<= 0: sin tope) */
+};
+
+/**
+ * @brief Parámetros del controlador.
+ */
+struct QosConfig {
+    float capacityFps;     /**< Frames/s que admite la inferencia; <= 0: se estima */
+    int   maxInflight;     /**< Frames en cola por encima del régimen (ritmo × latencia
+                                base) que indican sobrecarga */
+    int   updatePeriodMs;  /**< Periodo de recálculo de cuotas */
+};
+
+/**
+ * @brief Métricas de una clase en el último periodo.
+ */
+struct QosClassStats {
+    int32_t  cls;
+    int32_t  sources;
+    float    demandFps;    /**< Frames/s que llegan de las fuentes */
+    float    admittedFps;  /**< Frames/s que pasan a nvstreammux */
+    float    achievedFps;  /**< Frames/s que salen de la inferencia */
+    float    reserved;
+    uint64_t dropped;      /**< Frames descartados desde el inicio */
+};
+
+/**
+ * @brief Controlador de admisión. Cada periodo estima la demanda de cada
+ *        fuente y reparte la capacidad: primero el mínimo garantizado por
+ *        orden de clase, luego el resto también por orden de clase y a partes
+ *        iguales dentro de cada clase. Cada fuente se diezma de forma
+ *        uniforme a su cuota. Thread-safe.
+ */
+class QosController {
+public:
+    explicit QosController(const QosConfig &config);
+
+    /** @return Índice de la clase nueva. */
+    int addClass(const QosClassConfig &cls);
+
+    bool setSource(uint32_t sourceId, int cls);
+
+    /**
+     * @brief Decide si el frame entrante de la fuente pasa a nvstreammux.
+     *
+     * @param pts PTS del buffer (kQosNoPts si no tiene); empareja el frame
+     *            con su salida para medir la latencia.
+     */
+    bool admit(uint32_t sourceId, uint64_t pts, int64_t nowUs);
+
+    /** @brief Notifica un frame de la fuente que salió de la inferencia. */
+    void onProcessed(uint32_t sourceId, uint64_t pts, int64_t nowUs);
+
+    /** @brief Hay un probe de frames procesados (necesario para estimar la capacidad). */
+    void setProcessedProbe(bool attached);
+
+    int classStats(QosClassStats* out, int maxCount);
+
+    /** @brief Capacidad vigente en frames/s (0 si no hay sobrecarga detectada). */
+    float capacity();
+
+private:
+    struct Pending {
+        uint64_t pts;
+        int64_t  admittedUs;
+    };
+
+    struct Source {
+        int      cls;
+        uint32_t arrivals;     // Contadores del periodo en curso
+        uint32_t admitted;
+        uint32_t processed;
+        float    demandFps;    // Estimaciones suavizadas
+        float    admittedFps;
+        float    achievedFps;
+        float    quota;        // Fracción de frames a admitir (0..1)
+        float    credit;       // Acumulador del diezmado uniforme
+        uint64_t dropped;
+        std::deque<Pending> pending;   // Admitidos sin procesar, en orden
+
+        Source() : cls(0), arrivals(0), admitted(0), processed(0), demandFps(0.f), admittedFps(0.f),
+                   achievedFps(0.f), quota(1.f), credit(0.f), dropped(0) {}
+    };
+
+    void update(int64_t nowUs);
+    void allocate(float budget);
+
+    QosConfig                     m_config;
+    std::vector<QosClassConfig>   m_classes;
+    std::map<uint32_t, Source>    m_sources;
+    int64_t                       m_periodStartUs;
+    int64_t                       m_inflight;       // Suma de Source::pending
+    int64_t                       m_latencySumUs;   // Latencias del periodo en curso
+    uint32_t                      m_latencySamples;
+    int64_t                       m_windowMinUs;    // Latencia media mínima de la ventana en curso
+    int64_t                       m_prevWindowMinUs;
+    int                           m_windowPeriods;
+    float                         m_capacity;       // 0 = sin límite conocido
+    bool                          m_hasProcessedProbe;
+    std::mutex                    m_mutex;
+};
+
+extern "C" {
+void* RetinaFaceQosCreate(const QosConfig* config);
+void  RetinaFaceQosDestroy(void* qos);
+int   RetinaFaceQosAddClass(void* qos, const QosClassConfig* cls);
+
+/**
+ * @brief Instala un probe en el pad src de la fuente (antes de nvstreammux)
+ *        que descarta los frames no admitidos. `sourceId` es el índice del
+ *        pad sink_%u de nvstreammux, que luego aparece como source_id.
+ */
+int   RetinaFaceQosAttachSource(void* qos, GstPad* pad, uint32_t sourceId, int cls);
+
+/** @brief Instala un probe que cuenta los frames del batch tras la inferencia. */
+int   RetinaFaceQosAttachProcessed(void* qos, GstPad* pad);
+
+int   RetinaFaceQosGetClassStats(void* qos, QosClassStats* out, int maxCount);
+float RetinaFaceQosGetCapacity(void* qos);
+}
+
+#endif // RETINAFACE_QOS_H
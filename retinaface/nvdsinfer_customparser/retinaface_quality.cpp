@@ -0,0 +1,416 @@
+/******************************************************************************
+ * retinaface_quality.cpp
+ *
+ * Nitidez por varianza del Laplaciano sobre un parche de luma de tamaño fijo.
+ * El bbox se remuestrea a 32x32 con filtro de área (cada píxel del bbox se
+ * lee una vez, sin el aliasing del vecino más cercano), así que la varianza
+ * es comparable entre rostros de distinto tamaño. El Laplaciano son 900
+ * píxeles por rostro en int16 (8 por instrucción en SSE2/NEON).
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "retinaface_quality.h"
+
+static const int kPatch = kQualityPatchSize;
+
+//-------------------------------------------------------------------------------
+// Pesos verticales de remuestreo del bbox a kPatch filas: al reducir, área
+// (fracción de cada fila fuente cubierta por la muestra); al ampliar,
+// bilineal. Fuera del frame se repite el borde. Los pesos de cada muestra
+// suman 1 y las filas de los taps no decrecen.
+//-------------------------------------------------------------------------------
+struct AxisTaps {
+    int                first[kPatch + 1];  // Taps de la muestra i: [first[i], first[i + 1])
+    std::vector<int>   index;
+    std::vector<float> weight;
+};
+
+static void buildAxisTaps(float start, float length, int limit, AxisTaps &taps)
+{
+    const float scale = length / kPatch;
+    taps.index.clear();
+    taps.weight.clear();
+    for (int i = 0; i < kPatch; ++i) {
+        taps.first[i] = static_cast<int>(taps.index.size());
+        if (scale > 1.f) {
+            const float a = start + i * scale;
+            const float b = a + scale;
+            for (int s = static_cast<int>(std::floor(a)); s < b; ++s) {
+                const float cover = std::min(b, s + 1.f) - std::max(a, static_cast<float>(s));
+                if (cover <= 0.f) continue;
+                taps.index.push_back(std::min(std::max(s, 0), limit - 1));
+                taps.weight.push_back(cover / scale);
+            }
+        } else {
+            const float c = start + (i + 0.5f) * scale - 0.5f;
+            const int s = static_cast<int>(std::floor(c));
+            const float f = c - s;
+            taps.index.push_back(std::min(std::max(s, 0), limit - 1));
+            taps.weight.push_back(1.f - f);
+            taps.index.push_back(std::min(std::max(s + 1, 0), limit - 1));
+            taps.weight.push_back(f);
+        }
+    }
+    taps.first[kPatch] = static_cast<int>(taps.index.size());
+}
+
+//-------------------------------------------------------------------------------
+// Remuestreo horizontal de una fila ya filtrada en vertical. Al reducir, cada
+// muestra es la integral de [a, b) sacada de la suma prefija de la fila (dos
+// lecturas por muestra); al ampliar, bilineal entre las dos columnas vecinas.
+// Las posiciones no dependen de la fila y se calculan una vez por bbox.
+//-------------------------------------------------------------------------------
+class ColumnSampler {
+public:
+    ColumnSampler(float start, float length, int frameW)
+    {
+        const float scale = length / kPatch;
+        m_area  = scale > 1.f;
+        m_norm  = 1.f / scale;
+        m_first = static_cast<int>(std::floor(start)) - 1;
+        m_span  = static_cast<int>(std::ceil(length)) + 3;
+        m_inside0 = std::min(std::max(-m_first, 0), m_span);
+        m_inside1 = std::max(std::min(frameW - m_first, m_span), m_inside0);
+        m_prefix.resize(m_span + 1);
+
+        const float offset = start - m_first;
+        for (int i = 0; i <= kPatch; ++i) {
+            const float pos = m_area ? offset + i * scale : offset + (i + 0.5f) * scale - 0.5f;
+            m_index[i] = std::min(std::max(static_cast<int>(std::floor(pos)), 0), m_span - 2);
+            m_frac[i]  = pos - m_index[i];
+        }
+    }
+
+    int   first() const { return m_first; }
+    int   span() const { return m_span; }
+    int   inside0() const { return m_inside0; }  // [inside0, inside1): columnas dentro del frame
+    int   inside1() const { return m_inside1; }
+
+    void sample(const float* line, float* out)
+    {
+        if (m_area) {
+            m_prefix[0] = 0.f;
+            for (int k = 0; k < m_span; ++k) m_prefix[k + 1] = m_prefix[k] + line[k];
+            for (int i = 0; i < kPatch; ++i) {
+                const int ka = m_index[i], kb = m_index[i + 1];
+                out[i] = (m_prefix[kb] - m_prefix[ka] + m_frac[i + 1] * line[kb] - m_frac[i] * line[ka]) * m_norm;
+            }
+        } else {
+            for (int i = 0; i < kPatch; ++i) {
+                const int k = m_index[i];
+                out[i] = (1.f - m_frac[i]) * line[k] + m_frac[i] * line[k + 1];
+            }
+        }
+    }
+
+private:
+    bool               m_area;
+    float              m_norm;
+    int                m_first;    // Columna del frame de line[0]
+    int                m_span;
+    int                m_inside0;
+    int                m_inside1;
+    int                m_index[kPatch + 1];
+    float              m_frac[kPatch + 1];
+    std::vector<float> m_prefix;
+};
+
+static inline float lumaAt(const uint8_t* p)
+{
+    return static_cast<float>(77 * p[0] + 150 * p[1] + 29 * p[2]);
+}
+
+//-------------------------------------------------------------------------------
+// Parche de luma (BT.601 x256) del bbox: filtro separable, primero vertical
+// sobre las columnas del bbox (contiguo, vectorizable) y luego horizontal una
+// vez por fila del parche
+//-------------------------------------------------------------------------------
+static void sampleLumaPatch(const uint8_t* rgba, int pitch, int frameW, int frameH,
+                            const float box[4], uint8_t* patch)
+{
+    AxisTaps yt;
+    buildAxisTaps(box[1], box[3], frameH, yt);
+    ColumnSampler cols(box[0], box[2], frameW);
+
+    const int span = cols.span();
+    std::vector<float> luma(span), line(span);
+    int rowIndex = -1;
+    for (int y = 0; y < kPatch; ++y) {
+        std::fill(line.begin(), line.end(), 0.f);
+        for (int ty = yt.first[y]; ty < yt.first[y + 1]; ++ty) {
+            if (yt.index[ty] != rowIndex) {
+                // Fuera del frame se repite la columna del borde
+                rowIndex = yt.index[ty];
+                const uint8_t* row = rgba + static_cast<size_t>(rowIndex) * pitch;
+                const uint8_t* p = row + 4 * (cols.first() + cols.inside0());
+                for (int k = cols.inside0(); k < cols.inside1(); ++k, p += 4) luma[k] = lumaAt(p);
+                for (int k = 0; k < cols.inside0(); ++k) luma[k] = lumaAt(row);
+                for (int k = cols.inside1(); k < span; ++k) luma[k] = lumaAt(row + 4 * (frameW - 1));
+            }
+            const float wy = yt.weight[ty];
+            for (int k = 0; k < span; ++k) line[k] += wy * luma[k];
+        }
+
+        float out[kPatch];
+        cols.sample(&line[0], out);
+        uint8_t* dst = patch + y * kPatch;
+        for (int x = 0; x < kPatch; ++x) {
+            dst[x] = static_cast<uint8_t>(std::min(255.f, std::max(0.f, out[x] * (1.f / 256.f) + 0.5f)));
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Laplaciano 4-vecinos: L = 4c - arriba - abajo - izq - der. |L| <= 1020, así
+// que L cabe en int16 y L*L en int32.
+//-------------------------------------------------------------------------------
+static float laplacianVariance(const uint8_t* patch, int P)
+{
+    int64_t sum = 0;
+    int64_t sumSq = 0;
+
+    for (int y = 1; y < P - 1; ++y) {
+        const uint8_t* up  = patch + (y - 1) * P;
+        const uint8_t* mid = patch + y * P;
+        const uint8_t* dn  = patch + (y + 1) * P;
+        int x = 1;
+
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i accSum = _mm_setzero_si128();
+        __m128i accSq  = _mm_setzero_si128();
+        for (; x + 8 <= P - 1; x += 8) {
+            const __m128i c = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(mid + x)), zero);
+            const __m128i l = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(mid + x - 1)), zero);
+            const __m128i r = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(mid + x + 1)), zero);
+            const __m128i u = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(up + x)), zero);
+            const __m128i d = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(dn + x)), zero);
+            const __m128i lap = _mm_sub_epi16(_mm_slli_epi16(c, 2),
+                                              _mm_add_epi16(_mm_add_epi16(l, r), _mm_add_epi16(u, d)));
+            accSum = _mm_add_epi32(accSum, _mm_madd_epi16(lap, ones));
+            accSq  = _mm_add_epi32(accSq,  _mm_madd_epi16(lap, lap));
+        }
+        int32_t s[4], q[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(s), accSum);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(q), accSq);
+        sum   += static_cast<int64_t>(s[0]) + s[1] + s[2] + s[3];
+        sumSq += static_cast<int64_t>(q[0]) + q[1] + q[2] + q[3];
+#elif defined(__ARM_NEON)
+        int32x4_t accSum = vdupq_n_s32(0);
+        int32x4_t accSq  = vdupq_n_s32(0);
+        for (; x + 8 <= P - 1; x += 8) {
+            const int16x8_t c = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(mid + x)));
+            const int16x8_t l = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(mid + x - 1)));
+            const int16x8_t r = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(mid + x + 1)));
+            const int16x8_t u = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(up + x)));
+            const int16x8_t d = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(dn + x)));
+            const int16x8_t lap = vsubq_s16(vshlq_n_s16(c, 2), vaddq_s16(vaddq_s16(l, r), vaddq_s16(u, d)));
+            accSum = vpadalq_s16(accSum, lap);
+            accSq  = vmlal_s16(accSq, vget_low_s16(lap), vget_low_s16(lap));
+            accSq  = vmlal_s16(accSq, vget_high_s16(lap), vget_high_s16(lap));
+        }
+        sum   += vgetq_lane_s32(accSum, 0) + vgetq_lane_s32(accSum, 1) +
+                 vgetq_lane_s32(accSum, 2) + vgetq_lane_s32(accSum, 3);
+        sumSq += static_cast<int64_t>(vgetq_lane_s32(accSq, 0)) + vgetq_lane_s32(accSq, 1) +
+                 vgetq_lane_s32(accSq, 2) + vgetq_lane_s32(accSq, 3);
+#endif
+        for (; x < P - 1; ++x) {
+            const int lap = 4 * mid[x] - mid[x - 1] - mid[x + 1] - up[x] - dn[x];
+            sum   += lap;
+            sumSq += lap * lap;
+        }
+    }
+
+    const double n = static_cast<double>(P - 2) * (P - 2);
+    const double mean = sum / n;
+    return static_cast<float>(sumSq / n - mean * mean);
+}
+
+float faceSharpness(const uint8_t* rgba, int pitch, int frameW, int frameH, const float box[4])
+{
+    if (!rgba || frameW <= 0 || frameH <= 0 || box[2] <= 0.f || box[3] <= 0.f) return -1.f;
+
+    uint8_t patch[kPatch * kPatch];
+    sampleLumaPatch(rgba, pitch, frameW, frameH, box, patch);
+    return laplacianVariance(patch, kPatch);
+}
+
+//-------------------------------------------------------------------------------
+// Yaw aproximado: desplazamiento horizontal de la nariz respecto del centro de
+// los ojos, normalizado por media distancia entre ojos.
+//-------------------------------------------------------------------------------
+static float yawProxy(const float* lm)
+{
+    const float eyeDist = std::fabs(lm[2] - lm[0]);
+    if (eyeDist < 1e-3f) return 1.f;
+    const float midX = 0.5f * (lm[0] + lm[2]);
+    return std::min(1.f, 2.f * std::fabs(lm[4] - midX) / eyeDist);
+}
+
+int evaluateFaceQuality(const uint8_t* rgba, int pitch, int frameW, int frameH,
+                        const float* boxes, const float* scores, const float* landmarks,
+                        int count, const FaceQualityGates &gates, FaceQuality* out)
+{
+    int passed = 0;
+    for (int i = 0; i < count; ++i) {
+        const float* box = boxes + 4 * i;
+        FaceQuality &q = out[i];
+        q.sharpness = -1.f;
+        q.yaw       = landmarks ? yawProxy(landmarks + 10 * i) : -1.f;
+        q.score     = 0.f;
+        q.passed    = 0;
+
+        // 1) Filtros baratos: confianza, tamaño, pose
+        const float conf = scores ? scores[i] : 1.f;
+        const float minSide = std::min(box[2], box[3]);
+        if (conf < gates.minScore || minSide < gates.minSize) continue;
+        if (q.yaw >= 0.f && q.yaw > gates.maxYaw) continue;
+
+        // 2) Nitidez solo para los que pasan
+        q.passed = 1;
+        q.sharpness = faceSharpness(rgba, pitch, frameW, frameH, box);
+        ++passed;
+
+        const float sizeFactor  = std::min(1.f, minSide / 112.f);
+        const float sharpFactor = q.sharpness / (q.sharpness + std::max(gates.sharpnessRef, 1e-3f));
+        const float poseFactor  = q.yaw >= 0.f ? 1.f - 0.5f * q.yaw : 1.f;
+        q.score = conf * sizeFactor * sharpFactor * poseFactor;
+    }
+    return passed;
+}
+
+//-------------------------------------------------------------------------------
+// BestShotSelector
+//-------------------------------------------------------------------------------
+BestShotSelector::BestShotSelector(uint64_t maxAgeFrames)
+    : m_maxAgeFrames(maxAgeFrames), m_expired(0)
+{
+}
+
+// Olvida los tracks del stream sin offer() en maxAgeFrames; se recorre como
+// mucho una vez cada maxAgeFrames / 4 frames del stream, así que un track
+// vive a lo sumo 1.25 * maxAgeFrames
+void BestShotSelector::expireStream(uint32_t streamId, uint64_t frameNum)
+{
+    if (m_maxAgeFrames == 0) return;
+    uint64_t &nextSweep = m_nextSweep[streamId];
+    if (frameNum < nextSweep) return;
+    nextSweep = frameNum + std::max<uint64_t>(m_maxAgeFrames / 4, 1);
+
+    for (std::unordered_map<uint64_t, Entry>::iterator it = m_best.begin(); it != m_best.end();) {
+        if (it->second.streamId == streamId && frameNum > it->second.lastFrameNum + m_maxAgeFrames) {
+            it = m_best.erase(it);
+            ++m_expired;
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool BestShotSelector::offer(uint32_t streamId, uint64_t trackId, uint64_t frameNum,
+                             const FaceQuality &quality, const float box[4])
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    expireStream(streamId, frameNum);
+
+    // Cualquier oferta, aunque no mejore la toma, mantiene vivo el track
+    std::unordered_map<uint64_t, Entry>::iterator it = m_best.find(key(streamId, trackId));
+    if (it != m_best.end()) it->second.lastFrameNum = std::max(it->second.lastFrameNum, frameNum);
+    if (!quality.passed) return false;
+    if (it != m_best.end() && it->second.shot.score >= quality.score) return false;
+
+    Entry &entry = m_best[key(streamId, trackId)];
+    entry.streamId = streamId;
+    entry.lastFrameNum = std::max(entry.lastFrameNum, frameNum);
+    entry.shot.frameNum = frameNum;
+    entry.shot.score    = quality.score;
+    std::memcpy(entry.shot.box, box, sizeof(entry.shot.box));
+    return true;
+}
+
+bool BestShotSelector::take(uint32_t streamId, uint64_t trackId, Shot &shot)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unordered_map<uint64_t, Entry>::iterator it = m_best.find(key(streamId, trackId));
+    if (it == m_best.end()) return false;
+    shot = it->second.shot;
+    m_best.erase(it);
+    return true;
+}
+
+void BestShotSelector::forget(uint32_t streamId, uint64_t trackId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_best.erase(key(streamId, trackId));
+}
+
+uint64_t BestShotSelector::expired()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_expired;
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" int RetinaFaceEvaluateQuality(const uint8_t* rgba, int pitch, int frameW, int frameH,
+                                         const float* boxes, const float* scores,
+                                         const float* landmarks, int count,
+                                         const FaceQualityGates* gates, FaceQuality* out)
+{
+    if (!boxes || !gates || !out || count <= 0) return 0;
+    return evaluateFaceQuality(rgba, pitch, frameW, frameH, boxes, scores, landmarks,
+                               count, *gates, out);
+}
+
+extern "C" void* RetinaFaceBestShotCreate(uint64_t maxAgeFrames)
+{
+    return new BestShotSelector(maxAgeFrames);
+}
+
+extern "C" void RetinaFaceBestShotDestroy(void* selector)
+{
+    delete static_cast<BestShotSelector*>(selector);
+}
+
+extern "C" int RetinaFaceBestShotOffer(void* selector, uint32_t streamId, uint64_t trackId,
+                                       uint64_t frameNum, const FaceQuality* quality,
+                                       const float* box)
+{
+    if (!selector || !quality || !box) return 0;
+    return static_cast<BestShotSelector*>(selector)->offer(streamId, trackId, frameNum,
+                                                           *quality, box) ? 1 : 0;
+}
+
+extern "C" int RetinaFaceBestShotTake(void* selector, uint32_t streamId, uint64_t trackId,
+                                      uint64_t* frameNum, float* score, float* box)
+{
+    if (!selector) return 0;
+    BestShotSelector::Shot shot;
+    if (!static_cast<BestShotSelector*>(selector)->take(streamId, trackId, shot)) return 0;
+    if (frameNum) *frameNum = shot.frameNum;
+    if (score) *score = shot.score;
+    if (box) std::memcpy(box, shot.box, sizeof(shot.box));
+    return 1;
+}
+
+extern "C" void RetinaFaceBestShotForget(void* selector, uint32_t streamId, uint64_t trackId)
+{
+    if (selector) static_cast<BestShotSelector*>(selector)->forget(streamId, trackId);
+}
+
+extern "C" uint64_t RetinaFaceBestShotExpired(void* selector)
+{
+    return selector ? static_cast<BestShotSelector*>(selector)->expired() : 0;
+}
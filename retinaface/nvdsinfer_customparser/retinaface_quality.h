@@ -0,0 +1,151 @@
+/******************************************************************************
+ * retinaface_quality.h
+ *
+ * Calidad por rostro (nitidez, pose) y selección de la mejor toma por track
+ ******************************************************************************/
+
+#ifndef RETINAFACE_QUALITY_H
+#define RETINAFACE_QUALITY_H
+#include <stdint.h>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+/** @brief Lado del parche de luma sobre el que se mide la nitidez. */
+static const int kQualityPatchSize = 32;
+
+/**
+ * @brief Entrada de NvDsObjectMeta::misc_obj_info donde attachFaceQuality()
+ *        deja FaceQuality.score: etiqueta en los 32 bits altos y el float en
+ *        los bajos (ver encodeQualityMeta).
+ */
+static const int      kQualityMiscSlot = 0;
+static const uint32_t kQualityMiscTag  = 0x52465131;  // "RFQ1"
+
+/**
+ * @brief Filtros baratos que se evalúan antes de medir la nitidez.
+ */
+struct FaceQualityGates {
+    float minScore;     /**< Confianza mínima del detector */
+    float minSize;      /**< Lado mínimo del bbox en píxeles */
+    float maxYaw;       /**< Máximo desplazamiento nariz/centro de ojos (0..1), con landmarks */
+    float sharpnessRef; /**< Varianza del Laplaciano que puntúa 0.5 en bestShotScore */
+};
+
+/**
+ * @brief Calidad asociada a cada detección.
+ */
+struct FaceQuality {
+    float   sharpness;  /**< Varianza del Laplaciano (-1 si no se calculó) */
+    float   yaw;        /**< Proxy de yaw en [0, 1] (0 = frontal), -1 sin landmarks */
+    float   score;      /**< Puntuación combinada para best-shot (0 si no pasó los filtros) */
+    int32_t passed;     /**< 1 si pasó los filtros baratos */
+};
+
+/**
+ * @brief Varianza del Laplaciano 3x3 sobre el bbox remuestreado a un parche
+ *        de luma de kQualityPatchSize x kQualityPatchSize (filtro de área al
+ *        reducir, bilineal al ampliar), así que es comparable entre tamaños.
+ *
+ * @param rgba      Frame RGBA.
+ * @param pitch     Bytes por fila.
+ * @param frameW    Ancho del frame.
+ * @param frameH    Alto del frame.
+ * @param box       BBox [left, top, width, height].
+ */
+float faceSharpness(const uint8_t* rgba, int pitch, int frameW, int frameH, const float box[4]);
+
+/** @brief Codifica un score de calidad para misc_obj_info[kQualityMiscSlot]. */
+inline int64_t encodeQualityMeta(float score)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &score, sizeof(bits));
+    return static_cast<int64_t>((static_cast<uint64_t>(kQualityMiscTag) << 32) | bits);
+}
+
+/** @return `true` y el score si `value` lo escribió encodeQualityMeta(). */
+inline bool decodeQualityMeta(int64_t value, float &score)
+{
+    const uint64_t v = static_cast<uint64_t>(value);
+    if (static_cast<uint32_t>(v >> 32) != kQualityMiscTag) return false;
+    const uint32_t bits = static_cast<uint32_t>(v);
+    std::memcpy(&score, &bits, sizeof(score));
+    return true;
+}
+
+/**
+ * @brief Evalúa filtros baratos y, solo para los rostros que los pasan,
+ *        la nitidez. `landmarks` puede ser nullptr.
+ *
+ * @return Número de rostros que pasaron los filtros.
+ */
+int evaluateFaceQuality(const uint8_t* rgba, int pitch, int frameW, int frameH,
+                        const float* boxes, const float* scores, const float* landmarks,
+                        int count, const FaceQualityGates &gates, FaceQuality* out);
+
+/**
+ * @brief Guarda por track la mejor toma vista hasta ahora. Las entradas se
+ *        olvidan con take()/forget() cuando el tracker pierde el track, o solas
+ *        cuando el track lleva más de maxAgeFrames frames sin ofrecerse.
+ *        Thread-safe.
+ */
+class BestShotSelector {
+public:
+    struct Shot {
+        uint64_t frameNum;
+        float    score;
+        float    box[4];
+    };
+
+    /** @param maxAgeFrames Frames sin offer() tras los que se olvida un track (0: nunca). */
+    explicit BestShotSelector(uint64_t maxAgeFrames = 0);
+
+    /** @return `true` si la toma mejora la mejor guardada del track. */
+    bool offer(uint32_t streamId, uint64_t trackId, uint64_t frameNum,
+               const FaceQuality &quality, const float box[4]);
+
+    /** @brief Extrae (y olvida) la mejor toma del track; `false` si no hay. */
+    bool take(uint32_t streamId, uint64_t trackId, Shot &shot);
+
+    /** @brief Olvida el track sin devolver su toma (p.ej. al perderlo el tracker). */
+    void forget(uint32_t streamId, uint64_t trackId);
+
+    /** @brief Tracks olvidados por edad desde la creación. */
+    uint64_t expired();
+
+private:
+    struct Entry {
+        Shot     shot;
+        uint32_t streamId;
+        uint64_t lastFrameNum;  // Último frame en que se ofreció el track
+    };
+
+    void expireStream(uint32_t streamId, uint64_t frameNum);
+
+    static uint64_t key(uint32_t streamId, uint64_t trackId)
+    {
+        return (static_cast<uint64_t>(streamId) << 48) ^ trackId;
+    }
+
+    uint64_t                                m_maxAgeFrames;
+    uint64_t                                m_expired;
+    std::unordered_map<uint64_t, Entry>     m_best;
+    std::unordered_map<uint32_t, uint64_t>  m_nextSweep;  // Por stream: frame de la próxima purga
+    std::mutex                              m_mutex;
+};
+
+extern "C" {
+int   RetinaFaceEvaluateQuality(const uint8_t* rgba, int pitch, int frameW, int frameH,
+                                const float* boxes, const float* scores, const float* landmarks,
+                                int count, const FaceQualityGates* gates, FaceQuality* out);
+void* RetinaFaceBestShotCreate(uint64_t maxAgeFrames);
+void  RetinaFaceBestShotDestroy(void* selector);
+int   RetinaFaceBestShotOffer(void* selector, uint32_t streamId, uint64_t trackId,
+                              uint64_t frameNum, const FaceQuality* quality, const float* box);
+int   RetinaFaceBestShotTake(void* selector, uint32_t streamId, uint64_t trackId,
+                             uint64_t* frameNum, float* score, float* box);
+void  RetinaFaceBestShotForget(void* selector, uint32_t streamId, uint64_t trackId);
+uint64_t RetinaFaceBestShotExpired(void* selector);
+}
+
+#endif // RETINAFACE_QUALITY_H
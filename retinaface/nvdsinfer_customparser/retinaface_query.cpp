@@ -0,0 +1,341 @@
+/******************************************************************************
+ * retinaface_query.cpp
+ *
+ * Motor de consultas del archivo de detecciones. Cada bloque se poda con su
+ * cabecera (stream, track, rango de ts, score máximo, rango de tamaños y
+ * caja envolvente). Los supervivientes se decodifican a columnas y los
+ * predicados de ts/score/tamaño se evalúan con enteros cuantizados, 8 (AVX2)
+ * o 4 (SSE2) registros por instrucción. El polígono de zona solo se prueba
+ * con los registros que pasan el resto de filtros.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <thread>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "retinaface_analytics.h"
+#include "retinaface_query.h"
+
+namespace {
+
+struct BlockRef {
+    int segment;
+    int block;
+};
+
+// Umbrales de la consulta expresados en las unidades cuantizadas del bloque
+struct Thresholds {
+    int32_t tsLo, tsHi;
+    int32_t scoreMin;
+    int32_t sizeMin, sizeMax;
+};
+
+struct CompiledQuery {
+    ArchiveQuery query;
+    bool         hasZone;
+    ZoneGrid     zone;
+    float        zoneBounds[4];
+};
+
+struct WorkerState {
+    std::vector<QueryHit> hits;
+    std::vector<BlockRef> blocks;
+    std::vector<uint8_t>  payload;
+    std::vector<int32_t>  channels;
+    std::vector<uint16_t> candidates;
+    uint64_t              blocksScanned;
+    uint64_t              recordsScanned;
+
+    WorkerState() : blocksScanned(0), recordsScanned(0) {}
+};
+
+} // namespace
+
+static int32_t clampToInt32(double v)
+{
+    return static_cast<int32_t>(std::max(std::min(v, 2147483647.0), -2147483648.0));
+}
+
+static bool blockMayMatch(const ArchiveBlockInfo &b, const CompiledQuery &cq, float coordStep)
+{
+    const ArchiveQuery &q = cq.query;
+    // Holgura por la cuantización: lo decodificado puede diferir de lo escrito
+    const float tol = coordStep;
+    if (q.streamId >= 0 && b.streamId != static_cast<uint32_t>(q.streamId)) return false;
+    if (q.trackId != kQueryAnyTrack && b.trackId != q.trackId) return false;
+    if (b.lastTsMs < q.t0 || b.firstTsMs > q.t1) return false;
+    if (b.maxScore + 1.f / kArchiveScoreScale < q.minScore) return false;
+    if (b.maxSize + tol < q.minSize) return false;
+    if (q.maxSize > 0.f && b.minSize - tol > q.maxSize) return false;
+    if (cq.hasZone &&
+        (b.bounds[2] + tol < cq.zoneBounds[0] || b.bounds[0] - tol > cq.zoneBounds[2] ||
+         b.bounds[3] + tol < cq.zoneBounds[1] || b.bounds[1] - tol > cq.zoneBounds[3])) {
+        return false;
+    }
+    return true;
+}
+
+static Thresholds blockThresholds(const ArchiveBlockInfo &b, const ArchiveQuery &q, float coordStep)
+{
+    Thresholds th;
+    th.tsLo     = clampToInt32(static_cast<double>(q.t0) - static_cast<double>(b.firstTsMs));
+    th.tsHi     = clampToInt32(static_cast<double>(q.t1) - static_cast<double>(b.firstTsMs));
+    th.scoreMin = clampToInt32(std::ceil(static_cast<double>(q.minScore) * kArchiveScoreScale));
+    th.sizeMin  = clampToInt32(std::ceil(static_cast<double>(q.minSize) / coordStep));
+    th.sizeMax  = (q.maxSize > 0.f) ? clampToInt32(std::floor(static_cast<double>(q.maxSize) / coordStep))
+                                    : std::numeric_limits<int32_t>::max();
+    return th;
+}
+
+static inline bool passesScalar(const int32_t* ts, const int32_t* score, const int32_t* w,
+                                const int32_t* h, int i, const Thresholds &th)
+{
+    const int32_t size = std::min(w[i], h[i]);
+    return ts[i] >= th.tsLo && ts[i] <= th.tsHi && score[i] >= th.scoreMin &&
+           size >= th.sizeMin && size <= th.sizeMax;
+}
+
+// Índices de los registros del bloque que cumplen ts/score/tamaño
+static int filterColumns(const int32_t* channels, int count, const Thresholds &th, uint16_t* out)
+{
+    const int32_t* ts    = channels + ARCHIVE_CH_TS * count;
+    const int32_t* score = channels + ARCHIVE_CH_SCORE * count;
+    const int32_t* w     = channels + (ARCHIVE_CH_BOX + 2) * count;
+    const int32_t* h     = channels + (ARCHIVE_CH_BOX + 3) * count;
+    int n = 0;
+    int i = 0;
+
+#if defined(__AVX2__)
+    const __m256i tsLo = _mm256_set1_epi32(th.tsLo);
+    const __m256i tsHi = _mm256_set1_epi32(th.tsHi);
+    const __m256i sMin = _mm256_set1_epi32(th.scoreMin);
+    const __m256i zMin = _mm256_set1_epi32(th.sizeMin);
+    const __m256i zMax = _mm256_set1_epi32(th.sizeMax);
+    for (; i + 8 <= count; i += 8) {
+        const __m256i t    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ts + i));
+        const __m256i s    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(score + i));
+        const __m256i size = _mm256_min_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i)),
+                                              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i)));
+        __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi32(tsLo, t), _mm256_cmpgt_epi32(t, tsHi));
+        bad = _mm256_or_si256(bad, _mm256_cmpgt_epi32(sMin, s));
+        bad = _mm256_or_si256(bad, _mm256_cmpgt_epi32(zMin, size));
+        bad = _mm256_or_si256(bad, _mm256_cmpgt_epi32(size, zMax));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(bad))) & 0xFFu;
+        while (mask) {
+            out[n++] = static_cast<uint16_t>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i tsLo = _mm_set1_epi32(th.tsLo);
+    const __m128i tsHi = _mm_set1_epi32(th.tsHi);
+    const __m128i sMin = _mm_set1_epi32(th.scoreMin);
+    const __m128i zMin = _mm_set1_epi32(th.sizeMin);
+    const __m128i zMax = _mm_set1_epi32(th.sizeMax);
+    for (; i + 4 <= count; i += 4) {
+        const __m128i t  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ts + i));
+        const __m128i s  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(score + i));
+        const __m128i vw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+        const __m128i vh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i));
+        // SSE2 no tiene min_epi32: selección con la comparación
+        const __m128i wGreater = _mm_cmpgt_epi32(vw, vh);
+        const __m128i size = _mm_or_si128(_mm_and_si128(wGreater, vh), _mm_andnot_si128(wGreater, vw));
+        __m128i bad = _mm_or_si128(_mm_cmplt_epi32(t, tsLo), _mm_cmpgt_epi32(t, tsHi));
+        bad = _mm_or_si128(bad, _mm_cmplt_epi32(s, sMin));
+        bad = _mm_or_si128(bad, _mm_cmplt_epi32(size, zMin));
+        bad = _mm_or_si128(bad, _mm_cmpgt_epi32(size, zMax));
+        unsigned mask = ~static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(bad))) & 0xFu;
+        while (mask) {
+            out[n++] = static_cast<uint16_t>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        if (passesScalar(ts, score, w, h, i, th)) out[n++] = static_cast<uint16_t>(i);
+    }
+    return n;
+}
+
+static void scanBlocks(const std::vector<std::unique_ptr<ArchiveReader> > &readers,
+                       const std::vector<BlockRef> &blocks, const CompiledQuery &cq,
+                       std::atomic<size_t> &next, std::atomic<uint64_t> &found,
+                       std::atomic<bool> &stop, WorkerState &ws)
+{
+    const ArchiveQuery &q = cq.query;
+    const uint64_t cap = (q.maxResults > 0) ? static_cast<uint64_t>(q.maxResults) : 0;
+
+    while (!stop.load(std::memory_order_relaxed)) {
+        const size_t k = next.fetch_add(1, std::memory_order_relaxed);
+        if (k >= blocks.size()) break;
+
+        const ArchiveReader &reader = *readers[blocks[k].segment];
+        const ArchiveBlockInfo &info = reader.block(blocks[k].block);
+        const int count = static_cast<int>(info.count);
+        if (!reader.readPayload(blocks[k].block, ws.payload)) continue;
+
+        ws.channels.resize(static_cast<size_t>(count) * kArchiveChannels);
+        if (!decodeArchiveChannels(info, &ws.payload[0], &ws.channels[0])) continue;
+        ++ws.blocksScanned;
+        ws.recordsScanned += count;
+
+        const float step = reader.coordStep();
+        ws.candidates.resize(count);
+        const int n = filterColumns(&ws.channels[0], count, blockThresholds(info, q, step), &ws.candidates[0]);
+
+        const int32_t* left = &ws.channels[ARCHIVE_CH_BOX * count];
+        const int32_t* top  = left + count;
+        const int32_t* w    = top + count;
+        const int32_t* h    = w + count;
+        for (int c = 0; c < n; ++c) {
+            const int i = ws.candidates[c];
+            if (cq.hasZone) {
+                const float cx = (left[i] + 0.5f * w[i]) * step;
+                const float cy = (top[i] + 0.5f * h[i]) * step;
+                if (!(cq.zone.query(cx, cy) & 1ULL)) continue;
+            }
+            if (cap > 0 && found.fetch_add(1, std::memory_order_relaxed) >= cap) {
+                stop.store(true, std::memory_order_relaxed);
+                break;
+            }
+            QueryHit hit;
+            hit.streamId = info.streamId;
+            hit.reserved = 0;
+            hit.trackId  = info.trackId;
+            archiveChannelsToRecord(info, &ws.channels[0], step, i, hit.record);
+            ws.hits.push_back(hit);
+        }
+    }
+}
+
+static bool hitBefore(const QueryHit &a, const QueryHit &b)
+{
+    if (a.record.tsMs != b.record.tsMs) return a.record.tsMs < b.record.tsMs;
+    if (a.streamId != b.streamId) return a.streamId < b.streamId;
+    return a.trackId < b.trackId;
+}
+
+bool runArchiveQuery(const char* const* paths, int numPaths, const ArchiveQuery &query,
+                     const float* zoneXY, int zonePoints, std::vector<QueryHit> &hits,
+                     QueryStats &stats)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::memset(&stats, 0, sizeof(stats));
+    hits.clear();
+
+    CompiledQuery cq;
+    cq.query   = query;
+    cq.hasZone = zoneXY && zonePoints > 0;
+    if (cq.hasZone) {
+        if (zonePoints < 3) {
+            std::cerr << "ERROR: la zona de la consulta necesita al menos 3 vértices" << std::endl;
+            return false;
+        }
+        cq.zoneBounds[0] = cq.zoneBounds[2] = zoneXY[0];
+        cq.zoneBounds[1] = cq.zoneBounds[3] = zoneXY[1];
+        for (int p = 1; p < zonePoints; ++p) {
+            cq.zoneBounds[0] = std::min(cq.zoneBounds[0], zoneXY[2*p]);
+            cq.zoneBounds[1] = std::min(cq.zoneBounds[1], zoneXY[2*p + 1]);
+            cq.zoneBounds[2] = std::max(cq.zoneBounds[2], zoneXY[2*p]);
+            cq.zoneBounds[3] = std::max(cq.zoneBounds[3], zoneXY[2*p + 1]);
+        }
+        // Fuera de la rejilla ZoneGrid hace el test exacto, así que basta cubrir el polígono
+        cq.zone.reset(cq.zoneBounds[2] + 1.f, cq.zoneBounds[3] + 1.f, 64, 64);
+        cq.zone.addZone(zoneXY, zonePoints);
+    }
+
+    int numThreads = (query.threads > 0) ? query.threads
+                                         : static_cast<int>(std::thread::hardware_concurrency());
+    numThreads = std::max(1, numThreads);
+    std::vector<WorkerState> workers(numThreads);
+    std::vector<std::thread> threads;
+
+    // 1) Abrir segmentos (leer cabeceras) y podar bloques, en paralelo
+    std::vector<std::unique_ptr<ArchiveReader> > readers(numPaths);
+    std::atomic<size_t> nextSegment(0);
+    for (int t = 0; t < numThreads; ++t) {
+        threads.push_back(std::thread([&, t]() {
+            for (size_t s = nextSegment.fetch_add(1); s < readers.size(); s = nextSegment.fetch_add(1)) {
+                std::unique_ptr<ArchiveReader> reader(new ArchiveReader());
+                if (!reader->open(paths[s])) continue;
+                for (int b = 0; b < reader->blockCount(); ++b) {
+                    if (blockMayMatch(reader->block(b), cq, reader->coordStep())) {
+                        BlockRef ref = { static_cast<int>(s), b };
+                        workers[t].blocks.push_back(ref);
+                    }
+                }
+                readers[s].swap(reader);
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t) threads[t].join();
+    threads.clear();
+
+    std::vector<BlockRef> blocks;
+    for (int t = 0; t < numThreads; ++t) {
+        blocks.insert(blocks.end(), workers[t].blocks.begin(), workers[t].blocks.end());
+        std::vector<BlockRef>().swap(workers[t].blocks);
+    }
+    for (int s = 0; s < numPaths; ++s) {
+        if (!readers[s]) continue;
+        ++stats.segments;
+        stats.blocks += readers[s]->blockCount();
+    }
+    if (stats.segments == 0) return false;
+
+    // 2) Escanear los bloques que sobreviven
+    std::atomic<size_t>   nextBlock(0);
+    std::atomic<uint64_t> found(0);
+    std::atomic<bool>     stop(false);
+    for (int t = 0; t < numThreads; ++t) {
+        threads.push_back(std::thread(scanBlocks, std::cref(readers), std::cref(blocks), std::cref(cq),
+                                      std::ref(nextBlock), std::ref(found), std::ref(stop),
+                                      std::ref(workers[t])));
+    }
+    for (size_t t = 0; t < threads.size(); ++t) threads[t].join();
+
+    for (int t = 0; t < numThreads; ++t) {
+        stats.blocksScanned  += workers[t].blocksScanned;
+        stats.recordsScanned += workers[t].recordsScanned;
+        hits.insert(hits.end(), workers[t].hits.begin(), workers[t].hits.end());
+    }
+    std::sort(hits.begin(), hits.end(), hitBefore);
+
+    stats.hits      = hits.size();
+    stats.truncated = stop.load() ? 1 : 0;
+    stats.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" int RetinaFaceArchiveQuery(const char* const* paths, int numPaths, const ArchiveQuery* query,
+                                      const float* zoneXY, int zonePoints, QueryHit* out, int maxOut,
+                                      QueryStats* stats)
+{
+    if (!paths || numPaths <= 0 || !query || !out || maxOut <= 0) return -1;
+
+    ArchiveQuery q = *query;
+    q.maxResults = (q.maxResults > 0) ? std::min(q.maxResults, maxOut) : maxOut;
+
+    std::vector<QueryHit> hits;
+    QueryStats local;
+    if (!runArchiveQuery(paths, numPaths, q, zoneXY, zonePoints, hits, local)) return -1;
+    if (stats) *stats = local;
+    std::copy(hits.begin(), hits.end(), out);
+    return static_cast<int>(hits.size());
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+ * retinaface_query.h
+ *
+ * Consultas sobre segmentos del archivo de detecciones: poda por bloque con
+ * las cabeceras, predicados vectorizados sobre columnas y escaneo en paralelo
+ ******************************************************************************/
+
+#ifndef RETINAFACE_QUERY_H
+#define RETINAFACE_QUERY_H
+#include <stdint.h>
+#include <vector>
+#include "retinaface_archive.h"
+
+/** @brief Valor de ArchiveQuery::trackId que acepta cualquier track. */
+static const uint64_t kQueryAnyTrack = ~0ULL;
+
+/**
+ * @brief Filtros de una consulta. Todos se combinan con AND.
+ */
+struct ArchiveQuery {
+    int64_t  t0;           /**< Rango de ts_ms, inclusive */
+    int64_t  t1;
+    uint64_t trackId;      /**< kQueryAnyTrack = todos */
+    int32_t  streamId;     /**< -1 = todos */
+    float    minScore;
+    float    minSize;      /**< Sobre min(width, height), en píxeles */
+    float    maxSize;      /**< <= 0: sin límite */
+    int32_t  maxResults;   /**< Tope de resultados; <= 0: sin tope */
+    int32_t  threads;      /**< <= 0: núcleos disponibles */
+};
+
+/**
+ * @brief Detección que cumple la consulta.
+ */
+struct QueryHit {
+    uint32_t      streamId;
+    uint32_t      reserved;
+    uint64_t      trackId;
+    ArchiveRecord record;
+};
+
+/**
+ * @brief Contadores de una consulta.
+ */
+struct QueryStats {
+    uint64_t segments;        /**< Archivos abiertos */
+    uint64_t blocks;          /**< Bloques en total */
+    uint64_t blocksScanned;   /**< Bloques decodificados tras la poda */
+    uint64_t recordsScanned;
+    uint64_t hits;
+    int32_t  truncated;       /**< 1 si se alcanzó maxResults */
+    int32_t  reserved;
+    double   elapsedMs;
+};
+
+/**
+ * @brief Ejecuta una consulta sobre varios segmentos.
+ *
+ * Los segmentos se abren en paralelo. Los bloques que sobreviven a la poda
+ * por stream/track/tiempo/score/tamaño/zona se reparten entre los hilos. Los
+ * resultados salen ordenados por ts; con tope, son los primeros encontrados
+ * (no necesariamente los más antiguos).
+ *
+ * @param zoneXY     Polígono opcional (x,y por vértice) que debe contener el
+ *                   centro de la caja.
+ * @param zonePoints Vértices del polígono (0 = sin filtro de zona).
+ *
+ * @return `false` si ningún segmento se pudo abrir.
+ */
+bool runArchiveQuery(const char* const* paths, int numPaths, const ArchiveQuery &query,
+                     const float* zoneXY, int zonePoints, std::vector<QueryHit> &hits,
+                     QueryStats &stats);
+
+extern "C" {
+int RetinaFaceArchiveQuery(const char* const* paths, int numPaths, const ArchiveQuery* query,
+                           const float* zoneXY, int zonePoints, QueryHit* out, int maxOut,
+                           QueryStats* stats);
+}
+
+#endif // RETINAFACE_QUERY_H
@@ -0,0 +1,142 @@
+/******************************************************************************
+ * retinaface_query_main.cpp
+ *
+ * Herramienta de línea de comandos para consultar segmentos del archivo de
+ * detecciones. Imprime los resultados en CSV por stdout y un resumen por stderr.
+ *
+ *   retinaface_query --from 1700000000000 --to 1700003600000 --stream 0 \
+ *                    --min-score 0.8 --zone 100,100,600,100,600,500 /data/cam0-*.rfa
+ ******************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "retinaface_query.h"
+
+static void usage(const char* argv0)
+{
+    std::cerr << "Uso: " << argv0 << " [opciones] segmento.rfa [segmento.rfa ...]\n"
+              << "  --from MS          ts_ms mínimo (inclusive)\n"
+              << "  --to MS            ts_ms máximo (inclusive)\n"
+              << "  --stream N         solo este stream\n"
+              << "  --track N          solo este track\n"
+              << "  --min-score F      score mínimo\n"
+              << "  --min-size PX      min(ancho, alto) mínimo\n"
+              << "  --max-size PX      min(ancho, alto) máximo\n"
+              << "  --zone x,y,x,y,..  polígono que debe contener el centro de la caja\n"
+              << "  --limit N          tope de resultados (0 = sin tope, por defecto 100000)\n"
+              << "  --threads N        hilos (0 = núcleos disponibles)\n"
+              << "  --landmarks        incluir landmarks en la salida\n";
+}
+
+static bool parseZone(const char* text, std::vector<float> &xy)
+{
+    xy.clear();
+    const char* p = text;
+    while (*p) {
+        char* end = nullptr;
+        const float v = std::strtof(p, &end);
+        if (end == p) return false;
+        xy.push_back(v);
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return xy.size() >= 6 && xy.size() % 2 == 0;
+}
+
+int main(int argc, char** argv)
+{
+    ArchiveQuery query;
+    query.t0         = std::numeric_limits<int64_t>::min();
+    query.t1         = std::numeric_limits<int64_t>::max();
+    query.trackId    = kQueryAnyTrack;
+    query.streamId   = -1;
+    query.minScore   = 0.f;
+    query.minSize    = 0.f;
+    query.maxSize    = 0.f;
+    query.maxResults = 100000;
+    query.threads    = 0;
+
+    std::vector<float> zone;
+    std::vector<const char*> paths;
+    bool landmarks = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--landmarks") {
+            landmarks = true;
+        } else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else if (arg.compare(0, 2, "--") == 0 && !hasValue) {
+            std::cerr << "ERROR: falta el valor de " << arg << std::endl;
+            return 1;
+        } else if (arg == "--from") {
+            query.t0 = std::strtoll(argv[++i], nullptr, 10);
+        } else if (arg == "--to") {
+            query.t1 = std::strtoll(argv[++i], nullptr, 10);
+        } else if (arg == "--stream") {
+            query.streamId = std::atoi(argv[++i]);
+        } else if (arg == "--track") {
+            query.trackId = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--min-score") {
+            query.minScore = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--min-size") {
+            query.minSize = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--max-size") {
+            query.maxSize = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--zone") {
+            if (!parseZone(argv[++i], zone)) {
+                std::cerr << "ERROR: --zone espera al menos 3 vértices x,y" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--limit") {
+            query.maxResults = std::atoi(argv[++i]);
+        } else if (arg == "--threads") {
+            query.threads = std::atoi(argv[++i]);
+        } else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "ERROR: opción desconocida " << arg << std::endl;
+            usage(argv[0]);
+            return 1;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<QueryHit> hits;
+    QueryStats stats;
+    if (!runArchiveQuery(&paths[0], static_cast<int>(paths.size()), query,
+                         zone.empty() ? nullptr : &zone[0], static_cast<int>(zone.size() / 2),
+                         hits, stats)) {
+        return 2;
+    }
+
+    std::printf("stream,track,frame,ts_ms,left,top,width,height,score%s\n",
+                landmarks ? ",landmarks" : "");
+    for (size_t i = 0; i < hits.size(); ++i) {
+        const QueryHit &h = hits[i];
+        const ArchiveRecord &r = h.record;
+        std::printf("%u,%llu,%llu,%lld,%.1f,%.1f,%.1f,%.1f,%.3f", h.streamId,
+                    static_cast<unsigned long long>(h.trackId), static_cast<unsigned long long>(r.frameNum),
+                    static_cast<long long>(r.tsMs), r.box[0], r.box[1], r.box[2], r.box[3], r.score);
+        if (landmarks) {
+            for (int k = 0; k < 10; ++k) std::printf("%c%.1f", k == 0 ? ',' : ';', r.landmarks[k]);
+        }
+        std::printf("\n");
+    }
+
+    std::cerr << "segmentos " << stats.segments << ", bloques " << stats.blocksScanned << "/"
+              << stats.blocks << ", registros " << stats.recordsScanned << ", resultados "
+              << stats.hits << (stats.truncated ? " (truncado)" : "") << ", " << stats.elapsedMs
+              << " ms" << std::endl;
+    return 0;
+}
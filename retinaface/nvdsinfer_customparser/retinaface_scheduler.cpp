@@ -0,0 +1,263 @@
+/******************************************************************************
+ * retinaface_scheduler.cpp
+ *
+ * Implementación del planificador de peticiones de reconocimiento.
+ * La penalización por edad es lineal, así que se puede fijar al encolar:
+ *   q*wq + n*wn - wa*(now - t) = (q*wq + n*wn + wa*t) - wa*now
+ * y el orden entre peticiones no cambia con el tiempo. La novedad sí cambia
+ * (crece con el tiempo y cae con markRecognized), así que se reevalúa al
+ * llegar la petición a la cabeza de su cola.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "retinaface_scheduler.h"
+
+// A partir de 18 constantes de tiempo 1 - exp(-t/T) ya es 1.f en float: las
+// marcas más antiguas no cambian la novedad y se pueden purgar
+static const float kNoveltyHorizon = 18.f;
+
+RecognitionScheduler::RecognitionScheduler(const SchedulerConfig &config)
+    : m_config(config), m_cursor(0), m_epochMs(-1), m_nextPruneMs(0), m_seq(0)
+{
+    if (m_config.maxPendingPerStream <= 0) m_config.maxPendingPerStream = 64;
+    if (m_config.noveltyTimeMs <= 0.f) m_config.noveltyTimeMs = 5000.f;
+    std::memset(&m_stats, 0, sizeof(m_stats));
+}
+
+float RecognitionScheduler::novelty(uint32_t streamId, uint64_t trackId, int64_t nowMs) const
+{
+    std::unordered_map<uint64_t, int64_t>::const_iterator it =
+        m_lastRecognized.find(trackKey(streamId, trackId));
+    if (it == m_lastRecognized.end()) return 1.f;
+    const float dt = static_cast<float>(nowMs - it->second);
+    return 1.f - std::exp(-std::max(dt, 0.f) / m_config.noveltyTimeMs);
+}
+
+double RecognitionScheduler::ageSeconds(int64_t nowMs)
+{
+    if (m_epochMs < 0) m_epochMs = nowMs;
+    return static_cast<double>(nowMs - m_epochMs) / 1000.0;
+}
+
+// Clave con la novedad evaluada en nowMs y la edad anclada al encolado
+double RecognitionScheduler::keyFor(const RecognitionRequest &request, int64_t nowMs) const
+{
+    return m_config.qualityWeight * request.quality +
+           m_config.noveltyWeight * novelty(request.streamId, request.trackId, nowMs) +
+           m_config.agePerSecond * static_cast<double>(request.enqueueMs - m_epochMs) / 1000.0;
+}
+
+void RecognitionScheduler::insert(StreamQueue &sq, const Item &item)
+{
+    Pending &pending = sq.byTrack[item.request.trackId];
+    pending.item = sq.queue.insert(item).first;
+    pending.deadline = (item.request.deadlineMs > 0)
+        ? sq.deadlines.insert(std::make_pair(item.request.deadlineMs, item.request.trackId))
+        : sq.deadlines.end();
+    ++m_stats.pending;
+}
+
+void RecognitionScheduler::erase(StreamQueue &sq, Queue::iterator it)
+{
+    std::unordered_map<uint64_t, Pending>::iterator pending = sq.byTrack.find(it->request.trackId);
+    if (pending->second.deadline != sq.deadlines.end()) sq.deadlines.erase(pending->second.deadline);
+    sq.byTrack.erase(pending);
+    sq.queue.erase(it);
+    --m_stats.pending;
+}
+
+void RecognitionScheduler::rekey(StreamQueue &sq, Queue::iterator it, double key, int64_t nowMs)
+{
+    Item item = *it;
+    item.key = key;
+    item.keyedMs = nowMs;
+    sq.queue.erase(it);
+    sq.byTrack[item.request.trackId].item = sq.queue.insert(item).first;
+}
+
+// Descarta todas las peticiones vencidas del stream, estén donde estén en la cola
+void RecognitionScheduler::expire(StreamQueue &sq, int64_t nowMs)
+{
+    while (!sq.deadlines.empty() && sq.deadlines.begin()->first <= nowMs) {
+        ++m_stats.expired;
+        erase(sq, sq.byTrack[sq.deadlines.begin()->second].item);
+    }
+}
+
+// Olvida los reconocimientos fuera de la ventana de novedad; se recorre como
+// mucho una vez por noveltyTimeMs
+void RecognitionScheduler::pruneRecognized(int64_t nowMs)
+{
+    if (nowMs < m_nextPruneMs) return;
+    m_nextPruneMs = nowMs + static_cast<int64_t>(m_config.noveltyTimeMs);
+
+    const float horizonMs = kNoveltyHorizon * m_config.noveltyTimeMs;
+    for (std::unordered_map<uint64_t, int64_t>::iterator it = m_lastRecognized.begin();
+         it != m_lastRecognized.end();) {
+        if (static_cast<float>(nowMs - it->second) >= horizonMs) {
+            it = m_lastRecognized.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool RecognitionScheduler::submit(const RecognitionRequest &request, int64_t nowMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_stats.submitted;
+
+    if (request.deadlineMs > 0 && request.deadlineMs <= nowMs) {
+        ++m_stats.expired;
+        return false;
+    }
+
+    ageSeconds(nowMs);
+    Item item;
+    item.request = request;
+    item.request.enqueueMs = nowMs;
+    item.seq = m_seq++;
+    item.keyedMs = nowMs;
+    item.key = keyFor(item.request, nowMs);
+
+    StreamQueue &sq = m_streams[request.streamId];
+    expire(sq, nowMs);
+
+    // Una sola petición pendiente por track: gana la de mayor prioridad, con
+    // la novedad de ambas evaluada ahora
+    std::unordered_map<uint64_t, Pending>::iterator prev = sq.byTrack.find(request.trackId);
+    if (prev != sq.byTrack.end()) {
+        ++m_stats.coalesced;
+        if (keyFor(prev->second.item->request, nowMs) >= item.key) return false;
+        erase(sq, prev->second.item);
+    }
+
+    // Cola llena: se descarta la peor (que puede ser la nueva)
+    if (static_cast<int>(sq.queue.size()) >= m_config.maxPendingPerStream) {
+        Queue::iterator worst = --sq.queue.end();
+        ++m_stats.evicted;
+        if (!(item < *worst)) return false;
+        erase(sq, worst);
+    }
+
+    insert(sq, item);
+    return true;
+}
+
+int RecognitionScheduler::pop(RecognitionRequest* out, int maxCount, int64_t nowMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const double ageNow = m_config.agePerSecond * ageSeconds(nowMs);
+    pruneRecognized(nowMs);
+    for (std::map<uint32_t, StreamQueue>::iterator it = m_streams.begin(); it != m_streams.end(); ++it) {
+        expire(it->second, nowMs);
+    }
+
+    int produced = 0;
+    bool progress = true;
+    while (produced < maxCount && progress) {
+        progress = false;
+        std::map<uint32_t, StreamQueue>::iterator it = m_streams.lower_bound(m_cursor);
+        for (size_t n = m_streams.size(); n > 0 && produced < maxCount; --n) {
+            if (it == m_streams.end()) it = m_streams.begin();
+            StreamQueue &sq = it->second;
+
+            while (!sq.queue.empty()) {
+                Queue::iterator top = sq.queue.begin();
+                if (top->keyedMs != nowMs) {
+                    // Novedad reevaluada: si con ella la cabeza queda detrás de
+                    // la siguiente, se reordena y se vuelve a mirar la cabeza
+                    const double key = keyFor(top->request, nowMs);
+                    Queue::iterator next = top;
+                    ++next;
+                    rekey(sq, top, key, nowMs);
+                    if (next != sq.queue.end() && next == sq.queue.begin()) continue;
+                    top = sq.queue.begin();
+                }
+                out[produced] = top->request;
+                out[produced].priority = static_cast<float>(top->key - ageNow);
+                ++produced;
+                ++m_stats.served;
+                erase(sq, top);
+                progress = true;
+                break;
+            }
+
+            ++it;
+            m_cursor = (it == m_streams.end()) ? 0 : it->first;
+        }
+    }
+    return produced;
+}
+
+void RecognitionScheduler::markRecognized(uint32_t streamId, uint64_t trackId, int64_t nowMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lastRecognized[trackKey(streamId, trackId)] = nowMs;
+    pruneRecognized(nowMs);
+}
+
+void RecognitionScheduler::forgetTrack(uint32_t streamId, uint64_t trackId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lastRecognized.erase(trackKey(streamId, trackId));
+
+    std::map<uint32_t, StreamQueue>::iterator it = m_streams.find(streamId);
+    if (it == m_streams.end()) return;
+    std::unordered_map<uint64_t, Pending>::iterator pending = it->second.byTrack.find(trackId);
+    if (pending != it->second.byTrack.end()) erase(it->second, pending->second.item);
+}
+
+SchedulerStats RecognitionScheduler::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" void* RetinaFaceSchedulerCreate(const SchedulerConfig* config)
+{
+    if (!config) return nullptr;
+    return new RecognitionScheduler(*config);
+}
+
+extern "C" void RetinaFaceSchedulerDestroy(void* scheduler)
+{
+    delete static_cast<RecognitionScheduler*>(scheduler);
+}
+
+extern "C" int RetinaFaceSchedulerSubmit(void* scheduler, const RecognitionRequest* request,
+                                         int64_t nowMs)
+{
+    if (!scheduler || !request) return 0;
+    return static_cast<RecognitionScheduler*>(scheduler)->submit(*request, nowMs) ? 1 : 0;
+}
+
+extern "C" int RetinaFaceSchedulerPop(void* scheduler, RecognitionRequest* out, int maxCount,
+                                      int64_t nowMs)
+{
+    if (!scheduler || !out || maxCount <= 0) return 0;
+    return static_cast<RecognitionScheduler*>(scheduler)->pop(out, maxCount, nowMs);
+}
+
+extern "C" void RetinaFaceSchedulerMarkRecognized(void* scheduler, uint32_t streamId,
+                                                  uint64_t trackId, int64_t nowMs)
+{
+    if (scheduler) static_cast<RecognitionScheduler*>(scheduler)->markRecognized(streamId, trackId, nowMs);
+}
+
+extern "C" void RetinaFaceSchedulerForgetTrack(void* scheduler, uint32_t streamId, uint64_t trackId)
+{
+    if (scheduler) static_cast<RecognitionScheduler*>(scheduler)->forgetTrack(streamId, trackId);
+}
+
+extern "C" void RetinaFaceSchedulerGetStats(void* scheduler, SchedulerStats* stats)
+{
+    if (scheduler && stats) *stats = static_cast<RecognitionScheduler*>(scheduler)->stats();
+}
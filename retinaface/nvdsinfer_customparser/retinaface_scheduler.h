@@ -0,0 +1,156 @@
+/******************************************************************************
+ * retinaface_scheduler.h
+ *
+ * Planificador de peticiones de reconocimiento: prioridad por calidad,
+ * novedad del track y edad; descarte por deadline; reparto justo por stream
+ ******************************************************************************/
+
+#ifndef RETINAFACE_SCHEDULER_H
+#define RETINAFACE_SCHEDULER_H
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Petición de reconocimiento de un rostro.
+ */
+struct RecognitionRequest {
+    uint32_t streamId;
+    uint32_t reserved;
+    uint64_t frameNum;
+    uint64_t trackId;
+    uint64_t payload;     /**< Dato opaco del llamador (índice de recorte, etc.) */
+    float    quality;     /**< 0..1, p.ej. FaceQuality.score */
+    float    priority;    /**< Prioridad vigente al salir de la cola (la fija pop) */
+    int64_t  enqueueMs;   /**< Lo fija el planificador al encolar */
+    int64_t  deadlineMs;  /**< Instante absoluto a partir del cual ya no sirve */
+};
+
+/**
+ * @brief Pesos y límites del planificador.
+ *
+ * priority = qualityWeight * quality + noveltyWeight * novelty - agePerSecond * edad
+ * novelty  = 1 para tracks nunca reconocidos; 1 - exp(-t / noveltyTimeMs) desde
+ *            el último reconocimiento del track. Se recalcula cuando la
+ *            petición llega a la cabeza de su cola.
+ */
+struct SchedulerConfig {
+    float qualityWeight;
+    float noveltyWeight;
+    float agePerSecond;
+    float noveltyTimeMs;
+    int   maxPendingPerStream;  /**< Al superarse se descarta la petición de menor prioridad */
+};
+
+/**
+ * @brief Contadores del planificador.
+ */
+struct SchedulerStats {
+    uint64_t submitted;
+    uint64_t served;
+    uint64_t expired;      /**< Descartadas por deadline */
+    uint64_t evicted;      /**< Descartadas por exceso de pendientes del stream */
+    uint64_t coalesced;    /**< Reemplazadas por otra del mismo track */
+    uint64_t pending;
+};
+
+/**
+ * @brief Colas por stream ordenadas por prioridad, con una petición pendiente
+ *        como máximo por track, servidas en round-robin entre streams. Thread-safe.
+ */
+class RecognitionScheduler {
+public:
+    explicit RecognitionScheduler(const SchedulerConfig &config);
+
+    /**
+     * @brief Encola una petición. Si el track ya tiene una pendiente se
+     *        conserva la de mayor prioridad.
+     *
+     * @return `false` si la petición se descartó al encolar.
+     */
+    bool submit(const RecognitionRequest &request, int64_t nowMs);
+
+    /**
+     * @brief Saca hasta `maxCount` peticiones vigentes, una por stream y turno.
+     *        Antes descarta todas las peticiones con deadline vencido, no solo
+     *        las que están en la cabeza.
+     *
+     * @return Número de peticiones escritas en `out`.
+     */
+    int pop(RecognitionRequest* out, int maxCount, int64_t nowMs);
+
+    /** @brief Marca el track como reconocido (reduce su novedad). */
+    void markRecognized(uint32_t streamId, uint64_t trackId, int64_t nowMs);
+
+    /** @brief Olvida el historial de un track terminado. */
+    void forgetTrack(uint32_t streamId, uint64_t trackId);
+
+    SchedulerStats stats();
+
+private:
+    // Mayor prioridad primero; a igual prioridad, la más antigua
+    struct Item {
+        double   key;
+        uint64_t seq;
+        int64_t  keyedMs;   // Instante en que se evaluó la novedad de key
+        RecognitionRequest request;
+
+        bool operator<(const Item &o) const
+        {
+            return key != o.key ? key > o.key : seq < o.seq;
+        }
+    };
+    typedef std::set<Item> Queue;
+    typedef std::multimap<int64_t, uint64_t> Deadlines;   // deadlineMs -> trackId
+
+    struct Pending {
+        Queue::iterator     item;
+        Deadlines::iterator deadline;   // end() si la petición no tiene deadline
+    };
+
+    struct StreamQueue {
+        Queue     queue;
+        Deadlines deadlines;
+        std::unordered_map<uint64_t, Pending> byTrack;
+    };
+
+    void insert(StreamQueue &sq, const Item &item);
+    void erase(StreamQueue &sq, Queue::iterator it);
+    void rekey(StreamQueue &sq, Queue::iterator it, double key, int64_t nowMs);
+    void expire(StreamQueue &sq, int64_t nowMs);
+    void pruneRecognized(int64_t nowMs);
+    float novelty(uint32_t streamId, uint64_t trackId, int64_t nowMs) const;
+    double keyFor(const RecognitionRequest &request, int64_t nowMs) const;
+    double ageSeconds(int64_t nowMs);
+
+    static uint64_t trackKey(uint32_t streamId, uint64_t trackId)
+    {
+        return (static_cast<uint64_t>(streamId) << 48) ^ trackId;
+    }
+
+    SchedulerConfig                          m_config;
+    std::map<uint32_t, StreamQueue>          m_streams;
+    uint32_t                                 m_cursor;      // Próximo stream en el round-robin
+    int64_t                                  m_epochMs;     // Origen de tiempos de las claves
+    std::unordered_map<uint64_t, int64_t>    m_lastRecognized;
+    int64_t                                  m_nextPruneMs; // Próxima purga de m_lastRecognized
+    uint64_t                                 m_seq;
+    SchedulerStats                           m_stats;
+    std::mutex                               m_mutex;
+};
+
+extern "C" {
+void* RetinaFaceSchedulerCreate(const SchedulerConfig* config);
+void  RetinaFaceSchedulerDestroy(void* scheduler);
+int   RetinaFaceSchedulerSubmit(void* scheduler, const RecognitionRequest* request, int64_t nowMs);
+int   RetinaFaceSchedulerPop(void* scheduler, RecognitionRequest* out, int maxCount, int64_t nowMs);
+void  RetinaFaceSchedulerMarkRecognized(void* scheduler, uint32_t streamId, uint64_t trackId,
+                                        int64_t nowMs);
+void  RetinaFaceSchedulerForgetTrack(void* scheduler, uint32_t streamId, uint64_t trackId);
+void  RetinaFaceSchedulerGetStats(void* scheduler, SchedulerStats* stats);
+}
+
+#endif // RETINAFACE_SCHEDULER_H
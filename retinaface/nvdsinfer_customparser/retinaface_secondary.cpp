@@ -0,0 +1,148 @@
+/******************************************************************************
+ * retinaface_secondary.cpp
+ *
+ * Fusión de caras entre recortes de personas solapados. nvinfer ya devuelve
+ * las caras en coordenadas de frame (suma el origen del objeto padre), pero
+ * el clustering se hace por recorte: una cara visible en dos personas
+ * solapadas llega dos veces.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "gstnvdsmeta.h"
+#include "retinaface_secondary.h"
+
+namespace {
+struct FaceRef {
+    NvDsObjectMeta* meta;
+    float x1, y1, x2, y2;
+    float area;
+};
+
+struct MergeProbe {
+    CropMergeConfig       config;
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> faces;
+    std::atomic<uint64_t> merged;
+};
+} // namespace
+
+int mergeCrossCropFaces(NvDsBatchMeta* batchMeta, NvDsFrameMeta* frameMeta, const CropMergeConfig &config)
+{
+    std::vector<FaceRef> faces;
+    for (NvDsMetaList* l = frameMeta->obj_meta_list; l != nullptr; l = l->next) {
+        NvDsObjectMeta* obj = static_cast<NvDsObjectMeta*>(l->data);
+        if (obj->unique_component_id != config.gieUniqueId) continue;
+        const NvOSD_RectParams &r = obj->rect_params;
+        FaceRef f;
+        f.meta = obj;
+        f.x1 = r.left;
+        f.y1 = r.top;
+        f.x2 = r.left + r.width;
+        f.y2 = r.top + r.height;
+        f.area = std::max(0.f, r.width) * std::max(0.f, r.height);
+        faces.push_back(f);
+    }
+    if (faces.size() < 2) return 0;
+
+    std::sort(faces.begin(), faces.end(), [](const FaceRef &a, const FaceRef &b) {
+        return a.meta->confidence > b.meta->confidence;
+    });
+
+    std::vector<NvDsObjectMeta*> removed;
+    std::vector<size_t> kept;
+    for (size_t j = 0; j < faces.size(); ++j) {
+        FaceRef &b = faces[j];
+        bool duplicate = false;
+        for (size_t k = 0; k < kept.size() && !duplicate; ++k) {
+            FaceRef &a = faces[kept[k]];
+            const float iw = std::min(a.x2, b.x2) - std::max(a.x1, b.x1);
+            const float ih = std::min(a.y2, b.y2) - std::max(a.y1, b.y1);
+            if (iw <= 0.f || ih <= 0.f) continue;
+            const float inter = iw * ih;
+            const float iou = inter / (a.area + b.area - inter);
+            const float contain = inter / std::max(1.f, std::min(a.area, b.area));
+            if (iou <= config.iouThreshold && contain <= config.containThreshold) continue;
+
+            duplicate = true;
+            if (b.area > a.area && contain > config.containThreshold) {
+                // La aceptada estaba cortada por el borde de su recorte
+                a.x1 = b.x1; a.y1 = b.y1; a.x2 = b.x2; a.y2 = b.y2; a.area = b.area;
+                a.meta->rect_params = b.meta->rect_params;
+                a.meta->detector_bbox_info = b.meta->detector_bbox_info;
+            }
+        }
+        if (duplicate) {
+            removed.push_back(b.meta);
+        } else {
+            kept.push_back(j);
+        }
+    }
+
+    if (!removed.empty()) {
+        nvds_acquire_meta_lock(batchMeta);
+        for (size_t i = 0; i < removed.size(); ++i) {
+            nvds_remove_obj_meta_from_frame(frameMeta, removed[i]);
+        }
+        nvds_release_meta_lock(batchMeta);
+    }
+    return static_cast<int>(removed.size());
+}
+
+//-------------------------------------------------------------------------------
+// Probe de GStreamer
+//-------------------------------------------------------------------------------
+static GstPadProbeReturn mergeProbe(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    (void)pad;
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    NvDsBatchMeta* batchMeta = buffer ? gst_buffer_get_nvds_batch_meta(buffer) : nullptr;
+    if (!batchMeta) return GST_PAD_PROBE_OK;
+
+    MergeProbe* probe = static_cast<MergeProbe*>(data);
+    for (NvDsMetaList* l = batchMeta->frame_meta_list; l != nullptr; l = l->next) {
+        NvDsFrameMeta* frameMeta = static_cast<NvDsFrameMeta*>(l->data);
+        uint64_t faces = 0;
+        for (NvDsMetaList* o = frameMeta->obj_meta_list; o != nullptr; o = o->next) {
+            if (static_cast<NvDsObjectMeta*>(o->data)->unique_component_id == probe->config.gieUniqueId) ++faces;
+        }
+        probe->frames += 1;
+        probe->faces += faces;
+        probe->merged += mergeCrossCropFaces(batchMeta, frameMeta, probe->config);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+static void freeMergeProbe(gpointer data)
+{
+    delete static_cast<MergeProbe*>(data);
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" void* RetinaFaceSecondaryAttachMerge(GstPad* pad, const CropMergeConfig* config)
+{
+    if (!pad || !config) return nullptr;
+    MergeProbe* probe = new MergeProbe();
+    probe->config = *config;
+    probe->frames = 0;
+    probe->faces = 0;
+    probe->merged = 0;
+    // Con id 0 GStreamer ya llamó a freeMergeProbe: no se libera aquí
+    if (gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, mergeProbe, probe, freeMergeProbe) == 0) {
+        return nullptr;
+    }
+    return probe;
+}
+
+extern "C" void RetinaFaceSecondaryGetMergeStats(void* merge, CropMergeStats* stats)
+{
+    if (!merge || !stats) return;
+    const MergeProbe* probe = static_cast<const MergeProbe*>(merge);
+    stats->frames = probe->frames;
+    stats->faces = probe->faces;
+    stats->merged = probe->merged;
+}
@@ -0,0 +1,54 @@
+/******************************************************************************
+ * retinaface_secondary.h
+ *
+ * RetinaFace como detector secundario (process-mode=2) sobre recortes de
+ * personas: fusión de las caras repetidas por recortes solapados
+ ******************************************************************************/
+
+#ifndef RETINAFACE_SECONDARY_H
+#define RETINAFACE_SECONDARY_H
+#include <stdint.h>
+#include <gst/gst.h>
+#include "nvdsmeta.h"
+
+/**
+ * @brief Parámetros de la fusión entre recortes.
+ */
+struct CropMergeConfig {
+    int   gieUniqueId;       /**< gie-unique-id del nvinfer de caras */
+    float iouThreshold;      /**< IoU a partir del cual dos caras son la misma */
+    float containThreshold;  /**< Fracción de la caja menor dentro de la mayor (cara cortada en el borde de un recorte) */
+};
+
+/**
+ * @brief Contadores de la fusión desde el inicio.
+ */
+struct CropMergeStats {
+    uint64_t frames;
+    uint64_t faces;     /**< Caras del gie antes de fusionar */
+    uint64_t merged;    /**< Caras eliminadas por duplicadas */
+};
+
+/**
+ * @brief Fusiona en coordenadas de frame las caras que nvinfer emitió para
+ *        recortes solapados. Orden por confianza descendente; una cara se
+ *        elimina si su IoU con una ya aceptada supera iouThreshold o si queda
+ *        contenida en ella por encima de containThreshold. Si la eliminada
+ *        es la mayor (la aceptada estaba cortada por el borde del recorte),
+ *        la aceptada hereda su caja.
+ *
+ * @return Número de caras eliminadas del frame.
+ */
+int mergeCrossCropFaces(NvDsBatchMeta* batchMeta, NvDsFrameMeta* frameMeta, const CropMergeConfig &config);
+
+extern "C" {
+/**
+ * @brief Instala la fusión en un pad posterior al nvinfer de caras (su pad
+ *        src). Devuelve un handle para las estadísticas, válido mientras
+ *        exista el pad, o nullptr.
+ */
+void* RetinaFaceSecondaryAttachMerge(GstPad* pad, const CropMergeConfig* config);
+void  RetinaFaceSecondaryGetMergeStats(void* merge, CropMergeStats* stats);
+}
+
+#endif // RETINAFACE_SECONDARY_H
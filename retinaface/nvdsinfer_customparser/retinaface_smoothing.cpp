@@ -0,0 +1,297 @@
+/******************************************************************************
+ * retinaface_smoothing.cpp
+ *
+ * Implementación del suavizado. El estado de un stream son dos matrices
+ * canal x track (valor filtrado y velocidad filtrada); las observaciones del
+ * frame se reparten en una tercera con la misma forma y cada canal se filtra
+ * de una vez. Los tracks que salen se sustituyen por la última columna para
+ * que las columnas vivas sigan contiguas.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "retinaface_smoothing.h"
+
+static const float    kTwoPi = 6.2831853f;
+static const uint64_t kUntracked = ~static_cast<uint64_t>(0);
+
+//-------------------------------------------------------------------------------
+// Kernel
+//-------------------------------------------------------------------------------
+void oneEuroStep(const float* in, const float* dt, const float* alphaD, const float* mask, float minCutoff,
+                 float beta, float* x, float* dx, int n)
+{
+    int i = 0;
+#if defined(__AVX__)
+    const __m256 vMin = _mm256_set1_ps(minCutoff);
+    const __m256 vBeta = _mm256_set1_ps(beta);
+    const __m256 vTwoPi = _mm256_set1_ps(kTwoPi);
+    const __m256 vOne = _mm256_set1_ps(1.f);
+    const __m256 vAbs = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    for (; i + 8 <= n; i += 8) {
+        const __m256 xp = _mm256_loadu_ps(x + i);
+        const __m256 dxp = _mm256_loadu_ps(dx + i);
+        const __m256 d = _mm256_loadu_ps(dt + i);
+        const __m256 m = _mm256_loadu_ps(mask + i);
+        const __m256 delta = _mm256_sub_ps(_mm256_loadu_ps(in + i), xp);
+        // Velocidad filtrada y corte adaptativo
+        const __m256 dxi = _mm256_div_ps(delta, d);
+        const __m256 dxh = _mm256_add_ps(dxp, _mm256_mul_ps(_mm256_loadu_ps(alphaD + i), _mm256_sub_ps(dxi, dxp)));
+        const __m256 fc = _mm256_add_ps(vMin, _mm256_mul_ps(vBeta, _mm256_and_ps(dxh, vAbs)));
+        const __m256 k = _mm256_mul_ps(_mm256_mul_ps(vTwoPi, fc), d);
+        const __m256 a = _mm256_div_ps(k, _mm256_add_ps(k, vOne));
+        // Con mask 0 el estado queda igual
+        _mm256_storeu_ps(x + i, _mm256_add_ps(xp, _mm256_mul_ps(m, _mm256_mul_ps(a, delta))));
+        _mm256_storeu_ps(dx + i, _mm256_add_ps(dxp, _mm256_mul_ps(m, _mm256_sub_ps(dxh, dxp))));
+    }
+#elif defined(__SSE2__)
+    const __m128 vMin = _mm_set1_ps(minCutoff);
+    const __m128 vBeta = _mm_set1_ps(beta);
+    const __m128 vTwoPi = _mm_set1_ps(kTwoPi);
+    const __m128 vOne = _mm_set1_ps(1.f);
+    const __m128 vAbs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    for (; i + 4 <= n; i += 4) {
+        const __m128 xp = _mm_loadu_ps(x + i);
+        const __m128 dxp = _mm_loadu_ps(dx + i);
+        const __m128 d = _mm_loadu_ps(dt + i);
+        const __m128 m = _mm_loadu_ps(mask + i);
+        const __m128 delta = _mm_sub_ps(_mm_loadu_ps(in + i), xp);
+        const __m128 dxi = _mm_div_ps(delta, d);
+        const __m128 dxh = _mm_add_ps(dxp, _mm_mul_ps(_mm_loadu_ps(alphaD + i), _mm_sub_ps(dxi, dxp)));
+        const __m128 fc = _mm_add_ps(vMin, _mm_mul_ps(vBeta, _mm_and_ps(dxh, vAbs)));
+        const __m128 k = _mm_mul_ps(_mm_mul_ps(vTwoPi, fc), d);
+        const __m128 a = _mm_div_ps(k, _mm_add_ps(k, vOne));
+        _mm_storeu_ps(x + i, _mm_add_ps(xp, _mm_mul_ps(m, _mm_mul_ps(a, delta))));
+        _mm_storeu_ps(dx + i, _mm_add_ps(dxp, _mm_mul_ps(m, _mm_sub_ps(dxh, dxp))));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float32x4_t vMin = vdupq_n_f32(minCutoff);
+    const float32x4_t vBeta = vdupq_n_f32(beta);
+    const float32x4_t vTwoPi = vdupq_n_f32(kTwoPi);
+    const float32x4_t vOne = vdupq_n_f32(1.f);
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t xp = vld1q_f32(x + i);
+        const float32x4_t dxp = vld1q_f32(dx + i);
+        const float32x4_t d = vld1q_f32(dt + i);
+        const float32x4_t m = vld1q_f32(mask + i);
+        const float32x4_t delta = vsubq_f32(vld1q_f32(in + i), xp);
+        const float32x4_t dxi = vdivq_f32(delta, d);
+        const float32x4_t dxh = vmlaq_f32(dxp, vld1q_f32(alphaD + i), vsubq_f32(dxi, dxp));
+        const float32x4_t fc = vmlaq_f32(vMin, vBeta, vabsq_f32(dxh));
+        const float32x4_t k = vmulq_f32(vmulq_f32(vTwoPi, fc), d);
+        const float32x4_t a = vdivq_f32(k, vaddq_f32(k, vOne));
+        vst1q_f32(x + i, vmlaq_f32(xp, m, vmulq_f32(a, delta)));
+        vst1q_f32(dx + i, vmlaq_f32(dxp, m, vsubq_f32(dxh, dxp)));
+    }
+#endif
+    for (; i < n; ++i) {
+        const float delta = in[i] - x[i];
+        const float dxh = dx[i] + alphaD[i] * (delta / dt[i] - dx[i]);
+        const float k = kTwoPi * (minCutoff + beta * std::fabs(dxh)) * dt[i];
+        const float a = k / (k + 1.f);
+        x[i] += mask[i] * a * delta;
+        dx[i] += mask[i] * (dxh - dx[i]);
+    }
+}
+
+//-------------------------------------------------------------------------------
+// LandmarkSmoother
+//-------------------------------------------------------------------------------
+LandmarkSmoother::LandmarkSmoother(const SmoothingConfig &config)
+    : m_config(config)
+{
+    if (m_config.minCutoff <= 0.f) m_config.minCutoff = 1.f;
+    if (m_config.beta < 0.f) m_config.beta = 0.f;
+    if (m_config.derivativeCutoff <= 0.f) m_config.derivativeCutoff = 1.f;
+    if (m_config.maxAgeMs <= 0) m_config.maxAgeMs = 1000;
+}
+
+void LandmarkSmoother::grow(StreamFilters &s)
+{
+    // Las matrices canal x track cambian de stride: se copian canal a canal
+    const int capacity = std::max(8, s.capacity * 2);
+    std::vector<float>* columns[] = { &s.x, &s.dx, &s.in };
+    for (int a = 0; a < 3; ++a) {
+        std::vector<float> resized(static_cast<size_t>(kSmoothChannels) * capacity, 0.f);
+        for (int c = 0; c < kSmoothChannels && s.capacity > 0; ++c) {
+            std::memcpy(&resized[c * capacity], &(*columns[a])[c * s.capacity], s.count * sizeof(float));
+        }
+        columns[a]->swap(resized);
+    }
+    s.dt.resize(capacity, 1.f);
+    s.alphaD.resize(capacity, 0.f);
+    s.maskBox.resize(capacity, 0.f);
+    s.maskLm.resize(capacity, 0.f);
+    s.lmReady.resize(capacity, 0);
+    s.seen.resize(capacity, 0);
+    s.trackIds.resize(capacity);
+    s.lastMs.resize(capacity);
+    s.capacity = capacity;
+}
+
+int LandmarkSmoother::addTrack(StreamFilters &s, uint64_t trackId)
+{
+    if (s.count == s.capacity) grow(s);
+    const int slot = s.count++;
+    s.trackIds[slot] = trackId;
+    s.slots[trackId] = slot;
+    return slot;
+}
+
+void LandmarkSmoother::removeTrack(StreamFilters &s, int slot)
+{
+    const int last = s.count - 1;
+    s.slots.erase(s.trackIds[slot]);
+    if (slot != last) {
+        for (int c = 0; c < kSmoothChannels; ++c) {
+            s.x[c * s.capacity + slot] = s.x[c * s.capacity + last];
+            s.dx[c * s.capacity + slot] = s.dx[c * s.capacity + last];
+        }
+        s.trackIds[slot] = s.trackIds[last];
+        s.lastMs[slot] = s.lastMs[last];
+        s.lmReady[slot] = s.lmReady[last];
+        s.slots[s.trackIds[slot]] = slot;
+    }
+    --s.count;
+}
+
+void LandmarkSmoother::update(uint32_t streamId, int64_t tsMs, const uint64_t* trackIds, float* boxes,
+                              float* landmarks, int count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    StreamFilters &s = m_streams[streamId];
+
+    for (int slot = s.count - 1; slot >= 0; --slot) {
+        const int64_t age = tsMs - s.lastMs[slot];
+        if (age > m_config.maxAgeMs || age < -m_config.maxAgeMs) removeTrack(s, slot);
+    }
+
+    // Las columnas sin observación filtran su propio estado con peso 0
+    if (s.capacity > 0) {
+        std::memcpy(&s.in[0], &s.x[0], s.in.size() * sizeof(float));
+        std::fill(s.dt.begin(), s.dt.end(), 1.f);
+        std::fill(s.alphaD.begin(), s.alphaD.end(), 0.f);
+        std::fill(s.maskBox.begin(), s.maskBox.end(), 0.f);
+        std::fill(s.maskLm.begin(), s.maskLm.end(), 0.f);
+        std::fill(s.seen.begin(), s.seen.end(), 0);
+    }
+
+    m_faceSlot.assign(count, -1);
+    const float twoPiD = kTwoPi * m_config.derivativeCutoff;
+    for (int f = 0; f < count; ++f) {
+        if (trackIds[f] == kUntracked) continue;
+        const float* box = boxes + 4 * f;
+        const float* lm = landmarks ? landmarks + 10 * f : nullptr;
+        const bool hasLm = lm && !std::isnan(lm[0]);
+
+        std::unordered_map<uint64_t, int>::const_iterator it = s.slots.find(trackIds[f]);
+        const bool isNew = (it == s.slots.end());
+        const int slot = isNew ? addTrack(s, trackIds[f]) : it->second;
+        if (s.seen[slot]) continue;   // Id repetido en el frame: sale sin filtrar
+        s.seen[slot] = 1;
+        const int stride = s.capacity;
+
+        // Primera observación (del track o de sus landmarks): inicia el estado
+        if (isNew) {
+            for (int c = 0; c < 4; ++c) {
+                s.x[c * stride + slot] = s.in[c * stride + slot] = box[c];
+                s.dx[c * stride + slot] = 0.f;
+            }
+            s.lmReady[slot] = 0;
+        }
+        if (hasLm && !s.lmReady[slot]) {
+            for (int c = 0; c < 10; ++c) {
+                s.x[(4 + c) * stride + slot] = s.in[(4 + c) * stride + slot] = lm[c];
+                s.dx[(4 + c) * stride + slot] = 0.f;
+            }
+            s.lmReady[slot] = 1;
+        } else if (hasLm) {
+            for (int c = 0; c < 10; ++c) s.in[(4 + c) * stride + slot] = lm[c];
+            s.maskLm[slot] = isNew ? 0.f : 1.f;
+        }
+        const int64_t lastMs = s.lastMs[slot];
+        s.lastMs[slot] = tsMs;
+        if (isNew) continue;
+
+        const float dt = static_cast<float>(std::max<int64_t>(1, tsMs - lastMs)) * 1e-3f;
+        const float kd = twoPiD * dt;
+        s.dt[slot] = dt;
+        s.alphaD[slot] = kd / (kd + 1.f);
+        s.maskBox[slot] = 1.f;
+        for (int c = 0; c < 4; ++c) s.in[c * stride + slot] = box[c];
+        m_faceSlot[f] = slot;
+    }
+
+    const int n = s.count;
+    const int stride = s.capacity;
+    for (int c = 0; c < kSmoothChannels && n > 0; ++c) {
+        const float* mask = (c < 4) ? &s.maskBox[0] : &s.maskLm[0];
+        oneEuroStep(&s.in[c * stride], &s.dt[0], &s.alphaD[0], mask, m_config.minCutoff, m_config.beta,
+                    &s.x[c * stride], &s.dx[c * stride], n);
+    }
+
+    for (int f = 0; f < count; ++f) {
+        const int slot = m_faceSlot[f];
+        if (slot < 0) continue;
+        for (int c = 0; c < 4; ++c) boxes[4 * f + c] = s.x[c * stride + slot];
+        if (s.maskLm[slot] != 0.f) {
+            for (int c = 0; c < 10; ++c) landmarks[10 * f + c] = s.x[(4 + c) * stride + slot];
+        }
+    }
+}
+
+void LandmarkSmoother::resetStream(uint32_t streamId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_streams.erase(streamId);
+}
+
+int LandmarkSmoother::trackCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int total = 0;
+    for (std::unordered_map<uint32_t, StreamFilters>::const_iterator it = m_streams.begin(); it != m_streams.end();
+         ++it) {
+        total += it->second.count;
+    }
+    return total;
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" void* RetinaFaceSmoothingCreate(const SmoothingConfig* config)
+{
+    if (!config) return nullptr;
+    return new LandmarkSmoother(*config);
+}
+
+extern "C" void RetinaFaceSmoothingDestroy(void* smoother)
+{
+    delete static_cast<LandmarkSmoother*>(smoother);
+}
+
+extern "C" void RetinaFaceSmoothingUpdate(void* smoother, uint32_t streamId, int64_t tsMs, const uint64_t* trackIds,
+                                          float* boxes, float* landmarks, int count)
+{
+    if (!smoother || count <= 0 || !trackIds || !boxes) return;
+    static_cast<LandmarkSmoother*>(smoother)->update(streamId, tsMs, trackIds, boxes, landmarks, count);
+}
+
+extern "C" void RetinaFaceSmoothingResetStream(void* smoother, uint32_t streamId)
+{
+    if (smoother) static_cast<LandmarkSmoother*>(smoother)->resetStream(streamId);
+}
+
+extern "C" int RetinaFaceSmoothingTrackCount(void* smoother)
+{
+    return smoother ? static_cast<LandmarkSmoother*>(smoother)->trackCount() : 0;
+}
@@ -0,0 +1,100 @@
+/******************************************************************************
+ * retinaface_smoothing.h
+ *
+ * Suavizado temporal de caja y landmarks por track con filtros One-Euro,
+ * guardados en SoA por stream y actualizados con SIMD en una pasada por frame
+ ******************************************************************************/
+
+#ifndef RETINAFACE_SMOOTHING_H
+#define RETINAFACE_SMOOTHING_H
+#include <stdint.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/** @brief Canales filtrados por track: 4 de caja y 10 de landmarks. */
+static const int kSmoothChannels = 14;
+
+/**
+ * @brief Parámetros del One-Euro (Casiez et al.). Con la cara quieta manda
+ *        minCutoff (menos jitter cuanto más bajo); al moverse, el corte sube
+ *        con beta * |velocidad| en px/s para no añadir retraso.
+ */
+struct SmoothingConfig {
+    float   minCutoff;         /**< Hz */
+    float   beta;              /**< Hz por px/s */
+    float   derivativeCutoff;  /**< Hz del filtro de la velocidad */
+    int32_t maxAgeMs;          /**< Un track sin observaciones más tiempo se olvida */
+};
+
+/**
+ * @brief Filtros de todos los tracks. Cada stream guarda el estado en columnas
+ *        (canal x track) compactas, así que un frame se filtra recorriendo
+ *        cada canal una vez con SIMD (AVX/SSE2/NEON) sobre todos sus tracks;
+ *        los tracks no vistos en el frame conservan el estado. Thread-safe.
+ */
+class LandmarkSmoother {
+public:
+    explicit LandmarkSmoother(const SmoothingConfig &config);
+
+    /**
+     * @brief Filtra en sitio las caras de un frame.
+     *
+     * @param trackIds  Id de tracker por cara; UINT64_MAX (sin tracker) pasa tal cual.
+     * @param boxes     count x (left, top, width, height).
+     * @param landmarks count x 10, o nullptr. Una cara con NaN en sus
+     *                  landmarks no los actualiza.
+     */
+    void update(uint32_t streamId, int64_t tsMs, const uint64_t* trackIds, float* boxes, float* landmarks,
+                int count);
+
+    void resetStream(uint32_t streamId);
+    int  trackCount();
+
+private:
+    struct StreamFilters {
+        std::unordered_map<uint64_t, int> slots;   // trackId -> columna
+        std::vector<uint64_t> trackIds;            // columna -> trackId
+        std::vector<int64_t>  lastMs;
+        int                   count;
+        int                   capacity;            // Columnas reservadas (múltiplo de 8)
+        std::vector<float>    x;                   // kSmoothChannels x capacity
+        std::vector<float>    dx;
+        std::vector<float>    in;                  // Observaciones del frame
+        std::vector<float>    dt;                  // s desde la última observación
+        std::vector<float>    alphaD;              // Peso del filtro de la velocidad
+        std::vector<float>    maskBox;             // 1 si el track se vio en el frame
+        std::vector<float>    maskLm;              // 1 si además trae landmarks
+        std::vector<uint8_t>  lmReady;             // Landmarks ya iniciados en la columna
+        std::vector<uint8_t>  seen;                // Columna ya observada en este frame
+
+        StreamFilters() : count(0), capacity(0) {}
+    };
+
+    void grow(StreamFilters &s);
+    int  addTrack(StreamFilters &s, uint64_t trackId);
+    void removeTrack(StreamFilters &s, int slot);
+
+    SmoothingConfig                               m_config;
+    std::unordered_map<uint32_t, StreamFilters>   m_streams;
+    std::vector<int>                              m_faceSlot;   // Columna de cada cara del frame
+    std::mutex                                    m_mutex;
+};
+
+/**
+ * @brief Un paso del One-Euro para n tracks de un canal. Donde mask es 0 el
+ *        estado no cambia.
+ */
+void oneEuroStep(const float* in, const float* dt, const float* alphaD, const float* mask, float minCutoff,
+                 float beta, float* x, float* dx, int n);
+
+extern "C" {
+void* RetinaFaceSmoothingCreate(const SmoothingConfig* config);
+void  RetinaFaceSmoothingDestroy(void* smoother);
+void  RetinaFaceSmoothingUpdate(void* smoother, uint32_t streamId, int64_t tsMs, const uint64_t* trackIds,
+                                float* boxes, float* landmarks, int count);
+void  RetinaFaceSmoothingResetStream(void* smoother, uint32_t streamId);
+int   RetinaFaceSmoothingTrackCount(void* smoother);
+}
+
+#endif // RETINAFACE_SMOOTHING_H
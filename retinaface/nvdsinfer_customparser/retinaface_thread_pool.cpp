@@ -0,0 +1,72 @@
+/******************************************************************************
+ * retinaface_thread_pool.cpp
+ *
+ * Los hilos esperan a que cambie la generación, toman tareas del contador
+ * compartido y avisan al llamador cuando el último termina.
+ ******************************************************************************/
+
+#include "retinaface_thread_pool.h"
+
+ForkJoinPool::ForkJoinPool(int workers)
+    : m_fn(nullptr), m_tasks(0), m_next(0), m_busy(0), m_generation(0), m_stop(false)
+{
+    for (int t = 0; t < workers; ++t) {
+        m_threads.push_back(std::thread(&ForkJoinPool::threadLoop, this));
+    }
+}
+
+ForkJoinPool::~ForkJoinPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_start.notify_all();
+    for (size_t t = 0; t < m_threads.size(); ++t) m_threads[t].join();
+}
+
+void ForkJoinPool::drain()
+{
+    for (int task = m_next.fetch_add(1); task < m_tasks; task = m_next.fetch_add(1)) {
+        (*m_fn)(task);
+    }
+}
+
+void ForkJoinPool::threadLoop()
+{
+    unsigned long seen = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_start.wait(lock, [&]() { return m_stop || m_generation != seen; });
+        if (m_stop) break;
+        seen = m_generation;
+
+        lock.unlock();
+        drain();
+        lock.lock();
+        if (--m_busy == 0) m_done.notify_one();
+    }
+}
+
+bool ForkJoinPool::tryRun(int tasks, const std::function<void(int)> &fn)
+{
+    std::unique_lock<std::mutex> run(m_runMutex, std::try_to_lock);
+    if (!run.owns_lock()) return false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fn = &fn;
+        m_tasks = tasks;
+        m_next.store(0);
+        m_busy = static_cast<int>(m_threads.size());
+        ++m_generation;
+    }
+    m_start.notify_all();
+
+    drain();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this]() { return m_busy == 0; });
+    m_fn = nullptr;
+    return true;
+}
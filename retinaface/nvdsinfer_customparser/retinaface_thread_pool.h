@@ -0,0 +1,56 @@
+/******************************************************************************
+ * retinaface_thread_pool.h
+ *
+ * Pool fork-join persistente para repartir el trabajo de un solo frame entre
+ * varios núcleos sin crear hilos por llamada
+ ******************************************************************************/
+
+#ifndef RETINAFACE_THREAD_POOL_H
+#define RETINAFACE_THREAD_POOL_H
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Ejecuta fn(0) ... fn(tasks - 1) entre el hilo llamador y los hilos
+ *        del pool, que toman tareas de un contador atómico hasta agotarlas.
+ *        Una sola ejecución a la vez: si otro hilo ya lo está usando,
+ *        tryRun() no espera y devuelve false para que el llamador haga el
+ *        trabajo en serie.
+ */
+class ForkJoinPool {
+public:
+    /** @param workers Hilos además del llamador (0: todo en el llamador). */
+    explicit ForkJoinPool(int workers);
+    ~ForkJoinPool();
+
+    /** @brief Hilos que trabajan en una ejecución, incluido el llamador. */
+    int size() const { return static_cast<int>(m_threads.size()) + 1; }
+
+    /** @brief Vuelve cuando todas las tareas han terminado. */
+    bool tryRun(int tasks, const std::function<void(int)> &fn);
+
+private:
+    ForkJoinPool(const ForkJoinPool &);
+    ForkJoinPool &operator=(const ForkJoinPool &);
+
+    void threadLoop();
+    void drain();
+
+    std::vector<std::thread>          m_threads;
+    std::mutex                        m_runMutex;     // Una ejecución a la vez
+    std::mutex                        m_mutex;
+    std::condition_variable           m_start;
+    std::condition_variable           m_done;
+    const std::function<void(int)>*   m_fn;
+    int                               m_tasks;
+    std::atomic<int>                  m_next;
+    int                               m_busy;         // Hilos del pool aún en la ejecución
+    unsigned long                     m_generation;
+    bool                              m_stop;
+};
+
+#endif // RETINAFACE_THREAD_POOL_H
@@ -0,0 +1,694 @@
+/******************************************************************************
+ * retinaface_writer.cpp
+ *
+ * Implementación del escritor asíncrono. Con io_uring un único hilo vacía la
+ * cola en lotes (un io_uring_submit por lote) usando los buffers del pool
+ * registrados en el kernel (IORING_OP_WRITE_FIXED). Sin io_uring, un grupo de
+ * hilos hace open/pwrite/close. Con O_DIRECT la longitud se rellena hasta
+ * 4096 y el archivo se trunca después al tamaño real.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(RF_WITH_IO_URING)
+#include <liburing.h>
+#endif
+
+#include "retinaface_writer.h"
+
+static const size_t kAlignment = 4096;
+static const int    kMaxDirectRewrites = 3;   // Escrituras cortas toleradas por job con O_DIRECT
+
+static size_t alignUp(size_t v)
+{
+    return (v + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+FrameWriter::FrameWriter(const WriterConfig &config)
+    : m_config(config), m_bufferSize(0), m_memory(nullptr), m_running(false), m_inflight(0),
+      m_adaptiveJpeg(false), m_bandwidth(0.f), m_bwSampleMs(-1), m_bwSampleBytes(0), m_bwSaturatedMs(-1)
+{
+#if defined(RF_WITH_IO_URING)
+    m_ring = nullptr;
+#endif
+    if (m_config.bufferCount <= 0) m_config.bufferCount = 32;
+    if (m_config.threads <= 0) m_config.threads = 2;
+    if (m_config.queueDepth <= 0) m_config.queueDepth = 64;
+    std::memset(&m_stats, 0, sizeof(m_stats));
+    std::memset(&m_jpegConfig, 0, sizeof(m_jpegConfig));
+}
+
+FrameWriter::~FrameWriter()
+{
+    stop();
+}
+
+bool FrameWriter::start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running) return true;
+
+    m_bufferSize = alignUp(std::max(m_config.bufferSize, 1));
+    void* memory = nullptr;
+    if (posix_memalign(&memory, kAlignment, m_bufferSize * m_config.bufferCount) != 0) {
+        std::cerr << "ERROR: no se pudo reservar el pool del escritor (" << m_config.bufferCount
+                  << " x " << m_bufferSize << " bytes)" << std::endl;
+        return false;
+    }
+    m_memory = static_cast<uint8_t*>(memory);
+    m_free.clear();
+    for (int i = m_config.bufferCount - 1; i >= 0; --i) m_free.push_back(i);
+    m_running = true;
+
+#if defined(RF_WITH_IO_URING)
+    if (m_config.backend != WRITER_BACKEND_THREADS && startRing()) {
+        m_stats.backend = WRITER_BACKEND_IO_URING;
+        m_threads.push_back(std::thread(&FrameWriter::ringLoop, this));
+        return true;
+    }
+    if (m_config.backend == WRITER_BACKEND_IO_URING) {
+        std::cerr << "WARNING: io_uring no disponible, se usa el backend con hilos" << std::endl;
+    }
+#else
+    if (m_config.backend == WRITER_BACKEND_IO_URING) {
+        std::cerr << "WARNING: compilado sin io_uring (WITH_IO_URING=1), se usa el backend con hilos"
+                  << std::endl;
+    }
+#endif
+    m_stats.backend = WRITER_BACKEND_THREADS;
+    for (int t = 0; t < m_config.threads; ++t) {
+        m_threads.push_back(std::thread(&FrameWriter::threadLoop, this));
+    }
+    return true;
+}
+
+void FrameWriter::stop()
+{
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        m_running = false;
+    }
+    m_wake.notify_all();
+    for (size_t t = 0; t < m_threads.size(); ++t) m_threads[t].join();
+    m_threads.clear();
+
+#if defined(RF_WITH_IO_URING)
+    if (m_ring) {
+        io_uring_queue_exit(static_cast<struct io_uring*>(m_ring));
+        delete static_cast<struct io_uring*>(m_ring);
+        m_ring = nullptr;
+    }
+#endif
+    std::free(m_memory);
+    m_memory = nullptr;
+    m_free.clear();
+}
+
+int FrameWriter::bufferIndex(const uint8_t* buffer) const
+{
+    if (!m_memory || buffer < m_memory) return -1;
+    const size_t delta = static_cast<size_t>(buffer - m_memory);
+    if (delta % m_bufferSize != 0 || delta / m_bufferSize >= static_cast<size_t>(m_config.bufferCount)) {
+        return -1;
+    }
+    return static_cast<int>(delta / m_bufferSize);
+}
+
+size_t FrameWriter::paddedSize(size_t size) const
+{
+    return m_config.directIO ? alignUp(size) : size;
+}
+
+// Tras una escritura corta: sin O_DIRECT se sigue donde quedó; con O_DIRECT
+// el resto no está alineado a 4096 (EINVAL), así que se reescribe el bloque
+// entero desde el principio, un número limitado de veces
+bool FrameWriter::resumeShortWrite(Job* job)
+{
+    if (!m_config.directIO) return true;
+    if (++job->rewrites > kMaxDirectRewrites) return false;
+    job->done = 0;
+    return true;
+}
+
+uint8_t* FrameWriter::acquireBuffer()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_running || m_free.empty()) {
+        ++m_stats.dropped;
+        return nullptr;
+    }
+    const int index = m_free.back();
+    m_free.pop_back();
+    return m_memory + static_cast<size_t>(index) * m_bufferSize;
+}
+
+void FrameWriter::releaseBuffer(uint8_t* buffer)
+{
+    const int index = bufferIndex(buffer);
+    if (index < 0) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(index);
+}
+
+bool FrameWriter::submitFile(uint8_t* buffer, size_t size, const char* path)
+{
+    const int index = bufferIndex(buffer);
+    if (index < 0 || !path || size > m_bufferSize) {
+        std::cerr << "ERROR: submitFile con un buffer o tamaño inválido" << std::endl;
+        if (index >= 0) releaseBuffer(buffer);
+        return false;
+    }
+    Job* job = new Job();
+    job->buffer = index;
+    job->size   = size;
+    job->done   = 0;
+    job->rewrites = 0;
+    job->fd     = -1;
+    job->ownsFd = true;
+    job->offset = 0;
+    job->path   = path;
+    return submit(job);
+}
+
+bool FrameWriter::submitAt(uint8_t* buffer, size_t size, int fd, uint64_t offset)
+{
+    const int index = bufferIndex(buffer);
+    if (index < 0 || fd < 0 || size > m_bufferSize) {
+        std::cerr << "ERROR: submitAt con un buffer, descriptor o tamaño inválido" << std::endl;
+        if (index >= 0) releaseBuffer(buffer);
+        return false;
+    }
+    Job* job = new Job();
+    job->buffer = index;
+    job->size   = size;
+    job->done   = 0;
+    job->rewrites = 0;
+    job->fd     = fd;
+    job->ownsFd = false;
+    job->offset = offset;
+    return submit(job);
+}
+
+bool FrameWriter::submit(Job* job)
+{
+    // Con O_DIRECT se escribe el tamaño alineado; el relleno va a cero
+    const size_t padded = paddedSize(job->size);
+    uint8_t* data = m_memory + static_cast<size_t>(job->buffer) * m_bufferSize;
+    if (padded > job->size) std::memset(data + job->size, 0, padded - job->size);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            m_free.push_back(job->buffer);
+            delete job;
+            return false;
+        }
+        m_queue.push_back(job);
+        ++m_stats.submitted;
+        ++m_inflight;
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+bool FrameWriter::openJob(Job* job)
+{
+    if (job->fd >= 0) return true;
+
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    if (m_config.directIO) {
+        job->fd = ::open(job->path.c_str(), flags | O_DIRECT, 0644);
+        // tmpfs y algunos FS no aceptan O_DIRECT: se escribe igual, con caché
+        if (job->fd < 0 && errno == EINVAL) job->fd = ::open(job->path.c_str(), flags, 0644);
+    } else {
+        job->fd = ::open(job->path.c_str(), flags, 0644);
+    }
+    if (job->fd < 0) {
+        std::cerr << "ERROR: no se pudo abrir " << job->path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void FrameWriter::finishJob(Job* job, bool ok)
+{
+    if (job->ownsFd && job->fd >= 0) {
+        if (ok && paddedSize(job->size) != job->size && ftruncate(job->fd, job->size) != 0) ok = false;
+        ::close(job->fd);
+    }
+    if (!ok) {
+        std::cerr << "ERROR: fallo al escribir " << (job->path.empty() ? "(descriptor)" : job->path)
+                  << std::endl;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(job->buffer);
+        if (ok) {
+            ++m_stats.completed;
+            m_stats.bytes += job->size;
+        } else {
+            ++m_stats.failed;
+        }
+        --m_inflight;
+        if (m_inflight == 0) m_idle.notify_all();
+    }
+    delete job;
+}
+
+//-------------------------------------------------------------------------------
+// Backend con hilos (pwrite)
+//-------------------------------------------------------------------------------
+void FrameWriter::threadLoop()
+{
+    for (;;) {
+        Job* job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return !m_queue.empty() || !m_running; });
+            if (m_queue.empty()) return;
+            job = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        bool ok = openJob(job);
+        const uint8_t* data = m_memory + static_cast<size_t>(job->buffer) * m_bufferSize;
+        const size_t length = paddedSize(job->size);
+        while (ok && job->done < length) {
+            const ssize_t n = pwrite(job->fd, data + job->done, length - job->done, job->offset + job->done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            job->done += static_cast<size_t>(n);
+            if (job->done < length && !resumeShortWrite(job)) ok = false;
+        }
+        finishJob(job, ok);
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Backend io_uring
+//-------------------------------------------------------------------------------
+#if defined(RF_WITH_IO_URING)
+bool FrameWriter::startRing()
+{
+    struct io_uring* ring = new struct io_uring;
+    int ret = io_uring_queue_init(m_config.queueDepth, ring, 0);
+    if (ret < 0) {
+        std::cerr << "WARNING: io_uring_queue_init: " << std::strerror(-ret) << std::endl;
+        delete ring;
+        return false;
+    }
+
+    // Buffers registrados: el kernel no tiene que fijar páginas en cada escritura
+    std::vector<struct iovec> iov(m_config.bufferCount);
+    for (int i = 0; i < m_config.bufferCount; ++i) {
+        iov[i].iov_base = m_memory + static_cast<size_t>(i) * m_bufferSize;
+        iov[i].iov_len  = m_bufferSize;
+    }
+    ret = io_uring_register_buffers(ring, &iov[0], m_config.bufferCount);
+    if (ret < 0) {
+        std::cerr << "WARNING: io_uring_register_buffers: " << std::strerror(-ret)
+                  << " (¿RLIMIT_MEMLOCK?)" << std::endl;
+        io_uring_queue_exit(ring);
+        delete ring;
+        return false;
+    }
+    m_ring = ring;
+    return true;
+}
+
+void FrameWriter::ringLoop()
+{
+    struct io_uring* ring = static_cast<struct io_uring*>(m_ring);
+    const size_t depth = static_cast<size_t>(m_config.queueDepth);
+    std::vector<Job*> batch;
+    size_t inRing = 0;
+
+    for (;;) {
+        // 1) Vaciar la cola; solo se bloquea si no hay nada en vuelo
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (inRing == 0) m_wake.wait(lock, [this]() { return !m_queue.empty() || !m_running; });
+            if (inRing == 0 && m_queue.empty()) return;
+            while (!m_queue.empty() && inRing + batch.size() < depth) {
+                batch.push_back(m_queue.front());
+                m_queue.pop_front();
+            }
+        }
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+            Job* job = batch[i];
+            if (!openJob(job)) {
+                finishJob(job, false);
+                continue;
+            }
+            struct io_uring_sqe* sqe = io_uring_get_sqe(ring);
+            const size_t length = paddedSize(job->size);
+            io_uring_prep_write_fixed(sqe, job->fd, m_memory + static_cast<size_t>(job->buffer) * m_bufferSize,
+                                      static_cast<unsigned>(length), job->offset, job->buffer);
+            io_uring_sqe_set_data(sqe, job);
+            ++inRing;
+        }
+        if (inRing == 0) continue;
+        io_uring_submit(ring);
+
+        // 2) Completions; como mucho 1 ms de espera para volver a mirar la cola
+        struct io_uring_cqe* cqe = nullptr;
+        struct __kernel_timespec timeout;
+        timeout.tv_sec  = 0;
+        timeout.tv_nsec = 1000000;
+        if (io_uring_wait_cqe_timeout(ring, &cqe, &timeout) < 0) continue;
+
+        unsigned head;
+        unsigned seen = 0;
+        io_uring_for_each_cqe(ring, head, cqe) {
+            ++seen;
+            Job* job = static_cast<Job*>(io_uring_cqe_get_data(cqe));
+            const int res = cqe->res;
+            const size_t length = paddedSize(job->size);
+            if (res == -EINTR || res == -EAGAIN) {
+                // Reintento del resto
+            } else if (res <= 0) {
+                --inRing;
+                finishJob(job, false);
+                continue;
+            } else {
+                job->done += static_cast<size_t>(res);
+            }
+            if (job->done >= length) {
+                --inRing;
+                finishJob(job, true);
+                continue;
+            }
+            // Escritura corta: se encola el resto, o el bloque entero con O_DIRECT
+            // (se envía en el siguiente lote)
+            if (res > 0 && !resumeShortWrite(job)) {
+                --inRing;
+                finishJob(job, false);
+                continue;
+            }
+            struct io_uring_sqe* sqe = io_uring_get_sqe(ring);
+            io_uring_prep_write_fixed(sqe, job->fd,
+                                      m_memory + static_cast<size_t>(job->buffer) * m_bufferSize + job->done,
+                                      static_cast<unsigned>(length - job->done), job->offset + job->done,
+                                      job->buffer);
+            io_uring_sqe_set_data(sqe, job);
+        }
+        io_uring_cq_advance(ring, seen);
+    }
+}
+#endif
+
+void FrameWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_inflight == 0; });
+}
+
+WriterStats FrameWriter::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    WriterStats s = m_stats;
+    s.pending = m_inflight;
+    return s;
+}
+
+//-------------------------------------------------------------------------------
+// Calidad JPEG adaptativa
+//-------------------------------------------------------------------------------
+static const float kJpegDecrease       = 0.7f;   // Parte que queda del margen sobre minQuality
+static const int   kJpegIncrease       = 2;      // Puntos de calidad por ajuste
+static const float kJpegIncreaseGrowth = 1.1f;   // Bytes estimados tras subir la calidad
+static const float kJpegHeadroom       = 0.8f;   // Fracción del ancho de banda utilizable
+static const float kJpegEwma           = 0.2f;
+static const int   kBandwidthSampleMs  = 250;
+static const int   kBandwidthHoldMs    = 10000;  // Vigencia de una medida con el disco saturado
+
+static int64_t monotonicMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameWriter::enableAdaptiveJpeg(const AdaptiveJpegConfig &config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jpegConfig = config;
+    m_jpegConfig.minQuality = std::min(100, std::max(1, config.minQuality));
+    m_jpegConfig.maxQuality = std::min(100, std::max(m_jpegConfig.minQuality, config.maxQuality));
+    m_jpegConfig.maxDownscale = config.maxDownscale >= 4 ? 4 : (config.maxDownscale >= 2 ? 2 : 1);
+    m_jpegConfig.intervalMs = std::max(1, config.intervalMs);
+    m_jpegConfig.highWater = std::min(1.f, std::max(0.05f, config.highWater));
+    m_jpegConfig.lowWater = std::min(m_jpegConfig.highWater, std::max(0.f, config.lowWater));
+    m_jpegStreams.clear();
+    m_adaptiveJpeg = true;
+}
+
+FrameWriter::JpegStream &FrameWriter::jpegStream(uint32_t streamId)
+{
+    std::map<uint32_t, JpegStream>::iterator it = m_jpegStreams.find(streamId);
+    if (it != m_jpegStreams.end()) return it->second;
+
+    JpegStream &stream = m_jpegStreams[streamId];
+    std::memset(&stream.metric, 0, sizeof(stream.metric));
+    stream.metric.quality = m_jpegConfig.maxQuality;
+    stream.metric.downscale = 1;
+    stream.lastFrameMs = -1;
+    stream.lastStepMs = -1;
+    stream.writerDropped = m_stats.dropped;
+    stream.droppedSinceStep = false;
+    return stream;
+}
+
+bool FrameWriter::jpegSettings(uint32_t streamId, int &quality, int &downscale)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_adaptiveJpeg) return false;
+    const JpegStream &stream = jpegStream(streamId);
+    quality = stream.metric.quality;
+    downscale = stream.metric.downscale;
+    return true;
+}
+
+void FrameWriter::reportJpeg(uint32_t streamId, size_t bytes, bool dropped)
+{
+    reportJpeg(streamId, bytes, dropped, monotonicMs());
+}
+
+void FrameWriter::reportJpeg(uint32_t streamId, size_t bytes, bool dropped, int64_t nowMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_adaptiveJpeg) return;
+    JpegStream &stream = jpegStream(streamId);
+    JpegStreamQuality &metric = stream.metric;
+
+    ++metric.frames;
+    if (dropped) {
+        ++metric.dropped;
+        stream.droppedSinceStep = true;
+    } else {
+        const float size = static_cast<float>(bytes);
+        metric.bytesPerFrame = metric.bytesPerFrame > 0.f ? metric.bytesPerFrame + kJpegEwma * (size - metric.bytesPerFrame)
+                                                          : size;
+    }
+    if (stream.lastFrameMs >= 0 && nowMs > stream.lastFrameMs) {
+        const float fps = 1000.f / static_cast<float>(nowMs - stream.lastFrameMs);
+        metric.fps = metric.fps > 0.f ? metric.fps + kJpegEwma * (fps - metric.fps) : fps;
+    }
+    stream.lastFrameMs = nowMs;
+
+    // Con descartes se ajusta antes, sin esperar al intervalo completo
+    const int interval = stream.droppedSinceStep ? m_jpegConfig.intervalMs / 4 : m_jpegConfig.intervalMs;
+    if (stream.lastStepMs < 0) {
+        stream.lastStepMs = nowMs;
+    } else if (nowMs - stream.lastStepMs >= interval) {
+        stepJpegQuality(stream, nowMs);
+    }
+}
+
+void FrameWriter::sampleBandwidth(int64_t nowMs, float occupancy, bool congested)
+{
+    if (m_bwSampleMs < 0) {
+        m_bwSampleMs = nowMs;
+        m_bwSampleBytes = m_stats.bytes;
+        return;
+    }
+    const int64_t elapsed = nowMs - m_bwSampleMs;
+    if (elapsed < kBandwidthSampleMs) return;
+
+    const float rate = static_cast<float>(m_stats.bytes - m_bwSampleBytes) * 1000.f / static_cast<float>(elapsed);
+    if (congested || occupancy > m_jpegConfig.lowWater) {
+        // Con cola, lo completado es lo que da el disco
+        m_bandwidth = m_bandwidth > 0.f ? m_bandwidth + kJpegEwma * (rate - m_bandwidth) : rate;
+        m_bwSaturatedMs = nowMs;
+    } else if (rate > m_bandwidth) {
+        // Sin cola solo es una cota inferior
+        m_bandwidth = rate;
+    }
+    m_bwSampleMs = nowMs;
+    m_bwSampleBytes = m_stats.bytes;
+}
+
+void FrameWriter::stepJpegQuality(JpegStream &stream, int64_t nowMs)
+{
+    JpegStreamQuality &metric = stream.metric;
+    const float occupancy = m_running ? 1.f - static_cast<float>(m_free.size()) / m_config.bufferCount : 0.f;
+
+    // Congestión: descartes en el intervalo o pool lleno y sin bajar desde el
+    // último ajuste (tras bajar la calidad la cola tarda en vaciarse)
+    const bool drops = stream.droppedSinceStep || m_stats.dropped > stream.writerDropped;
+    const bool congested = drops || (occupancy >= m_jpegConfig.highWater && occupancy >= metric.occupancy);
+    sampleBandwidth(nowMs, occupancy, congested);
+
+    if (congested) {
+        // Decremento multiplicativo; en la calidad mínima, media resolución
+        if (metric.quality > m_jpegConfig.minQuality) {
+            metric.quality = m_jpegConfig.minQuality +
+                             static_cast<int>((metric.quality - m_jpegConfig.minQuality) * kJpegDecrease);
+            ++metric.decreases;
+        } else if (metric.downscale < m_jpegConfig.maxDownscale) {
+            metric.downscale *= 2;
+            ++metric.decreases;
+        }
+    } else if (occupancy <= m_jpegConfig.lowWater) {
+        // Incremento aditivo si la demanda estimada de todos los streams, con
+        // este ya subido, cabe en el ancho de banda medido
+        float demand = 0.f;
+        for (std::map<uint32_t, JpegStream>::const_iterator it = m_jpegStreams.begin(); it != m_jpegStreams.end();
+             ++it) {
+            demand += it->second.metric.bytesPerFrame * it->second.metric.fps;
+        }
+        // Sin una medida reciente con el disco saturado el ancho de banda es
+        // solo una cota inferior y se sube a prueba
+        const float own = metric.bytesPerFrame * metric.fps;
+        const float budget = kJpegHeadroom * m_bandwidth;
+        const bool probe = m_bwSaturatedMs < 0 || nowMs - m_bwSaturatedMs > kBandwidthHoldMs;
+
+        if (metric.downscale > 1 && (probe || demand + 3.f * own <= budget)) {
+            metric.downscale /= 2;
+            ++metric.increases;
+        } else if (metric.quality < m_jpegConfig.maxQuality &&
+                   (probe || demand + (kJpegIncreaseGrowth - 1.f) * own <= budget)) {
+            metric.quality = std::min(m_jpegConfig.maxQuality, metric.quality + kJpegIncrease);
+            ++metric.increases;
+        }
+    }
+    metric.occupancy = occupancy;
+    metric.bandwidth = m_bandwidth;
+    stream.lastStepMs = nowMs;
+    stream.writerDropped = m_stats.dropped;
+    stream.droppedSinceStep = false;
+}
+
+bool FrameWriter::jpegQuality(uint32_t streamId, JpegStreamQuality &quality)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<uint32_t, JpegStream>::const_iterator it = m_jpegStreams.find(streamId);
+    if (!m_adaptiveJpeg || it == m_jpegStreams.end()) return false;
+    quality = it->second.metric;
+    quality.bandwidth = m_bandwidth;
+    return true;
+}
+
+//-------------------------------------------------------------------------------
+// API C
+//-------------------------------------------------------------------------------
+extern "C" void* RetinaFaceWriterCreate(const WriterConfig* config)
+{
+    if (!config) return nullptr;
+    FrameWriter* writer = new FrameWriter(*config);
+    if (!writer->start()) {
+        delete writer;
+        return nullptr;
+    }
+    return writer;
+}
+
+extern "C" void RetinaFaceWriterDestroy(void* writer)
+{
+    delete static_cast<FrameWriter*>(writer);
+}
+
+extern "C" uint8_t* RetinaFaceWriterAcquire(void* writer)
+{
+    return writer ? static_cast<FrameWriter*>(writer)->acquireBuffer() : nullptr;
+}
+
+extern "C" void RetinaFaceWriterRelease(void* writer, uint8_t* buffer)
+{
+    if (writer && buffer) static_cast<FrameWriter*>(writer)->releaseBuffer(buffer);
+}
+
+extern "C" int RetinaFaceWriterSubmitFile(void* writer, uint8_t* buffer, uint64_t size, const char* path)
+{
+    if (!writer || !buffer) return 0;
+    return static_cast<FrameWriter*>(writer)->submitFile(buffer, size, path) ? 1 : 0;
+}
+
+extern "C" int RetinaFaceWriterSubmitAt(void* writer, uint8_t* buffer, uint64_t size, int fd, uint64_t offset)
+{
+    if (!writer || !buffer) return 0;
+    return static_cast<FrameWriter*>(writer)->submitAt(buffer, size, fd, offset) ? 1 : 0;
+}
+
+extern "C" int RetinaFaceWriterWriteFile(void* writer, const uint8_t* data, uint64_t size, const char* path)
+{
+    if (!writer || !data || !path) return 0;
+    FrameWriter* w = static_cast<FrameWriter*>(writer);
+    if (size > w->bufferSize()) {
+        std::cerr << "ERROR: " << path << " (" << size << " bytes) no cabe en un buffer de "
+                  << w->bufferSize() << " bytes" << std::endl;
+        return 0;
+    }
+    uint8_t* buffer = w->acquireBuffer();
+    if (!buffer) return 0;
+    std::memcpy(buffer, data, size);
+    return w->submitFile(buffer, size, path) ? 1 : 0;
+}
+
+extern "C" void RetinaFaceWriterFlush(void* writer)
+{
+    if (writer) static_cast<FrameWriter*>(writer)->flush();
+}
+
+extern "C" void RetinaFaceWriterGetStats(void* writer, WriterStats* stats)
+{
+    if (writer && stats) *stats = static_cast<FrameWriter*>(writer)->stats();
+}
+
+extern "C" void RetinaFaceWriterEnableAdaptiveJpeg(void* writer, const AdaptiveJpegConfig* config)
+{
+    if (writer && config) static_cast<FrameWriter*>(writer)->enableAdaptiveJpeg(*config);
+}
+
+extern "C" int RetinaFaceWriterJpegSettings(void* writer, uint32_t streamId, int* quality, int* downscale)
+{
+    if (!writer || !quality || !downscale) return 0;
+    return static_cast<FrameWriter*>(writer)->jpegSettings(streamId, *quality, *downscale) ? 1 : 0;
+}
+
+extern "C" void RetinaFaceWriterReportJpeg(void* writer, uint32_t streamId, uint64_t bytes, int dropped)
+{
+    if (writer) static_cast<FrameWriter*>(writer)->reportJpeg(streamId, bytes, dropped != 0);
+}
+
+extern "C" int RetinaFaceWriterJpegQuality(void* writer, uint32_t streamId, JpegStreamQuality* quality)
+{
+    if (!writer || !quality) return 0;
+    return static_cast<FrameWriter*>(writer)->jpegQuality(streamId, *quality) ? 1 : 0;
+}
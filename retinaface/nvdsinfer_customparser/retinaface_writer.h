@@ -0,0 +1,224 @@
+/******************************************************************************
+ * retinaface_writer.h
+ *
+ * Escritor asíncrono de frames y recortes codificados: pool de buffers de
+ * staging alineados, cola acotada con descarte y backend io_uring (buffers
+ * registrados, O_DIRECT) o hilos con pwrite
+ ******************************************************************************/
+
+#ifndef RETINAFACE_WRITER_H
+#define RETINAFACE_WRITER_H
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum WriterBackend {
+    WRITER_BACKEND_AUTO     = 0,  /**< io_uring si está compilado y disponible */
+    WRITER_BACKEND_THREADS  = 1,
+    WRITER_BACKEND_IO_URING = 2
+};
+
+/**
+ * @brief Parámetros del escritor.
+ */
+struct WriterConfig {
+    int bufferSize;    /**< Bytes por buffer de staging (se redondea a 4096) */
+    int bufferCount;   /**< Buffers del pool; acota las escrituras en vuelo */
+    int threads;       /**< Hilos del backend pwrite */
+    int queueDepth;    /**< Entradas del anillo io_uring */
+    int directIO;      /**< 1: O_DIRECT (sin page cache) con tamaños alineados */
+    int backend;       /**< WriterBackend */
+};
+
+/**
+ * @brief Contadores del escritor.
+ */
+struct WriterStats {
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t failed;
+    uint64_t dropped;     /**< acquireBuffer() sin buffers libres */
+    uint64_t bytes;
+    int32_t  pending;     /**< Escrituras encoladas o en vuelo */
+    int32_t  backend;     /**< WriterBackend en uso */
+};
+
+/**
+ * @brief Control de calidad JPEG por stream (AIMD): con descartes o el pool
+ *        por encima de highWater la calidad baja de forma multiplicativa y,
+ *        ya en minQuality, se reduce la resolución a la mitad; con el pool
+ *        por debajo de lowWater se recupera primero la resolución y luego la
+ *        calidad de forma aditiva, solo si la demanda estimada cabe en el
+ *        ancho de banda medido del disco.
+ */
+struct AdaptiveJpegConfig {
+    int32_t minQuality;
+    int32_t maxQuality;      /**< Calidad inicial */
+    int32_t maxDownscale;    /**< 1 (sin reducir), 2 o 4 */
+    int32_t intervalMs;      /**< Mínimo entre ajustes de un stream */
+    float   highWater;       /**< Fracción del pool en uso que cuenta como congestión */
+    float   lowWater;        /**< Por debajo se puede subir */
+};
+
+/**
+ * @brief Estado del control de un stream (métrica de calidad).
+ */
+struct JpegStreamQuality {
+    int32_t  quality;
+    int32_t  downscale;       /**< Divisor de ancho y alto */
+    float    bytesPerFrame;   /**< Media móvil del tamaño de los JPEG */
+    float    fps;             /**< Frames entregados al escritor por segundo */
+    float    bandwidth;       /**< Ancho de banda del disco estimado, bytes/s (0: sin medir) */
+    float    occupancy;       /**< Fracción del pool en uso en el último ajuste */
+    uint64_t frames;
+    uint64_t dropped;
+    uint64_t decreases;
+    uint64_t increases;
+};
+
+/**
+ * @brief Escritor de archivos con memoria de staging propia. El llamador pide
+ *        un buffer, escribe los bytes (p.ej. un JPEG) y lo entrega con
+ *        submitFile()/submitAt(); el buffer vuelve al pool al completarse.
+ *        Si no hay buffers libres, el frame se descarta en vez de bloquear el
+ *        pipeline. Thread-safe.
+ */
+class FrameWriter {
+public:
+    explicit FrameWriter(const WriterConfig &config);
+    ~FrameWriter();
+
+    /** @brief Reserva memoria y arranca el backend. */
+    bool start();
+
+    /** @brief Espera a que terminen las escrituras pendientes y para el backend. */
+    void stop();
+
+    /**
+     * @brief Buffer libre de bufferSize() bytes alineado a 4096, o nullptr
+     *        si el pool está agotado (cuenta como descarte).
+     */
+    uint8_t* acquireBuffer();
+
+    /** @brief Devuelve un buffer sin escribirlo. */
+    void releaseBuffer(uint8_t* buffer);
+
+    /** @brief Crea (o trunca) `path` con los `size` primeros bytes del buffer. */
+    bool submitFile(uint8_t* buffer, size_t size, const char* path);
+
+    /**
+     * @brief Escribe en `offset` de un descriptor del llamador, que debe
+     *        seguir abierto hasta completarse. Con O_DIRECT el offset debe
+     *        estar alineado a 4096 y el tamaño se rellena hasta 4096.
+     */
+    bool submitAt(uint8_t* buffer, size_t size, int fd, uint64_t offset);
+
+    /** @brief Bloquea hasta que no queden escrituras pendientes. */
+    void flush();
+
+    size_t bufferSize() const { return m_bufferSize; }
+    WriterStats stats();
+
+    /** @brief Activa el control adaptativo de calidad JPEG por stream. */
+    void enableAdaptiveJpeg(const AdaptiveJpegConfig &config);
+
+    /**
+     * @brief Calidad y divisor de resolución para el próximo JPEG del
+     *        stream. Devuelve false si el control no está activo.
+     */
+    bool jpegSettings(uint32_t streamId, int &quality, int &downscale);
+
+    /**
+     * @brief Resultado de un JPEG del stream (bytes 0 si se descartó por el
+     *        pool agotado); cada intervalMs ajusta la calidad del stream.
+     */
+    void reportJpeg(uint32_t streamId, size_t bytes, bool dropped, int64_t nowMs);
+    void reportJpeg(uint32_t streamId, size_t bytes, bool dropped);
+
+    bool jpegQuality(uint32_t streamId, JpegStreamQuality &quality);
+
+private:
+    FrameWriter(const FrameWriter &);
+    FrameWriter &operator=(const FrameWriter &);
+
+    struct JpegStream {
+        JpegStreamQuality metric;
+        int64_t           lastFrameMs;
+        int64_t           lastStepMs;
+        uint64_t          writerDropped;   // m_stats.dropped en el último ajuste
+        bool              droppedSinceStep;
+    };
+
+    JpegStream &jpegStream(uint32_t streamId);
+    void stepJpegQuality(JpegStream &stream, int64_t nowMs);
+    void sampleBandwidth(int64_t nowMs, float occupancy, bool congested);
+
+    struct Job {
+        int         buffer;    // Índice en el pool
+        size_t      size;
+        size_t      done;      // Bytes ya escritos (escrituras cortas)
+        int         rewrites;  // Bloques reescritos enteros tras escrituras cortas (O_DIRECT)
+        int         fd;        // -1 hasta abrir `path`
+        bool        ownsFd;
+        uint64_t    offset;
+        std::string path;
+    };
+
+    bool submit(Job* job);
+    int  bufferIndex(const uint8_t* buffer) const;
+    bool openJob(Job* job);
+    void finishJob(Job* job, bool ok);
+    size_t paddedSize(size_t size) const;
+    bool resumeShortWrite(Job* job);
+
+    void threadLoop();
+#if defined(RF_WITH_IO_URING)
+    bool startRing();
+    void ringLoop();
+    void*                       m_ring;        // struct io_uring*
+#endif
+
+    WriterConfig                m_config;
+    size_t                      m_bufferSize;
+    uint8_t*                    m_memory;
+    std::vector<int>            m_free;
+    std::deque<Job*>            m_queue;
+    std::vector<std::thread>    m_threads;
+    bool                        m_running;
+    int                         m_inflight;
+    WriterStats                 m_stats;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_wake;        // Trabajo nuevo para el backend
+    std::condition_variable     m_idle;        // Sin pendientes (flush)
+
+    bool                                m_adaptiveJpeg;
+    AdaptiveJpegConfig                  m_jpegConfig;
+    std::map<uint32_t, JpegStream>      m_jpegStreams;
+    float                               m_bandwidth;       // bytes/s medidos con el disco ocupado
+    int64_t                             m_bwSampleMs;
+    uint64_t                            m_bwSampleBytes;
+    int64_t                             m_bwSaturatedMs;   // Última medida con cola
+};
+
+extern "C" {
+void*    RetinaFaceWriterCreate(const WriterConfig* config);
+void     RetinaFaceWriterDestroy(void* writer);
+uint8_t* RetinaFaceWriterAcquire(void* writer);
+void     RetinaFaceWriterRelease(void* writer, uint8_t* buffer);
+int      RetinaFaceWriterSubmitFile(void* writer, uint8_t* buffer, uint64_t size, const char* path);
+int      RetinaFaceWriterSubmitAt(void* writer, uint8_t* buffer, uint64_t size, int fd, uint64_t offset);
+int      RetinaFaceWriterWriteFile(void* writer, const uint8_t* data, uint64_t size, const char* path);
+void     RetinaFaceWriterFlush(void* writer);
+void     RetinaFaceWriterGetStats(void* writer, WriterStats* stats);
+void     RetinaFaceWriterEnableAdaptiveJpeg(void* writer, const AdaptiveJpegConfig* config);
+int      RetinaFaceWriterJpegSettings(void* writer, uint32_t streamId, int* quality, int* downscale);
+void     RetinaFaceWriterReportJpeg(void* writer, uint32_t streamId, uint64_t bytes, int dropped);
+int      RetinaFaceWriterJpegQuality(void* writer, uint32_t streamId, JpegStreamQuality* quality);
+}
+
+#endif // RETINAFACE_WRITER_H
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+################################################################################
+# bench_crop_preprocess.py
+#
+# Compara la cadena OpenCV/NumPy (resize + cvtColor + aritmética + transpose)
+# contra el kernel nativo fusionado de retinaface_preprocess.cpp.
+#
+#   $ python3 tools/bench_crop_preprocess.py [num_crops]
+################################################################################
+
+import sys
+import time
+
+sys.path.append('../')
+sys.path.append('.')
+import cv2
+import numpy as np
+
+from common.retinaface_native import read_nvinfer_preprocess, resize_normalize
+
+CROP_W = 112
+CROP_H = 112
+
+
+def opencv_chain(frame, box, scale, offsets, color_format):
+    x, y, w, h = [int(v) for v in box]
+    crop = cv2.resize(frame[y:y + h, x:x + w], (CROP_W, CROP_H), interpolation=cv2.INTER_LINEAR)
+    crop = cv2.cvtColor(crop, cv2.COLOR_RGBA2BGR if color_format == 1 else cv2.COLOR_RGBA2RGB)
+    crop = (crop.astype(np.float32) - np.asarray(offsets, dtype=np.float32)) * scale
+    return np.ascontiguousarray(crop.transpose(2, 0, 1))
+
+
+def bench(name, fn, boxes):
+    fn(boxes[0])
+    start = time.perf_counter()
+    for box in boxes:
+        fn(box)
+    elapsed = time.perf_counter() - start
+    print("%-10s %8.1f us/crop" % (name, elapsed * 1e6 / len(boxes)))
+    return elapsed
+
+
+def main(args):
+    num_crops = int(args[1]) if len(args) > 1 else 2000
+    scale, offsets, color = read_nvinfer_preprocess("retinaface_config.txt")
+
+    rng = np.random.default_rng(0)
+    frame = rng.integers(0, 256, size=(1080, 1920, 4), dtype=np.uint8)
+    sizes = rng.integers(40, 300, size=num_crops)
+    boxes = [(rng.integers(0, 1920 - s), rng.integers(0, 1080 - s), s, s) for s in sizes]
+
+    out = np.empty((3, CROP_H, CROP_W), dtype=np.float32)
+    t_cv = bench("opencv", lambda b: opencv_chain(frame, b, scale, offsets, color), boxes)
+    t_nat = bench("native", lambda b: resize_normalize(frame, b, CROP_W, CROP_H, scale, offsets,
+                                                       color, out=out), boxes)
+    bench("native16", lambda b: resize_normalize(frame, b, CROP_W, CROP_H, scale, offsets,
+                                                 color, fp16=True), boxes)
+    print("speedup    %8.2fx" % (t_cv / t_nat))
+
+    # Diferencia máxima entre ambas cadenas (mismo muestreo de centros de píxel)
+    ref = opencv_chain(frame, boxes[0], scale, offsets, color)
+    nat = resize_normalize(frame, boxes[0], CROP_W, CROP_H, scale, offsets, color)
+    print("max |diff| %8.3f" % float(np.abs(ref - nat).max()))
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))